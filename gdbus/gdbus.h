@@ -94,6 +94,7 @@ enum GDBusPropertyFlags {
 	G_DBUS_PROPERTY_FLAG_DEPRECATED   = (1 << 0),
 	G_DBUS_PROPERTY_FLAG_EXPERIMENTAL = (1 << 1),
 	G_DBUS_PROPERTY_FLAG_TESTING      = (1 << 2),
+	G_DBUS_PROPERTY_FLAG_URGENT       = (1 << 3),
 };
 
 enum GDBusSecurityFlags {
@@ -336,6 +337,18 @@ void g_dbus_emit_property_changed_full(DBusConnection *connection,
 				const char *path, const char *interface,
 				const char *name,
 				GDbusPropertyChangedFlags flags);
+
+/*
+ * Emit PropertiesChanged for the given interface at most once per interval
+ * (in milliseconds), changes made meanwhile are merged into a single signal
+ * sent when the interval ends. Changing a property flagged with
+ * G_DBUS_PROPERTY_FLAG_URGENT sends the pending changes right away. An
+ * interval of 0, the default, disables the rate limiting.
+ */
+gboolean g_dbus_set_property_changed_interval(DBusConnection *connection,
+				const char *path, const char *interface,
+				unsigned int interval);
+
 gboolean g_dbus_get_properties(DBusConnection *connection, const char *path,
 				const char *interface, DBusMessageIter *iter);
 
@@ -62,6 +62,10 @@ struct interface_data {
 	const GDBusSignalTable *signals;
 	const GDBusPropertyTable *properties;
 	GSList *pending_prop;
+	unsigned int prop_interval;
+	gint64 prop_emitted;
+	guint prop_timeout;
+	struct generic_data *data;
 	void *user_data;
 	GDBusDestroyFunction destroy;
 };
@@ -1320,6 +1324,7 @@ done:
 	iface->properties = properties;
 	iface->user_data = user_data;
 	iface->destroy = destroy;
+	iface->data = data;
 
 	data->interfaces = g_slist_append(data->interfaces, iface);
 	if (data->parent == NULL)
@@ -1800,6 +1805,15 @@ fail:
 	return ret;
 }
 
+static void remove_interface_timeout(struct interface_data *iface)
+{
+	if (iface->prop_timeout == 0)
+		return;
+
+	g_source_remove(iface->prop_timeout);
+	iface->prop_timeout = 0;
+}
+
 static void process_properties_from_interface(struct generic_data *data,
 						struct interface_data *iface)
 {
@@ -1808,6 +1822,8 @@ static void process_properties_from_interface(struct generic_data *data,
 	DBusMessageIter iter, dict, array;
 	GSList *invalidated;
 
+	remove_interface_timeout(iface);
+
 	if (iface->pending_prop == NULL)
 		return;
 
@@ -1860,6 +1876,9 @@ static void process_properties_from_interface(struct generic_data *data,
 	g_slist_free(iface->pending_prop);
 	iface->pending_prop = NULL;
 
+	if (iface->prop_interval)
+		iface->prop_emitted = g_get_monotonic_time();
+
 	/* Use g_dbus_send_unref to avoid recursive calls to g_dbus_flush */
 	g_dbus_send_unref(data->conn, signal);
 }
@@ -1873,10 +1892,54 @@ static void process_property_changes(struct generic_data *data)
 	for (l = data->interfaces; l != NULL; l = l->next) {
 		struct interface_data *iface = l->data;
 
+		/* Wait for the end of the interval of rate limited ones */
+		if (iface->prop_timeout > 0)
+			continue;
+
 		process_properties_from_interface(data, iface);
 	}
 }
 
+static gboolean process_interface_changes(gpointer user_data)
+{
+	struct interface_data *iface = user_data;
+
+	iface->prop_timeout = 0;
+
+	process_properties_from_interface(iface->data, iface);
+
+	return FALSE;
+}
+
+static void add_interface_pending(struct generic_data *data,
+					struct interface_data *iface,
+					const GDBusPropertyTable *property)
+{
+	gint64 elapsed;
+
+	if (!iface->prop_interval ||
+			(property->flags & G_DBUS_PROPERTY_FLAG_URGENT)) {
+		/* Merge whatever was waiting into the next signal */
+		remove_interface_timeout(iface);
+
+		add_pending(data);
+		return;
+	}
+
+	/* Already waiting for the interval to end */
+	if (iface->prop_timeout > 0)
+		return;
+
+	elapsed = (g_get_monotonic_time() - iface->prop_emitted) / 1000;
+	if (elapsed >= iface->prop_interval) {
+		add_pending(data);
+		return;
+	}
+
+	iface->prop_timeout = g_timeout_add(iface->prop_interval - elapsed,
+					process_interface_changes, iface);
+}
+
 void g_dbus_emit_property_changed_full(DBusConnection *connection,
 				const char *path, const char *interface,
 				const char *name,
@@ -1918,10 +1981,11 @@ void g_dbus_emit_property_changed_full(DBusConnection *connection,
 	iface->pending_prop = g_slist_prepend(iface->pending_prop,
 						(void *) property);
 
-	if (flags & G_DBUS_PROPERTY_CHANGED_FLAG_FLUSH)
+	if (flags & G_DBUS_PROPERTY_CHANGED_FLAG_FLUSH) {
+		remove_interface_timeout(iface);
 		process_property_changes(data);
-	else
-		add_pending(data);
+	} else
+		add_interface_pending(data, iface, property);
 }
 
 void g_dbus_emit_property_changed(DBusConnection *connection, const char *path,
@@ -1930,6 +1994,29 @@ void g_dbus_emit_property_changed(DBusConnection *connection, const char *path,
 	g_dbus_emit_property_changed_full(connection, path, interface, name, 0);
 }
 
+gboolean g_dbus_set_property_changed_interval(DBusConnection *connection,
+				const char *path, const char *interface,
+				unsigned int interval)
+{
+	struct generic_data *data;
+	struct interface_data *iface;
+
+	if (path == NULL)
+		return FALSE;
+
+	if (!dbus_connection_get_object_path_data(connection, path,
+					(void **) &data) || data == NULL)
+		return FALSE;
+
+	iface = find_interface(data->interfaces, interface);
+	if (iface == NULL)
+		return FALSE;
+
+	iface->prop_interval = interval;
+
+	return TRUE;
+}
+
 gboolean g_dbus_get_properties(DBusConnection *connection, const char *path,
 				const char *interface, DBusMessageIter *iter)
 {
@@ -0,0 +1,191 @@
+// SPDX-License-Identifier: LGPL-2.1-or-later
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2026  agent <agent@local>
+ *
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include <ell/ell.h>
+
+#include "mesh/net-cache.h"
+
+/*
+ * Fixed capacity cache of recently seen network PDUs. Entries are kept in
+ * a ring buffer in arrival order, so the oldest one is evicted first, and
+ * are looked up through an open addressed index with linear probing. Both
+ * are allocated once, so adding an entry never allocates.
+ */
+
+#define MAX_CACHE_SIZE	0xffff
+
+struct cache_entry {
+	uint64_t key;
+	uint32_t key_ext;
+};
+
+struct net_cache {
+	struct cache_entry *entries;
+	uint16_t *index;		/* Entry slot + 1, 0 if unused */
+	unsigned int size;
+	unsigned int mask;
+	unsigned int head;
+	unsigned int count;
+};
+
+static unsigned int cache_hash(struct net_cache *cache, uint64_t key,
+							uint32_t key_ext)
+{
+	uint64_t hash = (key ^ ((uint64_t) key_ext << 24)) *
+							0x9e3779b97f4a7c15ULL;
+
+	return (hash >> 32) & cache->mask;
+}
+
+static unsigned int entry_hash(struct net_cache *cache, unsigned int slot)
+{
+	const struct cache_entry *entry = &cache->entries[slot];
+
+	return cache_hash(cache, entry->key, entry->key_ext);
+}
+
+struct net_cache *net_cache_new(unsigned int size)
+{
+	struct net_cache *cache;
+	unsigned int index_size = 1;
+
+	if (!size || size > MAX_CACHE_SIZE)
+		return NULL;
+
+	/* Keep the index at most half full so probe sequences stay short */
+	while (index_size < size * 2)
+		index_size <<= 1;
+
+	cache = l_new(struct net_cache, 1);
+	cache->entries = l_new(struct cache_entry, size);
+	cache->index = l_new(uint16_t, index_size);
+	cache->size = size;
+	cache->mask = index_size - 1;
+
+	return cache;
+}
+
+void net_cache_free(struct net_cache *cache)
+{
+	if (!cache)
+		return;
+
+	l_free(cache->entries);
+	l_free(cache->index);
+	l_free(cache);
+}
+
+void net_cache_clear(struct net_cache *cache)
+{
+	if (!cache)
+		return;
+
+	memset(cache->index, 0, (cache->mask + 1) * sizeof(*cache->index));
+	cache->head = 0;
+	cache->count = 0;
+}
+
+static void index_remove(struct net_cache *cache, unsigned int slot)
+{
+	unsigned int pos = entry_hash(cache, slot);
+	unsigned int next, home;
+
+	while (cache->index[pos] != slot + 1)
+		pos = (pos + 1) & cache->mask;
+
+	/*
+	 * Shift back the following entries of the probe sequence instead of
+	 * leaving a tombstone, so lookups never have to skip deleted slots.
+	 */
+	next = pos;
+
+	while (true) {
+		cache->index[pos] = 0;
+
+		while (true) {
+			next = (next + 1) & cache->mask;
+
+			if (!cache->index[next])
+				return;
+
+			home = entry_hash(cache, cache->index[next] - 1);
+
+			/* Stop at an entry whose home is not in (pos, next] */
+			if (pos <= next) {
+				if (home <= pos || home > next)
+					break;
+			} else if (home <= pos && home > next) {
+				break;
+			}
+		}
+
+		cache->index[pos] = cache->index[next];
+		pos = next;
+	}
+}
+
+/*
+ * Returns false if the key is already cached, otherwise adds it, evicting
+ * the oldest entry if the cache is full, and returns true.
+ */
+bool net_cache_add(struct net_cache *cache, uint64_t key, uint32_t key_ext)
+{
+	struct cache_entry *entry;
+	unsigned int pos, slot;
+
+	if (!cache)
+		return false;
+
+	pos = cache_hash(cache, key, key_ext);
+
+	while (cache->index[pos]) {
+		entry = &cache->entries[cache->index[pos] - 1];
+
+		if (entry->key == key && entry->key_ext == key_ext)
+			return false;
+
+		pos = (pos + 1) & cache->mask;
+	}
+
+	if (cache->count == cache->size) {
+		index_remove(cache, cache->head);
+		cache->head = (cache->head + 1) % cache->size;
+		cache->count--;
+
+		/* The removal may have shifted entries into the free spot */
+		pos = cache_hash(cache, key, key_ext);
+
+		while (cache->index[pos])
+			pos = (pos + 1) & cache->mask;
+	}
+
+	slot = (cache->head + cache->count) % cache->size;
+	entry = &cache->entries[slot];
+	entry->key = key;
+	entry->key_ext = key_ext;
+	cache->index[pos] = slot + 1;
+	cache->count++;
+
+	return true;
+}
+
+unsigned int net_cache_get_count(struct net_cache *cache)
+{
+	if (!cache)
+		return 0;
+
+	return cache->count;
+}
@@ -0,0 +1,17 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2026  agent <agent@local>
+ *
+ *
+ */
+
+struct net_cache;
+
+struct net_cache *net_cache_new(unsigned int size);
+void net_cache_free(struct net_cache *cache);
+void net_cache_clear(struct net_cache *cache);
+bool net_cache_add(struct net_cache *cache, uint64_t key, uint32_t key_ext);
+unsigned int net_cache_get_count(struct net_cache *cache);
@@ -33,6 +33,7 @@
 #include "mesh/model.h"
 #include "mesh/appkey.h"
 #include "mesh/rpl.h"
+#include "mesh/net-cache.h"
 
 #define abs_diff(a, b) ((a) > (b) ? (a) - (b) : (b) - (a))
 
@@ -129,8 +130,8 @@ struct mesh_net {
 	uint16_t features;
 
 	struct l_queue *subnets;
-	struct l_queue *msg_cache;
-	struct l_queue *replay_cache;
+	struct net_cache *msg_cache;
+	struct l_hashmap *replay_cache;
 	struct l_queue *sar_in;
 	struct l_queue *sar_out;
 	struct l_queue *sar_queue;
@@ -140,12 +141,6 @@ struct mesh_net {
 	struct l_queue *destinations;
 };
 
-struct mesh_msg {
-	uint16_t src;
-	uint32_t seq;
-	uint32_t mic;
-};
-
 struct mesh_sar {
 	unsigned int id;
 	struct l_timeout *seg_timeout;
@@ -206,7 +201,7 @@ struct net_beacon_data {
 	bool local;
 };
 
-static struct l_queue *fast_cache;
+static struct net_cache *fast_cache;
 static struct l_queue *nets;
 
 static void net_rx(void *net_ptr, void *user_data);
@@ -626,20 +621,20 @@ struct mesh_net *mesh_net_new(struct mesh_node *node)
 	net->tx_interval = DEFAULT_TRANSMIT_INTERVAL;
 
 	net->subnets = l_queue_new();
-	net->msg_cache = l_queue_new();
+	net->msg_cache = net_cache_new(MSG_CACHE_SIZE);
 	net->sar_in = l_queue_new();
 	net->sar_out = l_queue_new();
 	net->sar_queue = l_queue_new();
 	net->frnd_msgs = l_queue_new();
 	net->destinations = l_queue_new();
 	net->app_keys = l_queue_new();
-	net->replay_cache = l_queue_new();
+	net->replay_cache = l_hashmap_new();
 
 	if (!nets)
 		nets = l_queue_new();
 
 	if (!fast_cache)
-		fast_cache = l_queue_new();
+		fast_cache = net_cache_new(FAST_CACHE_SIZE);
 
 	return net;
 }
@@ -652,8 +647,8 @@ void mesh_net_free(void *user_data)
 		return;
 
 	l_queue_destroy(net->subnets, subnet_free);
-	l_queue_destroy(net->msg_cache, l_free);
-	l_queue_destroy(net->replay_cache, l_free);
+	net_cache_free(net->msg_cache);
+	l_hashmap_destroy(net->replay_cache, l_free);
 	l_queue_destroy(net->sar_in, mesh_sar_free);
 	l_queue_destroy(net->sar_out, mesh_sar_free);
 	l_queue_destroy(net->sar_queue, mesh_sar_free);
@@ -668,7 +663,7 @@ void mesh_net_free(void *user_data)
 
 void mesh_net_cleanup(void)
 {
-	l_queue_destroy(fast_cache, l_free);
+	net_cache_free(fast_cache);
 	fast_cache = NULL;
 	l_queue_destroy(nets, mesh_net_free);
 	nets = NULL;
@@ -1017,50 +1012,19 @@ void mesh_net_set_frnd_seq(struct mesh_net *net, bool seq)
 	net->friend_seq = seq;
 }
 
-static bool match_cache(const void *a, const void *b)
-{
-	const struct mesh_msg *msg = a;
-	const struct mesh_msg *tst = b;
-
-	if (msg->seq != tst->seq || msg->mic != tst->mic ||
-					msg->src != tst->src)
-		return false;
-
-	return true;
-}
-
 static bool msg_in_cache(struct mesh_net *net, uint16_t src, uint32_t seq,
 								uint32_t mic)
 {
-	struct mesh_msg *msg;
-	struct mesh_msg tst = {
-		.src = src,
-		.seq = seq,
-		.mic = mic,
-	};
-
-	msg = l_queue_find(net->msg_cache, match_cache, &tst);
-
-	if (msg) {
+	/* Oldest msg in cache is evicted once MSG_CACHE_SIZE is reached */
+	if (!net_cache_add(net->msg_cache, ((uint64_t) src << 24) | seq,
+								mic)) {
 		l_debug("Suppressing duplicate %4.4x + %6.6x + %8.8x",
 							src, seq, mic);
 		return true;
 	}
 
-	msg = l_new(struct mesh_msg, 1);
-	*msg = tst;
-	l_queue_push_head(net->msg_cache, msg);
 	l_debug("Add %4.4x + %6.6x + %8.8x", src, seq, mic);
 
-	if (l_queue_length(net->msg_cache) > MSG_CACHE_SIZE) {
-		msg = l_queue_peek_tail(net->msg_cache);
-		/* Remove Tail (oldest msg in cache) */
-		l_debug("Remove %4.4x + %6.6x + %8.8x",
-						msg->src, msg->seq, msg->mic);
-		if (l_queue_remove(net->msg_cache, msg))
-			l_free(msg);
-	}
-
 	return false;
 }
 
@@ -1632,15 +1596,7 @@ static void outseg_to(struct l_timeout *seg_timeout, void *user_data)
 					sar->seqZero, sar->last_nak);
 }
 
-static bool match_replay_cache(const void *a, const void *b)
-{
-	const struct mesh_rpl *rpe = a;
-	uint16_t src = L_PTR_TO_UINT(b);
-
-	return src == rpe->src;
-}
-
-static bool clean_old_iv_index(void *a, void *b)
+static bool clean_old_iv_index(const void *key, void *a, void *b)
 {
 	struct mesh_rpl *rpe = a;
 	uint32_t iv_index = L_PTR_TO_UINT(b);
@@ -1665,8 +1621,7 @@ static bool msg_check_replay_cache(struct mesh_net *net, uint16_t src,
 	if (!net || !net->node)
 		return true;
 
-	rpe = l_queue_find(net->replay_cache, match_replay_cache,
-						L_UINT_TO_PTR(src));
+	rpe = l_hashmap_lookup(net->replay_cache, L_UINT_TO_PTR(src));
 
 	if (rpe) {
 		if (iv_index > rpe->iv_index)
@@ -1677,10 +1632,10 @@ static bool msg_check_replay_cache(struct mesh_net *net, uint16_t src,
 			l_debug("Ignoring replayed packet");
 			return true;
 		}
-	} else if (l_queue_length(net->replay_cache) >= crpl) {
+	} else if (l_hashmap_size(net->replay_cache) >= crpl) {
 		/* SRC not in Replay Cache... see if there is space for it */
 
-		int ret = l_queue_foreach_remove(net->replay_cache,
+		int ret = l_hashmap_foreach_remove(net->replay_cache,
 				clean_old_iv_index, L_UINT_TO_PTR(iv_index));
 
 		/* Return true if no space could be freed */
@@ -1701,20 +1656,17 @@ static void msg_add_replay_cache(struct mesh_net *net, uint16_t src,
 	if (!net || !net->replay_cache)
 		return;
 
-	rpe = l_queue_remove_if(net->replay_cache, match_replay_cache,
-						L_UINT_TO_PTR(src));
+	rpe = l_hashmap_lookup(net->replay_cache, L_UINT_TO_PTR(src));
 
 	if (!rpe) {
 		rpe = l_new(struct mesh_rpl, 1);
 		rpe->src = src;
+		l_hashmap_insert(net->replay_cache, L_UINT_TO_PTR(src), rpe);
 	}
 
 	rpe->seq = seq;
 	rpe->iv_index = iv_index;
 	rpl_put_entry(net->node, src, iv_index, seq);
-
-	/* Optimize so that most recent conversations stay earliest in cache */
-	l_queue_push_head(net->replay_cache, rpe);
 }
 
 static bool msg_rxed(struct mesh_net *net, bool frnd, uint32_t iv_index,
@@ -2195,31 +2147,9 @@ static bool ctl_received(struct mesh_net *net, uint32_t net_key_id,
 	return true;
 }
 
-static bool find_fast_hash(const void *a, const void *b)
-{
-	const uint64_t *entry = a;
-	const uint64_t *test = b;
-
-	return *entry == *test;
-}
-
 static bool check_fast_cache(uint64_t hash)
 {
-	void *found = l_queue_find(fast_cache, find_fast_hash, &hash);
-	uint64_t *new_hash;
-
-	if (found)
-		return false;
-
-	if (l_queue_length(fast_cache) >= FAST_CACHE_SIZE)
-		new_hash = l_queue_pop_head(fast_cache);
-	else
-		new_hash = l_malloc(sizeof(hash));
-
-	*new_hash = hash;
-	l_queue_push_tail(fast_cache, new_hash);
-
-	return true;
+	return net_cache_add(fast_cache, hash, 0);
 }
 
 static bool match_by_dst(const void *a, const void *b)
@@ -2558,7 +2488,7 @@ static void iv_upd_to(struct l_timeout *upd_timeout, void *user_data)
 							net->iv_index, false);
 		l_queue_foreach(net->subnets, refresh_beacon, net);
 		queue_friend_update(net);
-		l_queue_clear(net->msg_cache, l_free);
+		net_cache_clear(net->msg_cache);
 		break;
 
 	case IV_UPD_INIT:
@@ -2994,7 +2924,7 @@ bool mesh_net_attach(struct mesh_net *net, struct mesh_io *io)
 			nets = l_queue_new();
 
 		if (!fast_cache)
-			fast_cache = l_queue_new();
+			fast_cache = net_cache_new(FAST_CACHE_SIZE);
 
 		mesh_io_register_recv_cb(io, snb, sizeof(snb),
 							beacon_recv, NULL);
@@ -3048,7 +2978,7 @@ bool mesh_net_iv_index_update(struct mesh_net *net)
 		return false;
 
 	l_debug("iv_upd_state = IV_UPD_UPDATING");
-	l_queue_clear(net->msg_cache, l_free);
+	net_cache_clear(net->msg_cache);
 
 	if (!mesh_config_write_iv_index(node_config_get(net->node),
 						net->iv_index + 1, true))
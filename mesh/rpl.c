@@ -33,104 +33,113 @@
 #include "mesh/rpl.h"
 
 static const char *rpl_dir = "/rpl";
+static const char *rpl_journal = "journal";
 
-bool rpl_put_entry(struct mesh_node *node, uint16_t src, uint32_t iv_index,
-								uint32_t seq)
-{
-	const char *node_path;
-	char src_file[PATH_MAX];
-	char seq_txt[7];
-	bool result = false;
-	DIR *dir;
-	int fd;
-
-	if (!IS_UNICAST(src))
-		return false;
+/*
+ * Replay protection entries are appended to a journal as fixed size
+ * records, the last record for a source wins. The journal is compacted
+ * into one record per source once it has grown well beyond the number of
+ * sources, and flushed to storage at most RPL_SYNC_TIMEOUT after a write or
+ * every RPL_SYNC_RECORDS records. The previous layout, one file per source
+ * under a directory per IV Index, is imported and removed on load.
+ */
+#define RPL_SYNC_TIMEOUT	1
+#define RPL_SYNC_RECORDS	64
+#define RPL_COMPACT_MIN		1024
 
-	node_path = node_get_storage_dir(node);
+#define RPL_OP_PUT		0x01
+#define RPL_OP_DEL		0x02
 
-	if (strlen(node_path) + strlen(rpl_dir) + 15 >= PATH_MAX)
-		return false;
+#define RPL_HDR_LEN		8
+#define RPL_REC_LEN		12
 
-	snprintf(src_file, PATH_MAX, "%s%s/%8.8x", node_path, rpl_dir,
-								iv_index);
-	dir = opendir(src_file);
+static const uint8_t rpl_magic[RPL_HDR_LEN] = {
+	'M', 'R', 'P', 'L', 0x01, 0x00, 0x00, 0x00
+};
 
-	if (!dir) {
-		if (mkdir(src_file, 0755) != 0)
-			l_error("Failed to create dir: %s", src_file);
-	} else
-		closedir(dir);
+struct rpl_store {
+	struct mesh_node *node;
+	char *path;
+	int fd;
+	struct l_hashmap *entries;	/* struct mesh_rpl indexed by src */
+	unsigned int records;		/* Records in the journal */
+	unsigned int unsynced;		/* Records not yet flushed */
+	unsigned int compact_min;	/* Records before compacting */
+	struct l_timeout *sync_timeout;
+};
 
-	snprintf(src_file, PATH_MAX, "%s%s/%8.8x/%4.4x", node_path, rpl_dir,
-								iv_index, src);
+static struct l_queue *stores;
 
-	fd = open(src_file, O_WRONLY | O_CREAT | O_TRUNC, 0600);
-	if (fd >= 0) {
-		snprintf(seq_txt, 7, "%6.6x", seq);
-		if (write(fd, seq_txt, 6) == 6)
-			result = true;
+static uint16_t rec_check(const uint8_t *rec)
+{
+	uint16_t sum1 = 0, sum2 = 0;
+	int i;
 
-		close(fd);
+	/* Fletcher-16, catches records torn by a power loss */
+	for (i = 0; i < RPL_REC_LEN - 2; i++) {
+		sum1 = (sum1 + rec[i]) % 255;
+		sum2 = (sum2 + sum1) % 255;
 	}
 
-	if (!result)
-		return false;
-
-	/* Delete RPL entry from old iv_index (if it exists) */
-	iv_index--;
-	snprintf(src_file, PATH_MAX, "%s%s/%8.8x/%4.4x", node_path, rpl_dir,
-								iv_index, src);
-	if (remove(src_file) < 0 && errno != ENOENT)
-		l_error("Failed to remove(%d): %s", errno, src_file);
-
-	return result;
+	return (sum2 << 8) | sum1;
 }
 
-void rpl_del_entry(struct mesh_node *node, uint16_t src)
+static void rec_build(uint8_t *rec, uint8_t op, uint16_t src,
+						uint32_t iv_index, uint32_t seq)
 {
-	const char *node_path;
-	char rpl_path[PATH_MAX];
-	struct dirent *entry;
-	DIR *dir;
+	rec[0] = op;
+	l_put_le16(src, rec + 1);
+	l_put_le32(iv_index, rec + 3);
+	rec[7] = seq;
+	rec[8] = seq >> 8;
+	rec[9] = seq >> 16;
+	l_put_le16(rec_check(rec), rec + 10);
+}
 
-	if (!IS_UNICAST(src))
-		return;
+static void entry_set(struct rpl_store *store, uint16_t src,
+						uint32_t iv_index, uint32_t seq)
+{
+	struct mesh_rpl *rpl;
 
-	node_path = node_get_storage_dir(node);
+	rpl = l_hashmap_lookup(store->entries, L_UINT_TO_PTR(src));
+	if (!rpl) {
+		rpl = l_new(struct mesh_rpl, 1);
+		rpl->src = src;
+		l_hashmap_insert(store->entries, L_UINT_TO_PTR(src), rpl);
+	}
 
-	if (strlen(node_path) + strlen(rpl_dir) + 15 >= PATH_MAX)
-		return;
+	rpl->iv_index = iv_index;
+	rpl->seq = seq;
+}
 
-	snprintf(rpl_path, PATH_MAX, "%s%s", node_path, rpl_dir);
-	dir = opendir(rpl_path);
+static bool apply_record(struct rpl_store *store, const uint8_t *rec)
+{
+	uint16_t src;
+	uint32_t iv_index, seq;
 
-	if (!dir)
-		return;
+	if (l_get_le16(rec + 10) != rec_check(rec))
+		return false;
 
-	/* Remove all instances of src address */
-	while ((entry = readdir(dir)) != NULL) {
-		if (entry->d_type == DT_DIR && entry->d_name[0] != '.') {
-			snprintf(rpl_path, PATH_MAX, "%s%s/%s/%4.4x",
-					node_path, rpl_dir, entry->d_name, src);
-			if (remove(rpl_path) < 0)
-				l_error("Failed to remove(%d): %s", errno,
-								rpl_path);
-		}
-	}
+	src = l_get_le16(rec + 1);
+	iv_index = l_get_le32(rec + 3);
+	seq = rec[7] | rec[8] << 8 | rec[9] << 16;
 
-	closedir(dir);
-}
+	if (!IS_UNICAST(src))
+		return false;
 
-static bool match_src(const void *a, const void *b)
-{
-	const struct mesh_rpl *rpl = a;
-	uint16_t src = L_PTR_TO_UINT(b);
+	switch (rec[0]) {
+	case RPL_OP_PUT:
+		entry_set(store, src, iv_index, seq);
+		return true;
+	case RPL_OP_DEL:
+		l_free(l_hashmap_remove(store->entries, L_UINT_TO_PTR(src)));
+		return true;
+	}
 
-	return rpl->src == src;
+	return false;
 }
 
-static void get_entries(const char *iv_path, struct l_queue *rpl_list)
+static void get_entries(struct rpl_store *store, const char *iv_path)
 {
 	struct mesh_rpl *rpl;
 	struct dirent *entry;
@@ -170,8 +179,8 @@ static void get_entries(const char *iv_path, struct l_queue *rpl_list)
 			if (read(fd, seq_txt, 6) == 6 &&
 					sscanf(seq_txt, "%06x", &seq) == 1) {
 
-				rpl = l_queue_find(rpl_list, match_src,
-						L_UINT_TO_PTR(src));
+				rpl = l_hashmap_lookup(store->entries,
+							L_UINT_TO_PTR(src));
 
 				if (rpl) {
 					/* Replace older entries */
@@ -179,14 +188,8 @@ static void get_entries(const char *iv_path, struct l_queue *rpl_list)
 						rpl->iv_index = iv_index;
 						rpl->seq = seq;
 					}
-				} else if (seq <= SEQ_MASK && IS_UNICAST(src)) {
-					rpl = l_new(struct mesh_rpl, 1);
-					rpl->src = src;
-					rpl->iv_index = iv_index;
-					rpl->seq = seq;
-
-					l_queue_push_head(rpl_list, rpl);
-				}
+				} else if (seq <= SEQ_MASK && IS_UNICAST(src))
+					entry_set(store, src, iv_index, seq);
 			}
 			close(fd);
 		}
@@ -195,57 +198,389 @@ static void get_entries(const char *iv_path, struct l_queue *rpl_list)
 	closedir(dir);
 }
 
-bool rpl_get_list(struct mesh_node *node, struct l_queue *rpl_list)
+/* Imports, or with no store just removes, the per IV Index directories */
+static bool legacy_entries(struct mesh_node *node, struct rpl_store *store)
 {
-	const char *node_path;
+	const char *node_path = node_get_storage_dir(node);
 	struct dirent *entry;
-	char *rpl_path;
-	size_t len;
+	char path[PATH_MAX];
+	bool found = false;
 	DIR *dir;
 
-	if (!rpl_list)
+	snprintf(path, PATH_MAX, "%s%s", node_path, rpl_dir);
+	dir = opendir(path);
+	if (!dir)
+		return false;
+
+	while ((entry = readdir(dir)) != NULL) {
+		if (entry->d_type != DT_DIR || entry->d_name[0] == '.')
+			continue;
+
+		snprintf(path, PATH_MAX, "%s%s/%s", node_path, rpl_dir,
+							entry->d_name);
+
+		if (store)
+			get_entries(store, path);
+		else
+			del_path(path);
+
+		found = true;
+	}
+
+	closedir(dir);
+
+	return found;
+}
+
+static void store_sync(struct rpl_store *store)
+{
+	l_timeout_remove(store->sync_timeout);
+	store->sync_timeout = NULL;
+
+	if (!store->unsynced)
+		return;
+
+	if (fdatasync(store->fd) < 0)
+		l_error("Failed to sync(%d): %s", errno, store->path);
+
+	store->unsynced = 0;
+}
+
+static void sync_timeout(struct l_timeout *timeout, void *user_data)
+{
+	store_sync(user_data);
+}
+
+static void put_record(const void *key, void *value, void *user_data)
+{
+	struct mesh_rpl *rpl = value;
+	uint8_t **rec = user_data;
+
+	rec_build(*rec, RPL_OP_PUT, rpl->src, rpl->iv_index, rpl->seq);
+	*rec += RPL_REC_LEN;
+}
+
+/*
+ * Rewrites the journal with a single record per source. The new journal is
+ * flushed before replacing the old one, so a power loss leaves either of
+ * them intact.
+ */
+static bool store_compact(struct rpl_store *store)
+{
+	char tmp_path[PATH_MAX];
+	uint8_t *data, *rec;
+	size_t len;
+	ssize_t written;
+	int fd, dir_fd;
+
+	snprintf(tmp_path, PATH_MAX, "%s.tmp", store->path);
+
+	/* Opened for appending, it becomes the journal once renamed */
+	fd = open(tmp_path, O_RDWR | O_CREAT | O_TRUNC | O_APPEND, 0600);
+	if (fd < 0) {
+		l_error("Failed to create(%d): %s", errno, tmp_path);
+		return false;
+	}
+
+	len = RPL_HDR_LEN + RPL_REC_LEN * l_hashmap_size(store->entries);
+	data = l_malloc(len);
+	memcpy(data, rpl_magic, RPL_HDR_LEN);
+	rec = data + RPL_HDR_LEN;
+	l_hashmap_foreach(store->entries, put_record, &rec);
+
+	written = write(fd, data, len);
+	l_free(data);
+
+	if (written != (ssize_t) len || fdatasync(fd) < 0) {
+		l_error("Failed to write(%d): %s", errno, tmp_path);
+		close(fd);
+		unlink(tmp_path);
+		return false;
+	}
+
+	if (rename(tmp_path, store->path) < 0) {
+		l_error("Failed to rename(%d): %s", errno, tmp_path);
+		close(fd);
+		unlink(tmp_path);
+		return false;
+	}
+
+	/* Make the rename itself durable */
+	snprintf(tmp_path, PATH_MAX, "%s%s", node_get_storage_dir(store->node),
+								rpl_dir);
+	dir_fd = open(tmp_path, O_RDONLY | O_DIRECTORY);
+	if (dir_fd >= 0) {
+		fsync(dir_fd);
+		close(dir_fd);
+	}
+
+	if (store->fd >= 0)
+		close(store->fd);
+
+	store->fd = fd;
+	store->records = l_hashmap_size(store->entries);
+	store->compact_min = RPL_COMPACT_MIN;
+	store->unsynced = 0;
+	l_timeout_remove(store->sync_timeout);
+	store->sync_timeout = NULL;
+
+	/* Only now the journal has all entries the old layout can go */
+	legacy_entries(store->node, NULL);
+
+	return true;
+}
+
+/* Replays the journal, dropping anything after the first invalid record */
+static bool store_load(struct rpl_store *store)
+{
+	struct stat st;
+	uint8_t *data;
+	size_t len, pos;
+
+	store->fd = open(store->path, O_RDWR | O_APPEND);
+	if (store->fd < 0)
+		return errno == ENOENT;
+
+	if (fstat(store->fd, &st) < 0) {
+		close(store->fd);
+		store->fd = -1;
+		return false;
+	}
+
+	len = st.st_size;
+	data = l_malloc(len ? len : 1);
+
+	if (read(store->fd, data, len) != (ssize_t) len) {
+		l_free(data);
+		close(store->fd);
+		store->fd = -1;
 		return false;
+	}
+
+	if (len < RPL_HDR_LEN || memcmp(data, rpl_magic, RPL_HDR_LEN)) {
+		l_error("Invalid RPL journal: %s", store->path);
+		pos = 0;
+		goto done;
+	}
+
+	for (pos = RPL_HDR_LEN; pos + RPL_REC_LEN <= len; pos += RPL_REC_LEN) {
+		if (!apply_record(store, data + pos))
+			break;
+
+		store->records++;
+	}
+
+done:
+	l_free(data);
+
+	if (pos == len)
+		return true;
+
+	l_warn("Discarding %zu bytes of RPL journal: %s", len - pos,
+								store->path);
+
+	/* Nothing valid at all, rewrite it from scratch */
+	if (pos < RPL_HDR_LEN) {
+		close(store->fd);
+		store->fd = -1;
+		return true;
+	}
+
+	if (ftruncate(store->fd, pos) < 0) {
+		l_error("Failed to truncate(%d): %s", errno, store->path);
+		return false;
+	}
+
+	return true;
+}
+
+static bool match_node(const void *a, const void *b)
+{
+	const struct rpl_store *store = a;
+
+	return store->node == b;
+}
+
+static struct rpl_store *get_store(struct mesh_node *node)
+{
+	struct rpl_store *store;
+	const char *node_path;
+	char path[PATH_MAX];
+	bool legacy;
+
+	store = l_queue_find(stores, match_node, node);
+	if (store)
+		return store;
 
 	node_path = node_get_storage_dir(node);
+	if (!node_path)
+		return NULL;
+
+	if (strlen(node_path) + strlen(rpl_dir) + 15 >= PATH_MAX)
+		return NULL;
+
+	snprintf(path, PATH_MAX, "%s%s/%s", node_path, rpl_dir, rpl_journal);
+
+	store = l_new(struct rpl_store, 1);
+	store->node = node;
+	store->path = l_strdup(path);
+	store->fd = -1;
+	store->compact_min = RPL_COMPACT_MIN;
+	store->entries = l_hashmap_new();
+
+	/* Journal records are newer than whatever is left of the old layout */
+	legacy = legacy_entries(node, store);
+
+	if (!store_load(store) || ((legacy || store->fd < 0) &&
+						!store_compact(store))) {
+		l_hashmap_destroy(store->entries, l_free);
+		if (store->fd >= 0)
+			close(store->fd);
+
+		l_free(store->path);
+		l_free(store);
+		return NULL;
+	}
+
+	if (!stores)
+		stores = l_queue_new();
+
+	l_queue_push_tail(stores, store);
+
+	return store;
+}
+
+static bool store_append(struct rpl_store *store, uint8_t op, uint16_t src,
+						uint32_t iv_index, uint32_t seq)
+{
+	uint8_t rec[RPL_REC_LEN];
+
+	/* The entries already include this change, so it gets compacted too */
+	if (store->records >= store->compact_min &&
+			store->records >= 4 * l_hashmap_size(store->entries)) {
+		if (store_compact(store))
+			return true;
+
+		/*
+		 * The journal is still intact, keep appending to it and only
+		 * try compacting again once it has grown some more.
+		 */
+		store->compact_min = store->records + RPL_COMPACT_MIN;
+	}
 
-	len = strlen(node_path) + strlen(rpl_dir) + 15;
+	rec_build(rec, op, src, iv_index, seq);
 
-	if (len > PATH_MAX)
+	if (write(store->fd, rec, sizeof(rec)) != sizeof(rec)) {
+		l_error("Failed to write(%d): %s", errno, store->path);
 		return false;
+	}
+
+	store->records++;
+
+	if (++store->unsynced >= RPL_SYNC_RECORDS) {
+		store_sync(store);
+		return true;
+	}
+
+	if (!store->sync_timeout)
+		store->sync_timeout = l_timeout_create(RPL_SYNC_TIMEOUT,
+						sync_timeout, store, NULL);
 
-	rpl_path = l_malloc(len);
-	snprintf(rpl_path, len, "%s%s", node_path, rpl_dir);
+	/* Without a main loop there is nothing to batch with */
+	if (!store->sync_timeout)
+		store_sync(store);
 
-	dir = opendir(rpl_path);
+	return true;
+}
 
-	if (!dir) {
-		l_error("Failed to read RPL dir: %s", rpl_path);
-		l_free(rpl_path);
+bool rpl_put_entry(struct mesh_node *node, uint16_t src, uint32_t iv_index,
+								uint32_t seq)
+{
+	struct rpl_store *store;
+
+	if (!IS_UNICAST(src))
+		return false;
+
+	store = get_store(node);
+	if (!store)
 		return false;
+
+	entry_set(store, src, iv_index, seq);
+
+	return store_append(store, RPL_OP_PUT, src, iv_index, seq);
+}
+
+void rpl_del_entry(struct mesh_node *node, uint16_t src)
+{
+	struct rpl_store *store;
+	struct mesh_rpl *rpl;
+
+	if (!IS_UNICAST(src))
+		return;
+
+	store = get_store(node);
+	if (!store)
+		return;
+
+	rpl = l_hashmap_remove(store->entries, L_UINT_TO_PTR(src));
+	if (!rpl)
+		return;
+
+	l_free(rpl);
+	store_append(store, RPL_OP_DEL, src, 0, 0);
+}
+
+static void copy_entry(const void *key, void *value, void *user_data)
+{
+	struct mesh_rpl *rpl = value;
+	struct l_hashmap *rpl_list = user_data;
+	struct mesh_rpl *rpe;
+
+	rpe = l_hashmap_lookup(rpl_list, key);
+	if (!rpe) {
+		rpe = l_new(struct mesh_rpl, 1);
+		l_hashmap_insert(rpl_list, key, rpe);
 	}
 
-	while ((entry = readdir(dir)) != NULL) {
-		/* RPL sequences are stored in files under iv_indexs */
-		if (entry->d_type == DT_DIR && entry->d_name[0] != '.') {
-			snprintf(rpl_path, len, "%s%s/%s",
-					node_path, rpl_dir, entry->d_name);
-			get_entries(rpl_path, rpl_list);
-		}
+	*rpe = *rpl;
+}
+
+bool rpl_get_list(struct mesh_node *node, struct l_hashmap *rpl_list)
+{
+	struct rpl_store *store;
+
+	if (!rpl_list)
+		return false;
+
+	store = get_store(node);
+	if (!store) {
+		l_error("Failed to read RPL of node: %s",
+						node_get_storage_dir(node));
+		return false;
 	}
 
-	l_free(rpl_path);
-	closedir(dir);
+	l_hashmap_foreach(store->entries, copy_entry, rpl_list);
+
+	return true;
+}
+
+static bool remove_stale(const void *key, void *value, void *user_data)
+{
+	struct mesh_rpl *rpl = value;
+	uint32_t cur = L_PTR_TO_UINT(user_data);
 
+	if (rpl->iv_index == cur || rpl->iv_index == cur - 1)
+		return false;
+
+	l_free(rpl);
 	return true;
 }
 
 void rpl_update(struct mesh_node *node, uint32_t cur)
 {
-	uint32_t old = cur - 1;
+	struct rpl_store *store;
 	const char *node_path;
-	struct dirent *entry;
 	char path[PATH_MAX];
-	DIR *dir;
 
 	node_path = node_get_storage_dir(node);
 	if (!node_path)
@@ -259,31 +594,38 @@ void rpl_update(struct mesh_node *node, uint32_t cur)
 	if (mkdir(path, 0755) != 0 && errno != EEXIST)
 		l_error("Failed to create dir(%d): %s", errno, path);
 
-	dir = opendir(path);
-	if (!dir)
+	store = get_store(node);
+	if (!store)
 		return;
 
-	/* Cleanup any stale or malformed trees */
-	while ((entry = readdir(dir)) != NULL) {
-		if (entry->d_type == DT_DIR && entry->d_name[0] != '.') {
-			uint32_t val;
-			bool del = false;
-
-			if (strlen(entry->d_name) != 8)
-				del = true;
-			else if (sscanf(entry->d_name, "%08x", &val) != 1)
-				del = true;
-
-			/* Delete all invalid iv_index trees */
-			if (del || (val != cur && val != old)) {
-				snprintf(path, PATH_MAX, "%s%s/%s",
-					node_path, rpl_dir, entry->d_name);
-				del_path(path);
-			}
-		}
+	/* Drop entries of any IV Index but the current and previous one */
+	l_hashmap_foreach_remove(store->entries, remove_stale,
+							L_UINT_TO_PTR(cur));
+	store_compact(store);
+}
+
+void rpl_release(struct mesh_node *node)
+{
+	struct rpl_store *store;
+
+	store = l_queue_remove_if(stores, match_node, node);
+	if (!store)
+		return;
+
+	if (store->fd >= 0) {
+		store_sync(store);
+		close(store->fd);
 	}
 
-	closedir(dir);
+	l_timeout_remove(store->sync_timeout);
+	l_hashmap_destroy(store->entries, l_free);
+	l_free(store->path);
+	l_free(store);
+
+	if (l_queue_isempty(stores)) {
+		l_queue_destroy(stores, NULL);
+		stores = NULL;
+	}
 }
 
 bool rpl_init(const char *node_path)
@@ -17,6 +17,7 @@ struct mesh_rpl {
 bool rpl_put_entry(struct mesh_node *node, uint16_t src, uint32_t iv_index,
 								uint32_t seq);
 void rpl_del_entry(struct mesh_node *node, uint16_t src);
-bool rpl_get_list(struct mesh_node *node, struct l_queue *rpl_list);
+bool rpl_get_list(struct mesh_node *node, struct l_hashmap *rpl_list);
 void rpl_update(struct mesh_node *node, uint32_t iv_index);
+void rpl_release(struct mesh_node *node);
 bool rpl_init(const char *node_path);
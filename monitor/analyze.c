@@ -16,6 +16,8 @@
 #define _GNU_SOURCE
 #include <stdio.h>
 #include <string.h>
+#include <stdlib.h>
+#include <pthread.h>
 #include <sys/time.h>
 #include <unistd.h>
 
@@ -32,6 +34,9 @@
 #define TIMEVAL_MSEC(_tv) \
 	(long long)((_tv)->tv_sec * 1000 + (_tv)->tv_usec / 1000)
 
+#define CONN_HASH_SIZE	64
+#define CHAN_HASH_SIZE	16
+
 struct hci_dev {
 	uint16_t index;
 	uint8_t type;
@@ -51,6 +56,9 @@ struct hci_dev {
 	unsigned long unknown;
 	uint16_t manufacturer;
 	struct queue *conn_list;
+	struct queue *conn_hash[CONN_HASH_SIZE];
+	size_t pos_added;
+	size_t pos_removed;
 };
 
 struct hci_stats {
@@ -85,6 +93,7 @@ struct hci_conn {
 	struct queue *tx_queue;
 	struct timeval last_rx;
 	struct queue *chan_list;
+	struct queue *chan_hash[CHAN_HASH_SIZE];
 	struct hci_stats rx;
 	struct hci_stats tx;
 };
@@ -111,7 +120,13 @@ struct l2cap_chan {
 	struct hci_stats tx;
 };
 
-static struct queue *dev_list;
+/*
+ * The analyzer state is per thread so that traces with multiple controllers
+ * can be analyzed in parallel, one controller index per worker.
+ */
+static __thread struct queue *dev_list;
+static __thread struct queue *dev_removed;
+static __thread size_t cur_pos;
 
 static void tmp_write(void *data, void *user_data)
 {
@@ -304,16 +319,31 @@ static bool chan_match_cid(const void *a, const void *b)
 	return chan->cid == cid && chan->out == out;
 }
 
+static struct l2cap_chan *chan_find(struct hci_conn *conn, uint16_t cid,
+								bool out)
+{
+	struct queue *bucket = conn->chan_hash[cid % CHAN_HASH_SIZE];
+	uint32_t val = cid | (out ? 0x10000 : 0);
+
+	return queue_find(bucket, chan_match_cid, UINT_TO_PTR(val));
+}
+
 static struct l2cap_chan *chan_lookup(struct hci_conn *conn, uint16_t cid,
 								bool out)
 {
 	struct l2cap_chan *chan;
-	uint32_t val = cid | (out ? 0x10000 : 0);
+	struct queue **bucket;
 
-	chan = queue_find(conn->chan_list, chan_match_cid, UINT_TO_PTR(val));
+	chan = chan_find(conn, cid, out);
 	if (!chan) {
 		chan = chan_alloc(conn, cid, out);
 		queue_push_tail(conn->chan_list, chan);
+
+		bucket = &conn->chan_hash[cid % CHAN_HASH_SIZE];
+		if (!*bucket)
+			*bucket = queue_new();
+
+		queue_push_tail(*bucket, chan);
 	}
 
 	return chan;
@@ -323,6 +353,7 @@ static void conn_destroy(void *data)
 {
 	struct hci_conn *conn = data;
 	const char *str;
+	int i;
 
 	switch (conn->type) {
 	case BTMON_CONN_ACL:
@@ -367,6 +398,10 @@ static void conn_destroy(void *data)
 
 	queue_destroy(conn->rx.plot, free);
 	queue_destroy(conn->tx.plot, free);
+
+	for (i = 0; i < CHAN_HASH_SIZE; i++)
+		queue_destroy(conn->chan_hash[i], NULL);
+
 	queue_destroy(conn->chan_list, chan_destroy);
 
 	queue_destroy(conn->tx_queue, free);
@@ -399,10 +434,15 @@ static bool conn_match_handle(const void *a, const void *b)
 	return (conn->handle == handle && !conn->terminated);
 }
 
+/*
+ * Connections are also kept in buckets by handle. Each bucket preserves the
+ * order of the connection list, so the first match is the same as when
+ * searching the whole list.
+ */
 static struct hci_conn *conn_lookup(struct hci_dev *dev, uint16_t handle)
 {
-	return queue_find(dev->conn_list, conn_match_handle,
-						UINT_TO_PTR(handle));
+	return queue_find(dev->conn_hash[handle % CONN_HASH_SIZE],
+				conn_match_handle, UINT_TO_PTR(handle));
 }
 
 static bool link_match_handle(const void *a, const void *b)
@@ -424,11 +464,18 @@ static struct hci_conn *conn_lookup_type(struct hci_dev *dev, uint16_t handle,
 {
 	struct hci_conn *conn;
 
-	conn = queue_find(dev->conn_list, conn_match_handle,
-						UINT_TO_PTR(handle));
+	conn = conn_lookup(dev, handle);
 	if (!conn || (type && conn->type != type)) {
+		struct queue **bucket;
+
 		conn = conn_alloc(dev, handle, type);
 		queue_push_tail(dev->conn_list, conn);
+
+		bucket = &dev->conn_hash[handle % CONN_HASH_SIZE];
+		if (!*bucket)
+			*bucket = queue_new();
+
+		queue_push_tail(*bucket, conn);
 	}
 
 	return conn;
@@ -438,6 +485,7 @@ static void dev_destroy(void *data)
 {
 	struct hci_dev *dev = data;
 	const char *str;
+	int i;
 
 	switch (dev->type) {
 	case 0x00:
@@ -470,6 +518,10 @@ static void dev_destroy(void *data)
 	printf("  %lu user logs\n", dev->user_log);
 	printf("  %lu control messages \n", dev->ctrl_msg);
 	printf("  %lu unknown opcodes\n", dev->unknown);
+
+	for (i = 0; i < CONN_HASH_SIZE; i++)
+		queue_destroy(dev->conn_hash[i], NULL);
+
 	queue_destroy(dev->conn_list, conn_destroy);
 	printf("\n");
 
@@ -484,6 +536,7 @@ static struct hci_dev *dev_alloc(uint16_t index)
 
 	dev->index = index;
 	dev->manufacturer = 0xffff;
+	dev->pos_added = cur_pos;
 
 	dev->conn_list = queue_new();
 
@@ -659,10 +712,7 @@ static void l2cap_le_sig(struct hci_conn *conn, bool out,
 			chan->mode = 0x80; /* LE Credit */
 
 			/* Propagate PSM from the request channel */
-			req_chan = queue_find(conn->chan_list,
-					chan_match_cid,
-					UINT_TO_PTR(dcid |
-						(!out ? 0x10000 : 0)));
+			req_chan = chan_find(conn, dcid, !out);
 			if (req_chan && req_chan->psm)
 				chan->psm = req_chan->psm;
 		}
@@ -718,6 +768,13 @@ static void del_index(struct timeval *tv, uint16_t index,
 		return;
 	}
 
+	/* Parallel analysis prints removed devices once all are done */
+	if (dev_removed) {
+		dev->pos_removed = cur_pos;
+		queue_push_tail(dev_removed, dev);
+		return;
+	}
+
 	dev_destroy(dev);
 }
 
@@ -1374,30 +1431,133 @@ static void unknown_opcode(struct timeval *tv, uint16_t index,
 	dev->unknown++;
 }
 
-void analyze_trace(const char *path)
+/*
+ * Packets before the time window are not analyzed, but controller
+ * information still needs to be tracked.
+ */
+static void track_index(struct timeval *tv, uint16_t index, uint16_t opcode,
+					const void *data, uint16_t size)
 {
-	struct btsnoop *btsnoop_file;
-	unsigned long num_packets = 0;
-	unsigned long num_frames = 0;
-	uint32_t format;
+	switch (opcode) {
+	case BTSNOOP_OPCODE_NEW_INDEX:
+		new_index(tv, index, data, size);
+		break;
+	case BTSNOOP_OPCODE_DEL_INDEX:
+		del_index(tv, index, data, size);
+		break;
+	case BTSNOOP_OPCODE_INDEX_INFO:
+		info_index(tv, index, data, size);
+		break;
+	}
+}
 
-	btsnoop_file = btsnoop_open(path, BTSNOOP_FLAG_PKLG_SUPPORT);
-	if (!btsnoop_file)
-		return;
+static void replay_index(struct btsnoop *btsnoop_file, size_t end)
+{
+	size_t pos;
 
-	format = btsnoop_get_format(btsnoop_file);
+	for (pos = 0; pos < end; pos++) {
+		const void *buf;
+		struct timeval tv;
+		uint16_t index, opcode, pktlen;
 
-	switch (format) {
-	case BTSNOOP_FORMAT_HCI:
-	case BTSNOOP_FORMAT_UART:
-	case BTSNOOP_FORMAT_MONITOR:
+		if (!btsnoop_peek_hci(btsnoop_file, pos, &tv, &index, &opcode,
+							&buf, &pktlen))
+			break;
+
+		track_index(&tv, index, opcode, buf, pktlen);
+	}
+}
+
+static bool is_frame(uint16_t opcode)
+{
+	switch (opcode) {
+	case BTSNOOP_OPCODE_COMMAND_PKT:
+	case BTSNOOP_OPCODE_EVENT_PKT:
+	case BTSNOOP_OPCODE_ACL_TX_PKT:
+	case BTSNOOP_OPCODE_ACL_RX_PKT:
+	case BTSNOOP_OPCODE_SCO_TX_PKT:
+	case BTSNOOP_OPCODE_SCO_RX_PKT:
+	case BTSNOOP_OPCODE_ISO_TX_PKT:
+	case BTSNOOP_OPCODE_ISO_RX_PKT:
+		return true;
+	}
+
+	return false;
+}
+
+static void analyze_packet(struct timeval *tv, uint16_t index,
+					uint16_t opcode, unsigned long frame,
+					const void *buf, uint16_t pktlen)
+{
+	switch (opcode) {
+	case BTSNOOP_OPCODE_NEW_INDEX:
+		new_index(tv, index, buf, pktlen);
+		break;
+	case BTSNOOP_OPCODE_DEL_INDEX:
+		del_index(tv, index, buf, pktlen);
+		break;
+	case BTSNOOP_OPCODE_COMMAND_PKT:
+		command_pkt(tv, index, buf, pktlen);
+		break;
+	case BTSNOOP_OPCODE_EVENT_PKT:
+		event_pkt(tv, index, frame, buf, pktlen);
+		break;
+	case BTSNOOP_OPCODE_ACL_TX_PKT:
+		acl_pkt(tv, index, true, buf, pktlen);
+		break;
+	case BTSNOOP_OPCODE_ACL_RX_PKT:
+		acl_pkt(tv, index, false, buf, pktlen);
+		break;
+	case BTSNOOP_OPCODE_SCO_TX_PKT:
+		sco_pkt(tv, index, true, buf, pktlen);
+		break;
+	case BTSNOOP_OPCODE_SCO_RX_PKT:
+		sco_pkt(tv, index, false, buf, pktlen);
+		break;
+	case BTSNOOP_OPCODE_OPEN_INDEX:
+	case BTSNOOP_OPCODE_CLOSE_INDEX:
+		break;
+	case BTSNOOP_OPCODE_INDEX_INFO:
+		info_index(tv, index, buf, pktlen);
+		break;
+	case BTSNOOP_OPCODE_VENDOR_DIAG:
+		vendor_diag(tv, index, buf, pktlen);
+		break;
+	case BTSNOOP_OPCODE_SYSTEM_NOTE:
+		system_note(tv, index, buf, pktlen);
+		break;
+	case BTSNOOP_OPCODE_USER_LOGGING:
+		user_log(tv, index, buf, pktlen);
+		break;
+	case BTSNOOP_OPCODE_CTRL_OPEN:
+	case BTSNOOP_OPCODE_CTRL_CLOSE:
+	case BTSNOOP_OPCODE_CTRL_COMMAND:
+	case BTSNOOP_OPCODE_CTRL_EVENT:
+		ctrl_msg(tv, index, buf, pktlen);
+		break;
+	case BTSNOOP_OPCODE_ISO_TX_PKT:
+		iso_pkt(tv, index, true, buf, pktlen);
+		break;
+	case BTSNOOP_OPCODE_ISO_RX_PKT:
+		iso_pkt(tv, index, false, buf, pktlen);
 		break;
 	default:
-		fprintf(stderr, "Unsupported packet format\n");
-		goto done;
+		unknown_opcode(tv, index, buf, pktlen);
+		break;
 	}
+}
 
-	dev_list = queue_new();
+static unsigned long analyze_serial(struct btsnoop *btsnoop_file,
+					const struct timeval *from,
+					const struct timeval *to)
+{
+	unsigned long num_packets = 0;
+	unsigned long num_frames = 0;
+
+	if (from && btsnoop_index(btsnoop_file)) {
+		btsnoop_seek_time(btsnoop_file, from);
+		replay_index(btsnoop_file, btsnoop_tell(btsnoop_file));
+	}
 
 	while (1) {
 		unsigned char buf[BTSNOOP_MAX_PACKET_SIZE];
@@ -1408,74 +1568,326 @@ void analyze_trace(const char *path)
 								buf, &pktlen))
 			break;
 
-		switch (opcode) {
-		case BTSNOOP_OPCODE_NEW_INDEX:
-			new_index(&tv, index, buf, pktlen);
-			break;
-		case BTSNOOP_OPCODE_DEL_INDEX:
-			del_index(&tv, index, buf, pktlen);
+		if (to && timercmp(&tv, to, >))
 			break;
-		case BTSNOOP_OPCODE_COMMAND_PKT:
-			num_frames++;
-			command_pkt(&tv, index, buf, pktlen);
-			break;
-		case BTSNOOP_OPCODE_EVENT_PKT:
-			num_frames++;
-			event_pkt(&tv, index, num_frames, buf, pktlen);
-			break;
-		case BTSNOOP_OPCODE_ACL_TX_PKT:
-			num_frames++;
-			acl_pkt(&tv, index, true, buf, pktlen);
-			break;
-		case BTSNOOP_OPCODE_ACL_RX_PKT:
-			num_frames++;
-			acl_pkt(&tv, index, false, buf, pktlen);
-			break;
-		case BTSNOOP_OPCODE_SCO_TX_PKT:
-			num_frames++;
-			sco_pkt(&tv, index, true, buf, pktlen);
-			break;
-		case BTSNOOP_OPCODE_SCO_RX_PKT:
-			num_frames++;
-			sco_pkt(&tv, index, false, buf, pktlen);
-			break;
-		case BTSNOOP_OPCODE_OPEN_INDEX:
-		case BTSNOOP_OPCODE_CLOSE_INDEX:
-			break;
-		case BTSNOOP_OPCODE_INDEX_INFO:
-			info_index(&tv, index, buf, pktlen);
-			break;
-		case BTSNOOP_OPCODE_VENDOR_DIAG:
-			vendor_diag(&tv, index, buf, pktlen);
-			break;
-		case BTSNOOP_OPCODE_SYSTEM_NOTE:
-			system_note(&tv, index, buf, pktlen);
-			break;
-		case BTSNOOP_OPCODE_USER_LOGGING:
-			user_log(&tv, index, buf, pktlen);
-			break;
-		case BTSNOOP_OPCODE_CTRL_OPEN:
-		case BTSNOOP_OPCODE_CTRL_CLOSE:
-		case BTSNOOP_OPCODE_CTRL_COMMAND:
-		case BTSNOOP_OPCODE_CTRL_EVENT:
-			ctrl_msg(&tv, index, buf, pktlen);
-			break;
-		case BTSNOOP_OPCODE_ISO_TX_PKT:
-			num_frames++;
-			iso_pkt(&tv, index, true, buf, pktlen);
-			break;
-		case BTSNOOP_OPCODE_ISO_RX_PKT:
+
+		if (from && timercmp(&tv, from, <)) {
+			track_index(&tv, index, opcode, buf, pktlen);
+			continue;
+		}
+
+		if (is_frame(opcode))
 			num_frames++;
-			iso_pkt(&tv, index, false, buf, pktlen);
+
+		analyze_packet(&tv, index, opcode, num_frames, buf, pktlen);
+
+		num_packets++;
+	}
+
+	return num_packets;
+}
+
+struct analyze_pkt {
+	size_t pos;
+	unsigned long frame;
+	bool track;
+};
+
+struct analyze_part {
+	struct analyze_pkt *pkts;
+	size_t num_pkts;
+	size_t max_pkts;
+	struct queue *dev_list;
+	struct queue *dev_removed;
+};
+
+struct analyze_job {
+	struct btsnoop *btsnoop_file;
+	struct analyze_part **parts;
+	unsigned int num_parts;
+	unsigned int next_part;
+};
+
+static bool part_add(struct analyze_part *part, size_t pos,
+					unsigned long frame, bool track)
+{
+	struct analyze_pkt *pkt;
+
+	if (part->num_pkts == part->max_pkts) {
+		size_t max = part->max_pkts ? part->max_pkts * 2 : 256;
+
+		pkt = reallocarray(part->pkts, max, sizeof(*pkt));
+		if (!pkt)
+			return false;
+
+		part->pkts = pkt;
+		part->max_pkts = max;
+	}
+
+	pkt = &part->pkts[part->num_pkts++];
+	pkt->pos = pos;
+	pkt->frame = frame;
+	pkt->track = track;
+
+	return true;
+}
+
+static void *analyze_worker(void *user_data)
+{
+	struct analyze_job *job = user_data;
+	unsigned int i;
+
+	while ((i = __sync_fetch_and_add(&job->next_part, 1)) <
+							job->num_parts) {
+		struct analyze_part *part = job->parts[i];
+		size_t n;
+
+		dev_list = queue_new();
+		dev_removed = queue_new();
+
+		for (n = 0; n < part->num_pkts; n++) {
+			struct analyze_pkt *pkt = &part->pkts[n];
+			unsigned char buf[BTSNOOP_MAX_PACKET_SIZE];
+			const void *data;
+			struct timeval tv;
+			uint16_t index, opcode, pktlen;
+
+			if (!btsnoop_peek_hci(job->btsnoop_file, pkt->pos, &tv,
+						&index, &opcode, &data, &pktlen))
+				break;
+
+			/* Decoders may read past short packets */
+			memcpy(buf, data, pktlen);
+
+			cur_pos = pkt->pos;
+
+			if (pkt->track)
+				track_index(&tv, index, opcode, buf, pktlen);
+			else
+				analyze_packet(&tv, index, opcode, pkt->frame,
+								buf, pktlen);
+		}
+
+		part->dev_list = dev_list;
+		part->dev_removed = dev_removed;
+	}
+
+	dev_list = NULL;
+	dev_removed = NULL;
+
+	return NULL;
+}
+
+static int dev_cmp_added(const void *a, const void *b)
+{
+	const struct hci_dev *dev1 = *(const struct hci_dev **) a;
+	const struct hci_dev *dev2 = *(const struct hci_dev **) b;
+
+	return (dev1->pos_added > dev2->pos_added) -
+				(dev1->pos_added < dev2->pos_added);
+}
+
+static int dev_cmp_removed(const void *a, const void *b)
+{
+	const struct hci_dev *dev1 = *(const struct hci_dev **) a;
+	const struct hci_dev *dev2 = *(const struct hci_dev **) b;
+
+	return (dev1->pos_removed > dev2->pos_removed) -
+				(dev1->pos_removed < dev2->pos_removed);
+}
+
+static void dev_collect(void *data, void *user_data)
+{
+	struct hci_dev ***devs = user_data;
+
+	*(*devs)++ = data;
+}
+
+/*
+ * Print devices of all partitions in the order the serial analysis would
+ * have destroyed them.
+ */
+static void destroy_sorted(struct analyze_part **parts, unsigned int num_parts,
+				bool removed)
+{
+	struct hci_dev **devs, **ptr;
+	size_t i, num_devs = 0;
+
+	for (i = 0; i < num_parts; i++)
+		num_devs += queue_length(removed ? parts[i]->dev_removed :
+							parts[i]->dev_list);
+
+	if (!num_devs)
+		return;
+
+	devs = new0(struct hci_dev *, num_devs);
+	ptr = devs;
+
+	for (i = 0; i < num_parts; i++)
+		queue_foreach(removed ? parts[i]->dev_removed :
+					parts[i]->dev_list, dev_collect, &ptr);
+
+	qsort(devs, num_devs, sizeof(*devs),
+				removed ? dev_cmp_removed : dev_cmp_added);
+
+	for (i = 0; i < num_devs; i++)
+		dev_destroy(devs[i]);
+
+	free(devs);
+}
+
+static bool analyze_parallel(struct btsnoop *btsnoop_file,
+					const struct timeval *from,
+					const struct timeval *to,
+					unsigned int jobs)
+{
+	struct analyze_part **index_map, **parts;
+	struct analyze_job job;
+	pthread_t *threads;
+	unsigned long num_packets = 0;
+	unsigned long num_frames = 0;
+	size_t pos, start = 0, count;
+	unsigned int i;
+	bool ret = false;
+
+	if (!btsnoop_index(btsnoop_file))
+		return false;
+
+	if (from) {
+		btsnoop_seek_time(btsnoop_file, from);
+		start = btsnoop_tell(btsnoop_file);
+	}
+
+	index_map = new0(struct analyze_part *, 0x10000);
+
+	memset(&job, 0, sizeof(job));
+	job.btsnoop_file = btsnoop_file;
+
+	/*
+	 * Split the trace by controller index. Frame numbers are assigned
+	 * here since they count packets across all controllers.
+	 */
+	count = btsnoop_get_count(btsnoop_file);
+
+	for (pos = 0; pos < count; pos++) {
+		struct analyze_part *part;
+		const void *data;
+		struct timeval tv;
+		uint16_t index, opcode, pktlen;
+		bool track = pos < start;
+
+		if (!btsnoop_peek_hci(btsnoop_file, pos, &tv, &index, &opcode,
+							&data, &pktlen))
 			break;
-		default:
-			unknown_opcode(&tv, index, buf, pktlen);
+
+		if (!track && to && timercmp(&tv, to, >))
 			break;
+
+		part = index_map[index];
+		if (!part) {
+			parts = reallocarray(job.parts, job.num_parts + 1,
+							sizeof(*parts));
+			if (!parts)
+				goto failed;
+
+			job.parts = parts;
+
+			part = new0(struct analyze_part, 1);
+			index_map[index] = part;
+			job.parts[job.num_parts++] = part;
+		}
+
+		if (track) {
+			if (!part_add(part, pos, 0, true))
+				goto failed;
+			continue;
 		}
 
+		if (is_frame(opcode))
+			num_frames++;
+
+		if (!part_add(part, pos, num_frames, false))
+			goto failed;
+
 		num_packets++;
 	}
 
+	free(index_map);
+	index_map = NULL;
+
+	if (jobs > job.num_parts)
+		jobs = job.num_parts;
+
+	threads = new0(pthread_t, jobs);
+
+	for (i = 0; i < jobs; i++) {
+		if (pthread_create(&threads[i], NULL, analyze_worker, &job))
+			break;
+	}
+
+	/* Run in this thread as well in case no worker could be started */
+	if (!i)
+		analyze_worker(&job);
+
+	while (i--)
+		pthread_join(threads[i], NULL);
+
+	free(threads);
+
+	destroy_sorted(job.parts, job.num_parts, true);
+
+	printf("Trace contains %lu packets\n\n", num_packets);
+
+	destroy_sorted(job.parts, job.num_parts, false);
+
+	ret = true;
+
+failed:
+	/* Without memory for the packet lists the serial analysis is used */
+	free(index_map);
+
+	for (i = 0; i < job.num_parts; i++) {
+		queue_destroy(job.parts[i]->dev_list, NULL);
+		queue_destroy(job.parts[i]->dev_removed, NULL);
+		free(job.parts[i]->pkts);
+		free(job.parts[i]);
+	}
+
+	free(job.parts);
+
+	return ret;
+}
+
+void analyze_trace(const char *path, const struct timeval *from,
+				const struct timeval *to, unsigned int jobs)
+{
+	struct btsnoop *btsnoop_file;
+	unsigned long num_packets;
+	uint32_t format;
+
+	btsnoop_file = btsnoop_open(path, BTSNOOP_FLAG_PKLG_SUPPORT);
+	if (!btsnoop_file)
+		return;
+
+	format = btsnoop_get_format(btsnoop_file);
+
+	switch (format) {
+	case BTSNOOP_FORMAT_HCI:
+	case BTSNOOP_FORMAT_UART:
+	case BTSNOOP_FORMAT_MONITOR:
+		break;
+	default:
+		fprintf(stderr, "Unsupported packet format\n");
+		goto done;
+	}
+
+	if (jobs > 1 && analyze_parallel(btsnoop_file, from, to, jobs))
+		goto done;
+
+	dev_list = queue_new();
+
+	num_packets = analyze_serial(btsnoop_file, from, to);
+
 	printf("Trace contains %lu packets\n\n", num_packets);
 
 	queue_destroy(dev_list, dev_destroy);
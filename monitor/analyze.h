@@ -9,4 +9,7 @@
  *
  */
 
-void analyze_trace(const char *path);
+#include <sys/time.h>
+
+void analyze_trace(const char *path, const struct timeval *from,
+				const struct timeval *to, unsigned int jobs);
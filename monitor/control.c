@@ -1521,14 +1521,67 @@ int control_rtt(char *jlink, char *rtt)
 	return 0;
 }
 
-bool control_writer(const char *path)
+#define WRITER_FLUSH_INTERVAL 1000
+
+static void writer_flush_callback(int id, void *user_data)
+{
+	btsnoop_flush(btsnoop_file);
+
+	if (mainloop_modify_timeout(id, WRITER_FLUSH_INTERVAL) < 0)
+		mainloop_exit_failure();
+}
+
+bool control_writer(const char *path, size_t buffer_size)
 {
 	btsnoop_file = btsnoop_create(path, 0, 0, BTSNOOP_FORMAT_MONITOR);
+	if (!btsnoop_file)
+		return false;
+
+	if (!buffer_size)
+		return true;
+
+	if (!btsnoop_set_buffer(btsnoop_file, buffer_size,
+						WRITER_FLUSH_INTERVAL))
+		goto failed;
 
-	return !!btsnoop_file;
+	if (mainloop_add_timeout(WRITER_FLUSH_INTERVAL, writer_flush_callback,
+							NULL, NULL) < 0)
+		goto failed;
+
+	return true;
+
+failed:
+	btsnoop_unref(btsnoop_file);
+	btsnoop_file = NULL;
+
+	return false;
 }
 
-void control_reader(const char *path, bool pager)
+void control_cleanup(void)
+{
+	btsnoop_unref(btsnoop_file);
+	btsnoop_file = NULL;
+}
+
+static void replay_index(struct btsnoop *btsnoop_file, size_t end)
+{
+	size_t pos;
+
+	for (pos = 0; pos < end; pos++) {
+		const void *buf;
+		struct timeval tv;
+		uint16_t index, opcode, pktlen;
+
+		if (!btsnoop_peek_hci(btsnoop_file, pos, &tv, &index, &opcode,
+							&buf, &pktlen))
+			break;
+
+		packet_track_index(index, opcode, buf, pktlen);
+	}
+}
+
+void control_reader(const char *path, bool pager,
+			const struct timeval *from, const struct timeval *to)
 {
 	unsigned char buf[BTSNOOP_MAX_PACKET_SIZE];
 	uint16_t pktlen;
@@ -1541,6 +1594,17 @@ void control_reader(const char *path, bool pager)
 
 	format = btsnoop_get_format(btsnoop_file);
 
+	/*
+	 * Index the trace when a time window is requested so its start can
+	 * be looked up without reading all prior packets. The controller
+	 * details announced before the window are still needed to decode
+	 * the packets within it.
+	 */
+	if (from && btsnoop_index(btsnoop_file)) {
+		btsnoop_seek_time(btsnoop_file, from);
+		replay_index(btsnoop_file, btsnoop_tell(btsnoop_file));
+	}
+
 	switch (format) {
 	case BTSNOOP_FORMAT_HCI:
 	case BTSNOOP_FORMAT_UART:
@@ -1567,6 +1631,14 @@ void control_reader(const char *path, bool pager)
 							&opcode, buf, &pktlen))
 				break;
 
+			if (from && timercmp(&tv, from, <)) {
+				packet_track_index(index, opcode, buf, pktlen);
+				continue;
+			}
+
+			if (to && timercmp(&tv, to, >))
+				break;
+
 			if (opcode == 0xffff)
 				continue;
 
@@ -1583,6 +1655,12 @@ void control_reader(const char *path, bool pager)
 								buf, &pktlen))
 				break;
 
+			if (from && timercmp(&tv, from, <))
+				continue;
+
+			if (to && timercmp(&tv, to, >))
+				break;
+
 			packet_simulator(&tv, frequency, buf, pktlen);
 		}
 		break;
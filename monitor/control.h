@@ -10,9 +10,12 @@
  */
 
 #include <stdint.h>
+#include <sys/time.h>
 
-bool control_writer(const char *path);
-void control_reader(const char *path, bool pager);
+bool control_writer(const char *path, size_t buffer_size);
+void control_cleanup(void);
+void control_reader(const char *path, bool pager,
+			const struct timeval *from, const struct timeval *to);
 void control_server(const char *path);
 int control_tty(const char *path, unsigned int speed);
 int control_rtt(char *jlink, char *rtt);
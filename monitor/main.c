@@ -15,10 +15,13 @@
 
 #define _GNU_SOURCE
 #include <stdio.h>
+#include <errno.h>
 #include <ctype.h>
 #include <stdlib.h>
 #include <string.h>
 #include <getopt.h>
+#include <time.h>
+#include <sys/time.h>
 #include <sys/un.h>
 
 #include "src/shared/mainloop.h"
@@ -50,10 +53,17 @@ static void usage(void)
 	printf("options:\n"
 		"\t-r, --read <file>      Read traces in btsnoop format\n"
 		"\t-w, --write <file>     Save traces in btsnoop format\n"
+		"\t-W, --write-buffer <size>[K|M]\n"
+		"\t                       Buffer saved traces in memory\n"
 		"\t-a, --analyze <file>   Analyze traces in btsnoop format\n"
 		"\t                       If gnuplot is installed on the\n"
                 "\t                       system it will also attempt to plot\n"
 		"\t                       packet latency graph.\n"
+		"\t-j, --jobs <num>       Analyze controllers in parallel\n"
+		"\t    --from <time>      Skip traces before time\n"
+		"\t    --to <time>        Skip traces after time\n"
+		"\t                       Time as YYYY-MM-DD HH:MM:SS[.usec]\n"
+		"\t                       or seconds since epoch\n"
 		"\t-s, --server <socket>  Start monitor server socket\n"
 		"\t-p, --priority <level> Show only priority or lower\n"
 		"\t-i, --index <num>      Show only specified controller\n"
@@ -81,7 +91,11 @@ static void usage(void)
 static const struct option main_options[] = {
 	{ "read",      required_argument, NULL, 'r' },
 	{ "write",     required_argument, NULL, 'w' },
+	{ "write-buffer", required_argument, NULL, 'W' },
 	{ "analyze",   required_argument, NULL, 'a' },
+	{ "jobs",      required_argument, NULL, 'j' },
+	{ "from",      required_argument, NULL, 'f' },
+	{ "to",        required_argument, NULL, 'o' },
 	{ "server",    required_argument, NULL, 's' },
 	{ "priority",  required_argument, NULL, 'p' },
 	{ "index",     required_argument, NULL, 'i' },
@@ -108,13 +122,91 @@ static const struct option main_options[] = {
 	{ }
 };
 
+static bool parse_time(const char *str, struct timeval *tv)
+{
+	struct tm tm;
+	char *endptr;
+
+	memset(&tm, 0, sizeof(tm));
+	tm.tm_isdst = -1;
+
+	endptr = strptime(str, "%Y-%m-%d %H:%M:%S", &tm);
+	if (endptr) {
+		tv->tv_sec = mktime(&tm);
+		if (tv->tv_sec < 0)
+			return false;
+	} else {
+		tv->tv_sec = strtol(str, &endptr, 10);
+		if (endptr == str || tv->tv_sec < 0)
+			return false;
+	}
+
+	tv->tv_usec = 0;
+
+	if (*endptr == '.') {
+		const char *usec = endptr + 1;
+		int digits;
+
+		tv->tv_usec = strtol(usec, &endptr, 10);
+
+		/* Scale the fractional part to microseconds */
+		digits = endptr - usec;
+		if (!digits || digits > 6 || tv->tv_usec < 0)
+			return false;
+
+		for (; digits < 6; digits++)
+			tv->tv_usec *= 10;
+	}
+
+	return *endptr == '\0';
+}
+
+#define MAX_WRITE_BUFFER	(64 * 1024 * 1024)
+
+static bool parse_size(const char *str, size_t *size)
+{
+	unsigned long val;
+	char *endptr;
+
+	if (!isdigit(*str))
+		return false;
+
+	errno = 0;
+	val = strtoul(str, &endptr, 10);
+	if (errno)
+		return false;
+
+	if (*endptr == 'K' || *endptr == 'k') {
+		if (val > MAX_WRITE_BUFFER / 1024)
+			return false;
+		val *= 1024;
+		endptr++;
+	} else if (*endptr == 'M' || *endptr == 'm') {
+		if (val > MAX_WRITE_BUFFER / (1024 * 1024))
+			return false;
+		val *= 1024 * 1024;
+		endptr++;
+	}
+
+	if (*endptr != '\0' || val > MAX_WRITE_BUFFER)
+		return false;
+
+	*size = val;
+
+	return true;
+}
+
 int main(int argc, char *argv[])
 {
 	unsigned long filter_mask = 0;
 	bool use_pager = true;
 	const char *reader_path = NULL;
 	const char *writer_path = NULL;
+	size_t writer_buffer = 0;
 	const char *analyze_path = NULL;
+	struct timeval from, to;
+	bool use_from = false, use_to = false;
+	unsigned int jobs = 1;
 	const char *ellisys_server = NULL;
 	const char *tty = NULL;
 	unsigned int tty_speed = B115200;
@@ -133,7 +225,7 @@ int main(int argc, char *argv[])
 		struct sockaddr_un addr;
 
 		opt = getopt_long(argc, argv,
-				"r:w:a:s:p:i:d:B:V:MKNtTSAIE:PJ:R:C:c:vh",
+				"r:w:W:a:j:s:p:i:d:B:V:MKNtTSAIE:PJ:R:C:c:vh",
 				main_options, NULL);
 		if (opt < 0)
 			break;
@@ -145,9 +237,38 @@ int main(int argc, char *argv[])
 		case 'w':
 			writer_path = optarg;
 			break;
+		case 'W':
+			if (!parse_size(optarg, &writer_buffer)) {
+				fprintf(stderr, "Invalid buffer size: %s\n",
+									optarg);
+				usage();
+				return EXIT_FAILURE;
+			}
+			break;
 		case 'a':
 			analyze_path = optarg;
 			break;
+		case 'j':
+			jobs = atoi(optarg);
+			if (!jobs) {
+				fprintf(stderr, "Invalid number of jobs\n");
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'f':
+			if (!parse_time(optarg, &from)) {
+				fprintf(stderr, "Invalid time: %s\n", optarg);
+				return EXIT_FAILURE;
+			}
+			use_from = true;
+			break;
+		case 'o':
+			if (!parse_time(optarg, &to)) {
+				fprintf(stderr, "Invalid time: %s\n", optarg);
+				return EXIT_FAILURE;
+			}
+			use_to = true;
+			break;
 		case 's':
 			if (strlen(optarg) > sizeof(addr.sun_path) - 1) {
 				fprintf(stderr, "Socket name too long\n");
@@ -264,6 +385,11 @@ int main(int argc, char *argv[])
 		return EXIT_FAILURE;
 	}
 
+	if ((use_from || use_to) && !reader_path && !analyze_path) {
+		fprintf(stderr, "Time window requires read or analyze\n");
+		return EXIT_FAILURE;
+	}
+
 	printf("Bluetooth monitor ver %s\n", VERSION);
 
 	keys_setup();
@@ -271,7 +397,8 @@ int main(int argc, char *argv[])
 	packet_set_filter(filter_mask);
 
 	if (analyze_path) {
-		analyze_trace(analyze_path);
+		analyze_trace(analyze_path, use_from ? &from : NULL,
+						use_to ? &to : NULL, jobs);
 		return EXIT_SUCCESS;
 	}
 
@@ -279,11 +406,12 @@ int main(int argc, char *argv[])
 		if (ellisys_server)
 			ellisys_enable(ellisys_server, ellisys_port);
 
-		control_reader(reader_path, use_pager);
+		control_reader(reader_path, use_pager, use_from ? &from : NULL,
+						use_to ? &to : NULL);
 		return EXIT_SUCCESS;
 	}
 
-	if (writer_path && !control_writer(writer_path)) {
+	if (writer_path && !control_writer(writer_path, writer_buffer)) {
 		printf("Failed to open '%s'\n", writer_path);
 		return EXIT_FAILURE;
 	}
@@ -302,6 +430,8 @@ int main(int argc, char *argv[])
 
 	exit_status = mainloop_run_with_signal(signal_callback, NULL);
 
+	control_cleanup();
+
 	keys_cleanup();
 
 	return exit_status;
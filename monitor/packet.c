@@ -4459,6 +4459,36 @@ static bool msft_event_prefix_match(const void *data, int size)
 	return false;
 }
 
+void packet_track_index(uint16_t index, uint16_t opcode,
+					const void *data, uint16_t size)
+{
+	const struct btsnoop_opcode_new_index *ni;
+	const struct btsnoop_opcode_index_info *ii;
+	uint16_t manufacturer;
+
+	if (index >= MAX_INDEX)
+		return;
+
+	switch (opcode) {
+	case BTSNOOP_OPCODE_NEW_INDEX:
+		ni = data;
+
+		index_list[index].type = ni->type;
+		memcpy(index_list[index].bdaddr, ni->bdaddr, 6);
+		index_list[index].manufacturer = fallback_manufacturer;
+		index_list[index].msft_opcode = BT_HCI_CMD_NOP;
+		break;
+	case BTSNOOP_OPCODE_INDEX_INFO:
+		ii = data;
+		manufacturer = le16_to_cpu(ii->manufacturer);
+
+		memcpy(index_list[index].bdaddr, ii->bdaddr, 6);
+		index_list[index].manufacturer = manufacturer;
+		index_list[index].msft_opcode = get_msft_opcode(manufacturer);
+		break;
+	}
+}
+
 void packet_monitor(struct timeval *tv, struct ucred *cred,
 					uint16_t index, uint16_t opcode,
 					const void *data, uint16_t size)
@@ -4486,12 +4516,7 @@ void packet_monitor(struct timeval *tv, struct ucred *cred,
 	case BTSNOOP_OPCODE_NEW_INDEX:
 		ni = data;
 
-		if (index < MAX_INDEX) {
-			index_list[index].type = ni->type;
-			memcpy(index_list[index].bdaddr, ni->bdaddr, 6);
-			index_list[index].manufacturer = fallback_manufacturer;
-			index_list[index].msft_opcode = BT_HCI_CMD_NOP;
-		}
+		packet_track_index(index, opcode, data, size);
 
 		addr2str(ni->bdaddr, str);
 		packet_new_index(tv, index, str, ni->type, ni->bus, ni->name);
@@ -4548,12 +4573,7 @@ void packet_monitor(struct timeval *tv, struct ucred *cred,
 		ii = data;
 		manufacturer = le16_to_cpu(ii->manufacturer);
 
-		if (index < MAX_INDEX) {
-			memcpy(index_list[index].bdaddr, ii->bdaddr, 6);
-			index_list[index].manufacturer = manufacturer;
-			index_list[index].msft_opcode =
-				get_msft_opcode(manufacturer);
-		}
+		packet_track_index(index, opcode, data, size);
 
 		addr2str(ii->bdaddr, str);
 		packet_index_info(tv, index, str, manufacturer);
@@ -105,6 +105,8 @@ void packet_control(struct timeval *tv, struct ucred *cred,
 void packet_monitor(struct timeval *tv, struct ucred *cred,
 					uint16_t index, uint16_t opcode,
 					const void *data, uint16_t size);
+void packet_track_index(uint16_t index, uint16_t opcode,
+					const void *data, uint16_t size);
 void packet_simulator(struct timeval *tv, uint16_t frequency,
 					const void *data, uint16_t size);
 
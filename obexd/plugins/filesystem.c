@@ -25,7 +25,6 @@
 #include <sys/statvfs.h>
 #include <sys/sendfile.h>
 #include <fcntl.h>
-#include <sys/wait.h>
 #include <inttypes.h>
 
 #include <glib.h>
@@ -208,6 +207,18 @@ static void *filesystem_open(const char *name, int oflag, mode_t mode,
 		goto failed;
 	}
 
+	/*
+	 * Reserve the blocks upfront so that writing one packet at a time
+	 * does not fragment the file, its size is left to grow as data is
+	 * written in case the transfer is interrupted.
+	 */
+	if (*size > 0 && fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, *size) < 0 &&
+							errno == ENOSPC) {
+		if (err)
+			*err = -ENOSPC;
+		goto failed;
+	}
+
 done:
 	if (err)
 		*err = 0;
@@ -263,52 +274,67 @@ static int filesystem_rename(const char *name, const char *destname)
 	return ret;
 }
 
-static int sendfile_async(int out_fd, int in_fd, off_t *offset, size_t count)
+static int copy_data(int out_fd, int in_fd, size_t count)
 {
-	int pid;
+	gboolean use_sendfile = FALSE;
+
+	while (count > 0) {
+		ssize_t ret;
+
+		/*
+		 * copy_file_range may share the extents instead of copying,
+		 * fallback to sendfile if the files are not on the same
+		 * filesystem or the filesystem does not support it.
+		 */
+		if (use_sendfile)
+			ret = sendfile(out_fd, in_fd, NULL, count);
+		else
+			ret = copy_file_range(in_fd, NULL, out_fd, NULL, count,
+									0);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+
+			if (!use_sendfile && (errno == EXDEV ||
+						errno == EINVAL ||
+						errno == ENOSYS ||
+						errno == EOPNOTSUPP)) {
+				use_sendfile = TRUE;
+				continue;
+			}
 
-	/* Run sendfile on child process */
-	pid = fork();
-	switch (pid) {
-		case 0:
-			break;
-		case -1:
-			error("fork() %s (%d)", strerror(errno), errno);
 			return -errno;
-		default:
-			DBG("child %d forked", pid);
-			return pid;
-	}
+		}
 
-	/* At child */
-	if (sendfile(out_fd, in_fd, offset, count) < 0)
-		error("sendfile(): %s (%d)", strerror(errno), errno);
+		/* Source got truncated while copying */
+		if (ret == 0)
+			break;
 
-	close(in_fd);
-	close(out_fd);
+		count -= ret;
+	}
 
-	exit(errno);
+	return 0;
 }
 
 static int filesystem_copy(const char *name, const char *destname)
 {
 	void *in, *out;
-	ssize_t ret;
 	size_t size;
 	struct stat st;
-	int in_fd, out_fd, err;
+	int in_fd, err;
 
 	in = filesystem_open(name, O_RDONLY, 0, NULL, &size, &err);
 	if (in == NULL) {
 		error("open(%s): %s (%d)", name, strerror(-err), -err);
-		return -err;
+		return err;
 	}
 
 	in_fd = GPOINTER_TO_INT(in);
-	ret = fstat(in_fd, &st);
-	if (ret < 0) {
-		error("stat(%s): %s (%d)", name, strerror(errno), errno);
-		return -errno;
+	if (fstat(in_fd, &st) < 0) {
+		err = -errno;
+		error("stat(%s): %s (%d)", name, strerror(-err), -err);
+		filesystem_close(in);
+		return err;
 	}
 
 	out = filesystem_open(destname, O_WRONLY | O_CREAT | O_TRUNC,
@@ -316,30 +342,18 @@ static int filesystem_copy(const char *name, const char *destname)
 	if (out == NULL) {
 		error("open(%s): %s (%d)", destname, strerror(-err), -err);
 		filesystem_close(in);
-		return -errno;
-	}
-
-	out_fd = GPOINTER_TO_INT(out);
-
-	/* Check if sendfile is supported */
-	ret = sendfile(out_fd, in_fd, NULL, 0);
-	if (ret < 0) {
-		ret = -errno;
-		error("sendfile: %s (%zd)", strerror(-ret), -ret);
-		goto done;
+		return err;
 	}
 
-	ret = sendfile_async(out_fd, in_fd, NULL, st.st_size);
-	if (ret < 0)
-		goto done;
-
-	return 0;
+	err = copy_data(GPOINTER_TO_INT(out), in_fd, st.st_size);
+	if (err < 0)
+		error("copy(%s, %s): %s (%d)", name, destname, strerror(-err),
+									-err);
 
-done:
 	filesystem_close(in);
 	filesystem_close(out);
 
-	return ret;
+	return err;
 }
 
 struct capability_object {
@@ -310,34 +310,52 @@ static void cmd_disconnect(GObex *obex, GObexPacket *req, void *user_data)
 	os_set_response(os, 0);
 }
 
-static ssize_t driver_write(struct obex_session *os)
+static int driver_write_data(struct obex_session *os, const void *buf,
+						size_t size, size_t *written)
 {
-	ssize_t len = 0;
+	*written = 0;
 
-	while (os->pending > 0) {
+	while (*written < size) {
 		ssize_t w;
 
-		w = os->driver->write(os->object, os->buf + len, os->pending);
+		w = os->driver->write(os->object,
+					(const uint8_t *) buf + *written,
+					size - *written);
 		if (w < 0) {
 			error("write(): %s (%zd)", strerror(-w), -w);
 			if (w == -EINTR)
 				continue;
-			else if (w == -EINVAL)
-				memmove(os->buf, os->buf + len, os->pending);
 
 			return w;
 		}
 
-		len += w;
+		*written += w;
 		os->offset += w;
-		os->pending -= w;
 	}
 
-	DBG("%zd written", len);
+	DBG("%zu written", *written);
 
 	if (os->service->progress != NULL)
 		os->service->progress(os, os->service_data);
 
+	return 0;
+}
+
+static ssize_t driver_write(struct obex_session *os)
+{
+	size_t len;
+	int err;
+
+	err = driver_write_data(os, os->buf, os->pending, &len);
+
+	/* Keep what is left at the start of the buffer for the next try */
+	os->pending -= len;
+	if (os->pending > 0 && len > 0)
+		memmove(os->buf, os->buf + len, os->pending);
+
+	if (err < 0)
+		return err;
+
 	return len;
 }
 
@@ -508,6 +526,24 @@ static gboolean recv_data(const void *buf, gsize size, gpointer user_data)
 	if (os->size == OBJECT_SIZE_DELETE)
 		os->size = OBJECT_SIZE_UNKNOWN;
 
+	/*
+	 * Write straight from the packet unless there is data buffered
+	 * already, only what could not be written is copied.
+	 */
+	if (os->pending == 0 && os->object != NULL && os->driver != NULL) {
+		size_t len;
+
+		ret = driver_write_data(os, buf, size, &len);
+		if (ret == -EAGAIN) {
+			os->buf = g_realloc(os->buf, size - len);
+			memcpy(os->buf, (const uint8_t *) buf + len,
+								size - len);
+			os->pending = size - len;
+		}
+
+		goto done;
+	}
+
 	os->buf = g_realloc(os->buf, os->pending + size);
 	memcpy(os->buf + os->pending, buf, size);
 	os->pending += size;
@@ -520,6 +556,18 @@ static gboolean recv_data(const void *buf, gsize size, gpointer user_data)
 	}
 
 	ret = driver_write(os);
+
+	/*
+	 * With SRM the client keeps sending while the driver is blocked, so
+	 * the buffered data may be written here before the driver is ready
+	 * again: stop waiting for it or the final response is never sent.
+	 */
+	if (ret >= 0 && os->pending == 0) {
+		obex_object_reset_io_watch(os->object);
+		g_obex_resume(os->obex);
+	}
+
+done:
 	if (ret >= 0)
 		return TRUE;
 
@@ -53,6 +53,7 @@
 #include "sdpd.h"
 #include "adapter.h"
 #include "device.h"
+#include "device-index.h"
 #include "profile.h"
 #include "dbus-common.h"
 #include "error.h"
@@ -65,6 +66,7 @@
 #include "gatt-database.h"
 #include "advertising.h"
 #include "adv_monitor.h"
+#include "adv_report.h"
 #include "eir.h"
 #include "battery.h"
 
@@ -77,6 +79,8 @@
 #define IDLE_DISCOV_TIMEOUT (5)
 #define TEMP_DEV_TIMEOUT (3 * 60)
 #define BONDING_TIMEOUT (2 * 60)
+#define RPA_CACHE_SIZE 1024
+#define PROBE_BATCH_SIZE 32
 
 #define SCAN_TYPE_BREDR (1 << BDADDR_BREDR)
 #define SCAN_TYPE_LE ((1 << BDADDR_LE_PUBLIC) | (1 << BDADDR_LE_RANDOM))
@@ -313,7 +317,7 @@ struct btd_adapter {
 	struct mgmt_cp_start_service_discovery *current_discovery_filter;
 	struct discovery_client *client;	/* active discovery client */
 
-	GSList *discovery_found;	/* list of found devices */
+	GHashTable *discovery_found;	/* set of found devices */
 	unsigned int discovery_idle_timeout; /* timeout between discovery
 					      * runs
 					      */
@@ -321,10 +325,16 @@ struct btd_adapter {
 
 	unsigned int pairable_timeout_id;	/* pairable timeout id */
 	guint auth_idle_id;		/* Pending authorization dequeue */
+	struct queue *probe_queue;	/* Stored devices left to probe */
+	guint probe_idle_id;		/* Pending profile probing */
+	uint64_t load_start;		/* Stored devices load time */
 	GQueue *auths;			/* Ongoing and pending auths */
 	bool pincode_requested;		/* PIN requested during last bonding */
 	GSList *connections;		/* Connected devices */
 	GSList *devices;		/* Devices structure pointers */
+	struct device_index *devices_by_addr;	/* Devices by address */
+	GHashTable *devices_by_path;	/* Object path to device */
+	struct bt_crypto_resolver *resolver;	/* Device IRKs */
 	GSList *connect_list;		/* Devices to connect when found */
 	struct btd_device *connect_le;	/* LE device waiting to be connected */
 	sdp_list_t *services;		/* Services associated to adapter */
@@ -336,6 +346,8 @@ struct btd_adapter {
 
 	struct btd_battery_provider_manager *battery_provider_manager;
 
+	struct btd_adv_report_manager *adv_report_manager;
+
 	GHashTable *allowed_uuid_set;	/* Set of allowed service UUIDs */
 
 	gboolean initialized;
@@ -1040,7 +1052,7 @@ struct btd_device *btd_adapter_find_device(struct btd_adapter *adapter,
 							uint8_t bdaddr_type)
 {
 	struct device_addr_type addr;
-	struct btd_device *device;
+	struct btd_device *device = NULL;
 	GSList *list;
 
 	if (!adapter)
@@ -1049,12 +1061,18 @@ struct btd_device *btd_adapter_find_device(struct btd_adapter *adapter,
 	bacpy(&addr.bdaddr, dst);
 	addr.bdaddr_type = bdaddr_type;
 
-	list = g_slist_find_custom(adapter->devices, &addr,
-							device_addr_type_cmp);
-	if (!list)
-		return NULL;
+	list = device_index_lookup(adapter->devices_by_addr, dst);
+	list = g_slist_find_custom(list, &addr, device_addr_type_cmp);
+	if (list)
+		device = list->data;
+
+	/* Resolve RPAs against the IRKs of all devices in a single pass */
+	if (!device && bdaddr_type == BDADDR_LE_RANDOM &&
+						(dst->b[5] >> 6) == 0x01)
+		device = bt_crypto_resolver_resolve(adapter->resolver, dst->b);
 
-	device = list->data;
+	if (!device)
+		return NULL;
 
 	/*
 	 * If we're looking up based on public address and the address
@@ -1069,28 +1087,13 @@ struct btd_device *btd_adapter_find_device(struct btd_adapter *adapter,
 	return device;
 }
 
-static int device_path_cmp(gconstpointer a, gconstpointer b)
-{
-	const struct btd_device *device = a;
-	const char *path = b;
-	const char *dev_path = device_get_path(device);
-
-	return strcasecmp(dev_path, path);
-}
-
 struct btd_device *btd_adapter_find_device_by_path(struct btd_adapter *adapter,
 						   const char *path)
 {
-	GSList *list;
-
 	if (!adapter)
 		return NULL;
 
-	list = g_slist_find_custom(adapter->devices, path, device_path_cmp);
-	if (!list)
-		return NULL;
-
-	return list->data;
+	return g_hash_table_lookup(adapter->devices_by_path, path);
 }
 
 static void uuid_to_uuid128(uuid_t *uuid128, const uuid_t *uuid)
@@ -1458,8 +1461,7 @@ void btd_adapter_remove_device(struct btd_adapter *adapter,
 	adapter_remove_device(adapter, dev);
 	btd_adv_monitor_device_remove(adapter->adv_monitor_manager, dev);
 
-	adapter->discovery_found = g_slist_remove(adapter->discovery_found,
-									dev);
+	g_hash_table_remove(adapter->discovery_found, dev);
 
 	adapter->connections = g_slist_remove(adapter->connections, dev);
 
@@ -1720,12 +1722,15 @@ static void free_discovery_filter(struct discovery_filter *discovery_filter)
 	g_free(discovery_filter);
 }
 
-static void invalidate_rssi_and_tx_power(gpointer a)
+static gboolean invalidate_rssi_and_tx_power(gpointer key, gpointer value,
+							gpointer user_data)
 {
-	struct btd_device *dev = a;
+	struct btd_device *dev = key;
 
 	device_set_rssi(dev, 0);
 	device_set_tx_power(dev, 127);
+
+	return TRUE;
 }
 
 static void discovery_cleanup(struct btd_adapter *adapter, int timeout)
@@ -1739,9 +1744,8 @@ static void discovery_cleanup(struct btd_adapter *adapter, int timeout)
 		adapter->discovery_idle_timeout = 0;
 	}
 
-	g_slist_free_full(adapter->discovery_found,
-						invalidate_rssi_and_tx_power);
-	adapter->discovery_found = NULL;
+	g_hash_table_foreach_remove(adapter->discovery_found,
+					invalidate_rssi_and_tx_power, NULL);
 
 	if (!adapter->devices)
 		return;
@@ -3641,21 +3645,18 @@ static DBusMessage *remove_device(DBusConnection *conn,
 	struct btd_adapter *adapter = user_data;
 	struct btd_device *device;
 	const char *path;
-	GSList *list;
 
 	if (dbus_message_get_args(msg, NULL, DBUS_TYPE_OBJECT_PATH, &path,
 						DBUS_TYPE_INVALID) == FALSE)
 		return btd_error_invalid_args(msg);
 
-	list = g_slist_find_custom(adapter->devices, path, device_path_cmp);
-	if (!list)
+	device = g_hash_table_lookup(adapter->devices_by_path, path);
+	if (!device)
 		return btd_error_does_not_exist(msg);
 
 	if (!btd_adapter_get_powered(adapter))
 		return btd_error_not_ready(msg);
 
-	device = list->data;
-
 	btd_device_set_temporary(device, true);
 
 	if (!btd_device_is_connected(device)) {
@@ -4544,7 +4545,6 @@ static void load_ltks(struct btd_adapter *adapter, GSList *keys)
 	for (l = keys, key = cp->keys; l && key_count;
 			l = g_slist_next(l), key++, key_count--) {
 		struct smp_ltk_info *info = l->data;
-		struct btd_device *dev;
 
 		bacpy(&key->addr.bdaddr, &info->bdaddr);
 		key->addr.type = info->bdaddr_type;
@@ -4554,16 +4554,6 @@ static void load_ltks(struct btd_adapter *adapter, GSList *keys)
 		key->type = info->authenticated;
 		key->central = info->central;
 		key->enc_size = info->enc_size;
-
-		/* Mark device as paired as their LTKs can be loaded. */
-		dev = btd_adapter_find_device(adapter, &info->bdaddr,
-							info->bdaddr_type);
-		if (dev) {
-			device_set_paired(dev, info->bdaddr_type);
-			device_set_bonded(dev, info->bdaddr_type);
-			device_set_ltk(dev, info->val, info->central,
-						info->enc_size);
-		}
 	}
 
 	/*
@@ -5094,18 +5084,181 @@ done:
 	mgmt_tlv_list_free(list);
 }
 
+struct stored_device {
+	char addr[18];
+	uint8_t bdaddr_type;
+	GKeyFile *key_file;
+	struct link_key_info *key_info;
+	struct smp_ltk_info *ltk_info;
+	struct smp_ltk_info *peripheral_ltk_info;
+	struct irk_info *irk_info;
+};
+
+static void stored_device_free(void *data)
+{
+	struct stored_device *stored = data;
+
+	g_key_file_unref(stored->key_file);
+	g_free(stored);
+}
+
+static struct stored_device *stored_device_new(struct btd_adapter *adapter,
+							const char *peer)
+{
+	struct stored_device *stored;
+	char filename[PATH_MAX];
+	GError *gerr = NULL;
+
+	create_filename(filename, PATH_MAX, "/%s/%s/info",
+				btd_adapter_get_storage_dir(adapter), peer);
+
+	stored = g_new0(struct stored_device, 1);
+	/* peer has already been validated by bachk() */
+	memcpy(stored->addr, peer, sizeof(stored->addr) - 1);
+
+	stored->key_file = btd_storage_load(filename, &gerr);
+	if (gerr) {
+		error("Unable to load key file from %s: (%s)", filename,
+								gerr->message);
+		g_clear_error(&gerr);
+	}
+
+	stored->bdaddr_type = get_addr_type(stored->key_file);
+
+	stored->key_info = get_key_info(stored->key_file, peer,
+							stored->bdaddr_type);
+	stored->ltk_info = get_ltk_info(stored->key_file, peer,
+							stored->bdaddr_type);
+	stored->peripheral_ltk_info = get_peripheral_ltk_info(stored->key_file,
+						peer, stored->bdaddr_type);
+	stored->irk_info = get_irk_info(stored->key_file, peer,
+							stored->bdaddr_type);
+
+	// If any key for the device is blocked, we discard all.
+	if ((stored->key_info && stored->key_info->is_blocked) ||
+			(stored->ltk_info && stored->ltk_info->is_blocked) ||
+			(stored->peripheral_ltk_info &&
+				stored->peripheral_ltk_info->is_blocked) ||
+			(stored->irk_info && stored->irk_info->is_blocked)) {
+		g_free(stored->key_info);
+		g_free(stored->ltk_info);
+		g_free(stored->peripheral_ltk_info);
+		g_free(stored->irk_info);
+		stored_device_free(stored);
+		return NULL;
+	}
+
+	return stored;
+}
+
+static void stored_device_set_ltk(struct btd_device *device,
+						struct smp_ltk_info *info)
+{
+	if (!info)
+		return;
+
+	/* Mark device as paired as their LTKs have been loaded. */
+	device_set_le_support(device, info->bdaddr_type);
+	device_set_paired(device, info->bdaddr_type);
+	device_set_bonded(device, info->bdaddr_type);
+	device_set_ltk(device, info->val, info->central, info->enc_size);
+}
+
+static void add_stored_device(struct btd_adapter *adapter,
+						struct stored_device *stored)
+{
+	struct btd_device *device;
+	GSList *list;
+	bdaddr_t bdaddr;
+
+	str2ba(stored->addr, &bdaddr);
+
+	list = device_index_lookup(adapter->devices_by_addr, &bdaddr);
+	if (list) {
+		device = list->data;
+		goto device_exist;
+	}
+
+	device = device_create_from_storage(adapter, stored->addr,
+							stored->key_file);
+	if (!device)
+		return;
+
+	if (stored->irk_info)
+		device_set_privacy(device, true, stored->irk_info->val);
+
+	btd_device_set_temporary(device, false);
+	adapter_add_device(adapter, device);
+
+	/* TODO: register services from pre-loaded list of primaries */
+
+	queue_push_tail(adapter->probe_queue, device);
+
+device_exist:
+	if (stored->key_info) {
+		device_set_paired(device, BDADDR_BREDR);
+		device_set_bonded(device, BDADDR_BREDR);
+	}
+
+	stored_device_set_ltk(device, stored->ltk_info);
+	stored_device_set_ltk(device, stored->peripheral_ltk_info);
+}
+
+static gboolean probe_stored_devices(gpointer user_data)
+{
+	struct btd_adapter *adapter = user_data;
+	unsigned int i;
+
+	for (i = 0; i < PROBE_BATCH_SIZE; i++) {
+		struct btd_device *device;
+
+		device = queue_pop_head(adapter->probe_queue);
+		if (!device)
+			break;
+
+		probe_devices(device);
+	}
+
+	if (!queue_isempty(adapter->probe_queue))
+		return TRUE;
+
+	DBG("hci%u stored devices probed after %" PRIu64 " usec",
+				adapter->dev_id,
+				g_get_monotonic_time() - adapter->load_start);
+
+	adapter->probe_idle_id = 0;
+
+	return FALSE;
+}
+
+/*
+ * Probes a stored device right away if it is still waiting for its batch,
+ * for users that need its profiles and services, e.g. to connect.
+ */
+void btd_adapter_probe_device(struct btd_adapter *adapter,
+						struct btd_device *device)
+{
+	if (!adapter || queue_isempty(adapter->probe_queue))
+		return;
+
+	if (queue_remove(adapter->probe_queue, device))
+		probe_devices(device);
+}
+
 static void load_devices(struct btd_adapter *adapter)
 {
 	char dirname[PATH_MAX];
+	GSList *stored_devices = NULL;
 	GSList *keys = NULL;
 	GSList *ltks = NULL;
 	GSList *irks = NULL;
 	GSList *params = NULL;
 	struct queue *subrates = NULL;
-	GSList *added_devices = NULL;
-	GError *gerr = NULL;
+	unsigned int count;
+	uint64_t keys_time;
 	DIR *dir;
 	struct dirent *entry;
+	GSList *l;
 
 	create_filename(dirname, PATH_MAX, "/%s",
 				btd_adapter_get_storage_dir(adapter));
@@ -5118,18 +5271,12 @@ static void load_devices(struct btd_adapter *adapter)
 		return;
 	}
 
+	adapter->load_start = g_get_monotonic_time();
+
 	while ((entry = readdir(dir)) != NULL) {
-		struct btd_device *device;
-		char filename[PATH_MAX];
-		GKeyFile *key_file;
-		struct link_key_info *key_info;
-		struct smp_ltk_info *ltk_info;
-		struct smp_ltk_info *peripheral_ltk_info;
-		GSList *list;
-		struct irk_info *irk_info;
+		struct stored_device *stored;
 		struct conn_param *param;
 		struct conn_subrate *subrate;
-		uint8_t bdaddr_type;
 
 		if (entry->d_type == DT_UNKNOWN)
 			entry->d_type = util_get_dt(dirname, entry->d_name);
@@ -5137,129 +5284,85 @@ static void load_devices(struct btd_adapter *adapter)
 		if (entry->d_type != DT_DIR || bachk(entry->d_name) < 0)
 			continue;
 
-		create_filename(filename, PATH_MAX, "/%s/%s/info",
-					btd_adapter_get_storage_dir(adapter),
-					entry->d_name);
-
-		key_file = g_key_file_new();
-		if (!g_key_file_load_from_file(key_file, filename, 0, &gerr)) {
-			error("Unable to load key file from %s: (%s)", filename,
-								gerr->message);
-			g_clear_error(&gerr);
-		}
-
-		bdaddr_type = get_addr_type(key_file);
-
-		key_info = get_key_info(key_file, entry->d_name, bdaddr_type);
-
-		ltk_info = get_ltk_info(key_file, entry->d_name, bdaddr_type);
-
-		peripheral_ltk_info = get_peripheral_ltk_info(key_file,
-						entry->d_name, bdaddr_type);
-
-		irk_info = get_irk_info(key_file, entry->d_name, bdaddr_type);
-
-		// If any key for the device is blocked, we discard all.
-		if ((key_info && key_info->is_blocked) ||
-				(ltk_info && ltk_info->is_blocked) ||
-				(peripheral_ltk_info &&
-					peripheral_ltk_info->is_blocked) ||
-				(irk_info && irk_info->is_blocked)) {
-
-			if (key_info) {
-				g_free(key_info);
-				key_info = NULL;
-			}
-
-			if (ltk_info) {
-				g_free(ltk_info);
-				ltk_info = NULL;
-			}
-
-			if (peripheral_ltk_info) {
-				g_free(peripheral_ltk_info);
-				peripheral_ltk_info = NULL;
-			}
+		stored = stored_device_new(adapter, entry->d_name);
+		if (!stored)
+			continue;
 
-			if (irk_info) {
-				g_free(irk_info);
-				irk_info = NULL;
-			}
+		stored_devices = g_slist_prepend(stored_devices, stored);
 
-			goto free;
-		}
+		if (stored->key_info)
+			keys = g_slist_prepend(keys, stored->key_info);
 
-		if (key_info)
-			keys = g_slist_append(keys, key_info);
+		if (stored->ltk_info)
+			ltks = g_slist_prepend(ltks, stored->ltk_info);
 
-		if (ltk_info)
-			ltks = g_slist_append(ltks, ltk_info);
+		if (stored->peripheral_ltk_info)
+			ltks = g_slist_prepend(ltks,
+						stored->peripheral_ltk_info);
 
-		if (peripheral_ltk_info)
-			ltks = g_slist_append(ltks, peripheral_ltk_info);
+		if (stored->irk_info)
+			irks = g_slist_prepend(irks, stored->irk_info);
 
-		if (irk_info)
-			irks = g_slist_append(irks, irk_info);
-
-		param = get_conn_param(key_file, entry->d_name, bdaddr_type);
+		param = get_conn_param(stored->key_file, entry->d_name,
+							stored->bdaddr_type);
 		if (param)
-			params = g_slist_append(params, param);
+			params = g_slist_prepend(params, param);
 
-		subrate = get_conn_subrate(key_file, entry->d_name,
-								bdaddr_type);
+		subrate = get_conn_subrate(stored->key_file, entry->d_name,
+							stored->bdaddr_type);
 		if (subrate) {
 			if (!subrates)
 				subrates = queue_new();
 			queue_push_tail(subrates, subrate);
 		}
-
-		list = g_slist_find_custom(adapter->devices, entry->d_name,
-							device_address_cmp);
-		if (list) {
-			device = list->data;
-			goto device_exist;
-		}
-
-		device = device_create_from_storage(adapter, entry->d_name,
-							key_file);
-		if (!device)
-			goto free;
-
-		if (irk_info)
-			device_set_privacy(device, true, irk_info->val);
-
-		btd_device_set_temporary(device, false);
-		adapter_add_device(adapter, device);
-
-		/* TODO: register services from pre-loaded list of primaries */
-
-		added_devices = g_slist_append(added_devices, device);
-
-device_exist:
-		if (key_info) {
-			device_set_paired(device, BDADDR_BREDR);
-			device_set_bonded(device, BDADDR_BREDR);
-		}
-
-free:
-		g_key_file_free(key_file);
 	}
 
 	closedir(dir);
 
-	load_link_keys(adapter, keys, btd_opts.debug_keys);
-	g_slist_free_full(keys, g_free);
+	/* Keep the storage order, as the LTK list may get truncated */
+	stored_devices = g_slist_reverse(stored_devices);
+	keys = g_slist_reverse(keys);
+	ltks = g_slist_reverse(ltks);
+	irks = g_slist_reverse(irks);
+	params = g_slist_reverse(params);
 
+	/*
+	 * Hand the keys to the kernel before creating any device object,
+	 * so that bonded devices can reconnect while the objects are set
+	 * up.
+	 */
+	load_link_keys(adapter, keys, btd_opts.debug_keys);
 	load_ltks(adapter, ltks);
-	g_slist_free_full(ltks, g_free);
 	load_irks(adapter, irks);
-	g_slist_free_full(irks, g_free);
 	load_conn_params(adapter, params);
 	g_slist_free_full(params, g_free);
 	load_conn_subrate(adapter, subrates);
 	queue_destroy(subrates, free);
 
-	g_slist_free_full(added_devices, probe_devices);
+	keys_time = g_get_monotonic_time() - adapter->load_start;
+
+	count = g_slist_length(stored_devices);
+
+	for (l = stored_devices; l; l = l->next)
+		add_stored_device(adapter, l->data);
+
+	g_slist_free_full(stored_devices, stored_device_free);
+	g_slist_free_full(keys, g_free);
+	g_slist_free_full(ltks, g_free);
+	g_slist_free_full(irks, g_free);
+
+	DBG("hci%u %u stored devices, keys loaded after %" PRIu64 " usec, "
+			"devices created after %" PRIu64 " usec",
+			adapter->dev_id, count, keys_time,
+			g_get_monotonic_time() - adapter->load_start);
+
+	/*
+	 * Probing profiles is the expensive part, so do it in batches
+	 * from the main loop instead of blocking the adapter setup.
+	 */
+	if (!queue_isempty(adapter->probe_queue) && !adapter->probe_idle_id)
+		adapter->probe_idle_id = g_idle_add(probe_stored_devices,
+								adapter);
 }
 
 int btd_adapter_block_address(struct btd_adapter *adapter,
@@ -5423,10 +5526,37 @@ void device_resolved_drivers(struct btd_adapter *adapter,
 	}
 }
 
+static guint path_hash(gconstpointer key)
+{
+	const char *p = key;
+	guint hash = 5381;
+
+	/* Paths are compared case insensitive */
+	for (; *p; p++)
+		hash = hash * 33 + g_ascii_tolower(*p);
+
+	return hash;
+}
+
+static gboolean path_equal(gconstpointer a, gconstpointer b)
+{
+	return !g_ascii_strcasecmp(a, b);
+}
+
 static void adapter_add_device(struct btd_adapter *adapter,
 						struct btd_device *device)
 {
+	const uint8_t *irk = device_get_irk(device);
+
 	adapter->devices = g_slist_prepend(adapter->devices, device);
+	device_index_add(adapter->devices_by_addr, device_get_address(device),
+								device);
+	g_hash_table_insert(adapter->devices_by_path,
+				(void *) device_get_path(device), device);
+
+	if (irk)
+		bt_crypto_resolver_add(adapter->resolver, irk, device);
+
 	device_added_drivers(adapter, device);
 }
 
@@ -5434,14 +5564,84 @@ static void adapter_remove_device(struct btd_adapter *adapter,
 						struct btd_device *device)
 {
 	adapter->devices = g_slist_remove(adapter->devices, device);
+	queue_remove(adapter->probe_queue, device);
+	device_index_remove(adapter->devices_by_addr,
+				device_get_address(device), device);
+	device_index_remove(adapter->devices_by_addr,
+				device_get_conn_address(device), device);
+
+	if (g_hash_table_lookup(adapter->devices_by_path,
+				device_get_path(device)) == device)
+		g_hash_table_remove(adapter->devices_by_path,
+						device_get_path(device));
+
+	bt_crypto_resolver_remove(adapter->resolver, device);
 	device_removed_drivers(adapter, device);
 }
 
+void btd_adapter_update_device_addr(struct btd_adapter *adapter,
+						struct btd_device *device,
+						const bdaddr_t *bdaddr)
+{
+	const bdaddr_t *old = device_get_address(device);
+	bool keep_old;
+
+	if (!adapter)
+		return;
+
+	/*
+	 * Once the identity address of a connected device is resolved it
+	 * keeps being found by the address it connected with, until that
+	 * connection is gone.
+	 */
+	keep_old = btd_device_is_connected(device) &&
+			!bacmp(device_get_conn_address(device), old);
+
+	device_index_move(adapter->devices_by_addr, device, old, bdaddr,
+								keep_old);
+}
+
+void btd_adapter_remove_device_conn_addr(struct btd_adapter *adapter,
+						struct btd_device *device)
+{
+	const bdaddr_t *conn_addr;
+
+	if (!adapter)
+		return;
+
+	conn_addr = device_get_conn_address(device);
+	if (!bacmp(conn_addr, device_get_address(device)))
+		return;
+
+	device_index_remove(adapter->devices_by_addr, conn_addr, device);
+}
+
+void btd_adapter_update_device_irk(struct btd_adapter *adapter,
+						struct btd_device *device)
+{
+	const uint8_t *irk;
+
+	if (!adapter)
+		return;
+
+	bt_crypto_resolver_remove(adapter->resolver, device);
+
+	if (!g_slist_find(adapter->devices, device))
+		return;
+
+	irk = device_get_irk(device);
+	if (irk)
+		bt_crypto_resolver_add(adapter->resolver, irk, device);
+}
+
 static void adapter_add_connection(struct btd_adapter *adapter,
 						struct btd_device *device,
 						uint8_t bdaddr_type,
 						uint32_t flags)
 {
+	/* Don't wait for the stored device to be probed in its batch */
+	btd_adapter_probe_device(adapter, device);
+
 	device_add_connection(device, bdaddr_type, flags);
 
 	if (g_slist_find(adapter->connections, device)) {
@@ -6115,6 +6315,11 @@ static void adapter_free(gpointer user_data)
 	if (adapter->auth_idle_id)
 		g_source_remove(adapter->auth_idle_id);
 
+	if (adapter->probe_idle_id)
+		g_source_remove(adapter->probe_idle_id);
+
+	queue_destroy(adapter->probe_queue, NULL);
+
 	g_queue_foreach(adapter->auths, free_service_auth, NULL);
 	g_queue_free(adapter->auths);
 	queue_destroy(adapter->exps, NULL);
@@ -6153,6 +6358,11 @@ static void adapter_free(gpointer user_data)
 	if (adapter->allowed_uuid_set)
 		g_hash_table_destroy(adapter->allowed_uuid_set);
 
+	g_hash_table_destroy(adapter->discovery_found);
+	device_index_free(adapter->devices_by_addr);
+	g_hash_table_destroy(adapter->devices_by_path);
+	bt_crypto_resolver_free(adapter->resolver);
+
 	g_free(adapter);
 }
 
@@ -7144,6 +7354,7 @@ static void load_config(struct btd_adapter *adapter)
 static struct btd_adapter *btd_adapter_new(uint16_t index)
 {
 	struct btd_adapter *adapter;
+	struct bt_crypto *crypto;
 	int blocked;
 
 	adapter = g_try_new0(struct btd_adapter, 1);
@@ -7185,9 +7396,18 @@ static struct btd_adapter *btd_adapter_new(uint16_t index)
 		DBG("Power state: %s",
 			adapter_power_state_str(adapter->power_state));
 
+	adapter->devices_by_addr = device_index_new();
+	adapter->devices_by_path = g_hash_table_new(path_hash, path_equal);
+	adapter->discovery_found = g_hash_table_new(NULL, NULL);
+
+	crypto = bt_crypto_new();
+	adapter->resolver = bt_crypto_resolver_new(crypto, RPA_CACHE_SIZE);
+	bt_crypto_unref(crypto);
+
 	adapter->auths = g_queue_new();
 	adapter->exps = queue_new();
 	adapter->exp_pending = queue_new();
+	adapter->probe_queue = queue_new();
 
 	return btd_adapter_ref(adapter);
 }
@@ -7202,7 +7422,18 @@ static void adapter_remove(struct btd_adapter *adapter)
 	g_slist_free(adapter->connect_list);
 	adapter->connect_list = NULL;
 
+	if (adapter->probe_idle_id) {
+		g_source_remove(adapter->probe_idle_id);
+		adapter->probe_idle_id = 0;
+	}
+
+	queue_remove_all(adapter->probe_queue, NULL, NULL, NULL);
+
+	device_index_clear(adapter->devices_by_addr);
+	g_hash_table_remove_all(adapter->devices_by_path);
+
 	for (l = adapter->devices; l; l = l->next) {
+		bt_crypto_resolver_remove(adapter->resolver, l->data);
 		device_removed_drivers(adapter, l->data);
 		device_remove(l->data, FALSE);
 	}
@@ -7230,6 +7461,9 @@ static void adapter_remove(struct btd_adapter *adapter)
 	btd_battery_provider_manager_destroy(adapter->battery_provider_manager);
 	adapter->battery_provider_manager = NULL;
 
+	btd_adv_report_manager_destroy(adapter->adv_report_manager);
+	adapter->adv_report_manager = NULL;
+
 	g_slist_free(adapter->pin_callbacks);
 	adapter->pin_callbacks = NULL;
 
@@ -7406,8 +7640,24 @@ static bool discovery_filter_has_proximity(struct btd_adapter *adapter)
 	return false;
 }
 
+static bool discovery_filter_has_pattern(struct btd_adapter *adapter)
+{
+	GSList *l;
+
+	for (l = adapter->discovery_list; l; l = g_slist_next(l)) {
+		struct discovery_client *client = l->data;
+		struct discovery_filter *filter = client->discovery_filter;
+
+		if (filter && filter->pattern)
+			return true;
+	}
+
+	return false;
+}
+
 static bool device_is_discoverable(struct btd_adapter *adapter,
-					struct eir_data *eir, const char *addr,
+					unsigned int eir_flags,
+					const char *name, const char *addr,
 					uint8_t bdaddr_type, bool *auto_connect)
 {
 	GSList *l;
@@ -7416,7 +7666,7 @@ static bool device_is_discoverable(struct btd_adapter *adapter,
 	if (bdaddr_type == BDADDR_BREDR || adapter->filtered_discovery)
 		discoverable = true;
 	else if (btd_opts.filter_discoverable)
-		discoverable = eir->flags & (EIR_LIM_DISC | EIR_GEN_DISC);
+		discoverable = eir_flags & (EIR_LIM_DISC | EIR_GEN_DISC);
 	else
 		discoverable = true;
 
@@ -7450,8 +7700,7 @@ static bool device_is_discoverable(struct btd_adapter *adapter,
 			return true;
 		}
 
-		if (eir->name && !strncmp(filter->pattern, eir->name,
-							pattern_len)) {
+		if (name && !strncmp(filter->pattern, name, pattern_len)) {
 			*auto_connect = filter->auto_connect;
 			return true;
 		}
@@ -7470,6 +7719,7 @@ void btd_adapter_device_found(struct btd_adapter *adapter,
 	struct btd_device *dev;
 	struct bt_ad *ad = NULL;
 	struct eir_data eir_data;
+	struct eir_scan scan;
 	bool name_known, discoverable;
 	char addr[18];
 	bool confirm;
@@ -7479,6 +7729,7 @@ void btd_adapter_device_found(struct btd_adapter *adapter,
 	bool scan_rsp;
 	bool duplicate = false;
 	bool auto_connect = false;
+	bool parsed = false;
 	struct queue *matched_monitors = NULL;
 
 	confirm = (flags & MGMT_DEV_FOUND_CONFIRM_NAME);
@@ -7487,11 +7738,25 @@ void btd_adapter_device_found(struct btd_adapter *adapter,
 	name_resolve_failed = (flags & MGMT_DEV_FOUND_NAME_REQUEST_FAILED);
 	scan_rsp = (flags & MGMT_DEV_FOUND_SCAN_RSP);
 
+	/* Raw reports are handed out before any filtering */
+	btd_adv_report_manager_push(adapter->adv_report_manager, bdaddr,
+					bdaddr_type, rssi, flags, data,
+					data_len);
+
 	if (!btd_adv_monitor_offload_enabled(adapter->adv_monitor_manager) ||
 				(MGMT_VERSION(mgmt_version, mgmt_revision) <
 							MGMT_VERSION(1, 22))) {
-		if (bdaddr_type != BDADDR_BREDR)
-			ad = bt_ad_new_with_data(data_len, data);
+		/* Only build the ad data if there is a pattern to match it
+		 * against, without data or patterns no monitor can match.
+		 */
+		if (bdaddr_type != BDADDR_BREDR) {
+			if (data && data_len &&
+					btd_adv_monitor_content_filter_enabled(
+						adapter->adv_monitor_manager))
+				ad = bt_ad_new_with_data(data_len, data);
+			else
+				monitoring = false;
+		}
 
 		/* During the background scanning, update the device only when
 		 * the data match at least one Adv monitor
@@ -7509,20 +7774,31 @@ void btd_adapter_device_found(struct btd_adapter *adapter,
 	if (!adapter->discovering && !monitoring)
 		return;
 
+	/* Only scan for the fields needed to decide whether the report is
+	 * of any interest, the full parsing is deferred until it is about to
+	 * be applied to a device so reports filtered out don't allocate.
+	 */
 	memset(&eir_data, 0, sizeof(eir_data));
-	eir_parse(&eir_data, data, data_len);
+	eir_scan(&scan, data, data_len);
+
+	/* Name pattern filters need the decoded name upfront */
+	if (scan.name && discovery_filter_has_pattern(adapter)) {
+		eir_parse(&eir_data, data, data_len);
+		parsed = true;
+	}
 
 	ba2str(bdaddr, addr);
 
-	discoverable = device_is_discoverable(adapter, &eir_data, addr,
+	discoverable = device_is_discoverable(adapter, scan.flags,
+						eir_data.name, addr,
 						bdaddr_type, &auto_connect);
 
 	/* Monitor Devices advertising Broadcast Announcements if the
 	 * adapter is capable of synchronizing to it.
 	 */
-	if (eir_get_service_data(&eir_data, BCAA_SERVICE_UUID) &&
-					btd_adapter_has_settings(adapter,
-					MGMT_SETTING_ISO_SYNC_RECEIVER))
+	if (btd_adapter_has_settings(adapter,
+					MGMT_SETTING_ISO_SYNC_RECEIVER) &&
+			eir_has_service_data(data, data_len, BCAA_SERVICE))
 		monitoring = true;
 
 	dev = btd_adapter_find_device(adapter, bdaddr, bdaddr_type);
@@ -7540,7 +7816,7 @@ void btd_adapter_device_found(struct btd_adapter *adapter,
 		 * their object are needed.
 		 */
 		if (btd_adapter_has_exp_feature(adapter, EXP_FEAT_ISO_SOCKET) &&
-						eir_data.rsi)
+						scan.rsi)
 			monitoring = true;
 
 		if (!discoverable && !monitoring) {
@@ -7560,6 +7836,9 @@ void btd_adapter_device_found(struct btd_adapter *adapter,
 
 	device_update_last_seen(dev, bdaddr_type, !not_connectable);
 
+	if (!parsed)
+		eir_parse(&eir_data, data, data_len);
+
 	/*
 	 * FIXME: We need to check for non-zero flags first because
 	 * older kernels send separate adv_ind and scan_rsp. Newer
@@ -7679,7 +7958,7 @@ void btd_adapter_device_found(struct btd_adapter *adapter,
 	if (!adapter->discovery_list)
 		goto connect_le;
 
-	if (g_slist_find(adapter->discovery_found, dev))
+	if (g_hash_table_contains(adapter->discovery_found, dev))
 		return;
 
 	/* If name is unknown but it's not allowed to resolve, don't send
@@ -7688,8 +7967,7 @@ void btd_adapter_device_found(struct btd_adapter *adapter,
 	if (confirm && (name_known || device_is_name_resolve_allowed(dev)))
 		confirm_name(adapter, bdaddr, bdaddr_type, name_known);
 
-	adapter->discovery_found = g_slist_prepend(adapter->discovery_found,
-									dev);
+	g_hash_table_add(adapter->discovery_found, dev);
 
 	/* If device has a pattern match and it also set auto-connect then
 	 * attempt to connect.
@@ -8911,9 +9189,7 @@ static void store_link_key(struct btd_adapter *adapter,
 	char filename[PATH_MAX];
 	GKeyFile *key_file;
 	GError *gerr = NULL;
-	gsize length = 0;
 	char key_str[33];
-	char *str;
 	int i;
 
 	ba2str(device_get_address(device), device_addr);
@@ -8922,12 +9198,12 @@ static void store_link_key(struct btd_adapter *adapter,
 			btd_adapter_get_storage_dir(adapter), device_addr);
 	create_file(filename, 0600);
 
-	key_file = g_key_file_new();
-	if (!g_key_file_load_from_file(key_file, filename, 0, &gerr)) {
+	key_file = btd_storage_load(filename, &gerr);
+	if (gerr) {
 		error("Unable to load key file from %s: (%s)", filename,
 								gerr->message);
 		g_error_free(gerr);
-		g_key_file_free(key_file);
+		g_key_file_unref(key_file);
 		return;
 	}
 
@@ -8939,15 +9215,9 @@ static void store_link_key(struct btd_adapter *adapter,
 	g_key_file_set_integer(key_file, "LinkKey", "Type", type);
 	g_key_file_set_integer(key_file, "LinkKey", "PINLength", pin_length);
 
-	str = g_key_file_to_data(key_file, &length, NULL);
-	if (!g_file_set_contents(filename, str, length, &gerr)) {
-		error("Unable set contents for %s: (%s)", filename,
-								gerr->message);
-		g_error_free(gerr);
-	}
-	g_free(str);
+	btd_storage_store_sync(filename, key_file);
 
-	g_key_file_free(key_file);
+	g_key_file_unref(key_file);
 }
 
 static void new_link_key_callback(uint16_t index, uint16_t length,
@@ -9007,16 +9277,14 @@ static void store_ltk_group(struct btd_adapter *adapter, const bdaddr_t *peer,
 	GKeyFile *key_file;
 	GError *gerr = NULL;
 	char key_str[33];
-	gsize length = 0;
-	char *str;
 	int i;
 
 	ba2str(peer, device_addr);
 
 	create_filename(filename, PATH_MAX, "/%s/%s/info",
 			btd_adapter_get_storage_dir(adapter), device_addr);
-	key_file = g_key_file_new();
-	if (!g_key_file_load_from_file(key_file, filename, 0, &gerr)) {
+	key_file = btd_storage_load(filename, &gerr);
+	if (gerr) {
 		error("Unable to load key file from %s: (%s)", filename,
 								gerr->message);
 		g_clear_error(&gerr);
@@ -9034,17 +9302,9 @@ static void store_ltk_group(struct btd_adapter *adapter, const bdaddr_t *peer,
 	g_key_file_set_integer(key_file, group, "EDiv", ediv);
 	g_key_file_set_uint64(key_file, group, "Rand", rand);
 
-	create_file(filename, 0600);
+	btd_storage_store_sync(filename, key_file);
 
-	str = g_key_file_to_data(key_file, &length, NULL);
-	if (!g_file_set_contents(filename, str, length, &gerr)) {
-		error("Unable set contents for %s: (%s)", filename,
-								gerr->message);
-		g_error_free(gerr);
-	}
-	g_free(str);
-
-	g_key_file_free(key_file);
+	g_key_file_unref(key_file);
 }
 
 static void store_longtermkey(struct btd_adapter *adapter, const bdaddr_t *peer,
@@ -9176,9 +9436,7 @@ static void store_irk(struct btd_adapter *adapter, const bdaddr_t *peer,
 	char filename[PATH_MAX];
 	GKeyFile *key_file;
 	GError *gerr = NULL;
-	char *store_data;
 	char str[33];
-	size_t length = 0;
 	int i;
 
 	ba2str(peer, device_addr);
@@ -9187,12 +9445,12 @@ static void store_irk(struct btd_adapter *adapter, const bdaddr_t *peer,
 			btd_adapter_get_storage_dir(adapter), device_addr);
 	create_file(filename, 0600);
 
-	key_file = g_key_file_new();
-	if (!g_key_file_load_from_file(key_file, filename, 0, &gerr)) {
+	key_file = btd_storage_load(filename, &gerr);
+	if (gerr) {
 		error("Unable to load key file from %s: (%s)", filename,
 								gerr->message);
 		g_error_free(gerr);
-		g_key_file_free(key_file);
+		g_key_file_unref(key_file);
 		return;
 	}
 
@@ -9201,15 +9459,9 @@ static void store_irk(struct btd_adapter *adapter, const bdaddr_t *peer,
 
 	g_key_file_set_string(key_file, "IdentityResolvingKey", "Key", str);
 
-	store_data = g_key_file_to_data(key_file, &length, NULL);
-	if (!g_file_set_contents(filename, store_data, length, &gerr)) {
-		error("Unable set contents for %s: (%s)", filename,
-								gerr->message);
-		g_error_free(gerr);
-	}
-	g_free(store_data);
+	btd_storage_store_sync(filename, key_file);
 
-	g_key_file_free(key_file);
+	g_key_file_unref(key_file);
 }
 
 static void new_irk_callback(uint16_t index, uint16_t length,
@@ -9275,8 +9527,6 @@ void btd_adapter_store_conn_param(struct btd_adapter *adapter,
 	char filename[PATH_MAX];
 	GKeyFile *key_file;
 	GError *gerr = NULL;
-	char *store_data;
-	size_t length = 0;
 
 	ba2str(peer, device_addr);
 
@@ -9284,8 +9534,8 @@ void btd_adapter_store_conn_param(struct btd_adapter *adapter,
 
 	create_filename(filename, PATH_MAX, "/%s/%s/info",
 			btd_adapter_get_storage_dir(adapter), device_addr);
-	key_file = g_key_file_new();
-	if (!g_key_file_load_from_file(key_file, filename, 0, &gerr)) {
+	key_file = btd_storage_load(filename, &gerr);
+	if (gerr) {
 		error("Unable to load key file from %s: (%s)", filename,
 								gerr->message);
 		g_clear_error(&gerr);
@@ -9300,17 +9550,9 @@ void btd_adapter_store_conn_param(struct btd_adapter *adapter,
 	g_key_file_set_integer(key_file, "ConnectionParameters",
 						"Timeout", timeout);
 
-	create_file(filename, 0600);
+	btd_storage_store(filename, key_file);
 
-	store_data = g_key_file_to_data(key_file, &length, NULL);
-	if (!g_file_set_contents(filename, store_data, length, &gerr)) {
-		error("Unable set contents for %s: (%s)", filename,
-								gerr->message);
-		g_error_free(gerr);
-	}
-	g_free(store_data);
-
-	g_key_file_free(key_file);
+	g_key_file_unref(key_file);
 }
 
 static void new_conn_param(uint16_t index, uint16_t length,
@@ -9645,6 +9887,10 @@ static int adapter_register(struct btd_adapter *adapter)
 	adapter->battery_provider_manager =
 		btd_battery_provider_manager_create(adapter);
 
+	if (g_dbus_get_flags() & G_DBUS_FLAG_ENABLE_EXPERIMENTAL)
+		adapter->adv_report_manager =
+			btd_adv_report_manager_create(adapter);
+
 	/* Don't start GATT database and advertising managers on
 	 * non-LE controllers.
 	 */
@@ -9972,16 +10218,14 @@ static void remove_keys(struct btd_adapter *adapter,
 	char filename[PATH_MAX];
 	GKeyFile *key_file;
 	GError *gerr = NULL;
-	gsize length = 0;
-	char *str;
 
 	ba2str(device_get_address(device), device_addr);
 
 	create_filename(filename, PATH_MAX, "/%s/%s/info",
 			btd_adapter_get_storage_dir(adapter), device_addr);
 
-	key_file = g_key_file_new();
-	if (!g_key_file_load_from_file(key_file, filename, 0, &gerr)) {
+	key_file = btd_storage_load(filename, &gerr);
+	if (gerr) {
 		error("Unable to load key file from %s: (%s)", filename,
 								gerr->message);
 		g_clear_error(&gerr);
@@ -9996,15 +10240,9 @@ static void remove_keys(struct btd_adapter *adapter,
 		g_key_file_remove_group(key_file, "IdentityResolvingKey", NULL);
 	}
 
-	str = g_key_file_to_data(key_file, &length, NULL);
-	if (!g_file_set_contents(filename, str, length, &gerr)) {
-		error("Unable set contents for %s: (%s)", filename,
-								gerr->message);
-		g_error_free(gerr);
-	}
-	g_free(str);
+	btd_storage_store_sync(filename, key_file);
 
-	g_key_file_free(key_file);
+	g_key_file_unref(key_file);
 }
 
 static void unpaired_callback(uint16_t index, uint16_t length,
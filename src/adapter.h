@@ -95,6 +95,15 @@ struct btd_device *btd_adapter_find_device(struct btd_adapter *adapter,
 struct btd_device *btd_adapter_find_device_by_path(struct btd_adapter *adapter,
 						   const char *path);
 struct btd_device *btd_adapter_find_device_by_fd(int fd);
+void btd_adapter_update_device_irk(struct btd_adapter *adapter,
+						struct btd_device *device);
+void btd_adapter_update_device_addr(struct btd_adapter *adapter,
+						struct btd_device *device,
+						const bdaddr_t *bdaddr);
+void btd_adapter_remove_device_conn_addr(struct btd_adapter *adapter,
+						struct btd_device *device);
+void btd_adapter_probe_device(struct btd_adapter *adapter,
+						struct btd_device *device);
 
 void btd_adapter_device_found(struct btd_adapter *adapter,
 					const bdaddr_t *bdaddr,
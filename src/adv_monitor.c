@@ -63,6 +63,7 @@ struct btd_adv_monitor_manager {
 
 	struct queue *apps;	/* apps who registered for Adv monitoring */
 	struct queue *merged_patterns;
+	struct bt_ad_matcher *matcher;	/* Index of merged_patterns content */
 };
 
 struct adv_monitor_app {
@@ -238,12 +239,16 @@ static void merged_pattern_free(void *data)
 {
 	struct adv_monitor_merged_pattern *merged_pattern = data;
 
+	if (merged_pattern->manager) {
+		bt_ad_matcher_remove(merged_pattern->manager->matcher,
+							merged_pattern);
+		queue_remove(merged_pattern->manager->merged_patterns,
+							merged_pattern);
+	}
+
 	queue_destroy(merged_pattern->patterns, pattern_free);
 	queue_destroy(merged_pattern->monitors, NULL);
 
-	if (merged_pattern->manager)
-		queue_remove(merged_pattern->manager->merged_patterns,
-							merged_pattern);
 	free(merged_pattern);
 }
 
@@ -1250,6 +1255,12 @@ static void monitor_proxy_added_cb(GDBusProxy *proxy, void *user_data)
 		monitor->merged_pattern->manager = monitor->app->manager;
 		queue_push_tail(monitor->app->manager->merged_patterns,
 						monitor->merged_pattern);
+
+		if (monitor->merged_pattern->type == MONITOR_TYPE_OR_PATTERNS)
+			bt_ad_matcher_add(monitor->app->manager->matcher,
+					monitor->merged_pattern->patterns,
+					monitor->merged_pattern);
+
 		merged_pattern_add(monitor->merged_pattern);
 	} else {
 		/* Since there is a matching pattern, abandon the one we have */
@@ -1723,6 +1734,7 @@ static struct btd_adv_monitor_manager *manager_new(
 	manager->adapter_id = btd_adapter_get_index(adapter);
 	manager->apps = queue_new();
 	manager->merged_patterns = queue_new();
+	manager->matcher = bt_ad_matcher_new();
 
 	mgmt_register(manager->mgmt, MGMT_EV_ADV_MONITOR_REMOVED,
 			manager->adapter_id, adv_monitor_removed_callback,
@@ -1746,6 +1758,7 @@ static void manager_free(struct btd_adv_monitor_manager *manager)
 
 	queue_destroy(manager->apps, app_destroy);
 	queue_destroy(manager->merged_patterns, merged_pattern_free);
+	bt_ad_matcher_free(manager->matcher);
 
 	free(manager);
 }
@@ -1856,55 +1869,63 @@ bool btd_adv_monitor_offload_enabled(struct btd_adv_monitor_manager *manager)
 				MGMT_ADV_MONITOR_FEATURE_MASK_OR_PATTERNS);
 }
 
-/* Processes the content matching based pattern(s) of a monitor */
-static void adv_match_per_monitor(void *data, void *user_data)
+static bool monitor_has_content_filter(const void *data,
+						const void *match_data)
 {
-	struct adv_monitor *monitor = data;
-	struct adv_content_filter_info *info = user_data;
-	struct queue *patterns;
-
-	if (!monitor) {
-		error("Unexpected NULL adv_monitor object upon match");
-		return;
-	}
+	const struct adv_monitor *monitor = data;
 
-	if (monitor->state != MONITOR_STATE_ACTIVE)
-		return;
+	return monitor->state == MONITOR_STATE_ACTIVE &&
+						monitor->merged_pattern;
+}
 
-	if (!monitor->merged_pattern)
-		return;
+static bool app_has_content_filter(const void *data, const void *match_data)
+{
+	const struct adv_monitor_app *app = data;
 
-	patterns = monitor->merged_pattern->patterns;
-	if (monitor->merged_pattern->type == MONITOR_TYPE_OR_PATTERNS &&
-				bt_ad_pattern_match(info->ad, patterns)) {
-		goto matched;
-	}
+	return queue_find(app->monitors, monitor_has_content_filter, NULL);
+}
 
-	return;
+/* Returns true if at least one active monitor would need the ad data to be
+ * matched, which lets the caller skip building it altogether otherwise.
+ */
+bool btd_adv_monitor_content_filter_enabled(
+				struct btd_adv_monitor_manager *manager)
+{
+	if (!manager)
+		return false;
 
-matched:
-	if (!info->matched_monitors)
-		info->matched_monitors = queue_new();
+	/* Nothing to look up without patterns, skip walking the monitors */
+	if (bt_ad_matcher_is_empty(manager->matcher))
+		return false;
 
-	queue_push_tail(info->matched_monitors, monitor);
+	return queue_find(manager->apps, app_has_content_filter, NULL);
 }
 
-/* Processes the content matching for the monitor(s) of an app */
-static void adv_match_per_app(void *data, void *user_data)
+/* Collects the active monitors of a merged_pattern whose content matched */
+static void adv_match_merged_pattern(void *data, void *user_data)
 {
-	struct adv_monitor_app *app = data;
+	struct adv_monitor_merged_pattern *merged_pattern = data;
+	struct adv_content_filter_info *info = user_data;
+	const struct queue_entry *e;
 
-	if (!app) {
-		error("Unexpected NULL adv_monitor_app object upon match");
-		return;
-	}
+	for (e = queue_get_entries(merged_pattern->monitors); e; e = e->next) {
+		struct adv_monitor *monitor = e->data;
+
+		if (monitor->state != MONITOR_STATE_ACTIVE ||
+				monitor->merged_pattern != merged_pattern)
+			continue;
 
-	queue_foreach(app->monitors, adv_match_per_monitor, user_data);
+		if (!info->matched_monitors)
+			info->matched_monitors = queue_new();
+
+		queue_push_tail(info->matched_monitors, monitor);
+	}
 }
 
 /* Processes the content matching for every app without RSSI filtering and
- * notifying monitors. The caller is responsible of releasing the memory of the
- * list but not the ad data.
+ * notifying monitors. The patterns are looked up in the compiled index so the
+ * cost doesn't grow with the number of monitors. The caller is responsible of
+ * releasing the memory of the list but not the ad data.
  * Returns the list of monitors whose content match the ad data.
  */
 struct queue *btd_adv_monitor_content_filter(
@@ -1919,7 +1940,8 @@ struct queue *btd_adv_monitor_content_filter(
 	info.ad = ad;
 	info.matched_monitors = NULL;
 
-	queue_foreach(manager->apps, adv_match_per_app, &info);
+	bt_ad_matcher_foreach_match(manager->matcher, ad,
+					adv_match_merged_pattern, &info);
 
 	return info.matched_monitors;
 }
@@ -0,0 +1,272 @@
+// SPDX-License-Identifier: LGPL-2.1-or-later
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2026  agent <agent@local>
+ *
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <glib.h>
+#include <dbus/dbus.h>
+
+#include "bluetooth/bluetooth.h"
+
+#include "gdbus/gdbus.h"
+#include "src/shared/adv-ring.h"
+#include "src/shared/queue.h"
+#include "src/shared/util.h"
+
+#include "adapter.h"
+#include "dbus-common.h"
+#include "error.h"
+#include "log.h"
+#include "adv_report.h"
+
+#define ADV_REPORT_MANAGER_INTERFACE	"org.bluez.AdvertisementReportManager1"
+
+#define ADV_REPORT_DEFAULT_SIZE		(256 * 1024)
+
+struct btd_adv_report_manager {
+	struct btd_adapter *adapter;
+	struct queue *clients;
+};
+
+struct adv_report_client {
+	struct btd_adv_report_manager *manager;
+	char *owner;
+	guint watch;
+	struct bt_adv_ring *ring;
+	uint32_t dropped;
+};
+
+static void client_free(void *data)
+{
+	struct adv_report_client *client = data;
+
+	if (client->watch)
+		g_dbus_remove_watch(btd_get_dbus_connection(), client->watch);
+
+	bt_adv_ring_free(client->ring);
+	g_free(client->owner);
+	free(client);
+}
+
+static bool match_owner(const void *data, const void *user_data)
+{
+	const struct adv_report_client *client = data;
+	const char *owner = user_data;
+
+	return !strcmp(client->owner, owner);
+}
+
+static void client_disconnect(DBusConnection *conn, void *user_data)
+{
+	struct adv_report_client *client = user_data;
+
+	DBG("owner %s", client->owner);
+
+	client->watch = 0;
+
+	queue_remove(client->manager->clients, client);
+	client_free(client);
+}
+
+static bool parse_options(DBusMessageIter *iter, uint32_t *size)
+{
+	DBusMessageIter dict;
+
+	if (dbus_message_iter_get_arg_type(iter) != DBUS_TYPE_ARRAY)
+		return false;
+
+	dbus_message_iter_recurse(iter, &dict);
+
+	while (dbus_message_iter_get_arg_type(&dict) == DBUS_TYPE_DICT_ENTRY) {
+		DBusMessageIter entry, value;
+		const char *key;
+
+		dbus_message_iter_recurse(&dict, &entry);
+
+		if (dbus_message_iter_get_arg_type(&entry) != DBUS_TYPE_STRING)
+			return false;
+
+		dbus_message_iter_get_basic(&entry, &key);
+		dbus_message_iter_next(&entry);
+
+		if (dbus_message_iter_get_arg_type(&entry) != DBUS_TYPE_VARIANT)
+			return false;
+
+		dbus_message_iter_recurse(&entry, &value);
+
+		if (!strcasecmp(key, "Size")) {
+			if (dbus_message_iter_get_arg_type(&value) !=
+							DBUS_TYPE_UINT32)
+				return false;
+
+			dbus_message_iter_get_basic(&value, size);
+		}
+
+		dbus_message_iter_next(&dict);
+	}
+
+	return true;
+}
+
+static DBusMessage *acquire_reports(DBusConnection *conn, DBusMessage *msg,
+							void *user_data)
+{
+	struct btd_adv_report_manager *manager = user_data;
+	const char *sender = dbus_message_get_sender(msg);
+	struct adv_report_client *client;
+	uint32_t size = ADV_REPORT_DEFAULT_SIZE;
+	DBusMessageIter args;
+	int fd, event_fd;
+
+	if (queue_find(manager->clients, match_owner, sender))
+		return btd_error_already_exists(msg);
+
+	dbus_message_iter_init(msg, &args);
+
+	if (!parse_options(&args, &size))
+		return btd_error_invalid_args(msg);
+
+	if (size < BT_ADV_RING_MIN_SIZE || size > BT_ADV_RING_MAX_SIZE)
+		return btd_error_invalid_args(msg);
+
+	client = new0(struct adv_report_client, 1);
+	client->manager = manager;
+	client->owner = g_strdup(sender);
+
+	client->ring = bt_adv_ring_new(size);
+	if (!client->ring) {
+		client_free(client);
+		return btd_error_failed(msg, "Unable to create report ring");
+	}
+
+	client->watch = g_dbus_add_disconnect_watch(conn, sender,
+						client_disconnect, client,
+						NULL);
+
+	queue_push_tail(manager->clients, client);
+
+	DBG("owner %s size %zu", sender, bt_adv_ring_get_size(client->ring));
+
+	fd = bt_adv_ring_get_fd(client->ring);
+	event_fd = bt_adv_ring_get_event_fd(client->ring);
+
+	return g_dbus_create_reply(msg, DBUS_TYPE_UNIX_FD, &fd,
+					DBUS_TYPE_UNIX_FD, &event_fd,
+					DBUS_TYPE_INVALID);
+}
+
+static DBusMessage *release_reports(DBusConnection *conn, DBusMessage *msg,
+							void *user_data)
+{
+	struct btd_adv_report_manager *manager = user_data;
+	const char *sender = dbus_message_get_sender(msg);
+	struct adv_report_client *client;
+
+	client = queue_remove_if(manager->clients, match_owner,
+							(void *) sender);
+	if (!client)
+		return btd_error_does_not_exist(msg);
+
+	DBG("owner %s dropped %u", sender,
+				bt_adv_ring_get_dropped(client->ring));
+
+	client_free(client);
+
+	return dbus_message_new_method_return(msg);
+}
+
+static const GDBusMethodTable methods[] = {
+	{ GDBUS_METHOD("AcquireReports",
+			GDBUS_ARGS({ "options", "a{sv}" }),
+			GDBUS_ARGS({ "ring", "h" }, { "event", "h" }),
+			acquire_reports) },
+	{ GDBUS_METHOD("ReleaseReports", NULL, NULL, release_reports) },
+	{ }
+};
+
+struct btd_adv_report_manager *btd_adv_report_manager_create(
+						struct btd_adapter *adapter)
+{
+	struct btd_adv_report_manager *manager;
+
+	manager = new0(struct btd_adv_report_manager, 1);
+	manager->adapter = adapter;
+	manager->clients = queue_new();
+
+	if (!g_dbus_register_interface(btd_get_dbus_connection(),
+					adapter_get_path(adapter),
+					ADV_REPORT_MANAGER_INTERFACE,
+					methods, NULL, NULL, manager, NULL)) {
+		error("Failed to register " ADV_REPORT_MANAGER_INTERFACE);
+		queue_destroy(manager->clients, NULL);
+		free(manager);
+		return NULL;
+	}
+
+	return manager;
+}
+
+void btd_adv_report_manager_destroy(struct btd_adv_report_manager *manager)
+{
+	if (!manager)
+		return;
+
+	g_dbus_unregister_interface(btd_get_dbus_connection(),
+					adapter_get_path(manager->adapter),
+					ADV_REPORT_MANAGER_INTERFACE);
+
+	queue_destroy(manager->clients, client_free);
+	free(manager);
+}
+
+static void push_report(void *data, void *user_data)
+{
+	struct adv_report_client *client = data;
+	const struct bt_adv_report *report = user_data;
+	uint32_t dropped;
+
+	if (bt_adv_ring_push(client->ring, report))
+		return;
+
+	/* Don't flood the logs while the client is behind */
+	dropped = bt_adv_ring_get_dropped(client->ring);
+	if (dropped - client->dropped >= 1000) {
+		DBG("owner %s dropped %u reports", client->owner, dropped);
+		client->dropped = dropped;
+	}
+}
+
+void btd_adv_report_manager_push(struct btd_adv_report_manager *manager,
+					const bdaddr_t *bdaddr,
+					uint8_t bdaddr_type, int8_t rssi,
+					uint32_t flags, const uint8_t *data,
+					uint8_t data_len)
+{
+	struct bt_adv_report report;
+
+	if (!manager || queue_isempty(manager->clients))
+		return;
+
+	memcpy(report.addr, bdaddr->b, sizeof(report.addr));
+	report.addr_type = bdaddr_type;
+	report.rssi = rssi;
+	report.flags = flags;
+	report.timestamp = g_get_monotonic_time();
+	report.data = data;
+	report.len = data_len;
+
+	queue_foreach(manager->clients, push_report, &report);
+}
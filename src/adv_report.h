@@ -0,0 +1,22 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2026  agent <agent@local>
+ *
+ *
+ */
+
+struct btd_adapter;
+struct btd_adv_report_manager;
+
+struct btd_adv_report_manager *btd_adv_report_manager_create(
+						struct btd_adapter *adapter);
+void btd_adv_report_manager_destroy(struct btd_adv_report_manager *manager);
+
+void btd_adv_report_manager_push(struct btd_adv_report_manager *manager,
+					const bdaddr_t *bdaddr,
+					uint8_t bdaddr_type, int8_t rssi,
+					uint32_t flags, const uint8_t *data,
+					uint8_t data_len);
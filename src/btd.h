@@ -48,6 +48,12 @@ enum bt_gatt_export_t {
 	BT_GATT_EXPORT_READ_WRITE,
 };
 
+enum bt_gatt_nfy_queue_t {
+	BT_GATT_NFY_QUEUE_OFF,
+	BT_GATT_NFY_QUEUE_LATEST,
+	BT_GATT_NFY_QUEUE_FIFO,
+};
+
 struct btd_br_defaults {
 	uint16_t	page_scan_type;
 	uint16_t	page_scan_interval;
@@ -139,6 +145,9 @@ struct btd_opts {
 	uint8_t		privacy;
 	bool		device_privacy;
 	uint32_t	name_request_retry_delay;
+	uint32_t	storage_flush_delay;
+	uint16_t	storage_flush_limit;
+	uint32_t	device_property_interval;
 	uint8_t		secure_conn;
 
 	struct btd_defaults defaults;
@@ -165,6 +174,8 @@ struct btd_opts {
 	uint8_t		gatt_channels;
 	bool		gatt_client;
 	enum bt_gatt_export_t gatt_export;
+	enum bt_gatt_nfy_queue_t gatt_nfy_queue;
+	uint16_t	gatt_nfy_queue_size;
 	bool		gatt_seclevel;
 	enum mps_mode_t	mps;
 
@@ -0,0 +1,156 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2026  agent <agent@local>
+ *
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <glib.h>
+
+#include "bluetooth/bluetooth.h"
+
+#include "src/shared/util.h"
+
+#include "device-index.h"
+
+/*
+ * Devices are indexed by address, several devices may share one since
+ * BR/EDR and LE devices are distinct objects. A device is indexed by its
+ * current address and, while connected after its identity address has been
+ * resolved, also by the address it connected with.
+ */
+struct device_index {
+	GHashTable *buckets;	/* Address to struct device_bucket */
+};
+
+struct device_bucket {
+	bdaddr_t bdaddr;
+	GSList *devices;		/* Devices using bdaddr */
+};
+
+static void device_bucket_free(void *data)
+{
+	struct device_bucket *bucket = data;
+
+	g_slist_free(bucket->devices);
+	g_free(bucket);
+}
+
+static guint bdaddr_hash(gconstpointer key)
+{
+	const bdaddr_t *bdaddr = key;
+
+	return get_le32(bdaddr->b) ^ get_le16(bdaddr->b + 4);
+}
+
+static gboolean bdaddr_equal(gconstpointer a, gconstpointer b)
+{
+	return !bacmp(a, b);
+}
+
+struct device_index *device_index_new(void)
+{
+	struct device_index *index;
+
+	index = g_new0(struct device_index, 1);
+	index->buckets = g_hash_table_new_full(bdaddr_hash, bdaddr_equal,
+						NULL, device_bucket_free);
+
+	return index;
+}
+
+void device_index_free(struct device_index *index)
+{
+	if (!index)
+		return;
+
+	g_hash_table_destroy(index->buckets);
+	g_free(index);
+}
+
+void device_index_clear(struct device_index *index)
+{
+	g_hash_table_remove_all(index->buckets);
+}
+
+void device_index_add(struct device_index *index, const bdaddr_t *bdaddr,
+						struct btd_device *device)
+{
+	struct device_bucket *bucket;
+
+	bucket = g_hash_table_lookup(index->buckets, bdaddr);
+	if (!bucket) {
+		bucket = g_new0(struct device_bucket, 1);
+		bacpy(&bucket->bdaddr, bdaddr);
+		g_hash_table_insert(index->buckets, &bucket->bdaddr, bucket);
+	}
+
+	/* Newest first, the same order as the adapter device list */
+	bucket->devices = g_slist_prepend(bucket->devices, device);
+}
+
+bool device_index_remove(struct device_index *index, const bdaddr_t *bdaddr,
+						struct btd_device *device)
+{
+	struct device_bucket *bucket;
+	GSList *l;
+
+	bucket = g_hash_table_lookup(index->buckets, bdaddr);
+	if (!bucket)
+		return false;
+
+	l = g_slist_find(bucket->devices, device);
+	if (!l)
+		return false;
+
+	bucket->devices = g_slist_delete_link(bucket->devices, l);
+	if (!bucket->devices)
+		g_hash_table_remove(index->buckets, bdaddr);
+
+	return true;
+}
+
+/*
+ * Moves a device indexed by old to bdaddr. With keep_old the device stays
+ * indexed by old as well, until that entry is removed explicitly.
+ */
+void device_index_move(struct device_index *index, struct btd_device *device,
+				const bdaddr_t *old, const bdaddr_t *bdaddr,
+				bool keep_old)
+{
+	if (!bacmp(old, bdaddr))
+		return;
+
+	if (keep_old) {
+		struct device_bucket *bucket;
+
+		bucket = g_hash_table_lookup(index->buckets, old);
+		if (!bucket || !g_slist_find(bucket->devices, device))
+			return;
+	} else if (!device_index_remove(index, old, device))
+		return;
+
+	device_index_add(index, bdaddr, device);
+}
+
+GSList *device_index_lookup(struct device_index *index,
+						const bdaddr_t *bdaddr)
+{
+	struct device_bucket *bucket;
+
+	bucket = g_hash_table_lookup(index->buckets, bdaddr);
+	if (!bucket)
+		return NULL;
+
+	return bucket->devices;
+}
@@ -0,0 +1,27 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2026  agent <agent@local>
+ *
+ *
+ */
+
+struct btd_device;
+struct device_index;
+
+struct device_index *device_index_new(void);
+void device_index_free(struct device_index *index);
+void device_index_clear(struct device_index *index);
+
+void device_index_add(struct device_index *index, const bdaddr_t *bdaddr,
+						struct btd_device *device);
+bool device_index_remove(struct device_index *index, const bdaddr_t *bdaddr,
+						struct btd_device *device);
+void device_index_move(struct device_index *index, struct btd_device *device,
+				const bdaddr_t *old, const bdaddr_t *bdaddr,
+				bool keep_old);
+
+GSList *device_index_lookup(struct device_index *index,
+						const bdaddr_t *bdaddr);
@@ -299,6 +299,7 @@ struct btd_device {
 
 	GIOChannel	*att_io;
 	guint		store_id;
+	bool		store_keys;	/* Keys changed, write immediately */
 
 	time_t		name_resolve_failed_time;
 
@@ -523,10 +524,8 @@ static gboolean store_device_info_cb(gpointer user_data)
 	GError *gerr = NULL;
 	char filename[PATH_MAX];
 	char device_addr[18];
-	char *str;
 	char class[9];
 	char **uuids = NULL;
-	gsize length = 0;
 
 	device->store_id = 0;
 
@@ -536,12 +535,12 @@ static gboolean store_device_info_cb(gpointer user_data)
 				device_addr);
 	create_file(filename, 0600);
 
-	key_file = g_key_file_new();
-	if (!g_key_file_load_from_file(key_file, filename, 0, &gerr)) {
+	key_file = btd_storage_load(filename, &gerr);
+	if (gerr) {
 		error("Unable to load key file from %s: (%s)", filename,
 								gerr->message);
 		g_error_free(gerr);
-		g_key_file_free(key_file);
+		g_key_file_unref(key_file);
 		return FALSE;
 	}
 
@@ -628,16 +627,14 @@ static gboolean store_device_info_cb(gpointer user_data)
 		}
 	}
 
-	str = g_key_file_to_data(key_file, &length, NULL);
-	if (!g_file_set_contents(filename, str, length, &gerr)) {
-		error("Unable set contents for %s: (%s)", filename,
-								gerr->message);
-		g_error_free(gerr);
-	}
+	if (device->store_keys)
+		btd_storage_store_sync(filename, key_file);
+	else
+		btd_storage_store(filename, key_file);
 
-	g_free(str);
+	device->store_keys = false;
 
-	g_key_file_free(key_file);
+	g_key_file_unref(key_file);
 	g_free(uuids);
 
 	return FALSE;
@@ -693,8 +690,8 @@ void device_store_cached_name(struct btd_device *dev, const char *name)
 			btd_adapter_get_storage_dir(dev->adapter), d_addr);
 	create_file(filename, 0600);
 
-	key_file = g_key_file_new();
-	if (!g_key_file_load_from_file(key_file, filename, 0, &gerr)) {
+	key_file = btd_storage_load(filename, &gerr);
+	if (gerr) {
 		error("Unable to load key file from %s: (%s)", filename,
 								gerr->message);
 		g_clear_error(&gerr);
@@ -706,17 +703,13 @@ void device_store_cached_name(struct btd_device *dev, const char *name)
 
 	data = g_key_file_to_data(key_file, &length, NULL);
 
-	if ((length != length_old) || (memcmp(data, data_old, length))) {
-		if (!g_file_set_contents(filename, data, length, &gerr)) {
-			error("Unable set contents for %s: (%s)", filename,
-								gerr->message);
-			g_clear_error(&gerr);
-		}
-	}
+	if ((length != length_old) || (memcmp(data, data_old, length)))
+		btd_storage_store(filename, key_file);
+
 	g_free(data);
 	g_free(data_old);
 
-	g_key_file_free(key_file);
+	g_key_file_unref(key_file);
 }
 
 static void device_store_cached_name_resolve(struct btd_device *dev)
@@ -742,8 +735,8 @@ static void device_store_cached_name_resolve(struct btd_device *dev)
 			btd_adapter_get_storage_dir(dev->adapter), d_addr);
 	create_file(filename, 0600);
 
-	key_file = g_key_file_new();
-	if (!g_key_file_load_from_file(key_file, filename, 0, &gerr)) {
+	key_file = btd_storage_load(filename, &gerr);
+	if (gerr) {
 		error("Unable to load key file from %s: (%s)", filename,
 								gerr->message);
 		g_clear_error(&gerr);
@@ -758,18 +751,13 @@ static void device_store_cached_name_resolve(struct btd_device *dev)
 
 	data = g_key_file_to_data(key_file, &length, NULL);
 
-	if ((length != length_old) || (memcmp(data, data_old, length))) {
-		if (!g_file_set_contents(filename, data, length, &gerr)) {
-			error("Unable set contents for %s: (%s)", filename,
-								gerr->message);
-			g_error_free(gerr);
-		}
-	}
+	if ((length != length_old) || (memcmp(data, data_old, length)))
+		btd_storage_store(filename, key_file);
 
 	g_free(data);
 	g_free(data_old);
 
-	g_key_file_free(key_file);
+	g_key_file_unref(key_file);
 }
 
 static void browse_request_free(struct browse_req *req)
@@ -2202,6 +2190,7 @@ void device_set_csrk(struct btd_device *device, const uint8_t val[16],
 	if (!store_hint)
 		return;
 
+	device->store_keys = true;
 	store_device_info(device);
 
 	btd_device_set_temporary(device, false);
@@ -2232,6 +2221,7 @@ static struct sirk_info *device_add_sirk_info(struct btd_device *device,
 	sirk->rank = rank;
 
 	queue_push_tail(device->sirks, sirk);
+	device->store_keys = true;
 	store_device_info(device);
 
 	return sirk;
@@ -2721,6 +2711,9 @@ int btd_device_connect_services(struct btd_device *dev, GSList *services)
 	if (dev->pending || dev->connect || dev->browse)
 		return -EBUSY;
 
+	/* Profiles of stored devices may not have been probed yet */
+	btd_adapter_probe_device(dev->adapter, dev);
+
 	if (!btd_adapter_get_powered(dev->adapter))
 		return -ENETDOWN;
 
@@ -2777,6 +2770,8 @@ DBusMessage *device_connect_profiles(struct btd_device *dev,
 					ERR_BREDR_CONN_ADAPTER_NOT_POWERED);
 	}
 
+	btd_adapter_probe_device(dev->adapter, dev);
+
 	btd_device_set_temporary(dev, false);
 
 	if (!state->svc_resolved)
@@ -2972,7 +2967,6 @@ static void store_services(struct btd_device *device)
 	uuid_t uuid;
 	char *prim_uuid;
 	GKeyFile *key_file;
-	GError *gerr = NULL;
 	GSList *l;
 	char *data;
 	gsize length = 0;
@@ -3028,18 +3022,12 @@ static void store_services(struct btd_device *device)
 	}
 
 	data = g_key_file_to_data(key_file, &length, NULL);
-	if (length > 0) {
-		create_file(filename, 0600);
-		if (!g_file_set_contents(filename, data, length, &gerr)) {
-			error("Unable set contents for %s: (%s)", filename,
-								gerr->message);
-			g_error_free(gerr);
-		}
-	}
+	if (length > 0)
+		btd_storage_store(filename, key_file);
 
 	free(prim_uuid);
 	g_free(data);
-	g_key_file_free(key_file);
+	g_key_file_unref(key_file);
 }
 
 static void store_gatt_db(struct btd_device *device)
@@ -3063,7 +3051,7 @@ static void store_gatt_db(struct btd_device *device)
 				dst_addr);
 	create_file(filename, 0600);
 
-	btd_settings_gatt_db_store(device->db, filename);
+	btd_settings_gatt_cache_store(device->db, filename);
 }
 
 static void browse_request_complete(struct browse_req *req, uint8_t type,
@@ -3700,14 +3688,17 @@ static const GDBusPropertyTable device_properties[] = {
 					dev_property_exists_appearance },
 	{ "Icon", "s", dev_property_get_icon, NULL,
 					dev_property_exists_icon },
-	{ "Paired", "b", dev_property_get_paired },
-	{ "Bonded", "b", dev_property_get_bonded },
+	{ "Paired", "b", dev_property_get_paired, NULL, NULL,
+					G_DBUS_PROPERTY_FLAG_URGENT },
+	{ "Bonded", "b", dev_property_get_bonded, NULL, NULL,
+					G_DBUS_PROPERTY_FLAG_URGENT },
 	{ "Trusted", "b", dev_property_get_trusted, dev_property_set_trusted },
 	{ "Blocked", "b", dev_property_get_blocked, dev_property_set_blocked },
 	{ "LegacyPairing", "b", dev_property_get_legacy },
 	{ "CablePairing", "b", dev_property_get_cable_pairing },
 	{ "RSSI", "n", dev_property_get_rssi, NULL, dev_property_exists_rssi },
-	{ "Connected", "b", dev_property_get_connected },
+	{ "Connected", "b", dev_property_get_connected, NULL, NULL,
+					G_DBUS_PROPERTY_FLAG_URGENT },
 	{ "UUIDs", "as", dev_property_get_uuids },
 	{ "Modalias", "s", dev_property_get_modalias, NULL,
 						dev_property_exists_modalias },
@@ -3718,7 +3709,8 @@ static const GDBusPropertyTable device_properties[] = {
 				NULL, dev_property_service_data_exist },
 	{ "TxPower", "n", dev_property_get_tx_power, NULL,
 					dev_property_exists_tx_power },
-	{ "ServicesResolved", "b", dev_property_get_svc_resolved, NULL, NULL },
+	{ "ServicesResolved", "b", dev_property_get_svc_resolved, NULL, NULL,
+					G_DBUS_PROPERTY_FLAG_URGENT },
 	{ "AdvertisingFlags", "ay", dev_property_get_flags, NULL,
 					dev_property_flags_exist },
 	{ "AdvertisingData", "a{yv}", dev_property_get_advertising_data,
@@ -3822,6 +3814,8 @@ void device_add_connection(struct btd_device *dev, uint8_t bdaddr_type,
 		return;
 	}
 
+	btd_adapter_remove_device_conn_addr(dev->adapter, dev);
+
 	bacpy(&dev->conn_bdaddr, &dev->bdaddr);
 	dev->conn_bdaddr_type = dev->bdaddr_type;
 
@@ -3953,6 +3947,9 @@ void device_remove_connection(struct btd_device *device, uint8_t bdaddr_type,
 	state->initiator = false;
 	device->general_connect = FALSE;
 
+	if (!device->bredr_state.connected && !device->le_state.connected)
+		btd_adapter_remove_device_conn_addr(device->adapter, device);
+
 	device_set_svc_refreshed(device, false);
 
 	if (device->disconn_timer > 0) {
@@ -4117,10 +4114,7 @@ static char *load_cached_name(struct btd_device *device, const char *local,
 
 	create_filename(filename, PATH_MAX, "/%s/cache/%s", local, peer);
 
-	key_file = g_key_file_new();
-
-	if (!g_key_file_load_from_file(key_file, filename, 0, NULL))
-		goto failed;
+	key_file = btd_storage_load(filename, NULL);
 
 	str = g_key_file_get_string(key_file, "General", "Name", NULL);
 	if (str) {
@@ -4129,8 +4123,7 @@ static char *load_cached_name(struct btd_device *device, const char *local,
 			str[HCI_MAX_NAME_LENGTH] = '\0';
 	}
 
-failed:
-	g_key_file_free(key_file);
+	g_key_file_unref(key_file);
 
 	return str;
 }
@@ -4147,18 +4140,14 @@ static void load_cached_name_resolve(struct btd_device *device,
 
 	create_filename(filename, PATH_MAX, "/%s/cache/%s", local, peer);
 
-	key_file = g_key_file_new();
-
-	if (!g_key_file_load_from_file(key_file, filename, 0, NULL))
-		goto failed;
+	key_file = btd_storage_load(filename, NULL);
 
 	failed_time = g_key_file_get_uint64(key_file, "NameResolving",
 							"FailedTime", NULL);
 
 	device->name_resolve_failed_time = failed_time;
 
-failed:
-	g_key_file_free(key_file);
+	g_key_file_unref(key_file);
 }
 
 static struct csrk_info *load_csrk(GKeyFile *key_file, const char *group)
@@ -4274,9 +4263,6 @@ static void convert_info(struct btd_device *device, GKeyFile *key_file)
 	char adapter_addr[18];
 	char device_addr[18];
 	char **uuids;
-	char *str;
-	gsize length = 0;
-	GError *gerr = NULL;
 
 	/* Load device profile list from legacy properties */
 	uuids = g_key_file_get_string_list(key_file, "General", "SDPServices",
@@ -4301,13 +4287,7 @@ static void convert_info(struct btd_device *device, GKeyFile *key_file)
 	create_filename(filename, PATH_MAX, "/%s/%s/info", adapter_addr,
 			device_addr);
 
-	str = g_key_file_to_data(key_file, &length, NULL);
-	if (!g_file_set_contents(filename, str, length, &gerr)) {
-		error("Unable set contents for %s: (%s)", filename,
-								gerr->message);
-		g_error_free(gerr);
-	}
-	g_free(str);
+	btd_storage_store(filename, key_file);
 
 	store_device_info(device);
 }
@@ -4436,7 +4416,7 @@ next:
 		char filename[PATH_MAX];
 		char device_addr[18];
 		struct stat st;
-		GKeyFile *key_file = g_key_file_new();
+		GKeyFile *key_file;
 		GError *gerr = NULL;
 
 		load_services(device, uuids);
@@ -4446,12 +4426,15 @@ next:
 			btd_adapter_get_storage_dir(device->adapter),
 			device_addr);
 
-		/* Check if ServiceRecords cached group exists */
-		if (stat(filename, &st) < 0) {
+		/* Check if ServiceRecords cached group exists, the file may
+		 * only exist as a pending write.
+		 */
+		key_file = btd_storage_load(filename, &gerr);
+		if (gerr && stat(filename, &st) < 0) {
 			DBG("Missing cache file for ServiceRecords");
+			g_clear_error(&gerr);
 			device->bredr_state.svc_resolved = false;
-		} else if (!g_key_file_load_from_file(key_file, filename,
-							0, &gerr)) {
+		} else if (gerr) {
 			DBG("Unable to load key file from %s: (%s)", filename,
 								gerr->message);
 			g_clear_error(&gerr);
@@ -4463,7 +4446,7 @@ next:
 			/* Discovered services restored from storage */
 			device->bredr_state.svc_resolved = true;
 		}
-		g_key_file_free(key_file);
+		g_key_file_unref(key_file);
 	}
 
 	/* Load device id */
@@ -4517,8 +4500,8 @@ static void load_att_info(struct btd_device *device, const char *local,
 	if (stat(filename, &st) < 0)
 		return;
 
-	key_file = g_key_file_new();
-	if (!g_key_file_load_from_file(key_file, filename, 0, &gerr)) {
+	key_file = btd_storage_load(filename, &gerr);
+	if (gerr) {
 		error("Unable to load key file from %s: (%s)", filename,
 								gerr->message);
 		g_clear_error(&gerr);
@@ -4590,7 +4573,7 @@ static void load_att_info(struct btd_device *device, const char *local,
 	}
 
 	g_strfreev(groups);
-	g_key_file_free(key_file);
+	g_key_file_unref(key_file);
 	free(prim_uuid);
 }
 
@@ -4624,6 +4607,7 @@ static void load_gatt_db(struct btd_device *device, const char *local,
 							const char *peer)
 {
 	char filename[PATH_MAX];
+	GKeyFile *key_file;
 	int err;
 
 	if (!gatt_cache_is_enabled(device))
@@ -4633,7 +4617,16 @@ static void load_gatt_db(struct btd_device *device, const char *local,
 
 	create_filename(filename, PATH_MAX, "/%s/cache/%s", local, peer);
 
-	err = btd_settings_gatt_db_load(device->db, filename);
+	err = btd_settings_gatt_cache_load(device->db, filename);
+	if (err == -ENOENT) {
+		key_file = btd_storage_load(filename, NULL);
+		err = btd_settings_gatt_cache_convert(device->db, filename,
+								key_file);
+		if (!err)
+			btd_storage_store(filename, key_file);
+		g_key_file_unref(key_file);
+	}
+
 	if (err < 0) {
 		if (err == -ENOENT)
 			return;
@@ -5008,6 +5001,11 @@ static struct btd_device *device_new(struct btd_adapter *adapter,
 		return NULL;
 	}
 
+	/* Rate limit updates coming from advertising reports */
+	g_dbus_set_property_changed_interval(dbus_conn, device->path,
+					DEVICE_INTERFACE,
+					btd_opts.device_property_interval);
+
 	device->adapter = adapter;
 	device->sirks = queue_new();
 	device->temporary = true;
@@ -5204,6 +5202,17 @@ void device_set_privacy(struct btd_device *device, bool value,
 		device->irk = util_memdup(irk, 16);
 	else
 		device->irk = NULL;
+
+	btd_adapter_update_device_irk(device->adapter, device);
+}
+
+const uint8_t *device_get_irk(struct btd_device *device)
+{
+	/* Only devices using privacy are resolved using their IRK */
+	if (!device->privacy)
+		return NULL;
+
+	return device->irk;
 }
 
 bool device_get_privacy(struct btd_device *device)
@@ -5237,6 +5246,8 @@ void device_update_addr(struct btd_device *device, const bdaddr_t *bdaddr,
 	if (auto_connect)
 		device_set_auto_connect(device, FALSE);
 
+	btd_adapter_update_device_addr(device->adapter, device, bdaddr);
+
 	bacpy(&device->bdaddr, bdaddr);
 	device->bdaddr_type = bdaddr_type;
 
@@ -5442,16 +5453,19 @@ static void device_remove_stored(struct btd_device *device)
 	create_filename(filename, PATH_MAX, "/%s/%s",
 				btd_adapter_get_storage_dir(device->adapter),
 				device_addr);
+	btd_storage_remove(filename);
 	delete_folder_tree(filename);
 
 	create_filename(filename, PATH_MAX, "/%s/cache/%s",
 				btd_adapter_get_storage_dir(device->adapter),
 				device_addr);
 
-	key_file = g_key_file_new();
-	if (!g_key_file_load_from_file(key_file, filename, 0, &gerr)) {
+	btd_settings_gatt_cache_remove(filename);
+
+	key_file = btd_storage_load(filename, &gerr);
+	if (gerr) {
 		g_error_free(gerr);
-		g_key_file_free(key_file);
+		g_key_file_unref(key_file);
 		return;
 	}
 	g_key_file_remove_group(key_file, "ServiceRecords", NULL);
@@ -5460,18 +5474,14 @@ static void device_remove_stored(struct btd_device *device)
 
 	data = g_key_file_to_data(key_file, &length, NULL);
 	if (length > 0) {
-		create_file(filename, 0600);
-		if (!g_file_set_contents(filename, data, length, &gerr)) {
-			error("Unable set contents for %s: (%s)", filename,
-								gerr->message);
-			g_error_free(gerr);
-		}
+		btd_storage_store(filename, key_file);
 	} else {
+		btd_storage_remove(filename);
 		unlink(filename);
 	}
 
 	g_free(data);
-	g_key_file_free(key_file);
+	g_key_file_unref(key_file);
 }
 
 void device_remove(struct btd_device *device, gboolean remove_stored)
@@ -5573,26 +5583,6 @@ static bool addr_is_resolvable(const bdaddr_t *bdaddr, uint8_t addr_type)
 	}
 }
 
-static int device_irk_cmp(const struct btd_device *device,
-				const struct device_addr_type *addr)
-{
-	struct bt_crypto *crypto;
-	uint8_t hash[3];
-
-	if (!device->irk)
-		return -1;
-
-	crypto = bt_crypto_new();
-	if (!crypto)
-		return -1;
-
-	bt_crypto_ah(crypto, device->irk, addr->bdaddr.b + 3, hash);
-
-	bt_crypto_unref(crypto);
-
-	return memcmp(addr, hash, 3);
-}
-
 int device_addr_type_cmp(gconstpointer a, gconstpointer b)
 {
 	const struct btd_device *dev = a;
@@ -5621,9 +5611,13 @@ int device_addr_type_cmp(gconstpointer a, gconstpointer b)
 		return -1;
 
 	if (addr->bdaddr_type != dev->bdaddr_type) {
+		/*
+		 * Resolvable addresses are matched against the IRK by the
+		 * adapter, see btd_adapter_find_device.
+		 */
 		if (dev->privacy && addr_is_resolvable(&addr->bdaddr,
 							addr->bdaddr_type))
-			return device_irk_cmp(dev, addr);
+			return -1;
 
 		if (addr->bdaddr_type == dev->conn_bdaddr_type)
 			return bacmp(&dev->conn_bdaddr, &addr->bdaddr);
@@ -5915,12 +5909,12 @@ static void update_bredr_services(struct browse_req *req, sdp_list_t *recs)
 	create_filename(sdp_file, PATH_MAX, "/%s/cache/%s", srcaddr, dstaddr);
 	create_file(sdp_file, 0600);
 
-	sdp_key_file = g_key_file_new();
-	if (!g_key_file_load_from_file(sdp_key_file, sdp_file, 0, &gerr)) {
+	sdp_key_file = btd_storage_load(sdp_file, &gerr);
+	if (gerr) {
 		error("Unable to load key file from %s: (%s)", sdp_file,
 								gerr->message);
 		g_clear_error(&gerr);
-		g_key_file_free(sdp_key_file);
+		g_key_file_unref(sdp_key_file);
 		sdp_key_file = NULL;
 	}
 
@@ -5928,12 +5922,12 @@ static void update_bredr_services(struct browse_req *req, sdp_list_t *recs)
 							dstaddr);
 	create_file(att_file, 0600);
 
-	att_key_file = g_key_file_new();
-	if (!g_key_file_load_from_file(att_key_file, att_file, 0, &gerr)) {
+	att_key_file = btd_storage_load(att_file, &gerr);
+	if (gerr) {
 		error("Unable to load key file from %s: (%s)", att_file,
 								gerr->message);
 		g_clear_error(&gerr);
-		g_key_file_free(att_key_file);
+		g_key_file_unref(att_key_file);
 		att_key_file = NULL;
 	}
 
@@ -5988,32 +5982,20 @@ next:
 
 	if (sdp_key_file) {
 		data = g_key_file_to_data(sdp_key_file, &length, NULL);
-		if (length > 0) {
-			if (!g_file_set_contents(sdp_file, data, length,
-								&gerr)) {
-				error("Unable set contents for %s: (%s)",
-						sdp_file, gerr->message);
-				g_clear_error(&gerr);
-			}
-		}
+		if (length > 0)
+			btd_storage_store(sdp_file, sdp_key_file);
 
 		g_free(data);
-		g_key_file_free(sdp_key_file);
+		g_key_file_unref(sdp_key_file);
 	}
 
 	if (att_key_file) {
 		data = g_key_file_to_data(att_key_file, &length, NULL);
-		if (length > 0) {
-			if (!g_file_set_contents(att_file, data, length,
-								&gerr)) {
-				error("Unable set contents for %s: (%s)",
-						att_file, gerr->message);
-				g_clear_error(&gerr);
-			}
-		}
+		if (length > 0)
+			btd_storage_store(att_file, att_key_file);
 
 		g_free(data);
-		g_key_file_free(att_key_file);
+		g_key_file_unref(att_key_file);
 	}
 }
 
@@ -6863,6 +6845,12 @@ const bdaddr_t *device_get_address(struct btd_device *device)
 {
 	return &device->bdaddr;
 }
+
+const bdaddr_t *device_get_conn_address(struct btd_device *device)
+{
+	return &device->conn_bdaddr;
+}
+
 uint8_t device_get_le_address_type(struct btd_device *device)
 {
 	return device->bdaddr_type;
@@ -7012,16 +7000,14 @@ void device_store_svc_chng_ccc(struct btd_device *device, uint8_t bdaddr_type,
 	GKeyFile *key_file;
 	GError *gerr = NULL;
 	uint16_t old_value;
-	gsize length = 0;
-	char *str;
 
 	ba2str(&device->bdaddr, device_addr);
 	create_filename(filename, PATH_MAX, "/%s/%s/info",
 				btd_adapter_get_storage_dir(device->adapter),
 				device_addr);
 
-	key_file = g_key_file_new();
-	if (!g_key_file_load_from_file(key_file, filename, 0, &gerr)) {
+	key_file = btd_storage_load(filename, &gerr);
+	if (gerr) {
 		error("Unable to load key file from %s: (%s)", filename,
 								gerr->message);
 		g_clear_error(&gerr);
@@ -7048,18 +7034,10 @@ void device_store_svc_chng_ccc(struct btd_device *device, uint8_t bdaddr_type,
 									value);
 	}
 
-	create_file(filename, 0600);
-
-	str = g_key_file_to_data(key_file, &length, NULL);
-	if (!g_file_set_contents(filename, str, length, &gerr)) {
-		error("Unable set contents for %s: (%s)", filename,
-								gerr->message);
-		g_error_free(gerr);
-	}
-	g_free(str);
+	btd_storage_store(filename, key_file);
 
 done:
-	g_key_file_free(key_file);
+	g_key_file_unref(key_file);
 }
 void device_load_svc_chng_ccc(struct btd_device *device, uint16_t *ccc_le,
 							uint16_t *ccc_bredr)
@@ -7074,8 +7052,8 @@ void device_load_svc_chng_ccc(struct btd_device *device, uint16_t *ccc_le,
 				btd_adapter_get_storage_dir(device->adapter),
 				device_addr);
 
-	key_file = g_key_file_new();
-	if (!g_key_file_load_from_file(key_file, filename, 0, &gerr)) {
+	key_file = btd_storage_load(filename, &gerr);
+	if (gerr) {
 		error("Unable to load key file from %s: (%s)", filename,
 								gerr->message);
 		g_error_free(gerr);
@@ -7086,7 +7064,7 @@ void device_load_svc_chng_ccc(struct btd_device *device, uint16_t *ccc_le,
 			*ccc_le = 0x0000;
 		if (ccc_bredr)
 			*ccc_bredr = 0x0000;
-		g_key_file_free(key_file);
+		g_key_file_unref(key_file);
 		return;
 	}
 
@@ -7098,7 +7076,7 @@ void device_load_svc_chng_ccc(struct btd_device *device, uint16_t *ccc_le,
 		*ccc_bredr = g_key_file_get_integer(key_file, "ServiceChanged",
 							"CCC_BR/EDR", NULL);
 
-	g_key_file_free(key_file);
+	g_key_file_unref(key_file);
 }
 
 void device_set_rssi_with_delta(struct btd_device *device, int8_t rssi,
@@ -7977,8 +7955,8 @@ static sdp_list_t *read_device_records(struct btd_device *device)
 
 	create_filename(filename, PATH_MAX, "/%s/cache/%s", local, peer);
 
-	key_file = g_key_file_new();
-	if (!g_key_file_load_from_file(key_file, filename, 0, &gerr)) {
+	key_file = btd_storage_load(filename, &gerr);
+	if (gerr) {
 		error("Unable to load key file from %s: (%s)", filename,
 								gerr->message);
 		g_error_free(gerr);
@@ -7997,7 +7975,7 @@ static sdp_list_t *read_device_records(struct btd_device *device)
 	}
 
 	g_strfreev(keys);
-	g_key_file_free(key_file);
+	g_key_file_unref(key_file);
 
 	return recs;
 }
@@ -8240,6 +8218,8 @@ struct btd_service *btd_device_get_service(struct btd_device *dev,
 {
 	GSList *l;
 
+	btd_adapter_probe_device(dev->adapter, dev);
+
 	for (l = dev->services; l != NULL; l = g_slist_next(l)) {
 		struct btd_service *service = l->data;
 		struct btd_profile *p = btd_service_get_profile(service);
@@ -34,6 +34,7 @@ bool device_address_is_private(struct btd_device *dev);
 void device_set_privacy(struct btd_device *device, bool value,
 					const uint8_t *irk);
 bool device_get_privacy(struct btd_device *device);
+const uint8_t *device_get_irk(struct btd_device *device);
 void device_update_addr(struct btd_device *device, const bdaddr_t *bdaddr,
 				uint8_t bdaddr_type, const uint8_t *irk);
 void device_set_bredr_support(struct btd_device *device);
@@ -91,6 +92,7 @@ void device_probe_profile(gpointer a, gpointer b);
 void device_remove_profile(gpointer a, gpointer b);
 struct btd_adapter *device_get_adapter(struct btd_device *device);
 const bdaddr_t *device_get_address(struct btd_device *device);
+const bdaddr_t *device_get_conn_address(struct btd_device *device);
 uint8_t device_get_le_address_type(struct btd_device *device);
 const char *device_get_path(const struct btd_device *device);
 gboolean device_is_temporary(struct btd_device *device);
@@ -241,36 +241,49 @@ static void eir_parse_data(struct eir_data *eir, uint8_t type,
 		eir->rsi = true;
 }
 
-void eir_parse(struct eir_data *eir, const uint8_t *eir_data, uint8_t eir_len)
+/* Returns the next field, stopping at the first zero or truncated one */
+static bool eir_next_field(const uint8_t **eir_data, uint16_t *pos,
+				uint8_t eir_len, uint8_t *type,
+				const uint8_t **data, uint8_t *data_len)
 {
-	uint16_t len = 0;
+	const uint8_t *field = *eir_data;
+	uint8_t field_len;
 
-	eir->flags = 0;
-	eir->tx_power = 127;
+	if (!field || *pos >= eir_len - 1)
+		return false;
 
-	/* No EIR data to parse */
-	if (eir_data == NULL)
-		return;
+	field_len = field[0];
 
-	while (len < eir_len - 1) {
-		uint8_t field_len = eir_data[0];
-		const uint8_t *data;
-		uint8_t data_len;
+	/* Check for the end of EIR */
+	if (field_len == 0)
+		return false;
 
-		/* Check for the end of EIR */
-		if (field_len == 0)
-			break;
+	*pos += field_len + 1;
 
-		len += field_len + 1;
+	/* Do not continue EIR Data parsing if got incorrect length */
+	if (*pos > eir_len)
+		return false;
 
-		/* Do not continue EIR Data parsing if got incorrect length */
-		if (len > eir_len)
-			break;
+	*type = field[1];
+	*data = &field[2];
+	*data_len = field_len - 1;
+	*eir_data += field_len + 1;
+
+	return true;
+}
 
-		data = &eir_data[2];
-		data_len = field_len - 1;
+void eir_parse(struct eir_data *eir, const uint8_t *eir_data, uint8_t eir_len)
+{
+	uint16_t len = 0;
+	const uint8_t *data;
+	uint8_t type, data_len;
 
-		switch (eir_data[1]) {
+	eir->flags = 0;
+	eir->tx_power = 127;
+
+	while (eir_next_field(&eir_data, &len, eir_len, &type, &data,
+								&data_len)) {
+		switch (type) {
 		case EIR_UUID16_SOME:
 		case EIR_UUID16_ALL:
 			eir_parse_uuid16(eir, data, data_len);
@@ -302,7 +315,7 @@ void eir_parse(struct eir_data *eir, const uint8_t *eir_data, uint8_t eir_len)
 			g_free(eir->name);
 
 			eir->name = name2utf8(data, data_len);
-			eir->name_complete = eir_data[1] != EIR_NAME_SHORT;
+			eir->name_complete = type != EIR_NAME_SHORT;
 			break;
 
 		case EIR_TX_POWER:
@@ -363,12 +376,73 @@ void eir_parse(struct eir_data *eir, const uint8_t *eir_data, uint8_t eir_len)
 			break;
 
 		default:
-			eir_parse_data(eir, eir_data[1], data, data_len);
+			eir_parse_data(eir, type, data, data_len);
+			break;
+		}
+	}
+}
+
+void eir_scan(struct eir_scan *scan, const uint8_t *eir_data, uint8_t eir_len)
+{
+	uint16_t len = 0;
+	const uint8_t *data;
+	uint8_t type, data_len;
+
+	memset(scan, 0, sizeof(*scan));
+
+	while (eir_next_field(&eir_data, &len, eir_len, &type, &data,
+								&data_len)) {
+		switch (type) {
+		case EIR_FLAGS:
+			if (data_len > 0)
+				scan->flags = *data;
+			break;
+		case EIR_NAME_SHORT:
+		case EIR_NAME_COMPLETE:
+		case EIR_BC_NAME:
+			scan->name = true;
+			break;
+		case EIR_CSIP_RSI:
+			scan->rsi = true;
 			break;
 		}
+	}
+}
 
-		eir_data += field_len + 1;
+bool eir_has_service_data(const uint8_t *eir_data, uint8_t eir_len,
+							uint16_t uuid)
+{
+	static const uint8_t base[16] = {
+			0xfb, 0x34, 0x9b, 0x5f, 0x80, 0x00, 0x00, 0x80,
+			0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 };
+	uint16_t len = 0;
+	const uint8_t *data;
+	uint8_t type, data_len;
+
+	while (eir_next_field(&eir_data, &len, eir_len, &type, &data,
+								&data_len)) {
+		/* Same length limits as the full parser */
+		if (data_len > EIR_SD_MAX_LEN)
+			continue;
+
+		switch (type) {
+		case EIR_SVC_DATA16:
+			if (data_len >= 2 && get_le16(data) == uuid)
+				return true;
+			break;
+		case EIR_SVC_DATA32:
+			if (data_len >= 4 && get_le32(data) == uuid)
+				return true;
+			break;
+		case EIR_SVC_DATA128:
+			if (data_len >= 16 && !memcmp(data, base, 12) &&
+						get_le32(data + 12) == uuid)
+				return true;
+			break;
+		}
 	}
+
+	return false;
 }
 
 int eir_parse_oob(struct eir_data *eir, uint8_t *eir_data, uint16_t eir_len)
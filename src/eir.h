@@ -92,8 +92,18 @@ struct eir_data {
 	struct queue *data_list;
 };
 
+/* Fields that can be extracted without allocating */
+struct eir_scan {
+	unsigned int flags;
+	bool name;
+	bool rsi;
+};
+
 void eir_data_free(struct eir_data *eir);
 void eir_parse(struct eir_data *eir, const uint8_t *eir_data, uint8_t eir_len);
+void eir_scan(struct eir_scan *scan, const uint8_t *eir_data, uint8_t eir_len);
+bool eir_has_service_data(const uint8_t *eir_data, uint8_t eir_len,
+							uint16_t uuid);
 int eir_parse_oob(struct eir_data *eir, uint8_t *eir_data, uint16_t eir_len);
 int eir_create_oob(const bdaddr_t *addr, const char *name, uint32_t cod,
 			const uint8_t *hash, const uint8_t *randomizer,
@@ -13,6 +13,7 @@
 #endif
 
 #include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <errno.h>
 #include <unistd.h>
@@ -31,6 +32,7 @@
 #include "src/shared/att.h"
 #include "src/shared/gatt-db.h"
 #include "src/shared/gatt-server.h"
+#include "src/shared/gatt-nfy-queue.h"
 #include "log.h"
 #include "error.h"
 #include "btd.h"
@@ -42,6 +44,7 @@
 #include "service.h"
 #include "textfile.h"
 #include "settings.h"
+#include "storage.h"
 
 #define GATT_MANAGER_IFACE	"org.bluez.GattManager1"
 #define GATT_PROFILE_IFACE	"org.bluez.GattProfile1"
@@ -69,6 +72,7 @@ struct btd_gatt_database {
 	GIOChannel *bredr_io;
 	struct queue *records;
 	struct queue *device_states;
+	struct queue *ccc_subs;		/* Enabled CCC states by handle */
 	struct queue *ccc_callbacks;
 	struct gatt_db_attribute *svc_chngd;
 	struct gatt_db_attribute *svc_chngd_ccc;
@@ -166,6 +170,7 @@ struct notify {
 	uint16_t handle, ccc_handle;
 	uint8_t *value;
 	uint16_t len;
+	struct bt_gatt_notification *pdu;	/* Encoded once for all */
 	bt_gatt_server_conf_func_t conf;
 	void *user_data;
 };
@@ -182,6 +187,11 @@ struct device_state {
 	bool out_of_sync;
 	struct queue *ccc_states;
 	struct notify *pending;
+	struct bt_gatt_server *server;	/* Cached while connected */
+	struct gatt_nfy_queue *nfy_queue;	/* Values sent while away */
+	uint8_t nfy_hash[16];		/* Hash of restored values */
+	bool nfy_restored;
+	unsigned int nfy_store_id;	/* Idle store of nfy_queue */
 };
 
 typedef uint8_t (*btd_gatt_database_ccc_write_t) (struct pending_op *op,
@@ -189,10 +199,16 @@ typedef uint8_t (*btd_gatt_database_ccc_write_t) (struct pending_op *op,
 typedef void (*btd_gatt_database_destroy_t) (void *data);
 
 struct ccc_state {
+	struct device_state *state;
 	uint16_t handle;
 	uint16_t value;
 };
 
+struct ccc_subs {
+	uint16_t handle;
+	struct queue *ccc_states;	/* States with the CCC enabled */
+};
+
 struct ccc_cb_data {
 	uint16_t handle;
 	btd_gatt_database_ccc_write_t callback;
@@ -275,6 +291,100 @@ static struct ccc_state *find_ccc_state(struct device_state *dev_state,
 							UINT_TO_PTR(handle));
 }
 
+static bool ccc_subs_match(const void *a, const void *b)
+{
+	const struct ccc_subs *subs = a;
+	uint16_t handle = PTR_TO_UINT(b);
+
+	return subs->handle == handle;
+}
+
+static bool ccc_subs_match_service(const void *data, const void *match_data)
+{
+	const struct ccc_subs *subs = data;
+	const struct gatt_db_attribute *attrib = match_data;
+	uint16_t start, end;
+
+	if (!gatt_db_attribute_get_service_handles(attrib, &start, &end))
+		return false;
+
+	return subs->handle >= start && subs->handle <= end;
+}
+
+static void ccc_subs_free(void *data)
+{
+	struct ccc_subs *subs = data;
+
+	queue_destroy(subs->ccc_states, NULL);
+	free(subs);
+}
+
+static struct ccc_subs *find_ccc_subs(struct btd_gatt_database *db,
+							uint16_t handle)
+{
+	return queue_find(db->ccc_subs, ccc_subs_match, UINT_TO_PTR(handle));
+}
+
+/* Keep the subscription index in sync with the CCC value */
+static void ccc_state_set_value(struct ccc_state *ccc, uint16_t value)
+{
+	struct btd_gatt_database *db = ccc->state->db;
+	bool enabled = value & 0x0003;
+	struct ccc_subs *subs;
+
+	if (!!(ccc->value & 0x0003) == enabled) {
+		ccc->value = value;
+		return;
+	}
+
+	ccc->value = value;
+
+	subs = find_ccc_subs(db, ccc->handle);
+
+	if (!enabled) {
+		if (subs)
+			queue_remove(subs->ccc_states, ccc);
+		return;
+	}
+
+	if (!subs) {
+		subs = new0(struct ccc_subs, 1);
+		subs->handle = ccc->handle;
+		subs->ccc_states = queue_new();
+		queue_push_tail(db->ccc_subs, subs);
+	}
+
+	queue_push_tail(subs->ccc_states, ccc);
+}
+
+static struct ccc_state *ccc_state_new(struct device_state *dev_state,
+							uint16_t handle)
+{
+	struct ccc_state *ccc;
+
+	ccc = new0(struct ccc_state, 1);
+	ccc->state = dev_state;
+	ccc->handle = handle;
+	queue_push_tail(dev_state->ccc_states, ccc);
+
+	return ccc;
+}
+
+static void ccc_state_free(void *data)
+{
+	struct ccc_state *ccc = data;
+
+	ccc_state_set_value(ccc, 0);
+	free(ccc);
+}
+
+static void notify_free(struct notify *notify)
+{
+	bt_gatt_notification_unref(notify->pdu);
+	free(notify->value);
+	free(notify);
+}
+
 static struct device_state *device_state_create(struct btd_gatt_database *db,
 							const bdaddr_t *bdaddr,
 							uint8_t bdaddr_type)
@@ -290,17 +400,24 @@ static struct device_state *device_state_create(struct btd_gatt_database *db,
 	return dev_state;
 }
 
+static gboolean store_notifications_cb(gpointer user_data);
+
 static void device_state_free(void *data)
 {
 	struct device_state *state = data;
 
-	queue_destroy(state->ccc_states, free);
-
-	if (state->pending) {
-		free(state->pending->value);
-		free(state->pending);
+	if (state->nfy_store_id) {
+		g_source_remove(state->nfy_store_id);
+		store_notifications_cb(state);
 	}
 
+	queue_destroy(state->ccc_states, ccc_state_free);
+
+	if (state->pending)
+		notify_free(state->pending);
+
+	gatt_nfy_queue_free(state->nfy_queue);
+	bt_gatt_server_unref(state->server);
 	free(state);
 }
 
@@ -332,6 +449,9 @@ static void att_disconnected(int err, void *user_data)
 	state->disc_id = 0;
 	state->out_of_sync = false;
 
+	bt_gatt_server_unref(state->server);
+	state->server = NULL;
+
 	device = btd_adapter_find_device(state->db->adapter, &state->bdaddr,
 							state->bdaddr_type);
 	if (!device)
@@ -444,11 +564,7 @@ static struct ccc_state *get_ccc_state(struct btd_gatt_database *database,
 	if (ccc)
 		return ccc;
 
-	ccc = new0(struct ccc_state, 1);
-	ccc->handle = handle;
-	queue_push_tail(dev_state->ccc_states, ccc);
-
-	return ccc;
+	return ccc_state_new(dev_state, handle);
 }
 
 static void cancel_pending_read(void *data)
@@ -607,6 +723,158 @@ static void gatt_record_free(void *data)
 	free(rec);
 }
 
+static struct gatt_nfy_queue *nfy_queue_new(void)
+{
+	switch (btd_opts.gatt_nfy_queue) {
+	case BT_GATT_NFY_QUEUE_LATEST:
+		return gatt_nfy_queue_new(GATT_NFY_QUEUE_LATEST, 1);
+	case BT_GATT_NFY_QUEUE_FIFO:
+		return gatt_nfy_queue_new(GATT_NFY_QUEUE_FIFO,
+					btd_opts.gatt_nfy_queue_size);
+	case BT_GATT_NFY_QUEUE_OFF:
+	default:
+		return NULL;
+	}
+}
+
+struct nfy_store {
+	char **values;
+	unsigned int count;
+};
+
+static const char *nfy_store_group(uint8_t bdaddr_type)
+{
+	return bdaddr_type == BDADDR_BREDR ? "BR/EDR" : "LE";
+}
+
+static void store_nfy_value(uint16_t handle, const uint8_t *value,
+					uint16_t len, void *user_data)
+{
+	struct nfy_store *store = user_data;
+	char *str;
+	uint16_t i;
+
+	str = g_malloc(5 + len * 2 + 1);
+	sprintf(str, "%04x:", handle);
+
+	for (i = 0; i < len; i++)
+		sprintf(str + 5 + i * 2, "%02x", value[i]);
+
+	store->values[store->count++] = str;
+}
+
+static void nfy_store_filename(struct device_state *state, char *filename)
+{
+	char device_addr[18];
+
+	ba2str(&state->bdaddr, device_addr);
+	create_filename(filename, PATH_MAX, "/%s/%s/notifications",
+			btd_adapter_get_storage_dir(state->db->adapter),
+			device_addr);
+}
+
+/*
+ * Keep values queued for bonded devices across restarts. The file is
+ * updated once per main loop iteration in which values were queued, and
+ * the values of a bearer are removed from it once delivered.
+ */
+static gboolean store_notifications_cb(gpointer user_data)
+{
+	struct device_state *state = user_data;
+	char filename[PATH_MAX];
+	char hash_str[33];
+	struct nfy_store store;
+	GKeyFile *key_file;
+	const char *group;
+	uint8_t *hash = NULL;
+	gchar **groups;
+	gsize num_groups = 0;
+	int i;
+
+	state->nfy_store_id = 0;
+
+	/* The stored values are left alone until checked against the db */
+	if (state->nfy_restored)
+		return FALSE;
+
+	if (gatt_nfy_queue_length(state->nfy_queue)) {
+		hash = gatt_db_get_hash(state->db->db);
+		if (!hash)
+			return FALSE;
+	}
+
+	nfy_store_filename(state, filename);
+
+	/* Values of the other bearer may be stored already */
+	key_file = btd_storage_load(filename, NULL);
+	group = nfy_store_group(state->bdaddr_type);
+
+	if (hash) {
+		for (i = 0; i < 16; i++)
+			sprintf(hash_str + i * 2, "%02x", hash[i]);
+
+		store.values = g_new0(char *,
+				gatt_nfy_queue_length(state->nfy_queue) + 1);
+		store.count = 0;
+		gatt_nfy_queue_foreach(state->nfy_queue, store_nfy_value,
+									&store);
+
+		g_key_file_set_string(key_file, group, "Hash", hash_str);
+		g_key_file_set_string_list(key_file, group, "Values",
+					(const char * const *) store.values,
+					store.count);
+		g_strfreev(store.values);
+	} else if (!g_key_file_remove_group(key_file, group, NULL)) {
+		goto done;
+	}
+
+	groups = g_key_file_get_groups(key_file, &num_groups);
+	g_strfreev(groups);
+
+	if (num_groups) {
+		btd_storage_store(filename, key_file);
+	} else {
+		btd_storage_remove(filename);
+		unlink(filename);
+	}
+
+done:
+	g_key_file_unref(key_file);
+
+	return FALSE;
+}
+
+static void state_store_notifications(struct device_state *state)
+{
+	if (state->nfy_store_id)
+		return;
+
+	state->nfy_store_id = g_idle_add(store_notifications_cb, state);
+}
+
+/* Values restored from storage are only valid for the same database */
+static void state_check_restored(struct device_state *state)
+{
+	uint8_t *hash;
+
+	if (!state->nfy_restored)
+		return;
+
+	state->nfy_restored = false;
+
+	hash = gatt_db_get_hash(state->db->db);
+	if (hash && !memcmp(hash, state->nfy_hash, sizeof(state->nfy_hash)))
+		return;
+
+	DBG("Database changed, dropping %u queued notifications",
+				gatt_nfy_queue_length(state->nfy_queue));
+
+	gatt_nfy_queue_free(state->nfy_queue);
+	state->nfy_queue = NULL;
+
+	state_store_notifications(state);
+}
+
 static void gatt_database_free(void *data)
 {
 	struct btd_gatt_database *database = data;
@@ -631,10 +899,12 @@ static void gatt_database_free(void *data)
 
 	queue_destroy(database->records, gatt_record_free);
 	queue_destroy(database->device_states, device_state_free);
+	queue_destroy(database->ccc_subs, ccc_subs_free);
 	queue_destroy(database->apps, app_free);
 	queue_destroy(database->profiles, profile_free);
 	queue_destroy(database->ccc_callbacks, ccc_cb_free);
 	database->device_states = NULL;
+	database->ccc_subs = NULL;
 	database->ccc_callbacks = NULL;
 
 	gatt_db_unref(database->db);
@@ -1092,7 +1362,7 @@ static void gatt_ccc_write_cb(struct gatt_db_attribute *attrib,
 	}
 
 	if (!ecode)
-		ccc->value = val;
+		ccc_state_set_value(ccc, val);
 
 done:
 	gatt_db_attribute_write_result(attrib, id, ecode);
@@ -1392,6 +1662,10 @@ static void state_set_pending(struct device_state *state, struct notify *notify)
 		if (end > old_end)
 			put_le16(end, state->pending->value + 2);
 
+		/* Encoded again with the merged range when sent */
+		bt_gatt_notification_unref(state->pending->pdu);
+		state->pending->pdu = NULL;
+
 		return;
 	}
 
@@ -1400,6 +1674,56 @@ static void state_set_pending(struct device_state *state, struct notify *notify)
 	memcpy(state->pending, notify, sizeof(*notify));
 	state->pending->value = malloc(notify->len);
 	memcpy(state->pending->value, notify->value, notify->len);
+	state->pending->pdu = NULL;
+}
+
+static void state_queue_notification(struct device_state *state,
+						struct ccc_state *ccc,
+						struct notify *notify)
+{
+	/* Service Changed is kept as pending, indications are not queued as
+	 * they would all need to be confirmed on reconnection.
+	 */
+	if (notify->conf == service_changed_conf || !(ccc->value & 0x0001))
+		return;
+
+	state_check_restored(state);
+
+	if (!state->nfy_queue) {
+		state->nfy_queue = nfy_queue_new();
+		if (!state->nfy_queue)
+			return;
+	}
+
+	if (gatt_nfy_queue_push(state->nfy_queue, notify->handle,
+						notify->value, notify->len))
+		state_store_notifications(state);
+}
+
+static void send_notification_to_server(struct device_state *device_state,
+					struct bt_gatt_server *server,
+					struct ccc_state *ccc,
+					struct notify *notify)
+{
+	if (!notify->pdu) {
+		notify->pdu = bt_gatt_notification_new(notify->handle,
+							notify->value,
+							notify->len);
+		if (!notify->pdu)
+			return;
+	}
+
+	if (ccc->value & 0x0001) {
+		DBG("GATT server sending notification");
+		bt_gatt_server_send_notification_pdu(server, notify->pdu,
+					device_state->cli_feat[0] &
+					BT_GATT_CHRC_CLI_FEAT_NFY_MULTI);
+		return;
+	}
+
+	DBG("GATT server sending indication");
+	bt_gatt_server_send_indication_pdu(server, notify->pdu, notify->conf,
+						notify->user_data, NULL);
 }
 
 static void send_notification_to_device(void *data, void *user_data)
@@ -1439,26 +1763,24 @@ static void send_notification_to_device(void *data, void *user_data)
 		if (!device_is_bonded(device, device_state->bdaddr_type))
 			goto remove;
 		state_set_pending(device_state, notify);
+		state_queue_notification(device_state, ccc, notify);
 		return;
 	}
 
-	/*
-	 * TODO: If the device is not connected but bonded, send the
-	 * notification/indication when it becomes connected.
+	/* Cache the server until disconnected so that further updates go
+	 * straight to it.
 	 */
-	if (ccc->value & 0x0001) {
-		DBG("GATT server sending notification");
-		bt_gatt_server_send_notification(server,
-					notify->handle, notify->value,
-					notify->len, device_state->cli_feat[0] &
-					BT_GATT_CHRC_CLI_FEAT_NFY_MULTI);
-		return;
+	if (!device_state->server) {
+		if (!device_state->disc_id)
+			device_state->disc_id = bt_att_register_disconnect(
+					bt_gatt_server_get_att(server),
+					att_disconnected, device_state, NULL);
+
+		if (device_state->disc_id)
+			device_state->server = bt_gatt_server_ref(server);
 	}
 
-	DBG("GATT server sending indication");
-	bt_gatt_server_send_indication(server, notify->handle, notify->value,
-						notify->len, notify->conf,
-						notify->user_data, NULL);
+	send_notification_to_server(device_state, server, ccc, notify);
 
 	return;
 
@@ -1471,6 +1793,39 @@ remove:
 	}
 }
 
+static void send_notification_to_subscriber(void *data, void *user_data)
+{
+	struct ccc_state *ccc = data;
+	struct notify *notify = user_data;
+
+	if (ccc->state->server)
+		send_notification_to_server(ccc->state, ccc->state->server,
+								ccc, notify);
+	else
+		send_notification_to_device(ccc->state, notify);
+}
+
+static void send_notification_to_subscribers(struct notify *notify)
+{
+	struct ccc_subs *subs;
+
+	/* Service Changed also marks robust caching clients change unaware,
+	 * whether they are subscribed or not.
+	 */
+	if (notify->conf == service_changed_conf) {
+		queue_foreach(notify->database->device_states,
+				send_notification_to_device, notify);
+		return;
+	}
+
+	subs = find_ccc_subs(notify->database, notify->ccc_handle);
+	if (!subs)
+		return;
+
+	queue_foreach(subs->ccc_states, send_notification_to_subscriber,
+								notify);
+}
+
 static void gatt_notify_cb(struct gatt_db_attribute *attrib,
 					struct gatt_db_attribute *ccc,
 					const uint8_t *value, size_t len,
@@ -1500,8 +1855,9 @@ static void gatt_notify_cb(struct gatt_db_attribute *attrib,
 
 		send_notification_to_device(state, &notify);
 	} else
-		queue_foreach(database->device_states,
-				send_notification_to_device, &notify);
+		send_notification_to_subscribers(&notify);
+
+	bt_gatt_notification_unref(notify.pdu);
 }
 
 static void register_core_services(struct btd_gatt_database *database)
@@ -1532,8 +1888,9 @@ static void send_notification_to_devices(struct btd_gatt_database *database,
 	notify.conf = conf;
 	notify.user_data = user_data;
 
-	queue_foreach(database->device_states, send_notification_to_device,
-								&notify);
+	send_notification_to_subscribers(&notify);
+
+	bt_gatt_notification_unref(notify.pdu);
 }
 
 static void send_service_changed(struct btd_gatt_database *database,
@@ -1568,12 +1925,15 @@ static void send_service_changed(struct btd_gatt_database *database,
 static void database_store(struct btd_gatt_database *database)
 {
 	char filename[PATH_MAX];
+	GKeyFile *key_file;
 
 	create_filename(filename, PATH_MAX, "/%s/attributes",
 				btd_adapter_get_storage_dir(database->adapter));
-	create_file(filename, 0600);
 
-	btd_settings_gatt_db_store(database->db, filename);
+	key_file = btd_storage_load(filename, NULL);
+	btd_settings_gatt_db_store(database->db, key_file);
+	btd_storage_store(filename, key_file);
+	g_key_file_unref(key_file);
 }
 
 static void gatt_db_service_added(struct gatt_db_attribute *attrib,
@@ -1605,8 +1965,17 @@ static bool ccc_match_service(const void *data, const void *match_data)
 static void remove_device_ccc(void *data, void *user_data)
 {
 	struct device_state *state = data;
+	uint16_t start, end;
+
+	queue_remove_all(state->ccc_states, ccc_match_service, user_data,
+							ccc_state_free);
 
-	queue_remove_all(state->ccc_states, ccc_match_service, user_data, free);
+	if (state->nfy_queue &&
+			gatt_db_attribute_get_service_handles(user_data, &start,
+									&end)) {
+		gatt_nfy_queue_remove_range(state->nfy_queue, start, end);
+		state_store_notifications(state);
+	}
 }
 
 static bool match_gatt_record(const void *data, const void *user_data)
@@ -1632,6 +2001,8 @@ static void gatt_db_service_removed(struct gatt_db_attribute *attrib,
 	send_service_changed(database, attrib);
 
 	queue_foreach(database->device_states, remove_device_ccc, attrib);
+	queue_remove_all(database->ccc_subs, ccc_subs_match_service, attrib,
+								ccc_subs_free);
 	queue_remove_all(database->ccc_callbacks, ccc_cb_match_service, attrib,
 								ccc_cb_free);
 }
@@ -4054,6 +4425,7 @@ struct btd_gatt_database *btd_gatt_database_new(struct btd_adapter *adapter)
 	database->db = gatt_db_new();
 	database->records = queue_new();
 	database->device_states = queue_new();
+	database->ccc_subs = queue_new();
 	database->apps = queue_new();
 	database->profiles = queue_new();
 	database->ccc_callbacks = queue_new();
@@ -4186,6 +4558,48 @@ struct gatt_db *btd_gatt_database_get_db(struct btd_gatt_database *database)
 	return database->db;
 }
 
+struct nfy_flush {
+	struct bt_gatt_server *server;
+	bool multiple;
+};
+
+static void flush_notification(uint16_t handle, const uint8_t *value,
+					uint16_t len, void *user_data)
+{
+	struct nfy_flush *flush = user_data;
+
+	bt_gatt_server_send_notification(flush->server, handle, value, len,
+							flush->multiple);
+}
+
+static void state_flush_notifications(struct device_state *state,
+						struct bt_gatt_server *server)
+{
+	struct nfy_flush flush;
+	unsigned int count;
+
+	state_check_restored(state);
+
+	if (!state->nfy_queue)
+		return;
+
+	/* Batch values in Multiple Handle Value Notifications if possible */
+	flush.server = server;
+	flush.multiple = state->cli_feat[0] & BT_GATT_CHRC_CLI_FEAT_NFY_MULTI;
+
+	count = gatt_nfy_queue_flush(state->nfy_queue, flush_notification,
+								&flush);
+
+	DBG("%u queued notifications sent, %u dropped", count,
+			gatt_nfy_queue_get_dropped(state->nfy_queue));
+
+	gatt_nfy_queue_free(state->nfy_queue);
+	state->nfy_queue = NULL;
+
+	/* Only removed from storage once delivered */
+	state_store_notifications(state);
+}
+
 void btd_gatt_database_server_connected(struct btd_gatt_database *database,
 						struct bt_gatt_server *server)
 {
@@ -4200,18 +4614,23 @@ void btd_gatt_database_server_connected(struct btd_gatt_database *database,
 	bt_gatt_server_set_authorize(server, server_authorize, database);
 
 	state = find_device_state(database, &bdaddr, bdaddr_type);
-	if (!state || !state->pending)
+	if (!state)
 		return;
 
-	send_notification_to_device(state, state->pending);
+	if (state->pending) {
+		send_notification_to_device(state, state->pending);
 
-	state = find_device_state(database, &bdaddr, bdaddr_type);
-	if (!state || !state->pending)
-		return;
+		state = find_device_state(database, &bdaddr, bdaddr_type);
+		if (!state)
+			return;
 
-	free(state->pending->value);
-	free(state->pending);
-	state->pending = NULL;
+		if (state->pending) {
+			notify_free(state->pending);
+			state->pending = NULL;
+		}
+	}
+
+	state_flush_notifications(state, server);
 }
 
 void btd_gatt_database_att_disconnected(struct btd_gatt_database *database,
@@ -4247,10 +4666,100 @@ static void restore_ccc(struct btd_gatt_database *database,
 	dev_state = device_state_create(database, addr, addr_type);
 	queue_push_tail(database->device_states, dev_state);
 
-	ccc = new0(struct ccc_state, 1);
-	ccc->handle = gatt_db_attribute_get_handle(database->svc_chngd_ccc);
-	ccc->value = value;
-	queue_push_tail(dev_state->ccc_states, ccc);
+	ccc = ccc_state_new(dev_state,
+			gatt_db_attribute_get_handle(database->svc_chngd_ccc));
+	ccc_state_set_value(ccc, value);
+}
+
+static bool restore_nfy_value(struct gatt_nfy_queue *queue, const char *str)
+{
+	uint8_t value[BT_ATT_MAX_VALUE_LEN];
+	uint16_t handle;
+	size_t i, len;
+
+	if (sscanf(str, "%04hx:", &handle) != 1 || strlen(str) < 5)
+		return false;
+
+	str += 5;
+	len = strlen(str) / 2;
+	if (len > sizeof(value))
+		return false;
+
+	for (i = 0; i < len; i++) {
+		if (sscanf(str + i * 2, "%2hhx", &value[i]) != 1)
+			return false;
+	}
+
+	return gatt_nfy_queue_push(queue, handle, value, len);
+}
+
+static void restore_nfy_queue(struct btd_gatt_database *database,
+				GKeyFile *key_file, const bdaddr_t *addr,
+				uint8_t addr_type)
+{
+	const char *group = nfy_store_group(addr_type);
+	struct device_state *state;
+	char *hash;
+	char **values;
+	gsize len = 0;
+	gsize i;
+
+	hash = g_key_file_get_string(key_file, group, "Hash", NULL);
+	values = g_key_file_get_string_list(key_file, group, "Values", &len,
+									NULL);
+	if (!hash || strlen(hash) != 32 || !values)
+		goto done;
+
+	state = find_device_state(database, addr, addr_type);
+	if (!state) {
+		state = device_state_create(database, addr, addr_type);
+		queue_push_tail(database->device_states, state);
+	}
+
+	gatt_nfy_queue_free(state->nfy_queue);
+	state->nfy_queue = nfy_queue_new();
+	if (!state->nfy_queue)
+		goto done;
+
+	for (i = 0; i < sizeof(state->nfy_hash); i++)
+		sscanf(hash + i * 2, "%2hhx", &state->nfy_hash[i]);
+
+	/* Checked against the database once services are registered */
+	state->nfy_restored = true;
+
+	for (i = 0; i < len; i++) {
+		if (!restore_nfy_value(state->nfy_queue, values[i]))
+			DBG("Invalid queued notification: %s", values[i]);
+	}
+
+	DBG("%u queued notifications restored",
+				gatt_nfy_queue_length(state->nfy_queue));
+
+done:
+	g_strfreev(values);
+	g_free(hash);
+}
+
+static void restore_notifications(struct btd_gatt_database *database,
+						struct btd_device *device)
+{
+	char filename[PATH_MAX];
+	char device_addr[18];
+	GKeyFile *key_file;
+
+	ba2str(device_get_address(device), device_addr);
+	create_filename(filename, PATH_MAX, "/%s/%s/notifications",
+				btd_adapter_get_storage_dir(database->adapter),
+				device_addr);
+
+	key_file = btd_storage_load(filename, NULL);
+
+	restore_nfy_queue(database, key_file, device_get_address(device),
+					device_get_le_address_type(device));
+	restore_nfy_queue(database, key_file, device_get_address(device),
+					BDADDR_BREDR);
+
+	g_key_file_unref(key_file);
 }
 
 static void restore_state(struct btd_device *device, void *data)
@@ -4273,6 +4782,8 @@ static void restore_state(struct btd_device *device, void *data)
 
 		DBG("%s BR/EDR", device_get_path(device));
 	}
+
+	restore_notifications(database, device);
 }
 
 void btd_gatt_database_restore_svc_chng_ccc(struct btd_gatt_database *database)
@@ -54,6 +54,7 @@
 #include "dbus-common.h"
 #include "agent.h"
 #include "profile.h"
+#include "storage.h"
 
 #define BLUEZ_NAME "org.bluez"
 
@@ -61,6 +62,8 @@
 #define DEFAULT_DISCOVERABLE_TIMEOUT     180 /* 3 minutes */
 #define DEFAULT_TEMPORARY_TIMEOUT         30 /* 30 seconds */
 #define DEFAULT_NAME_REQUEST_RETRY_DELAY 300 /* 5 minutes */
+#define DEFAULT_STORAGE_FLUSH_DELAY     1000 /* 1 second */
+#define DEFAULT_STORAGE_FLUSH_LIMIT       32
 
 #define SHUTDOWN_GRACE_SECONDS 10
 
@@ -92,6 +95,9 @@ static const char *supported_options[] = {
 	"KernelExperimental",
 	"RemoteNameRequestRetryDelay",
 	"FilterDiscoverable",
+	"StorageFlushDelay",
+	"StorageFlushLimit",
+	"DevicePropertyInterval",
 	NULL
 };
 
@@ -153,6 +159,8 @@ static const char *gatt_options[] = {
 	"Client",
 	"ExportClaimedServices",
 	"Security",
+	"NotifyQueue",
+	"NotifyQueueSize",
 	NULL
 };
 
@@ -1116,6 +1124,15 @@ static void parse_general(GKeyFile *config)
 					0, UINT32_MAX);
 	parse_config_bool(config, "General", "FilterDiscoverable",
 						&btd_opts.filter_discoverable);
+	parse_config_u32(config, "General", "StorageFlushDelay",
+						&btd_opts.storage_flush_delay,
+						0, 60000);
+	parse_config_u16(config, "General", "StorageFlushLimit",
+						&btd_opts.storage_flush_limit,
+						1, UINT16_MAX);
+	parse_config_u32(config, "General", "DevicePropertyInterval",
+					&btd_opts.device_property_interval,
+					0, 60000);
 }
 
 static void parse_gatt_cache(GKeyFile *config)
@@ -1157,6 +1174,33 @@ static void parse_gatt_export(GKeyFile *config)
 	g_free(str);
 }
 
+static enum bt_gatt_nfy_queue_t parse_gatt_nfy_queue_str(const char *str)
+{
+	if (!strcmp(str, "no") || !strcmp(str, "false") ||
+				!strcmp(str, "off")) {
+		return BT_GATT_NFY_QUEUE_OFF;
+	} else if (!strcmp(str, "latest")) {
+		return BT_GATT_NFY_QUEUE_LATEST;
+	} else if (!strcmp(str, "fifo")) {
+		return BT_GATT_NFY_QUEUE_FIFO;
+	}
+
+	DBG("Invalid value for NotifyQueue=%s", str);
+	return BT_GATT_NFY_QUEUE_OFF;
+}
+
+static void parse_gatt_nfy_queue(GKeyFile *config)
+{
+	char *str = NULL;
+
+	parse_config_string(config, "GATT", "NotifyQueue", &str);
+	if (!str)
+		return;
+
+	btd_opts.gatt_nfy_queue = parse_gatt_nfy_queue_str(str);
+	g_free(str);
+}
+
 static uint8_t parse_gatt_seclevel_str(const char *str)
 {
 	if (!strcmp(str, "auto"))
@@ -1200,6 +1244,9 @@ static void parse_gatt(GKeyFile *config)
 	parse_config_bool(config, "GATT", "Client", &btd_opts.gatt_client);
 	parse_gatt_export(config);
 	parse_gatt_seclevel(config);
+	parse_gatt_nfy_queue(config);
+	parse_config_u16(config, "GATT", "NotifyQueueSize",
+				&btd_opts.gatt_nfy_queue_size, 1, 1024);
 }
 
 static void parse_csis_sirk(GKeyFile *config)
@@ -1401,6 +1448,8 @@ static void init_defaults(void)
 	btd_opts.debug_keys = FALSE;
 	btd_opts.refresh_discovery = TRUE;
 	btd_opts.name_request_retry_delay = DEFAULT_NAME_REQUEST_RETRY_DELAY;
+	btd_opts.storage_flush_delay = DEFAULT_STORAGE_FLUSH_DELAY;
+	btd_opts.storage_flush_limit = DEFAULT_STORAGE_FLUSH_LIMIT;
 	btd_opts.secure_conn = SC_ON;
 	btd_opts.filter_discoverable = true;
 
@@ -1424,6 +1473,8 @@ static void init_defaults(void)
 	btd_opts.gatt_client = true;
 	btd_opts.gatt_export = BT_GATT_EXPORT_READ_ONLY;
 	btd_opts.gatt_seclevel = BT_ATT_SECURITY_AUTO;
+	btd_opts.gatt_nfy_queue = BT_GATT_NFY_QUEUE_OFF;
+	btd_opts.gatt_nfy_queue_size = 16;
 
 	btd_opts.avdtp.session_mode = BT_IO_MODE_BASIC;
 	btd_opts.avdtp.stream_mode = BT_IO_MODE_BASIC;
@@ -1718,6 +1769,8 @@ int main(int argc, char *argv[])
 
 	adapter_cleanup();
 
+	btd_storage_cleanup();
+
 	rfkill_exit();
 
 	if (btd_opts.mode != BT_MODE_LE)
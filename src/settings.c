@@ -13,6 +13,8 @@
 
 #include <stdbool.h>
 #include <errno.h>
+#include <string.h>
+#include <unistd.h>
 
 #include <glib.h>
 
@@ -23,6 +25,7 @@
 #include "src/shared/queue.h"
 #include "src/shared/att.h"
 #include "src/shared/gatt-db.h"
+#include "src/shared/gatt-cache.h"
 #include "settings.h"
 
 #define GATT_PRIM_SVC_UUID_STR "2800"
@@ -306,9 +309,30 @@ static int gatt_db_load(struct gatt_db *db, GKeyFile *key_file, char **keys)
 	return 0;
 }
 
-int btd_settings_gatt_db_load(struct gatt_db *db, const char *filename)
+int btd_settings_gatt_db_load_key_file(struct gatt_db *db, GKeyFile *key_file)
 {
 	char **keys;
+	int err;
+
+	keys = g_key_file_get_keys(key_file, "Attributes", NULL, NULL);
+	if (!keys)
+		return -ENOENT;
+
+	err = gatt_db_load(db, key_file, keys);
+
+	g_strfreev(keys);
+
+	return err;
+}
+
+/*
+ * Reads filename from disk. bluetoothd must not use it since it would miss
+ * changes still pending in src/storage.c, it loads the key file with
+ * btd_storage_load() and calls btd_settings_gatt_db_load_key_file()
+ * instead. This is for tools not linking the daemon storage, i.e. btmon.
+ */
+int btd_settings_gatt_db_load(struct gatt_db *db, const char *filename)
+{
 	GKeyFile *key_file;
 	GError *gerr = NULL;
 	int err;
@@ -320,16 +344,8 @@ int btd_settings_gatt_db_load(struct gatt_db *db, const char *filename)
 		g_clear_error(&gerr);
 	}
 
-	keys = g_key_file_get_keys(key_file, "Attributes", NULL, NULL);
+	err = btd_settings_gatt_db_load_key_file(db, key_file);
 
-	if (!keys) {
-		g_key_file_free(key_file);
-		return -ENOENT;
-	}
-
-	err = gatt_db_load(db, key_file, keys);
-
-	g_strfreev(keys);
 	g_key_file_free(key_file);
 
 	return err;
@@ -491,21 +507,10 @@ static void store_service(struct gatt_db_attribute *attr, void *user_data)
 	gatt_db_service_foreach_char(attr, store_chrc, saver);
 }
 
-void btd_settings_gatt_db_store(struct gatt_db *db, const char *filename)
+void btd_settings_gatt_db_store(struct gatt_db *db, GKeyFile *key_file)
 {
-	GKeyFile *key_file;
-	GError *gerr = NULL;
-	char *data;
-	gsize length = 0;
 	struct gatt_saver saver;
 
-	key_file = g_key_file_new();
-	if (!g_key_file_load_from_file(key_file, filename, 0, &gerr)) {
-		DBG("Unable to load key file from %s: (%s)", filename,
-								gerr->message);
-		g_clear_error(&gerr);
-	}
-
 	/* Remove current attributes since it might have changed */
 	g_key_file_remove_group(key_file, "Attributes", NULL);
 
@@ -513,14 +518,69 @@ void btd_settings_gatt_db_store(struct gatt_db *db, const char *filename)
 	saver.db = db;
 
 	gatt_db_foreach_service(db, NULL, store_service, &saver);
+}
 
-	data = g_key_file_to_data(key_file, &length, NULL);
-	if (!g_file_set_contents(filename, data, length, &gerr)) {
-		DBG("Unable set contents for %s: (%s)", filename,
-								gerr->message);
-		g_error_free(gerr);
-	}
+static char *gatt_cache_filename(const char *filename)
+{
+	return g_strconcat(filename, ".gatt", NULL);
+}
 
-	g_free(data);
-	g_key_file_free(key_file);
+int btd_settings_gatt_cache_load(struct gatt_db *db, const char *filename)
+{
+	char *cache;
+	int err;
+
+	cache = gatt_cache_filename(filename);
+	err = gatt_cache_load(db, cache);
+	g_free(cache);
+
+	return err;
+}
+
+/*
+ * Converts attributes stored by older versions in the [Attributes] group
+ * of key_file, the contents of filename, to the cache. The group is
+ * removed once the cache is written, the caller stores key_file unless an
+ * error is returned.
+ */
+int btd_settings_gatt_cache_convert(struct gatt_db *db, const char *filename,
+							GKeyFile *key_file)
+{
+	int err;
+
+	err = btd_settings_gatt_db_load_key_file(db, key_file);
+	if (err)
+		return err;
+
+	DBG("Converting attributes of %s", filename);
+
+	if (!btd_settings_gatt_cache_store(db, filename))
+		g_key_file_remove_group(key_file, "Attributes", NULL);
+
+	return 0;
+}
+
+int btd_settings_gatt_cache_store(struct gatt_db *db, const char *filename)
+{
+	char *cache;
+	int err;
+
+	cache = gatt_cache_filename(filename);
+
+	err = gatt_cache_store(db, cache);
+	if (err < 0)
+		DBG("Unable to store %s: %s (%d)", cache, strerror(-err), err);
+
+	g_free(cache);
+
+	return err;
+}
+
+void btd_settings_gatt_cache_remove(const char *filename)
+{
+	char *cache;
+
+	cache = gatt_cache_filename(filename);
+	unlink(cache);
+	g_free(cache);
 }
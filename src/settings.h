@@ -8,4 +8,11 @@
  */
 
 int btd_settings_gatt_db_load(struct gatt_db *db, const char *filename);
-void btd_settings_gatt_db_store(struct gatt_db *db, const char *filename);
+int btd_settings_gatt_db_load_key_file(struct gatt_db *db, GKeyFile *key_file);
+void btd_settings_gatt_db_store(struct gatt_db *db, GKeyFile *key_file);
+
+int btd_settings_gatt_cache_load(struct gatt_db *db, const char *filename);
+int btd_settings_gatt_cache_convert(struct gatt_db *db, const char *filename,
+							GKeyFile *key_file);
+int btd_settings_gatt_cache_store(struct gatt_db *db, const char *filename);
+void btd_settings_gatt_cache_remove(const char *filename);
@@ -1479,3 +1479,305 @@ struct bt_ad_pattern *bt_ad_pattern_match(struct bt_ad *ad,
 
 	return info.matched_pattern;
 }
+
+/* The matcher indexes patterns by AD type, offset and the first bytes they
+ * expect at that offset so a report only has to be compared against the
+ * patterns that can possibly match it, regardless of how many are
+ * registered.
+ */
+#define MATCHER_BUCKETS		256
+#define MATCHER_KEY_LEN		4
+
+struct matcher_entry {
+	void *data;
+	unsigned int match_id;
+};
+
+struct matcher_pattern {
+	uint8_t type;
+	uint8_t key_len;
+	const struct bt_ad_pattern *pattern;
+	struct matcher_entry *entry;
+};
+
+struct bt_ad_matcher {
+	struct queue *entries;
+	struct queue *buckets[MATCHER_BUCKETS];
+	/* Offsets in use per AD type and key length */
+	uint32_t offsets[256][MATCHER_KEY_LEN];
+	unsigned int match_id;
+};
+
+struct matcher_info {
+	struct bt_ad_matcher *matcher;
+	bt_ad_func_t func;
+	void *user_data;
+};
+
+static uint8_t matcher_type(uint8_t type)
+{
+	/* Service data patterns match any service data, see match_service */
+	switch (type) {
+	case BT_AD_SERVICE_DATA16:
+	case BT_AD_SERVICE_DATA32:
+	case BT_AD_SERVICE_DATA128:
+		return BT_AD_SERVICE_DATA16;
+	}
+
+	return type;
+}
+
+static unsigned int matcher_hash(uint8_t type, uint8_t offset,
+					const uint8_t *key, uint8_t key_len)
+{
+	unsigned int hash = type * 31 + offset;
+	uint8_t i;
+
+	for (i = 0; i < key_len; i++)
+		hash = hash * 31 + key[i];
+
+	return hash % MATCHER_BUCKETS;
+}
+
+struct bt_ad_matcher *bt_ad_matcher_new(void)
+{
+	struct bt_ad_matcher *matcher;
+
+	matcher = new0(struct bt_ad_matcher, 1);
+	matcher->entries = queue_new();
+
+	return matcher;
+}
+
+void bt_ad_matcher_free(struct bt_ad_matcher *matcher)
+{
+	unsigned int i;
+
+	if (!matcher)
+		return;
+
+	for (i = 0; i < MATCHER_BUCKETS; i++)
+		queue_destroy(matcher->buckets[i], free);
+
+	queue_destroy(matcher->entries, free);
+	free(matcher);
+}
+
+/* The patterns are referenced, not copied, so they must remain valid until
+ * the entry is removed.
+ */
+bool bt_ad_matcher_add(struct bt_ad_matcher *matcher, struct queue *patterns,
+								void *data)
+{
+	struct matcher_entry *entry;
+	const struct queue_entry *e;
+
+	if (!matcher || queue_isempty(patterns))
+		return false;
+
+	entry = new0(struct matcher_entry, 1);
+	entry->data = data;
+
+	for (e = queue_get_entries(patterns); e; e = e->next) {
+		const struct bt_ad_pattern *pattern = e->data;
+		struct matcher_pattern *mp;
+		unsigned int hash;
+
+		mp = new0(struct matcher_pattern, 1);
+		mp->type = matcher_type(pattern->type);
+		mp->key_len = MIN(pattern->len, MATCHER_KEY_LEN);
+		mp->pattern = pattern;
+		mp->entry = entry;
+
+		hash = matcher_hash(mp->type, pattern->offset, pattern->data,
+								mp->key_len);
+		if (!matcher->buckets[hash])
+			matcher->buckets[hash] = queue_new();
+
+		queue_push_tail(matcher->buckets[hash], mp);
+		matcher->offsets[mp->type][mp->key_len - 1] |=
+							1u << pattern->offset;
+	}
+
+	queue_push_tail(matcher->entries, entry);
+
+	return true;
+}
+
+static bool match_entry_data(const void *data, const void *match_data)
+{
+	const struct matcher_entry *entry = data;
+
+	return entry->data == match_data;
+}
+
+static bool match_pattern_entry(const void *data, const void *match_data)
+{
+	const struct matcher_pattern *mp = data;
+
+	return mp->entry == match_data;
+}
+
+static void update_offsets(void *data, void *user_data)
+{
+	struct matcher_pattern *mp = data;
+	struct bt_ad_matcher *matcher = user_data;
+
+	matcher->offsets[mp->type][mp->key_len - 1] |=
+						1u << mp->pattern->offset;
+}
+
+bool bt_ad_matcher_remove(struct bt_ad_matcher *matcher, void *data)
+{
+	struct matcher_entry *entry;
+	unsigned int i;
+
+	if (!matcher)
+		return false;
+
+	entry = queue_remove_if(matcher->entries, match_entry_data, data);
+	if (!entry)
+		return false;
+
+	/* Removal is rare so just recompute the offsets in use */
+	memset(matcher->offsets, 0, sizeof(matcher->offsets));
+
+	for (i = 0; i < MATCHER_BUCKETS; i++) {
+		queue_remove_all(matcher->buckets[i], match_pattern_entry,
+								entry, free);
+		queue_foreach(matcher->buckets[i], update_offsets, matcher);
+	}
+
+	free(entry);
+
+	return true;
+}
+
+bool bt_ad_matcher_is_empty(struct bt_ad_matcher *matcher)
+{
+	if (!matcher)
+		return true;
+
+	return queue_isempty(matcher->entries);
+}
+
+static void matcher_lookup(struct matcher_info *info, uint8_t type,
+					const uint8_t *data, size_t len)
+{
+	struct bt_ad_matcher *matcher = info->matcher;
+	const uint32_t *offsets = matcher->offsets[type];
+	uint32_t mask = 0;
+	uint8_t offset, i;
+
+	for (i = 0; i < MATCHER_KEY_LEN; i++)
+		mask |= offsets[i];
+
+	for (offset = 0; offset < len && (mask >> offset); offset++) {
+		for (i = 0; i < MATCHER_KEY_LEN; i++) {
+			const struct queue_entry *e;
+			uint8_t key_len = i + 1;
+			unsigned int hash;
+
+			if (!(offsets[i] & (1u << offset)))
+				continue;
+
+			if (len < (size_t) offset + key_len)
+				break;
+
+			hash = matcher_hash(type, offset, data + offset,
+								key_len);
+
+			for (e = queue_get_entries(matcher->buckets[hash]); e;
+								e = e->next) {
+				const struct matcher_pattern *mp = e->data;
+				const struct bt_ad_pattern *pattern;
+
+				pattern = mp->pattern;
+
+				if (mp->type != type || mp->key_len != key_len ||
+						pattern->offset != offset)
+					continue;
+
+				if (len < (size_t) offset + pattern->len)
+					continue;
+
+				if (mp->entry->match_id == matcher->match_id)
+					continue;
+
+				if (memcmp(data + offset, pattern->data,
+								pattern->len))
+					continue;
+
+				/* Only report each entry once per ad */
+				mp->entry->match_id = matcher->match_id;
+				info->func(mp->entry->data, info->user_data);
+			}
+		}
+	}
+}
+
+static void matcher_manufacturer(void *data, void *user_data)
+{
+	struct bt_ad_manufacturer_data *manufacturer_data = data;
+	uint8_t all_data[BT_AD_MAX_DATA_LEN];
+	size_t len;
+
+	/* Patterns never go beyond BT_AD_MAX_DATA_LEN so there is no need to
+	 * copy the rest of the data.
+	 */
+	len = MIN(manufacturer_data->len + 2, sizeof(all_data));
+
+	/* Take the manufacturer ID into account */
+	memcpy(&all_data[0], &manufacturer_data->manufacturer_id, 2);
+	memcpy(&all_data[2], manufacturer_data->data, len - 2);
+
+	matcher_lookup(user_data, BT_AD_MANUFACTURER_DATA, all_data, len);
+}
+
+static void matcher_service(void *data, void *user_data)
+{
+	struct bt_ad_service_data *service_data = data;
+
+	matcher_lookup(user_data, BT_AD_SERVICE_DATA16, service_data->data,
+							service_data->len);
+}
+
+static void matcher_data(void *data, void *user_data)
+{
+	struct bt_ad_data *ad_data = data;
+
+	matcher_lookup(user_data, ad_data->type, ad_data->data, ad_data->len);
+}
+
+static void reset_match_id(void *data, void *user_data)
+{
+	struct matcher_entry *entry = data;
+
+	entry->match_id = 0;
+}
+
+void bt_ad_matcher_foreach_match(struct bt_ad_matcher *matcher,
+					struct bt_ad *ad, bt_ad_func_t func,
+					void *user_data)
+{
+	struct matcher_info info;
+
+	if (!matcher || !ad || !func)
+		return;
+
+	/* Start a new match round, entries matched by a previous one are
+	 * told apart by their match_id.
+	 */
+	if (!++matcher->match_id) {
+		queue_foreach(matcher->entries, reset_match_id, NULL);
+		matcher->match_id++;
+	}
+
+	info.matcher = matcher;
+	info.func = func;
+	info.user_data = user_data;
+
+	queue_foreach(ad->manufacturer_data, matcher_manufacturer, &info);
+	queue_foreach(ad->service_data, matcher_service, &info);
+	queue_foreach(ad->data, matcher_data, &info);
+}
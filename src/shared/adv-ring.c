@@ -0,0 +1,379 @@
+// SPDX-License-Identifier: LGPL-2.1-or-later
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2026  agent <agent@local>
+ *
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/eventfd.h>
+
+#include "src/shared/util.h"
+#include "src/shared/adv-ring.h"
+
+#define ADV_RING_MAGIC		0x52415a42	/* "BZAR" */
+#define ADV_RING_VERSION	0x0001
+#define ADV_RING_HDR_SIZE	256
+
+/*
+ * Layout of the shared memory: a header followed by the data area. The
+ * producer only writes head and dropped, the consumer only writes tail,
+ * each on its own cache line. Both are free running and masked with the
+ * size of the data area, which is a power of two. All fields are in host
+ * byte order since both sides run on the same host.
+ */
+struct adv_ring_hdr {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t hdr_size;
+	uint32_t size;
+	uint32_t dropped;
+	uint32_t head __attribute__((aligned(64)));
+	uint32_t tail __attribute__((aligned(64)));
+} __attribute__((aligned(64)));
+
+/*
+ * Records are 8 bytes aligned so that there is always room for the length
+ * at the end of the data area, a length of 0 means continue at the start.
+ */
+struct adv_ring_record {
+	uint16_t len;
+	uint16_t data_len;
+	uint8_t addr[6];
+	uint8_t addr_type;
+	int8_t rssi;
+	uint32_t flags;
+	uint64_t timestamp;
+	uint8_t data[];
+} __packed;
+
+#define ADV_RING_RECORD_LEN(_len) \
+	((sizeof(struct adv_ring_record) + (_len) + 7) & ~7)
+
+struct bt_adv_ring {
+	int fd;
+	int event_fd;
+	bool producer;
+	struct adv_ring_hdr *hdr;
+	uint8_t *data;
+	size_t size;
+	size_t map_size;
+	uint32_t head;		/* Producer copies, only published */
+	uint32_t dropped;
+};
+
+/* Find last (most significant) set bit */
+static inline unsigned int fls(unsigned int x)
+{
+	return x ? sizeof(x) * 8 - __builtin_clz(x) : 0;
+}
+
+/* Round up to nearest power of two */
+static inline unsigned int align_power2(unsigned int u)
+{
+	return 1 << fls(u - 1);
+}
+
+static struct bt_adv_ring *ring_map(int fd, int event_fd, size_t size,
+								bool producer)
+{
+	struct bt_adv_ring *ring;
+	void *map;
+
+	map = mmap(NULL, ADV_RING_HDR_SIZE + size, PROT_READ | PROT_WRITE,
+							MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED)
+		return NULL;
+
+	ring = new0(struct bt_adv_ring, 1);
+	ring->fd = fd;
+	ring->event_fd = event_fd;
+	ring->producer = producer;
+	ring->hdr = map;
+	ring->data = map + ADV_RING_HDR_SIZE;
+	ring->size = size;
+	ring->map_size = ADV_RING_HDR_SIZE + size;
+
+	return ring;
+}
+
+struct bt_adv_ring *bt_adv_ring_new(size_t size)
+{
+	struct bt_adv_ring *ring;
+	int fd, event_fd;
+
+	if (size < BT_ADV_RING_MIN_SIZE || size > BT_ADV_RING_MAX_SIZE)
+		return NULL;
+
+	size = align_power2(size);
+
+	fd = memfd_create("bluez-adv-ring", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+	if (fd < 0)
+		return NULL;
+
+	/*
+	 * The consumer maps the memory as well, sealing its size makes sure
+	 * it cannot truncate it under the producer.
+	 */
+	if (ftruncate(fd, ADV_RING_HDR_SIZE + size) < 0 ||
+			fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW |
+							F_SEAL_SEAL) < 0) {
+		close(fd);
+		return NULL;
+	}
+
+	event_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (event_fd < 0) {
+		close(fd);
+		return NULL;
+	}
+
+	ring = ring_map(fd, event_fd, size, true);
+	if (!ring) {
+		close(event_fd);
+		close(fd);
+		return NULL;
+	}
+
+	ring->hdr->magic = ADV_RING_MAGIC;
+	ring->hdr->version = ADV_RING_VERSION;
+	ring->hdr->hdr_size = ADV_RING_HDR_SIZE;
+	ring->hdr->size = size;
+
+	return ring;
+}
+
+struct bt_adv_ring *bt_adv_ring_attach(int fd, int event_fd)
+{
+	struct adv_ring_hdr *hdr;
+	struct bt_adv_ring *ring;
+	struct stat st;
+	size_t size;
+
+	if (fd < 0 || event_fd < 0)
+		return NULL;
+
+	if (fstat(fd, &st) < 0 || st.st_size < ADV_RING_HDR_SIZE)
+		return NULL;
+
+	hdr = mmap(NULL, ADV_RING_HDR_SIZE, PROT_READ, MAP_SHARED, fd, 0);
+	if (hdr == MAP_FAILED)
+		return NULL;
+
+	size = hdr->size;
+
+	if (hdr->magic != ADV_RING_MAGIC || hdr->version != ADV_RING_VERSION ||
+			hdr->hdr_size != ADV_RING_HDR_SIZE ||
+			size < BT_ADV_RING_MIN_SIZE ||
+			size > BT_ADV_RING_MAX_SIZE || (size & (size - 1)) ||
+			(size_t) st.st_size != ADV_RING_HDR_SIZE + size) {
+		munmap(hdr, ADV_RING_HDR_SIZE);
+		return NULL;
+	}
+
+	munmap(hdr, ADV_RING_HDR_SIZE);
+
+	ring = ring_map(fd, event_fd, size, false);
+	if (!ring)
+		return NULL;
+
+	return ring;
+}
+
+void bt_adv_ring_free(struct bt_adv_ring *ring)
+{
+	if (!ring)
+		return;
+
+	munmap(ring->hdr, ring->map_size);
+	close(ring->event_fd);
+	close(ring->fd);
+	free(ring);
+}
+
+int bt_adv_ring_get_fd(struct bt_adv_ring *ring)
+{
+	if (!ring)
+		return -1;
+
+	return ring->fd;
+}
+
+int bt_adv_ring_get_event_fd(struct bt_adv_ring *ring)
+{
+	if (!ring)
+		return -1;
+
+	return ring->event_fd;
+}
+
+size_t bt_adv_ring_get_size(struct bt_adv_ring *ring)
+{
+	if (!ring)
+		return 0;
+
+	return ring->size;
+}
+
+uint32_t bt_adv_ring_get_dropped(struct bt_adv_ring *ring)
+{
+	if (!ring)
+		return 0;
+
+	if (ring->producer)
+		return ring->dropped;
+
+	return __atomic_load_n(&ring->hdr->dropped, __ATOMIC_RELAXED);
+}
+
+static void ring_notify(struct bt_adv_ring *ring)
+{
+	uint64_t value = 1;
+
+	/* Fails only if the consumer left the counter to overflow */
+	if (write(ring->event_fd, &value, sizeof(value)) < 0)
+		return;
+}
+
+bool bt_adv_ring_push(struct bt_adv_ring *ring,
+					const struct bt_adv_report *report)
+{
+	struct adv_ring_record *rec;
+	uint32_t head, tail, start, offset, contig, len, need;
+
+	if (!ring || !ring->producer || !report)
+		return false;
+
+	if (report->len && !report->data)
+		return false;
+
+	len = ADV_RING_RECORD_LEN(report->len);
+	if (len > UINT16_MAX || len > ring->size / 2)
+		return false;
+
+	/* The mapping is writable by the consumer, only tail is read back */
+	head = ring->head;
+	tail = __atomic_load_n(&ring->hdr->tail, __ATOMIC_ACQUIRE);
+
+	offset = head & (ring->size - 1);
+	contig = ring->size - offset;
+	need = contig < len ? contig + len : len;
+
+	/*
+	 * Drop the newest report when the consumer is behind, tail is
+	 * written by the consumer so it is not trusted to be in range.
+	 */
+	if (head - tail > ring->size || ring->size - (head - tail) < need) {
+		__atomic_store_n(&ring->hdr->dropped, ++ring->dropped,
+							__ATOMIC_RELAXED);
+		return false;
+	}
+
+	start = head;
+
+	if (contig < len) {
+		rec = (void *) (ring->data + offset);
+		rec->len = 0;
+		head += contig;
+		offset = 0;
+	}
+
+	rec = (void *) (ring->data + offset);
+	rec->len = len;
+	rec->data_len = report->len;
+	memcpy(rec->addr, report->addr, sizeof(rec->addr));
+	rec->addr_type = report->addr_type;
+	rec->rssi = report->rssi;
+	rec->flags = report->flags;
+	rec->timestamp = report->timestamp;
+
+	if (report->len)
+		memcpy(rec->data, report->data, report->len);
+
+	ring->head = head + len;
+	__atomic_store_n(&ring->hdr->head, ring->head, __ATOMIC_RELEASE);
+
+	/*
+	 * Only wake up the consumer if it had caught up, otherwise it picks
+	 * up the new report before waiting again.
+	 */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+	if (__atomic_load_n(&ring->hdr->tail, __ATOMIC_ACQUIRE) == start)
+		ring_notify(ring);
+
+	return true;
+}
+
+unsigned int bt_adv_ring_read(struct bt_adv_ring *ring,
+				bt_adv_ring_func_t func, void *user_data)
+{
+	struct bt_adv_report report;
+	unsigned int count = 0;
+	uint32_t head, tail;
+	uint64_t value;
+
+	if (!ring || ring->producer || !func)
+		return 0;
+
+	/* Reset the wakeup counter before looking at the ring */
+	if (read(ring->event_fd, &value, sizeof(value)) < 0)
+		value = 0;
+
+	tail = ring->hdr->tail;
+
+	do {
+		head = __atomic_load_n(&ring->hdr->head, __ATOMIC_ACQUIRE);
+
+		while (tail != head) {
+			const struct adv_ring_record *rec;
+			uint32_t offset = tail & (ring->size - 1);
+
+			rec = (const void *) (ring->data + offset);
+
+			if (!rec->len) {
+				tail += ring->size - offset;
+				continue;
+			}
+
+			if (rec->len < sizeof(*rec) ||
+				rec->len > ring->size - offset ||
+				rec->data_len > rec->len - sizeof(*rec)) {
+				/* Corrupted, skip whatever is left */
+				tail = head;
+				break;
+			}
+
+			memcpy(report.addr, rec->addr, sizeof(report.addr));
+			report.addr_type = rec->addr_type;
+			report.rssi = rec->rssi;
+			report.flags = rec->flags;
+			report.timestamp = rec->timestamp;
+			report.data = rec->data;
+			report.len = rec->data_len;
+
+			func(&report, user_data);
+
+			tail += rec->len;
+			count++;
+		}
+
+		__atomic_store_n(&ring->hdr->tail, tail, __ATOMIC_RELEASE);
+		__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	} while (__atomic_load_n(&ring->hdr->head, __ATOMIC_ACQUIRE) != tail);
+
+	return count;
+}
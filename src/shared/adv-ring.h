@@ -0,0 +1,44 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2026  agent <agent@local>
+ *
+ *
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define BT_ADV_RING_MIN_SIZE	4096
+#define BT_ADV_RING_MAX_SIZE	(16 * 1024 * 1024)
+
+struct bt_adv_report {
+	uint8_t addr[6];
+	uint8_t addr_type;
+	int8_t rssi;
+	uint32_t flags;
+	uint64_t timestamp;
+	const uint8_t *data;
+	uint16_t len;
+};
+
+struct bt_adv_ring;
+
+typedef void (*bt_adv_ring_func_t)(const struct bt_adv_report *report,
+							void *user_data);
+
+struct bt_adv_ring *bt_adv_ring_new(size_t size);
+struct bt_adv_ring *bt_adv_ring_attach(int fd, int event_fd);
+void bt_adv_ring_free(struct bt_adv_ring *ring);
+
+int bt_adv_ring_get_fd(struct bt_adv_ring *ring);
+int bt_adv_ring_get_event_fd(struct bt_adv_ring *ring);
+size_t bt_adv_ring_get_size(struct bt_adv_ring *ring);
+uint32_t bt_adv_ring_get_dropped(struct bt_adv_ring *ring);
+
+bool bt_adv_ring_push(struct bt_adv_ring *ring,
+					const struct bt_adv_report *report);
+unsigned int bt_adv_ring_read(struct bt_adv_ring *ring,
+				bt_adv_ring_func_t func, void *user_data);
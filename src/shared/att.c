@@ -12,9 +12,12 @@
 #include <config.h>
 #endif
 
+#define _GNU_SOURCE
 #include <stdlib.h>
 #include <unistd.h>
 #include <errno.h>
+#include <time.h>
+#include <sys/socket.h>
 
 #include "src/shared/io.h"
 #include "src/shared/queue.h"
@@ -34,7 +37,17 @@
 /* Length of signature in write signed packet */
 #define BT_ATT_SIGNATURE_LEN		12
 
+/* Number of released send operations kept for reuse */
+#define ATT_OP_POOL_SIZE		16
+
+/* Maximum number of PDUs written per write wakeup */
+#define ATT_WRITE_BURST			16
+
+/* Number of queued operations a channel looks past one it can't carry */
+#define ATT_SCHED_LOOKAHEAD		8
+
 struct att_send_op;
+struct att_sched;
 
 struct bt_att_chan {
 	struct bt_att *att;
@@ -51,9 +64,12 @@ struct bt_att_chan {
 	bool writer_active;
 
 	bool in_req;			/* There's a pending incoming request */
+	bool burst;			/* Several PDUs per write wakeup */
 
 	uint8_t *buf;
 	uint16_t mtu;
+
+	struct bt_att_chan_stats stats;
 };
 
 struct bt_att {
@@ -92,6 +108,13 @@ struct bt_att {
 
 	struct sign_info *local_sign;
 	struct sign_info *remote_sign;
+
+	struct att_send_op *op_pool;	/* Released ops, PDU buffer kept */
+	unsigned int op_pool_len;
+
+	struct bt_att_write_stats write_stats;
+
+	const struct att_sched *sched;	/* Shared queue dispatch policy */
 };
 
 struct sign_info {
@@ -192,18 +215,75 @@ static uint8_t get_req_opcode(uint8_t rsp_opcode)
 }
 
 struct att_send_op {
+	struct bt_att *att;
+	struct bt_att_chan *chan;	/* Channel the timeout applies to */
 	unsigned int id;
 	unsigned int timeout_id;
 	enum att_op_type type;
 	uint8_t opcode;
 	void *pdu;
 	uint16_t len;
+	uint16_t size;			/* Allocated size of pdu */
 	bool retry;
+	uint64_t sent;			/* Time written, in usec */
 	bt_att_response_func_t callback;
 	bt_att_destroy_func_t destroy;
 	void *user_data;
+	struct att_send_op *next;	/* Next op in the pool */
 };
 
+static struct att_send_op *get_att_send_op(struct bt_att *att)
+{
+	struct att_send_op *op = att->op_pool;
+	void *pdu = NULL;
+	uint16_t size = 0;
+
+	if (op) {
+		att->op_pool = op->next;
+		att->op_pool_len--;
+
+		pdu = op->pdu;
+		size = op->size;
+		memset(op, 0, sizeof(*op));
+	} else {
+		op = new0(struct att_send_op, 1);
+	}
+
+	op->att = att;
+	op->pdu = pdu;
+	op->size = size;
+
+	return op;
+}
+
+static void put_att_send_op(struct att_send_op *op)
+{
+	struct bt_att *att = op->att;
+
+	if (att->op_pool_len < ATT_OP_POOL_SIZE) {
+		op->next = att->op_pool;
+		att->op_pool = op;
+		att->op_pool_len++;
+		return;
+	}
+
+	free(op->pdu);
+	free(op);
+}
+
+static void free_att_send_op_pool(struct bt_att *att)
+{
+	while (att->op_pool) {
+		struct att_send_op *op = att->op_pool;
+
+		att->op_pool = op->next;
+		free(op->pdu);
+		free(op);
+	}
+
+	att->op_pool_len = 0;
+}
+
 static void destroy_att_send_op(void *data)
 {
 	struct att_send_op *op = data;
@@ -214,8 +294,7 @@ static void destroy_att_send_op(void *data)
 	if (op->destroy)
 		op->destroy(op->user_data);
 
-	free(op->pdu);
-	free(op);
+	put_att_send_op(op);
 }
 
 static void cancel_att_send_op(void *data)
@@ -331,35 +410,61 @@ static void att_hexdump(struct bt_att *att, char dir, const void *data,
 }
 
 static bool encode_pdu(struct bt_att *att, struct att_send_op *op,
-					const void *pdu, uint16_t length)
+				const struct iovec *iov, size_t iovcnt)
 {
-	uint16_t pdu_len = 1;
 	struct sign_info *sign = att->local_sign;
+	size_t sig_len = 0, length = 0, pdu_len;
 	uint32_t sign_cnt;
+	uint8_t *ptr;
+	size_t i;
 
-	if (sign && (op->opcode & ATT_OP_SIGNED_MASK))
-		pdu_len += BT_ATT_SIGNATURE_LEN;
+	/* Stop at the MTU so that the sum cannot wrap around */
+	for (i = 0; i < iovcnt; i++) {
+		if (iov[i].iov_len > att->mtu)
+			return false;
 
-	if (length && pdu)
-		pdu_len += length;
+		length += iov[i].iov_len;
+		if (length > att->mtu)
+			return false;
+	}
 
+	if (sign && (op->opcode & ATT_OP_SIGNED_MASK))
+		sig_len = BT_ATT_SIGNATURE_LEN;
+
+	pdu_len = 1 + sig_len + length;
 	if (pdu_len > att->mtu)
 		return false;
 
+	/* Size buffers for the MTU so that pooled ops can be reused as is */
+	if (op->size < pdu_len) {
+		free(op->pdu);
+		op->pdu = malloc(att->mtu);
+		if (!op->pdu) {
+			op->size = 0;
+			return false;
+		}
+
+		op->size = att->mtu;
+	}
+
 	op->len = pdu_len;
-	op->pdu = malloc(op->len);
-	if (!op->pdu)
-		return false;
 
-	((uint8_t *) op->pdu)[0] = op->opcode;
-	if (pdu_len > 1)
-		memcpy(op->pdu + 1, pdu, length);
+	ptr = op->pdu;
+	*ptr++ = op->opcode;
+
+	for (i = 0; i < iovcnt; i++) {
+		if (!iov[i].iov_len)
+			continue;
+
+		memcpy(ptr, iov[i].iov_base, iov[i].iov_len);
+		ptr += iov[i].iov_len;
+	}
 
 	if (!sign || !(op->opcode & ATT_OP_SIGNED_MASK) || !att->crypto)
 		return true;
 
 	if (!sign->counter(&sign_cnt, sign->user_data))
-		goto fail;
+		return false;
 
 	if ((bt_crypto_sign_att(att->crypto, sign->key, op->pdu, 1 + length,
 				sign_cnt, &((uint8_t *) op->pdu)[1 + length])))
@@ -367,24 +472,25 @@ static bool encode_pdu(struct bt_att *att, struct att_send_op *op,
 
 	DBG(att, "ATT unable to generate signature");
 
-fail:
-	free(op->pdu);
 	return false;
 }
 
 static struct att_send_op *create_att_send_op(struct bt_att *att,
 						uint8_t opcode,
-						const void *pdu,
-						uint16_t length,
+						const struct iovec *iov,
+						size_t iovcnt,
 						bt_att_response_func_t callback,
 						void *user_data,
 						bt_att_destroy_func_t destroy)
 {
 	struct att_send_op *op;
 	enum att_op_type type;
+	size_t i;
 
-	if (length && !pdu)
-		return NULL;
+	for (i = 0; i < iovcnt; i++) {
+		if (iov[i].iov_len && !iov[i].iov_base)
+			return NULL;
+	}
 
 	type = get_op_type(opcode);
 	if (type == ATT_OP_TYPE_UNKNOWN)
@@ -403,60 +509,242 @@ static struct att_send_op *create_att_send_op(struct bt_att *att,
 	if (!callback && (type == ATT_OP_TYPE_REQ || type == ATT_OP_TYPE_IND))
 		return NULL;
 
-	op = new0(struct att_send_op, 1);
+	op = get_att_send_op(att);
 	op->type = type;
 	op->opcode = opcode;
+
+	if (!encode_pdu(att, op, iov, iovcnt)) {
+		put_att_send_op(op);
+		return NULL;
+	}
+
 	op->callback = callback;
 	op->destroy = destroy;
 	op->user_data = user_data;
 
-	if (!encode_pdu(att, op, pdu, length)) {
-		free(op);
+	return op;
+}
+
+static void wakeup_chan_writer(void *data, void *user_data);
+static void wakeup_writer(struct bt_att *att);
+
+static uint64_t get_time_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1000000ull + ts.tv_nsec / 1000;
+}
+
+static bool chan_can_send(struct bt_att_chan *chan, struct att_send_op *op)
+{
+	if (op->len > chan->mtu)
+		return false;
+
+	/* Don't send Exchange MTU over EATT */
+	if (op->opcode == BT_ATT_OP_MTU_REQ && chan->type == BT_ATT_EATT)
+		return false;
+
+	return true;
+}
+
+struct att_sched {
+	/* Remove and return the operation of a shared queue that chan should
+	 * send next, if any.
+	 */
+	struct att_send_op *(*pick)(struct bt_att_chan *chan,
+						struct queue *queue);
+};
+
+static struct att_send_op *sched_fifo_pick(struct bt_att_chan *chan,
+						struct queue *queue)
+{
+	struct att_send_op *op = queue_peek_head(queue);
+
+	if (!op || !chan_can_send(chan, op))
 		return NULL;
+
+	return queue_pop_head(queue);
+}
+
+static bool chan_is_idle(struct bt_att_chan *chan, struct att_send_op *op)
+{
+	if (op->type == ATT_OP_TYPE_REQ)
+		return !chan->pending_req;
+
+	if (op->type == ATT_OP_TYPE_IND)
+		return !chan->pending_ind;
+
+	return true;
+}
+
+/* Pick the channel that would answer op the soonest: the least backlog on
+ * its own queue first, then the lowest recent response time.
+ */
+static struct bt_att_chan *sched_best_chan(struct bt_att *att,
+						struct att_send_op *op)
+{
+	const struct queue_entry *entry;
+	struct bt_att_chan *best = NULL;
+	unsigned int best_queued = 0;
+
+	for (entry = queue_get_entries(att->chans); entry;
+						entry = entry->next) {
+		struct bt_att_chan *chan = entry->data;
+		unsigned int queued;
+
+		if (!chan_is_idle(chan, op) || !chan_can_send(chan, op))
+			continue;
+
+		queued = queue_length(chan->queue);
+
+		if (best && (queued > best_queued || (queued == best_queued &&
+				chan->stats.latency >= best->stats.latency)))
+			continue;
+
+		best = chan;
+		best_queued = queued;
+	}
+
+	return best;
+}
+
+/* Returns the handle an operation starts with, if it has one */
+static bool op_get_handle(struct att_send_op *op, uint16_t *handle)
+{
+	switch (op->opcode) {
+	case BT_ATT_OP_READ_REQ:
+	case BT_ATT_OP_READ_BLOB_REQ:
+	case BT_ATT_OP_WRITE_REQ:
+	case BT_ATT_OP_WRITE_CMD:
+	case BT_ATT_OP_SIGNED_WRITE_CMD:
+	case BT_ATT_OP_HANDLE_NFY:
+	case BT_ATT_OP_HANDLE_IND:
+		break;
+	default:
+		return false;
+	}
+
+	if (op->len < 3)
+		return false;
+
+	*handle = get_le16(op->pdu + 1);
+
+	return true;
+}
+
+static struct att_send_op *sched_balanced_pick(struct bt_att_chan *chan,
+						struct queue *queue)
+{
+	const struct queue_entry *entry;
+	uint16_t skipped[ATT_SCHED_LOOKAHEAD];
+	unsigned int i, j, num_skipped = 0;
+
+	/* Look past operations this channel can't carry so that a PDU
+	 * bigger than the MTU of some channels doesn't block the rest.
+	 * Operations on the same handle are never reordered, and those
+	 * without a handle are never passed nor pass anything.
+	 */
+	for (entry = queue_get_entries(queue), i = 0;
+				entry && i < ATT_SCHED_LOOKAHEAD;
+				entry = entry->next, i++) {
+		struct att_send_op *op = entry->data;
+		struct bt_att_chan *best;
+		uint16_t handle;
+
+		if (!op_get_handle(op, &handle)) {
+			if (num_skipped || !chan_can_send(chan, op))
+				return NULL;
+		} else {
+			for (j = 0; j < num_skipped; j++) {
+				if (skipped[j] == handle)
+					break;
+			}
+
+			if (j < num_skipped || !chan_can_send(chan, op)) {
+				skipped[num_skipped++] = handle;
+				continue;
+			}
+		}
+
+		/* Only requests and indications wait for the remote, anything
+		 * else goes out on whichever channel is writable.
+		 */
+		if (op->type == ATT_OP_TYPE_REQ ||
+					op->type == ATT_OP_TYPE_IND) {
+			best = sched_best_chan(chan->att, op);
+			if (best && best != chan) {
+				wakeup_chan_writer(best, NULL);
+				return NULL;
+			}
+		}
+
+		queue_remove(queue, op);
+
+		return op;
 	}
 
+	return NULL;
+}
+
+static const struct att_sched att_sched_table[] = {
+	[BT_ATT_SCHED_FIFO] = {
+		.pick = sched_fifo_pick,
+	},
+	[BT_ATT_SCHED_BALANCED] = {
+		.pick = sched_balanced_pick,
+	},
+};
+
+static struct att_send_op *pick_from(struct bt_att_chan *chan,
+						struct queue *queue,
+						struct queue **from)
+{
+	struct att_send_op *op;
+
+	if (queue == chan->queue)
+		op = queue_pop_head(queue);
+	else
+		op = chan->att->sched->pick(chan, queue);
+
+	if (op)
+		*from = queue;
+
 	return op;
 }
 
-static struct att_send_op *pick_next_send_op(struct bt_att_chan *chan)
+/* Returns the next operation to write and the queue it was taken from */
+static struct att_send_op *pick_next_send_op(struct bt_att_chan *chan,
+							struct queue **from)
 {
 	struct bt_att *att = chan->att;
 	struct att_send_op *op;
 
 	/* Check if there is anything queued on the channel */
-	op = queue_pop_head(chan->queue);
+	op = pick_from(chan, chan->queue, from);
 	if (op)
 		return op;
 
 	/* See if any operations are already in the write queue */
-	op = queue_peek_head(att->write_queue);
-	if (op && op->len <= chan->mtu)
-		return queue_pop_head(att->write_queue);
+	op = pick_from(chan, att->write_queue, from);
+	if (op)
+		return op;
 
 	/* If there is no pending request, pick an operation from the
 	 * request queue.
 	 */
 	if (!chan->pending_req) {
-		op = queue_peek_head(att->req_queue);
-		if (op && op->len <= chan->mtu) {
-			/* Don't send Exchange MTU over EATT */
-			if (op->opcode == BT_ATT_OP_MTU_REQ &&
-					chan->type == BT_ATT_EATT)
-				goto indicate;
-
-			return queue_pop_head(att->req_queue);
-		}
+		op = pick_from(chan, att->req_queue, from);
+		if (op)
+			return op;
 	}
 
-indicate:
 	/* There is either a request pending or no requests queued. If there is
 	 * no pending indication, pick an operation from the indication queue.
 	 */
-	if (!chan->pending_ind) {
-		op = queue_peek_head(att->ind_queue);
-		if (op && op->len <= chan->mtu)
-			return queue_pop_head(att->ind_queue);
-	}
+	if (!chan->pending_ind)
+		return pick_from(chan, att->ind_queue, from);
 
 	return NULL;
 }
@@ -471,28 +759,20 @@ static void disc_att_send_op(void *data)
 	destroy_att_send_op(op);
 }
 
-struct timeout_data {
-	struct bt_att_chan *chan;
-	unsigned int id;
-};
-
 static bool timeout_cb(void *user_data)
 {
-	struct timeout_data *timeout = user_data;
-	struct bt_att_chan *chan = timeout->chan;
+	struct att_send_op *op = user_data;
+	struct bt_att_chan *chan = op->chan;
 	struct bt_att *att = chan->att;
-	struct att_send_op *op = NULL;
 
-	if (chan->pending_req && chan->pending_req->id == timeout->id) {
-		op = chan->pending_req;
+	if (chan->pending_req == op)
 		chan->pending_req = NULL;
-	} else if (chan->pending_ind && chan->pending_ind->id == timeout->id) {
-		op = chan->pending_ind;
+	else if (chan->pending_ind == op)
 		chan->pending_ind = NULL;
-	}
-
-	if (!op)
+	else {
+		op->timeout_id = 0;
 		return false;
+	}
 
 	DBG(att, "(chan %p) Operation timed out: 0x%02x", chan,
 						op->opcode);
@@ -546,35 +826,75 @@ static ssize_t bt_att_chan_write(struct bt_att_chan *chan, uint8_t opcode,
 	return ret;
 }
 
-static bool can_write_data(struct io *io, void *user_data)
+/* Write a burst of PDUs, returns the number written or a negative errno */
+static int bt_att_chan_write_burst(struct bt_att_chan *chan,
+					struct att_send_op **ops,
+					unsigned int count)
 {
-	struct bt_att_chan *chan = user_data;
-	struct att_send_op *op;
-	struct timeout_data *timeout;
+	struct bt_att *att = chan->att;
+	struct mmsghdr msgs[ATT_WRITE_BURST];
+	struct iovec iov[ATT_WRITE_BURST];
+	unsigned int i;
+	ssize_t ret;
+	int sent;
 
-	op = pick_next_send_op(chan);
-	if (!op)
-		return false;
+	if (count == 1 || !chan->burst) {
+		ret = bt_att_chan_write(chan, ops[0]->opcode, ops[0]->pdu,
+								ops[0]->len);
+		return ret < 0 ? ret : 1;
+	}
 
-	if (bt_att_chan_write(chan, op->opcode, op->pdu, op->len) < 0) {
-		if (op->callback)
-			op->callback(BT_ATT_OP_ERROR_RSP, NULL, 0,
-							op->user_data);
-		destroy_att_send_op(op);
-		return true;
+	memset(msgs, 0, count * sizeof(*msgs));
+
+	for (i = 0; i < count; i++) {
+		iov[i].iov_base = ops[i]->pdu;
+		iov[i].iov_len = ops[i]->len;
+		msgs[i].msg_hdr.msg_iov = &iov[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	sent = sendmmsg(chan->fd, msgs, count, MSG_DONTWAIT | MSG_NOSIGNAL);
+	if (sent < 0) {
+		sent = -errno;
+
+		/* Not a socket, fall back to one PDU per wakeup */
+		if (sent == -ENOTSOCK) {
+			chan->burst = false;
+			return bt_att_chan_write_burst(chan, ops, 1);
+		}
+
+		if (sent != -EAGAIN)
+			DBG(att, "(chan %p) write failed: %s", chan,
+							strerror(-sent));
+
+		return sent;
+	}
+
+	for (i = 0; i < (unsigned int) sent; i++) {
+		VERBOSE(att, "(chan %p) ATT op 0x%02x", chan, ops[i]->opcode);
+
+		if (att->debug_level)
+			util_hexdump('<', ops[i]->pdu, msgs[i].msg_len,
+					att->debug_callback, att->debug_data);
 	}
 
-	/* Based on the operation type, set either the pending request or the
-	 * pending indication. If it came from the write queue, then there is
-	 * no need to keep it around.
+	return sent;
+}
+
+static void write_op_complete(struct bt_att_chan *chan,
+						struct att_send_op *op)
+{
+	/* Requests and indications stay pending until the remote answers,
+	 * anything else is done once written.
 	 */
 	switch (op->type) {
 	case ATT_OP_TYPE_REQ:
-		chan->pending_req = op;
-		break;
 	case ATT_OP_TYPE_IND:
-		chan->pending_ind = op;
-		break;
+		op->chan = chan;
+		op->sent = get_time_us();
+		op->timeout_id = timeout_add(ATT_TIMEOUT_INTERVAL, timeout_cb,
+								op, NULL);
+		return;
 	case ATT_OP_TYPE_RSP:
 		/* Set in_req to false to indicate that no request is pending */
 		chan->in_req = false;
@@ -585,14 +905,96 @@ static bool can_write_data(struct io *io, void *user_data)
 	case ATT_OP_TYPE_UNKNOWN:
 	default:
 		destroy_att_send_op(op);
+		return;
+	}
+}
+
+static void clear_pending_op(struct bt_att_chan *chan,
+						struct att_send_op *op)
+{
+	if (chan->pending_req == op)
+		chan->pending_req = NULL;
+	else if (chan->pending_ind == op)
+		chan->pending_ind = NULL;
+}
+
+static bool can_write_data(struct io *io, void *user_data)
+{
+	struct bt_att_chan *chan = user_data;
+	struct bt_att *att = chan->att;
+	struct att_send_op *ops[ATT_WRITE_BURST];
+	struct queue *from[ATT_WRITE_BURST];
+	unsigned int count = 0, max, i;
+	int sent;
+
+	max = chan->burst ? ATT_WRITE_BURST : 1;
+
+	/* Mark requests and indications as pending as soon as they are
+	 * picked, so at most one of each ends up in a burst.
+	 */
+	while (count < max) {
+		struct att_send_op *op = pick_next_send_op(chan, &from[count]);
+
+		if (!op)
+			break;
+
+		if (op->type == ATT_OP_TYPE_REQ)
+			chan->pending_req = op;
+		else if (op->type == ATT_OP_TYPE_IND)
+			chan->pending_ind = op;
+
+		ops[count++] = op;
+	}
+
+	if (!count)
+		return false;
+
+	sent = bt_att_chan_write_burst(chan, ops, count);
+	if (sent < 0 && sent != -EAGAIN) {
+		/* The first PDU failed, put the rest back in order */
+		for (i = count - 1; i > 0; i--) {
+			clear_pending_op(chan, ops[i]);
+			queue_push_head(from[i], ops[i]);
+		}
+
+		clear_pending_op(chan, ops[0]);
+
+		if (ops[0]->callback)
+			ops[0]->callback(BT_ATT_OP_ERROR_RSP, NULL, 0,
+							ops[0]->user_data);
+		destroy_att_send_op(ops[0]);
 		return true;
 	}
 
-	timeout = new0(struct timeout_data, 1);
-	timeout->chan = chan;
-	timeout->id = op->id;
-	op->timeout_id = timeout_add(ATT_TIMEOUT_INTERVAL, timeout_cb,
-								timeout, free);
+	if (sent < 0)
+		sent = 0;
+
+	/* Whatever did not fit goes back in front of the queue it came from,
+	 * so operations from the shared queues remain available to other
+	 * channels and are failed properly if this one disconnects.
+	 */
+	for (i = count; i > (unsigned int) sent; i--) {
+		clear_pending_op(chan, ops[i - 1]);
+		queue_push_head(from[i - 1], ops[i - 1]);
+	}
+
+	if (sent) {
+		chan->stats.pdus += sent;
+		att->write_stats.wakeups++;
+		att->write_stats.pdus += sent;
+
+		if ((unsigned int) sent > att->write_stats.max_burst)
+			att->write_stats.max_burst = sent;
+	}
+
+	for (i = 0; i < (unsigned int) sent; i++)
+		write_op_complete(chan, ops[i]);
+
+	/* Let other channels pick up what this one has left behind */
+	if (queue_length(att->chans) > 1 && (!queue_isempty(att->req_queue) ||
+					!queue_isempty(att->ind_queue) ||
+					!queue_isempty(att->write_queue)))
+		wakeup_writer(att);
 
 	/* Return true as there may be more operations ready to write. */
 	return true;
@@ -677,6 +1079,10 @@ static bool disconnect_cb(struct io *io, void *user_data)
 
 	DBG(att, "Channel %p disconnected: %s", chan, strerror(err));
 
+	DBG(att, "%u PDUs written in %u wakeups, max %u per wakeup",
+				att->write_stats.pdus, att->write_stats.wakeups,
+				att->write_stats.max_burst);
+
 	/* Detach channel */
 	queue_remove(att->chans, chan);
 
@@ -856,6 +1262,25 @@ retry:
 	return queue_push_head(chan->queue, op);
 }
 
+static void chan_update_latency(struct bt_att_chan *chan,
+						struct att_send_op *op)
+{
+	unsigned int latency = get_time_us() - op->sent;
+
+	chan->stats.requests++;
+
+	if (latency > chan->stats.max_latency)
+		chan->stats.max_latency = latency;
+
+	/* Smoothed so that a single slow response doesn't take the channel
+	 * out of rotation.
+	 */
+	if (chan->stats.requests == 1)
+		chan->stats.latency = latency;
+	else
+		chan->stats.latency = (chan->stats.latency * 7 + latency) / 8;
+}
+
 static void handle_rsp(struct bt_att_chan *chan, uint8_t opcode, uint8_t *pdu,
 								ssize_t pdu_len)
 {
@@ -909,6 +1334,8 @@ fail:
 	rsp_opcode = BT_ATT_OP_ERROR_RSP;
 
 done:
+	chan_update_latency(chan, op);
+
 	if (op->callback)
 		op->callback(rsp_opcode, rsp_pdu, rsp_pdu_len, op->user_data);
 
@@ -934,6 +1361,8 @@ static void handle_conf(struct bt_att_chan *chan, uint8_t *pdu, ssize_t pdu_len)
 		return;
 	}
 
+	chan_update_latency(chan, op);
+
 	if (op->callback)
 		op->callback(BT_ATT_OP_HANDLE_CONF, NULL, 0, op->user_data);
 
@@ -1197,6 +1626,8 @@ static void bt_att_free(struct bt_att *att)
 	queue_destroy(att->exchange_list, NULL);
 	queue_destroy(att->chans, bt_att_chan_free);
 
+	free_att_send_op_pool(att);
+
 	free(att);
 }
 
@@ -1243,6 +1674,7 @@ static struct bt_att_chan *bt_att_chan_new(int fd, uint8_t type)
 
 	chan = new0(struct bt_att_chan, 1);
 	chan->fd = fd;
+	chan->burst = true;
 
 	chan->io = io_new(fd);
 	if (!chan->io)
@@ -1319,6 +1751,7 @@ struct bt_att *bt_att_new(int fd, bool ext_signed)
 	att->req_queue = queue_new();
 	att->ind_queue = queue_new();
 	att->write_queue = queue_new();
+	att->sched = &att_sched_table[BT_ATT_SCHED_BALANCED];
 	att->notify_list = queue_new();
 	att->disconn_list = queue_new();
 	att->exchange_list = queue_new();
@@ -1379,7 +1812,9 @@ int bt_att_attach_fd(struct bt_att *att, int fd)
 	if (!att || fd < 0)
 		return -EINVAL;
 
-	chan = bt_att_chan_new(fd, BT_ATT_EATT);
+	/* Bearers that are not L2CAP sockets are local, as in bt_att_new */
+	chan = bt_att_chan_new(fd, is_io_l2cap_based(fd) ? BT_ATT_EATT :
+								BT_ATT_LOCAL);
 	if (!chan)
 		return -EINVAL;
 
@@ -1483,6 +1918,56 @@ bool bt_att_set_mtu(struct bt_att *att, uint16_t mtu)
 	return true;
 }
 
+bool bt_att_get_write_stats(struct bt_att *att,
+					struct bt_att_write_stats *stats)
+{
+	if (!att || !stats)
+		return false;
+
+	*stats = att->write_stats;
+
+	return true;
+}
+
+bool bt_att_get_chan_stats(struct bt_att *att, unsigned int index,
+					struct bt_att_chan_stats *stats)
+{
+	const struct queue_entry *entry;
+	struct bt_att_chan *chan;
+
+	if (!att || !stats)
+		return false;
+
+	for (entry = queue_get_entries(att->chans); entry && index;
+						entry = entry->next, index--);
+
+	if (!entry)
+		return false;
+
+	chan = entry->data;
+
+	*stats = chan->stats;
+	stats->type = chan->type;
+	stats->mtu = chan->mtu;
+	stats->in_flight = !!chan->pending_req + !!chan->pending_ind;
+	stats->queued = queue_length(chan->queue);
+
+	return true;
+}
+
+bool bt_att_set_scheduler(struct bt_att *att, uint8_t sched)
+{
+	if (!att || sched >= ARRAY_SIZE(att_sched_table))
+		return false;
+
+	att->sched = &att_sched_table[sched];
+
+	/* Operations held back by the previous policy may be sent now */
+	wakeup_writer(att);
+
+	return true;
+}
+
 uint8_t bt_att_get_link_type(struct bt_att *att)
 {
 	struct bt_att_chan *chan;
@@ -1641,8 +2126,8 @@ bool bt_att_unregister_exchange(struct bt_att *att, unsigned int id)
 	return true;
 }
 
-unsigned int bt_att_send(struct bt_att *att, uint8_t opcode,
-				const void *pdu, uint16_t length,
+unsigned int bt_att_send_iov(struct bt_att *att, uint8_t opcode,
+				const struct iovec *iov, size_t iovcnt,
 				bt_att_response_func_t callback, void *user_data,
 				bt_att_destroy_func_t destroy)
 {
@@ -1652,7 +2137,7 @@ unsigned int bt_att_send(struct bt_att *att, uint8_t opcode,
 	if (!att || queue_isempty(att->chans))
 		return 0;
 
-	op = create_att_send_op(att, opcode, pdu, length, callback, user_data,
+	op = create_att_send_op(att, opcode, iov, iovcnt, callback, user_data,
 								destroy);
 	if (!op)
 		return 0;
@@ -1690,8 +2175,7 @@ unsigned int bt_att_send(struct bt_att *att, uint8_t opcode,
 
 done:
 	if (!result) {
-		free(op->pdu);
-		free(op);
+		put_att_send_op(op);
 		return 0;
 	}
 
@@ -1700,6 +2184,17 @@ done:
 	return op->id;
 }
 
+unsigned int bt_att_send(struct bt_att *att, uint8_t opcode,
+				const void *pdu, uint16_t length,
+				bt_att_response_func_t callback, void *user_data,
+				bt_att_destroy_func_t destroy)
+{
+	struct iovec iov = { .iov_base = (void *) pdu, .iov_len = length };
+
+	return bt_att_send_iov(att, opcode, &iov, 1, callback, user_data,
+								destroy);
+}
+
 int bt_att_resend(struct bt_att *att, unsigned int id, uint8_t opcode,
 				const void *pdu, uint16_t length,
 				bt_att_response_func_t callback,
@@ -1708,6 +2203,7 @@ int bt_att_resend(struct bt_att *att, unsigned int id, uint8_t opcode,
 {
 	const struct queue_entry *entry;
 	struct att_send_op *op;
+	struct iovec iov;
 	bool result;
 
 	if (!att || !id)
@@ -1738,7 +2234,10 @@ int bt_att_resend(struct bt_att *att, unsigned int id, uint8_t opcode,
 	if (get_op_type(opcode) != ATT_OP_TYPE_REQ)
 		return -EOPNOTSUPP;
 
-	op = create_att_send_op(att, opcode, pdu, length, callback, user_data,
+	iov.iov_base = (void *) pdu;
+	iov.iov_len = length;
+
+	op = create_att_send_op(att, opcode, &iov, 1, callback, user_data,
 								destroy);
 	if (!op)
 		return -ENOMEM;
@@ -1759,8 +2258,7 @@ done:
 	}
 
 	if (!result) {
-		free(op->pdu);
-		free(op);
+		put_att_send_op(op);
 		return -ENOMEM;
 	}
 
@@ -1776,18 +2274,18 @@ unsigned int bt_att_chan_send(struct bt_att_chan *chan, uint8_t opcode,
 				bt_att_destroy_func_t destroy)
 {
 	struct att_send_op *op;
+	struct iovec iov = { .iov_base = (void *) pdu, .iov_len = len };
 
 	if (!chan || !chan->att)
 		return -EINVAL;
 
-	op = create_att_send_op(chan->att, opcode, pdu, len, callback,
+	op = create_att_send_op(chan->att, opcode, &iov, 1, callback,
 						user_data, destroy);
 	if (!op)
 		return -EINVAL;
 
 	if (!queue_push_tail(chan->queue, op)) {
-		free(op->pdu);
-		free(op);
+		put_att_send_op(op);
 		return 0;
 	}
 
@@ -10,6 +10,7 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include <sys/uio.h>
 
 #include "src/shared/att-types.h"
 
@@ -17,9 +18,30 @@
 #define BT_ATT_DEBUG_VERBOSE	0x01
 #define BT_ATT_DEBUG_HEXDUMP	0x02
 
+/* Dispatch of queued operations over multiple (EATT) channels */
+#define BT_ATT_SCHED_FIFO	0x00	/* Head of queue to first writable */
+#define BT_ATT_SCHED_BALANCED	0x01	/* By channel MTU, load and latency */
+
 struct bt_att;
 struct bt_att_chan;
 
+struct bt_att_write_stats {
+	unsigned int wakeups;		/* Write wakeups that sent PDUs */
+	unsigned int pdus;		/* PDUs written */
+	unsigned int max_burst;		/* Most PDUs written in one wakeup */
+};
+
+struct bt_att_chan_stats {
+	uint8_t type;			/* BT_ATT_LE, BT_ATT_EATT, ... */
+	uint16_t mtu;
+	unsigned int pdus;		/* PDUs written */
+	unsigned int requests;		/* Requests and indications answered */
+	unsigned int in_flight;		/* Requests and indications pending */
+	unsigned int queued;		/* Operations queued on the channel */
+	unsigned int latency;		/* Smoothed response time in usec */
+	unsigned int max_latency;	/* Slowest response time in usec */
+};
+
 struct bt_att *bt_att_new(int fd, bool ext_signed);
 
 struct bt_att *bt_att_ref(struct bt_att *att);
@@ -58,6 +80,11 @@ bool bt_att_set_debug(struct bt_att *att, uint8_t level,
 uint16_t bt_att_get_mtu(struct bt_att *att);
 bool bt_att_set_mtu(struct bt_att *att, uint16_t mtu);
 uint8_t bt_att_get_link_type(struct bt_att *att);
+bool bt_att_get_write_stats(struct bt_att *att,
+					struct bt_att_write_stats *stats);
+bool bt_att_get_chan_stats(struct bt_att *att, unsigned int index,
+					struct bt_att_chan_stats *stats);
+bool bt_att_set_scheduler(struct bt_att *att, uint8_t sched);
 
 bool bt_att_set_timeout_cb(struct bt_att *att, bt_att_timeout_func_t callback,
 						void *user_data,
@@ -72,6 +99,11 @@ unsigned int bt_att_send(struct bt_att *att, uint8_t opcode,
 					bt_att_response_func_t callback,
 					void *user_data,
 					bt_att_destroy_func_t destroy);
+unsigned int bt_att_send_iov(struct bt_att *att, uint8_t opcode,
+					const struct iovec *iov, size_t iovcnt,
+					bt_att_response_func_t callback,
+					void *user_data,
+					bt_att_destroy_func_t destroy);
 int bt_att_resend(struct bt_att *att, unsigned int id, uint8_t opcode,
 					const void *pdu, uint16_t length,
 					bt_att_response_func_t callback,
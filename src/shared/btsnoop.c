@@ -20,8 +20,11 @@
 #include <string.h>
 #include <stdio.h>
 #include <limits.h>
+#include <time.h>
 #include <arpa/inet.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
 
 #include "src/shared/btsnoop.h"
 
@@ -68,8 +71,64 @@ struct btsnoop {
 	size_t cur_size;
 	unsigned int max_count;
 	unsigned int cur_count;
+	uint8_t *buf;
+	size_t buf_size;
+	size_t buf_len;
+	unsigned int flush_interval;
+	uint64_t last_flush;
+	uint8_t *map;
+	size_t map_size;
+	struct btsnoop_entry *entries;
+	size_t num_entries;
+	size_t cur_entry;
 };
 
+struct btsnoop_entry {
+	size_t offset;			/* Payload offset in mapping */
+	uint64_t ts;			/* Timestamp microseconds */
+	uint16_t index;
+	uint16_t opcode;
+	uint16_t size;
+};
+
+static uint64_t get_time_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1000ull + ts.tv_nsec / 1000000;
+}
+
+static bool write_iov(int fd, struct iovec *iov, int iovcnt)
+{
+	while (iovcnt > 0) {
+		ssize_t written;
+
+		written = writev(fd, iov, iovcnt);
+		if (written < 0)
+			return false;
+
+		/*
+		 * Skip over fully written vectors and adjust partial one, so on
+		 * failure the vectors only describe what was not written.
+		 */
+		while (iovcnt > 0 && (size_t) written >= iov->iov_len) {
+			written -= iov->iov_len;
+			iov->iov_len = 0;
+			iov++;
+			iovcnt--;
+		}
+
+		if (iovcnt > 0) {
+			iov->iov_base = (uint8_t *) iov->iov_base + written;
+			iov->iov_len -= written;
+		}
+	}
+
+	return true;
+}
+
 struct btsnoop *btsnoop_open(const char *path, unsigned long flags)
 {
 	struct btsnoop *btsnoop;
@@ -205,9 +264,16 @@ void btsnoop_unref(struct btsnoop *btsnoop)
 	if (__sync_sub_and_fetch(&btsnoop->ref_count, 1))
 		return;
 
+	btsnoop_flush(btsnoop);
+
+	if (btsnoop->map)
+		munmap(btsnoop->map, btsnoop->map_size);
+
 	if (btsnoop->fd >= 0)
 		close(btsnoop->fd);
 
+	free(btsnoop->entries);
+	free(btsnoop->buf);
 	free(btsnoop);
 }
 
@@ -219,12 +285,94 @@ uint32_t btsnoop_get_format(struct btsnoop *btsnoop)
 	return btsnoop->format;
 }
 
+bool btsnoop_set_buffer(struct btsnoop *btsnoop, size_t size,
+						unsigned int flush_interval)
+{
+	uint8_t *buf = NULL;
+
+	if (!btsnoop || btsnoop->fd < 0)
+		return false;
+
+	/* Buffering only applies to files opened for writing */
+	if (btsnoop->cur_size < BTSNOOP_HDR_SIZE)
+		return false;
+
+	if (!btsnoop_flush(btsnoop))
+		return false;
+
+	if (size) {
+		/* Buffer must at least hold a single maximum sized record */
+		if (size < BTSNOOP_PKT_SIZE + BTSNOOP_MAX_PACKET_SIZE)
+			size = BTSNOOP_PKT_SIZE + BTSNOOP_MAX_PACKET_SIZE;
+
+		buf = malloc(size);
+		if (!buf)
+			return false;
+	}
+
+	free(btsnoop->buf);
+
+	btsnoop->buf = buf;
+	btsnoop->buf_size = size;
+	btsnoop->buf_len = 0;
+	btsnoop->flush_interval = flush_interval;
+	btsnoop->last_flush = get_time_ms();
+
+	return true;
+}
+
+/* Keeps what could not be written at the start of the buffer */
+static void buffer_keep(struct btsnoop *btsnoop, const struct iovec *iov,
+								int iovcnt)
+{
+	size_t len = 0;
+	int i;
+
+	for (i = 0; i < iovcnt; i++) {
+		memmove(btsnoop->buf + len, iov[i].iov_base, iov[i].iov_len);
+		len += iov[i].iov_len;
+	}
+
+	btsnoop->buf_len = len;
+}
+
+bool btsnoop_flush(struct btsnoop *btsnoop)
+{
+	struct iovec iov;
+
+	if (!btsnoop)
+		return false;
+
+	if (!btsnoop->buf_len)
+		return true;
+
+	btsnoop->last_flush = get_time_ms();
+
+	if (btsnoop->fd < 0)
+		return false;
+
+	iov.iov_base = btsnoop->buf;
+	iov.iov_len = btsnoop->buf_len;
+
+	if (!write_iov(btsnoop->fd, &iov, 1)) {
+		buffer_keep(btsnoop, &iov, 1);
+		return false;
+	}
+
+	btsnoop->buf_len = 0;
+
+	return true;
+}
+
 static bool btsnoop_rotate(struct btsnoop *btsnoop)
 {
 	struct btsnoop_hdr hdr;
 	char path[PATH_MAX];
 	ssize_t written;
 
+	/* Pending records belong to the file that is being closed */
+	btsnoop_flush(btsnoop);
+
 	close(btsnoop->fd);
 
 	/* Check if max number of log files has been reached */
@@ -255,6 +403,58 @@ static bool btsnoop_rotate(struct btsnoop *btsnoop)
 	return true;
 }
 
+static bool buffer_write(struct btsnoop *btsnoop, struct btsnoop_pkt *pkt,
+					const void *data, uint16_t size)
+{
+	struct iovec iov[3];
+
+	/*
+	 * If the record doesn't fit anymore, write out the pending records
+	 * together with the new one using a single system call.
+	 */
+	if (btsnoop->buf_len + BTSNOOP_PKT_SIZE + size > btsnoop->buf_size) {
+		iov[0].iov_base = btsnoop->buf;
+		iov[0].iov_len = btsnoop->buf_len;
+		iov[1].iov_base = pkt;
+		iov[1].iov_len = BTSNOOP_PKT_SIZE;
+		iov[2].iov_base = (void *) data;
+		iov[2].iov_len = size;
+
+		btsnoop->last_flush = get_time_ms();
+
+		if (write_iov(btsnoop->fd, iov, 3)) {
+			btsnoop->buf_len = 0;
+			return true;
+		}
+
+		/*
+		 * Keep the unwritten tail for the next flush. The new record
+		 * is dropped if none of it made it to the file since it might
+		 * not fit into the buffer anymore.
+		 */
+		if (iov[0].iov_len)
+			buffer_keep(btsnoop, iov, 1);
+		else
+			buffer_keep(btsnoop, iov + 1, 2);
+
+		return false;
+	}
+
+	memcpy(btsnoop->buf + btsnoop->buf_len, pkt, BTSNOOP_PKT_SIZE);
+	btsnoop->buf_len += BTSNOOP_PKT_SIZE;
+
+	if (size > 0) {
+		memcpy(btsnoop->buf + btsnoop->buf_len, data, size);
+		btsnoop->buf_len += size;
+	}
+
+	if (btsnoop->flush_interval && get_time_ms() - btsnoop->last_flush >=
+						btsnoop->flush_interval)
+		return btsnoop_flush(btsnoop);
+
+	return true;
+}
+
 bool btsnoop_write(struct btsnoop *btsnoop, struct timeval *tv,
 			uint32_t flags, uint32_t drops, const void *data,
 			uint16_t size)
@@ -266,6 +466,9 @@ bool btsnoop_write(struct btsnoop *btsnoop, struct timeval *tv,
 	if (!btsnoop || !tv)
 		return false;
 
+	if (!data)
+		size = 0;
+
 	if (btsnoop->max_size && btsnoop->max_size <=
 			btsnoop->cur_size + size + BTSNOOP_PKT_SIZE)
 		if (!btsnoop_rotate(btsnoop))
@@ -279,6 +482,15 @@ bool btsnoop_write(struct btsnoop *btsnoop, struct timeval *tv,
 	pkt.drops = htobe32(drops);
 	pkt.ts    = htobe64(ts + 0x00E03AB44A676000ll);
 
+	if (btsnoop->buf) {
+		if (!buffer_write(btsnoop, &pkt, data, size))
+			return false;
+
+		btsnoop->cur_size += BTSNOOP_PKT_SIZE + size;
+
+		return true;
+	}
+
 	written = write(btsnoop->fd, &pkt, BTSNOOP_PKT_SIZE);
 	if (written < 0)
 		return false;
@@ -377,44 +589,9 @@ bool btsnoop_write_phy(struct btsnoop *btsnoop, struct timeval *tv,
 	return btsnoop_write(btsnoop, tv, flags, 0, data, size);
 }
 
-static bool pklg_read_hci(struct btsnoop *btsnoop, struct timeval *tv,
-					uint16_t *index, uint16_t *opcode,
-					void *data, uint16_t *size)
+static void pklg_get_opcode(uint8_t type, uint16_t *index, uint16_t *opcode)
 {
-	struct pklg_pkt pkt;
-	uint32_t toread;
-	uint64_t ts;
-	ssize_t len;
-
-	len = read(btsnoop->fd, &pkt, PKLG_PKT_SIZE);
-	if (len == 0)
-		return false;
-
-	if (len < 0 || len != PKLG_PKT_SIZE) {
-		btsnoop->aborted = true;
-		return false;
-	}
-
-	if (btsnoop->pklg_v2) {
-		toread = le32toh(pkt.len) - (PKLG_PKT_SIZE - 4);
-
-		ts = le64toh(pkt.ts);
-		tv->tv_sec = ts & 0xffffffff;
-		tv->tv_usec = ts >> 32;
-	} else {
-		toread = be32toh(pkt.len) - (PKLG_PKT_SIZE - 4);
-
-		ts = be64toh(pkt.ts);
-		tv->tv_sec = ts >> 32;
-		tv->tv_usec = ts & 0xffffffff;
-	}
-
-	if (toread > BTSNOOP_MAX_PACKET_SIZE) {
-                btsnoop->aborted = true;
-                return false;
-        }
-
-	switch (pkt.type) {
+	switch (type) {
 	case 0x00:
 		*index = 0x0000;
 		*opcode = BTSNOOP_OPCODE_COMMAND_PKT;
@@ -460,6 +637,46 @@ static bool pklg_read_hci(struct btsnoop *btsnoop, struct timeval *tv,
 		*opcode = 0xffff;
 		break;
 	}
+}
+
+static bool pklg_read_hci(struct btsnoop *btsnoop, struct timeval *tv,
+					uint16_t *index, uint16_t *opcode,
+					void *data, uint16_t *size)
+{
+	struct pklg_pkt pkt;
+	uint32_t toread;
+	uint64_t ts;
+	ssize_t len;
+
+	len = read(btsnoop->fd, &pkt, PKLG_PKT_SIZE);
+	if (len == 0)
+		return false;
+
+	if (len < 0 || len != PKLG_PKT_SIZE) {
+		btsnoop->aborted = true;
+		return false;
+	}
+
+	if (btsnoop->pklg_v2) {
+		toread = le32toh(pkt.len) - (PKLG_PKT_SIZE - 4);
+
+		ts = le64toh(pkt.ts);
+		tv->tv_sec = ts & 0xffffffff;
+		tv->tv_usec = ts >> 32;
+	} else {
+		toread = be32toh(pkt.len) - (PKLG_PKT_SIZE - 4);
+
+		ts = be64toh(pkt.ts);
+		tv->tv_sec = ts >> 32;
+		tv->tv_usec = ts & 0xffffffff;
+	}
+
+	if (toread > BTSNOOP_MAX_PACKET_SIZE) {
+                btsnoop->aborted = true;
+                return false;
+        }
+
+	pklg_get_opcode(pkt.type, index, opcode);
 
 	len = read(btsnoop->fd, data, toread);
 	if (len < 0) {
@@ -525,6 +742,19 @@ bool btsnoop_read_hci(struct btsnoop *btsnoop, struct timeval *tv,
 	if (!btsnoop || btsnoop->aborted)
 		return false;
 
+	if (btsnoop->entries) {
+		const void *ptr;
+
+		if (!btsnoop_peek_hci(btsnoop, btsnoop->cur_entry, tv, index,
+							opcode, &ptr, size))
+			return false;
+
+		memcpy(data, ptr, *size);
+		btsnoop->cur_entry++;
+
+		return true;
+	}
+
 	if (btsnoop->pklg_format)
 		return pklg_read_hci(btsnoop, tv, index, opcode, data, size);
 
@@ -588,6 +818,284 @@ bool btsnoop_read_hci(struct btsnoop *btsnoop, struct timeval *tv,
 	return true;
 }
 
+static bool index_pklg_entry(struct btsnoop *btsnoop, size_t offset,
+				struct btsnoop_entry *entry, size_t *next)
+{
+	struct pklg_pkt pkt;
+	uint32_t toread;
+	uint64_t ts;
+
+	if (btsnoop->map_size - offset < PKLG_PKT_SIZE)
+		return false;
+
+	memcpy(&pkt, btsnoop->map + offset, PKLG_PKT_SIZE);
+
+	if (btsnoop->pklg_v2) {
+		toread = le32toh(pkt.len) - (PKLG_PKT_SIZE - 4);
+
+		ts = le64toh(pkt.ts);
+		entry->ts = (ts & 0xffffffff) * 1000000ull + (ts >> 32);
+	} else {
+		toread = be32toh(pkt.len) - (PKLG_PKT_SIZE - 4);
+
+		ts = be64toh(pkt.ts);
+		entry->ts = (ts >> 32) * 1000000ull + (ts & 0xffffffff);
+	}
+
+	if (toread > BTSNOOP_MAX_PACKET_SIZE)
+		return false;
+
+	offset += PKLG_PKT_SIZE;
+
+	if (btsnoop->map_size - offset < toread)
+		return false;
+
+	pklg_get_opcode(pkt.type, &entry->index, &entry->opcode);
+	entry->offset = offset;
+	entry->size = toread;
+
+	*next = offset + toread;
+
+	return true;
+}
+
+static bool index_btsnoop_entry(struct btsnoop *btsnoop, size_t offset,
+				struct btsnoop_entry *entry, size_t *next)
+{
+	struct btsnoop_pkt pkt;
+	uint32_t toread, flags;
+	uint64_t ts;
+
+	if (btsnoop->map_size - offset < BTSNOOP_PKT_SIZE)
+		return false;
+
+	memcpy(&pkt, btsnoop->map + offset, BTSNOOP_PKT_SIZE);
+
+	toread = be32toh(pkt.len);
+	if (toread > BTSNOOP_MAX_PACKET_SIZE)
+		return false;
+
+	offset += BTSNOOP_PKT_SIZE;
+
+	if (btsnoop->map_size - offset < toread)
+		return false;
+
+	*next = offset + toread;
+
+	flags = be32toh(pkt.flags);
+
+	ts = be64toh(pkt.ts) - 0x00E03AB44A676000ll;
+	entry->ts = ts + 946684800ll * 1000000ll;
+
+	switch (btsnoop->format) {
+	case BTSNOOP_FORMAT_HCI:
+		entry->index = 0;
+		entry->opcode = get_opcode_from_flags(0xff, flags);
+		break;
+
+	case BTSNOOP_FORMAT_UART:
+		if (!toread)
+			return false;
+
+		entry->index = 0;
+		entry->opcode = get_opcode_from_flags(btsnoop->map[offset],
+									flags);
+		offset++;
+		toread--;
+		break;
+
+	case BTSNOOP_FORMAT_MONITOR:
+		entry->index = flags >> 16;
+		entry->opcode = flags & 0xffff;
+		break;
+
+	default:
+		return false;
+	}
+
+	entry->offset = offset;
+	entry->size = toread;
+
+	return true;
+}
+
+bool btsnoop_index(struct btsnoop *btsnoop)
+{
+	struct btsnoop_entry entry;
+	struct stat st;
+	size_t alloc = 0;
+	off_t start;
+	void *map;
+
+	if (!btsnoop || btsnoop->aborted)
+		return false;
+
+	if (btsnoop->entries)
+		return true;
+
+	/* Only files opened for reading can be indexed */
+	if (btsnoop->cur_size)
+		return false;
+
+	switch (btsnoop->format) {
+	case BTSNOOP_FORMAT_HCI:
+	case BTSNOOP_FORMAT_UART:
+	case BTSNOOP_FORMAT_MONITOR:
+		break;
+	default:
+		return false;
+	}
+
+	if (fstat(btsnoop->fd, &st) < 0 || !S_ISREG(st.st_mode))
+		return false;
+
+	/* Start indexing with the next packet to be read */
+	start = lseek(btsnoop->fd, 0, SEEK_CUR);
+	if (start < 0 || start >= st.st_size)
+		return false;
+
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, btsnoop->fd, 0);
+	if (map == MAP_FAILED)
+		return false;
+
+	btsnoop->map = map;
+	btsnoop->map_size = st.st_size;
+
+	while ((size_t) start < btsnoop->map_size) {
+		size_t next;
+		bool valid;
+
+		if (btsnoop->pklg_format)
+			valid = index_pklg_entry(btsnoop, start, &entry, &next);
+		else
+			valid = index_btsnoop_entry(btsnoop, start, &entry,
+									&next);
+
+		/* Truncated or corrupted packets end the trace */
+		if (!valid)
+			break;
+
+		if (btsnoop->num_entries == alloc) {
+			struct btsnoop_entry *entries;
+
+			alloc = alloc ? alloc * 2 : 1024;
+
+			entries = reallocarray(btsnoop->entries, alloc,
+							sizeof(*entries));
+			if (!entries)
+				goto failed;
+
+			btsnoop->entries = entries;
+		}
+
+		btsnoop->entries[btsnoop->num_entries++] = entry;
+		start = next;
+	}
+
+	if (!btsnoop->entries)
+		goto failed;
+
+	btsnoop->cur_entry = 0;
+
+	return true;
+
+failed:
+	free(btsnoop->entries);
+	btsnoop->entries = NULL;
+	btsnoop->num_entries = 0;
+
+	munmap(btsnoop->map, btsnoop->map_size);
+	btsnoop->map = NULL;
+	btsnoop->map_size = 0;
+
+	return false;
+}
+
+size_t btsnoop_get_count(struct btsnoop *btsnoop)
+{
+	if (!btsnoop)
+		return 0;
+
+	return btsnoop->num_entries;
+}
+
+size_t btsnoop_tell(struct btsnoop *btsnoop)
+{
+	if (!btsnoop)
+		return 0;
+
+	return btsnoop->cur_entry;
+}
+
+bool btsnoop_seek(struct btsnoop *btsnoop, size_t pos)
+{
+	if (!btsnoop || !btsnoop->entries)
+		return false;
+
+	if (pos > btsnoop->num_entries)
+		return false;
+
+	btsnoop->cur_entry = pos;
+
+	return true;
+}
+
+bool btsnoop_seek_time(struct btsnoop *btsnoop, const struct timeval *tv)
+{
+	size_t low, high;
+	uint64_t ts;
+
+	if (!btsnoop || !btsnoop->entries || !tv)
+		return false;
+
+	ts = tv->tv_sec * 1000000ull + tv->tv_usec;
+
+	/*
+	 * Find the first packet not older than the given time. Traces are
+	 * written in order, so timestamps are expected to not decrease.
+	 */
+	low = 0;
+	high = btsnoop->num_entries;
+
+	while (low < high) {
+		size_t mid = low + (high - low) / 2;
+
+		if (btsnoop->entries[mid].ts < ts)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	btsnoop->cur_entry = low;
+
+	return low < btsnoop->num_entries;
+}
+
+bool btsnoop_peek_hci(struct btsnoop *btsnoop, size_t pos,
+					struct timeval *tv, uint16_t *index,
+					uint16_t *opcode, const void **data,
+					uint16_t *size)
+{
+	const struct btsnoop_entry *entry;
+
+	if (!btsnoop || !btsnoop->entries)
+		return false;
+
+	if (pos >= btsnoop->num_entries)
+		return false;
+
+	entry = &btsnoop->entries[pos];
+
+	tv->tv_sec = entry->ts / 1000000ull;
+	tv->tv_usec = entry->ts % 1000000ull;
+	*index = entry->index;
+	*opcode = entry->opcode;
+	*data = btsnoop->map + entry->offset;
+	*size = entry->size;
+
+	return true;
+}
+
 bool btsnoop_read_phy(struct btsnoop *btsnoop, struct timeval *tv,
 			uint16_t *frequency, void *data, uint16_t *size)
 {
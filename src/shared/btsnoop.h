@@ -98,6 +98,10 @@ void btsnoop_unref(struct btsnoop *btsnoop);
 
 uint32_t btsnoop_get_format(struct btsnoop *btsnoop);
 
+bool btsnoop_set_buffer(struct btsnoop *btsnoop, size_t size,
+						unsigned int flush_interval);
+bool btsnoop_flush(struct btsnoop *btsnoop);
+
 bool btsnoop_write(struct btsnoop *btsnoop, struct timeval *tv, uint32_t flags,
 			uint32_t drops, const void *data, uint16_t size);
 bool btsnoop_write_hci(struct btsnoop *btsnoop, struct timeval *tv,
@@ -111,3 +115,13 @@ bool btsnoop_read_hci(struct btsnoop *btsnoop, struct timeval *tv,
 					void *data, uint16_t *size);
 bool btsnoop_read_phy(struct btsnoop *btsnoop, struct timeval *tv,
 			uint16_t *frequency, void *data, uint16_t *size);
+
+bool btsnoop_index(struct btsnoop *btsnoop);
+size_t btsnoop_get_count(struct btsnoop *btsnoop);
+size_t btsnoop_tell(struct btsnoop *btsnoop);
+bool btsnoop_seek(struct btsnoop *btsnoop, size_t pos);
+bool btsnoop_seek_time(struct btsnoop *btsnoop, const struct timeval *tv);
+bool btsnoop_peek_hci(struct btsnoop *btsnoop, size_t pos,
+					struct timeval *tv, uint16_t *index,
+					uint16_t *opcode, const void **data,
+					uint16_t *size);
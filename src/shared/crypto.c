@@ -12,11 +12,22 @@
 #include <config.h>
 #endif
 
+#define _GNU_SOURCE
 #include <fcntl.h>
 #include <unistd.h>
 #include <string.h>
 #include <sys/socket.h>
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <emmintrin.h>
+#include <wmmintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+
 #include "src/shared/util.h"
 #include "src/shared/crypto.h"
 
@@ -64,8 +75,41 @@ struct af_alg_iv {
 
 #define ATT_SIGN_LEN	12
 
+#define AES_BLOCK_SIZE	16
+#define AES_ROUNDS	10
+
+struct aes_key {
+	uint8_t rk[AES_BLOCK_SIZE * (AES_ROUNDS + 1)];
+};
+
+typedef void (*aes_encrypt_func_t)(const struct aes_key *key,
+					const uint8_t in[16], uint8_t out[16]);
+
+/* Encrypt the same block with several keys */
+typedef void (*aes_encrypt_multi_func_t)(const struct aes_key *keys,
+					size_t count, const uint8_t in[16],
+					uint8_t (*out)[16]);
+
+/*
+ * Backend operations. Keys, input and output are in AES byte order, i.e.
+ * the most significant octet first.
+ */
+struct crypto_ops {
+	const char *name;
+	bool (*encrypt)(struct bt_crypto *crypto, const uint8_t key[16],
+					const uint8_t in[16], uint8_t out[16]);
+	bool (*cmac)(struct bt_crypto *crypto, const uint8_t key[16],
+					const struct iovec *iov, size_t iov_len,
+					uint8_t res[16]);
+};
+
 struct bt_crypto {
 	int ref_count;
+	enum bt_crypto_backend backend;
+	const struct crypto_ops *ops;
+	const char *name;
+	aes_encrypt_func_t aes_encrypt;
+	aes_encrypt_multi_func_t aes_encrypt_multi;
 	int ecb_aes;
 	int urandom;
 	int cmac_aes;
@@ -126,40 +170,552 @@ static int cmac_aes_setup(void)
 	return fd;
 }
 
-static struct bt_crypto *singleton;
+static int alg_new(int fd, const void *keyval, socklen_t keylen)
+{
+	if (setsockopt(fd, SOL_ALG, ALG_SET_KEY, keyval, keylen) < 0)
+		return -1;
 
-struct bt_crypto *bt_crypto_new(void)
+	/* FIXME: This should use accept4() with SOCK_CLOEXEC */
+	return accept(fd, NULL, 0);
+}
+
+static bool alg_encrypt(int fd, const void *inbuf, size_t inlen,
+						void *outbuf, size_t outlen)
 {
-	if (singleton)
-		return bt_crypto_ref(singleton);
+	__u32 alg_op = ALG_OP_ENCRYPT;
+	char cbuf[CMSG_SPACE(sizeof(alg_op))];
+	struct cmsghdr *cmsg;
+	struct msghdr msg;
+	struct iovec iov;
+	ssize_t len;
 
-	singleton = new0(struct bt_crypto, 1);
+	memset(cbuf, 0, sizeof(cbuf));
+	memset(&msg, 0, sizeof(msg));
 
-	singleton->ecb_aes = ecb_aes_setup();
-	if (singleton->ecb_aes < 0) {
-		free(singleton);
-		singleton = NULL;
-		return NULL;
+	msg.msg_control = cbuf;
+	msg.msg_controllen = sizeof(cbuf);
+
+	cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_ALG;
+	cmsg->cmsg_type = ALG_SET_OP;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(alg_op));
+	memcpy(CMSG_DATA(cmsg), &alg_op, sizeof(alg_op));
+
+	iov.iov_base = (void *) inbuf;
+	iov.iov_len = inlen;
+
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+
+	len = sendmsg(fd, &msg, 0);
+	if (len < 0)
+		return false;
+
+	len = read(fd, outbuf, outlen);
+	if (len < 0)
+		return false;
+
+	return true;
+}
+
+static bool af_alg_encrypt(struct bt_crypto *crypto, const uint8_t key[16],
+					const uint8_t in[16], uint8_t out[16])
+{
+	bool ret;
+	int fd;
+
+	fd = alg_new(crypto->ecb_aes, key, 16);
+	if (fd < 0)
+		return false;
+
+	ret = alg_encrypt(fd, in, 16, out, 16);
+
+	close(fd);
+
+	return ret;
+}
+
+static bool af_alg_cmac(struct bt_crypto *crypto, const uint8_t key[16],
+				const struct iovec *iov, size_t iov_len,
+				uint8_t res[16])
+{
+	ssize_t len;
+	int fd;
+
+	fd = alg_new(crypto->cmac_aes, key, 16);
+	if (fd < 0)
+		return false;
+
+	len = writev(fd, iov, iov_len);
+	if (len < 0) {
+		close(fd);
+		return false;
+	}
+
+	len = read(fd, res, 16);
+	if (len < 0) {
+		close(fd);
+		return false;
 	}
 
-	singleton->urandom = urandom_setup();
-	if (singleton->urandom < 0) {
-		close(singleton->ecb_aes);
-		free(singleton);
-		singleton = NULL;
+	close(fd);
+
+	return true;
+}
+
+static const struct crypto_ops af_alg_ops = {
+	.name = "af_alg",
+	.encrypt = af_alg_encrypt,
+	.cmac = af_alg_cmac,
+};
+
+static inline uint8_t aes_xtime(uint8_t x)
+{
+	return (x << 1) ^ ((x >> 7) * 0x1b);
+}
+
+/* Multiplication in GF(2^8) without data dependent branches */
+static uint8_t aes_gmul(uint8_t a, uint8_t b)
+{
+	uint8_t r = 0;
+	unsigned int i;
+
+	for (i = 0; i < 8; i++) {
+		r ^= a & -(b & 1);
+		a = aes_xtime(a);
+		b >>= 1;
+	}
+
+	return r;
+}
+
+/*
+ * The S-box is computed instead of looked up in a table since lookups
+ * indexed by key dependent values leak the key through the cache.
+ */
+static uint8_t aes_sub_byte(uint8_t x)
+{
+	uint8_t x2, x3, x12, x15, x240, y;
+
+	/* Multiplicative inverse as x^254, with 0 mapped to 0 */
+	x2 = aes_gmul(x, x);
+	x3 = aes_gmul(x2, x);
+	x12 = aes_gmul(x3, x3);
+	x12 = aes_gmul(x12, x12);
+	x15 = aes_gmul(x12, x3);
+	x240 = aes_gmul(x15, x15);
+	x240 = aes_gmul(x240, x240);
+	x240 = aes_gmul(x240, x240);
+	x240 = aes_gmul(x240, x240);
+	y = aes_gmul(aes_gmul(x240, x12), x2);
+
+	/* Affine transformation */
+	return y ^ (uint8_t) ((y << 1) | (y >> 7)) ^
+			(uint8_t) ((y << 2) | (y >> 6)) ^
+			(uint8_t) ((y << 3) | (y >> 5)) ^
+			(uint8_t) ((y << 4) | (y >> 4)) ^ 0x63;
+}
+
+static const uint8_t aes_rcon[AES_ROUNDS] = {
+	0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1b, 0x36,
+};
+
+static void aes_expand_key(const uint8_t key[16], struct aes_key *aes)
+{
+	uint8_t *rk = aes->rk;
+	unsigned int i;
+
+	memcpy(rk, key, 16);
+
+	for (i = 16; i < sizeof(aes->rk); i += 4) {
+		uint8_t t[4];
+
+		if (i % 16) {
+			memcpy(t, rk + i - 4, 4);
+		} else {
+			/* SubWord(RotWord(w)) ^ Rcon */
+			t[0] = aes_sub_byte(rk[i - 3]) ^ aes_rcon[i / 16 - 1];
+			t[1] = aes_sub_byte(rk[i - 2]);
+			t[2] = aes_sub_byte(rk[i - 1]);
+			t[3] = aes_sub_byte(rk[i - 4]);
+		}
+
+		rk[i + 0] = rk[i - 16] ^ t[0];
+		rk[i + 1] = rk[i - 15] ^ t[1];
+		rk[i + 2] = rk[i - 14] ^ t[2];
+		rk[i + 3] = rk[i - 13] ^ t[3];
+	}
+}
+
+static void aes_encrypt_generic(const struct aes_key *key,
+					const uint8_t in[16], uint8_t out[16])
+{
+	const uint8_t *rk = key->rk;
+	uint8_t s[16], t[16];
+	unsigned int round, i;
+
+	for (i = 0; i < 16; i++)
+		s[i] = in[i] ^ rk[i];
+
+	for (round = 1; round <= AES_ROUNDS; round++) {
+		rk += 16;
+
+		/* SubBytes and ShiftRows on the column-major state */
+		for (i = 0; i < 16; i++)
+			t[i] = aes_sub_byte(s[(i + 4 * (i % 4)) % 16]);
+
+		if (round == AES_ROUNDS) {
+			for (i = 0; i < 16; i++)
+				out[i] = t[i] ^ rk[i];
+			break;
+		}
+
+		/* MixColumns and AddRoundKey */
+		for (i = 0; i < 16; i += 4) {
+			uint8_t u = t[i] ^ t[i + 1] ^ t[i + 2] ^ t[i + 3];
+
+			s[i + 0] = t[i + 0] ^ u ^ aes_xtime(t[i + 0] ^ t[i + 1]) ^
+								rk[i + 0];
+			s[i + 1] = t[i + 1] ^ u ^ aes_xtime(t[i + 1] ^ t[i + 2]) ^
+								rk[i + 1];
+			s[i + 2] = t[i + 2] ^ u ^ aes_xtime(t[i + 2] ^ t[i + 3]) ^
+								rk[i + 2];
+			s[i + 3] = t[i + 3] ^ u ^ aes_xtime(t[i + 3] ^ t[i + 0]) ^
+								rk[i + 3];
+		}
+	}
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("aes,sse2")))
+static void aes_encrypt_aesni(const struct aes_key *key,
+					const uint8_t in[16], uint8_t out[16])
+{
+	__m128i s;
+	unsigned int round;
+
+	s = _mm_loadu_si128((const void *) in);
+	s = _mm_xor_si128(s, _mm_loadu_si128((const void *) key->rk));
+
+	for (round = 1; round < AES_ROUNDS; round++)
+		s = _mm_aesenc_si128(s, _mm_loadu_si128((const void *)
+						(key->rk + round * 16)));
+
+	s = _mm_aesenclast_si128(s, _mm_loadu_si128((const void *)
+						(key->rk + AES_ROUNDS * 16)));
+
+	_mm_storeu_si128((void *) out, s);
+}
+
+/* Interleave four keys to hide the latency of the AES instructions */
+__attribute__((target("aes,sse2")))
+static void aes_encrypt_multi_aesni(const struct aes_key *keys, size_t count,
+					const uint8_t in[16], uint8_t (*out)[16])
+{
+	__m128i b, s0, s1, s2, s3;
+	unsigned int round;
+	size_t i;
+
+	b = _mm_loadu_si128((const void *) in);
+
+	for (i = 0; i + 4 <= count; i += 4) {
+		const uint8_t *k0 = keys[i].rk;
+		const uint8_t *k1 = keys[i + 1].rk;
+		const uint8_t *k2 = keys[i + 2].rk;
+		const uint8_t *k3 = keys[i + 3].rk;
+
+		s0 = _mm_xor_si128(b, _mm_loadu_si128((const void *) k0));
+		s1 = _mm_xor_si128(b, _mm_loadu_si128((const void *) k1));
+		s2 = _mm_xor_si128(b, _mm_loadu_si128((const void *) k2));
+		s3 = _mm_xor_si128(b, _mm_loadu_si128((const void *) k3));
+
+		for (round = 1; round < AES_ROUNDS; round++) {
+			k0 += 16;
+			k1 += 16;
+			k2 += 16;
+			k3 += 16;
+
+			s0 = _mm_aesenc_si128(s0,
+					_mm_loadu_si128((const void *) k0));
+			s1 = _mm_aesenc_si128(s1,
+					_mm_loadu_si128((const void *) k1));
+			s2 = _mm_aesenc_si128(s2,
+					_mm_loadu_si128((const void *) k2));
+			s3 = _mm_aesenc_si128(s3,
+					_mm_loadu_si128((const void *) k3));
+		}
+
+		s0 = _mm_aesenclast_si128(s0,
+				_mm_loadu_si128((const void *) (k0 + 16)));
+		s1 = _mm_aesenclast_si128(s1,
+				_mm_loadu_si128((const void *) (k1 + 16)));
+		s2 = _mm_aesenclast_si128(s2,
+				_mm_loadu_si128((const void *) (k2 + 16)));
+		s3 = _mm_aesenclast_si128(s3,
+				_mm_loadu_si128((const void *) (k3 + 16)));
+
+		_mm_storeu_si128((void *) out[i], s0);
+		_mm_storeu_si128((void *) out[i + 1], s1);
+		_mm_storeu_si128((void *) out[i + 2], s2);
+		_mm_storeu_si128((void *) out[i + 3], s3);
+	}
+
+	for (; i < count; i++)
+		aes_encrypt_aesni(&keys[i], in, out[i]);
+}
+
+static bool aes_accel_probe(struct bt_crypto *crypto)
+{
+	unsigned int eax, ebx, ecx, edx;
+
+	if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+		return false;
+
+	if (!(ecx & bit_AES) || !(edx & bit_SSE2))
+		return false;
+
+	crypto->name = "aes-ni";
+	crypto->aes_encrypt = aes_encrypt_aesni;
+	crypto->aes_encrypt_multi = aes_encrypt_multi_aesni;
+
+	return true;
+}
+#elif defined(__aarch64__)
+#ifdef __clang__
+#define AES_CE_TARGET	__attribute__((target("aes")))
+#else
+#define AES_CE_TARGET	__attribute__((target("+crypto")))
+#endif
+
+AES_CE_TARGET
+static void aes_encrypt_ce(const struct aes_key *key,
+					const uint8_t in[16], uint8_t out[16])
+{
+	uint8x16_t s;
+	unsigned int round;
+
+	s = vld1q_u8(in);
+
+	/* AESE performs AddRoundKey, SubBytes and ShiftRows */
+	for (round = 0; round < AES_ROUNDS - 1; round++)
+		s = vaesmcq_u8(vaeseq_u8(s, vld1q_u8(key->rk + round * 16)));
+
+	s = vaeseq_u8(s, vld1q_u8(key->rk + (AES_ROUNDS - 1) * 16));
+	s = veorq_u8(s, vld1q_u8(key->rk + AES_ROUNDS * 16));
+
+	vst1q_u8(out, s);
+}
+
+AES_CE_TARGET
+static void aes_encrypt_multi_ce(const struct aes_key *keys, size_t count,
+					const uint8_t in[16], uint8_t (*out)[16])
+{
+	size_t i;
+
+	for (i = 0; i < count; i++)
+		aes_encrypt_ce(&keys[i], in, out[i]);
+}
+
+static bool aes_accel_probe(struct bt_crypto *crypto)
+{
+	if (!(getauxval(AT_HWCAP) & HWCAP_AES))
+		return false;
+
+	crypto->name = "armv8-ce";
+	crypto->aes_encrypt = aes_encrypt_ce;
+	crypto->aes_encrypt_multi = aes_encrypt_multi_ce;
+
+	return true;
+}
+#else
+static bool aes_accel_probe(struct bt_crypto *crypto)
+{
+	return false;
+}
+#endif
+
+static void aes_encrypt_multi_generic(const struct aes_key *keys, size_t count,
+					const uint8_t in[16], uint8_t (*out)[16])
+{
+	size_t i;
+
+	for (i = 0; i < count; i++)
+		aes_encrypt_generic(&keys[i], in, out[i]);
+}
+
+static bool soft_encrypt(struct bt_crypto *crypto, const uint8_t key[16],
+					const uint8_t in[16], uint8_t out[16])
+{
+	struct aes_key aes;
+
+	aes_expand_key(key, &aes);
+	crypto->aes_encrypt(&aes, in, out);
+
+	return true;
+}
+
+/* Left shift by one bit in GF(2^128) as used by CMAC subkey generation */
+static void cmac_dbl(const uint8_t in[16], uint8_t out[16])
+{
+	uint8_t msb = in[0] >> 7;
+	int i;
+
+	for (i = 0; i < 15; i++)
+		out[i] = (in[i] << 1) | (in[i + 1] >> 7);
+
+	out[15] = (in[15] << 1) ^ (msb * 0x87);
+}
+
+/* AES-CMAC as defined by RFC 4493 */
+static bool soft_cmac(struct bt_crypto *crypto, const uint8_t key[16],
+				const struct iovec *iov, size_t iov_len,
+				uint8_t res[16])
+{
+	static const uint8_t zero[16];
+	struct aes_key aes;
+	uint8_t x[16], k[16], buf[16];
+	size_t buf_len = 0;
+	size_t i, j;
+
+	aes_expand_key(key, &aes);
+
+	memset(x, 0, sizeof(x));
+
+	for (i = 0; i < iov_len; i++) {
+		const uint8_t *data = iov[i].iov_base;
+		size_t len = iov[i].iov_len;
+
+		while (len) {
+			size_t n;
+
+			/*
+			 * Only process a full block once more data follows,
+			 * the last block needs to be combined with a subkey.
+			 */
+			if (buf_len == 16) {
+				for (j = 0; j < 16; j++)
+					x[j] ^= buf[j];
+
+				crypto->aes_encrypt(&aes, x, x);
+				buf_len = 0;
+			}
+
+			n = MIN(len, 16 - buf_len);
+			memcpy(buf + buf_len, data, n);
+			buf_len += n;
+			data += n;
+			len -= n;
+		}
+	}
+
+	/* K1 = dbl(E(K, 0)), K2 = dbl(K1) */
+	crypto->aes_encrypt(&aes, zero, k);
+	cmac_dbl(k, k);
+
+	if (buf_len < 16) {
+		cmac_dbl(k, k);
+
+		buf[buf_len++] = 0x80;
+		memset(buf + buf_len, 0, 16 - buf_len);
+	}
+
+	for (j = 0; j < 16; j++)
+		x[j] ^= buf[j] ^ k[j];
+
+	crypto->aes_encrypt(&aes, x, res);
+
+	return true;
+}
+
+static const struct crypto_ops soft_ops = {
+	.name = "generic",
+	.encrypt = soft_encrypt,
+	.cmac = soft_cmac,
+};
+
+static struct bt_crypto *singleton[BT_CRYPTO_BACKEND_AF_ALG + 1];
+
+static bool af_alg_setup(struct bt_crypto *crypto)
+{
+	crypto->ecb_aes = ecb_aes_setup();
+	if (crypto->ecb_aes < 0)
+		return false;
+
+	crypto->cmac_aes = cmac_aes_setup();
+	if (crypto->cmac_aes < 0) {
+		close(crypto->ecb_aes);
+		return false;
+	}
+
+	crypto->ops = &af_alg_ops;
+	crypto->name = af_alg_ops.name;
+
+	return true;
+}
+
+static bool backend_setup(struct bt_crypto *crypto)
+{
+	switch (crypto->backend) {
+	case BT_CRYPTO_BACKEND_AF_ALG:
+		return af_alg_setup(crypto);
+	case BT_CRYPTO_BACKEND_DEFAULT:
+		if (aes_accel_probe(crypto))
+			break;
+
+		/*
+		 * The kernel may have accelerated drivers the CPU probe does
+		 * not know about and the portable code is slower.
+		 */
+		if (af_alg_setup(crypto))
+			return true;
+		/* fall through */
+	case BT_CRYPTO_BACKEND_GENERIC:
+		crypto->aes_encrypt = aes_encrypt_generic;
+		crypto->aes_encrypt_multi = aes_encrypt_multi_generic;
+		crypto->name = soft_ops.name;
+		break;
+	}
+
+	crypto->ecb_aes = -1;
+	crypto->cmac_aes = -1;
+	crypto->ops = &soft_ops;
+
+	return true;
+}
+
+struct bt_crypto *bt_crypto_new_backend(enum bt_crypto_backend backend)
+{
+	struct bt_crypto *crypto;
+
+	if (backend > BT_CRYPTO_BACKEND_AF_ALG)
+		return NULL;
+
+	if (singleton[backend])
+		return bt_crypto_ref(singleton[backend]);
+
+	crypto = new0(struct bt_crypto, 1);
+	crypto->backend = backend;
+
+	crypto->urandom = urandom_setup();
+	if (crypto->urandom < 0) {
+		free(crypto);
 		return NULL;
 	}
 
-	singleton->cmac_aes = cmac_aes_setup();
-	if (singleton->cmac_aes < 0) {
-		close(singleton->urandom);
-		close(singleton->ecb_aes);
-		free(singleton);
-		singleton = NULL;
+	if (!backend_setup(crypto)) {
+		close(crypto->urandom);
+		free(crypto);
 		return NULL;
 	}
 
-	return bt_crypto_ref(singleton);
+	singleton[backend] = crypto;
+
+	return bt_crypto_ref(crypto);
+}
+
+struct bt_crypto *bt_crypto_new(void)
+{
+	return bt_crypto_new_backend(BT_CRYPTO_BACKEND_DEFAULT);
 }
 
 struct bt_crypto *bt_crypto_ref(struct bt_crypto *crypto)
@@ -181,71 +737,35 @@ void bt_crypto_unref(struct bt_crypto *crypto)
 		return;
 
 	close(crypto->urandom);
-	close(crypto->ecb_aes);
-	close(crypto->cmac_aes);
 
-	free(crypto);
-	singleton = NULL;
-}
+	if (crypto->ecb_aes >= 0)
+		close(crypto->ecb_aes);
 
-bool bt_crypto_random_bytes(struct bt_crypto *crypto,
-					void *buf, uint8_t num_bytes)
-{
-	ssize_t len;
+	if (crypto->cmac_aes >= 0)
+		close(crypto->cmac_aes);
 
-	if (!crypto)
-		return false;
-
-	len = read(crypto->urandom, buf, num_bytes);
-	if (len < num_bytes)
-		return false;
-
-	return true;
+	singleton[crypto->backend] = NULL;
+	free(crypto);
 }
 
-static int alg_new(int fd, const void *keyval, socklen_t keylen)
+const char *bt_crypto_get_backend(struct bt_crypto *crypto)
 {
-	if (setsockopt(fd, SOL_ALG, ALG_SET_KEY, keyval, keylen) < 0)
-		return -1;
+	if (!crypto)
+		return NULL;
 
-	/* FIXME: This should use accept4() with SOCK_CLOEXEC */
-	return accept(fd, NULL, 0);
+	return crypto->name;
 }
 
-static bool alg_encrypt(int fd, const void *inbuf, size_t inlen,
-						void *outbuf, size_t outlen)
+bool bt_crypto_random_bytes(struct bt_crypto *crypto,
+					void *buf, uint8_t num_bytes)
 {
-	__u32 alg_op = ALG_OP_ENCRYPT;
-	char cbuf[CMSG_SPACE(sizeof(alg_op))];
-	struct cmsghdr *cmsg;
-	struct msghdr msg;
-	struct iovec iov;
 	ssize_t len;
 
-	memset(cbuf, 0, sizeof(cbuf));
-	memset(&msg, 0, sizeof(msg));
-
-	msg.msg_control = cbuf;
-	msg.msg_controllen = sizeof(cbuf);
-
-	cmsg = CMSG_FIRSTHDR(&msg);
-	cmsg->cmsg_level = SOL_ALG;
-	cmsg->cmsg_type = ALG_SET_OP;
-	cmsg->cmsg_len = CMSG_LEN(sizeof(alg_op));
-	memcpy(CMSG_DATA(cmsg), &alg_op, sizeof(alg_op));
-
-	iov.iov_base = (void *) inbuf;
-	iov.iov_len = inlen;
-
-	msg.msg_iov = &iov;
-	msg.msg_iovlen = 1;
-
-	len = sendmsg(fd, &msg, 0);
-	if (len < 0)
+	if (!crypto)
 		return false;
 
-	len = read(fd, outbuf, outlen);
-	if (len < 0)
+	len = read(crypto->urandom, buf, num_bytes);
+	if (len < num_bytes)
 		return false;
 
 	return true;
@@ -264,12 +784,11 @@ bool bt_crypto_sign_att(struct bt_crypto *crypto, const uint8_t key[16],
 				uint32_t sign_cnt,
 				uint8_t signature[ATT_SIGN_LEN])
 {
-	int fd;
-	int len;
 	uint8_t tmp[16], out[16];
 	uint16_t msg_len = m_len + sizeof(uint32_t);
 	uint8_t msg[msg_len];
 	uint8_t msg_s[msg_len];
+	struct iovec iov;
 
 	if (!crypto)
 		return false;
@@ -283,26 +802,14 @@ bool bt_crypto_sign_att(struct bt_crypto *crypto, const uint8_t key[16],
 	/* The most significant octet of key corresponds to key[0] */
 	swap_buf(key, tmp, 16);
 
-	fd = alg_new(crypto->cmac_aes, tmp, 16);
-	if (fd < 0)
-		return false;
-
 	/* Swap msg before signing */
 	swap_buf(msg, msg_s, msg_len);
 
-	len = send(fd, msg_s, msg_len, 0);
-	if (len < 0) {
-		close(fd);
-		return false;
-	}
+	iov.iov_base = msg_s;
+	iov.iov_len = msg_len;
 
-	len = read(fd, out, 16);
-	if (len < 0) {
-		close(fd);
+	if (!crypto->ops->cmac(crypto, tmp, &iov, 1, out))
 		return false;
-	}
-
-	close(fd);
 
 	/*
 	 * As to BT spec. 4.1 Vol[3], Part C, chapter 10.4.1 sign counter should
@@ -358,7 +865,6 @@ bool bt_crypto_e(struct bt_crypto *crypto, const uint8_t key[16],
 			const uint8_t plaintext[16], uint8_t encrypted[16])
 {
 	uint8_t tmp[16], in[16], out[16];
-	int fd;
 
 	if (!crypto)
 		return false;
@@ -366,24 +872,15 @@ bool bt_crypto_e(struct bt_crypto *crypto, const uint8_t key[16],
 	/* The most significant octet of key corresponds to key[0] */
 	swap_buf(key, tmp, 16);
 
-	fd = alg_new(crypto->ecb_aes, tmp, 16);
-	if (fd < 0)
-		return false;
-
-
 	/* Most significant octet of plaintextData corresponds to in[0] */
 	swap_buf(plaintext, in, 16);
 
-	if (!alg_encrypt(fd, in, 16, out, 16)) {
-		close(fd);
+	if (!crypto->ops->encrypt(crypto, tmp, in, out))
 		return false;
-	}
 
 	/* Most significant octet of encryptedData corresponds to out[0] */
 	swap_buf(out, encrypted, 16);
 
-	close(fd);
-
 	return true;
 }
 
@@ -442,6 +939,230 @@ bool bt_crypto_ah(struct bt_crypto *crypto, const uint8_t k[16],
 	return true;
 }
 
+/* Number of keys processed per pass over the IRK list */
+#define RESOLVE_BATCH	64
+
+struct resolver_irk {
+	uint8_t val[16];
+	void *user_data;
+};
+
+struct rpa_cache_entry {
+	uint8_t rpa[6];
+	bool valid;
+	void *user_data;
+};
+
+struct bt_crypto_resolver {
+	struct bt_crypto *crypto;
+	struct resolver_irk *irks;
+	struct aes_key *keys;
+	size_t num_irks;
+	size_t max_irks;
+	struct rpa_cache_entry *cache;
+	size_t cache_mask;
+};
+
+struct bt_crypto_resolver *bt_crypto_resolver_new(struct bt_crypto *crypto,
+							size_t cache_size)
+{
+	struct bt_crypto_resolver *resolver;
+	size_t size = 1;
+
+	if (!crypto)
+		return NULL;
+
+	resolver = new0(struct bt_crypto_resolver, 1);
+	resolver->crypto = bt_crypto_ref(crypto);
+
+	if (cache_size) {
+		/* Round up to a power of two so the hash can be masked */
+		while (size < cache_size)
+			size <<= 1;
+
+		resolver->cache = new0(struct rpa_cache_entry, size);
+		resolver->cache_mask = size - 1;
+	}
+
+	return resolver;
+}
+
+void bt_crypto_resolver_free(struct bt_crypto_resolver *resolver)
+{
+	if (!resolver)
+		return;
+
+	free(resolver->cache);
+	free(resolver->keys);
+	free(resolver->irks);
+	bt_crypto_unref(resolver->crypto);
+	free(resolver);
+}
+
+static void resolver_invalidate(struct bt_crypto_resolver *resolver)
+{
+	if (resolver->cache)
+		memset(resolver->cache, 0, (resolver->cache_mask + 1) *
+					sizeof(struct rpa_cache_entry));
+}
+
+bool bt_crypto_resolver_add(struct bt_crypto_resolver *resolver,
+				const uint8_t irk[16], void *user_data)
+{
+	uint8_t key_msb[16];
+
+	if (!resolver || !user_data)
+		return false;
+
+	if (resolver->num_irks == resolver->max_irks) {
+		size_t max = resolver->max_irks ? resolver->max_irks * 2 : 16;
+		void *irks, *keys;
+
+		irks = reallocarray(resolver->irks, max,
+						sizeof(struct resolver_irk));
+		if (!irks)
+			return false;
+
+		resolver->irks = irks;
+
+		keys = reallocarray(resolver->keys, max,
+						sizeof(struct aes_key));
+		if (!keys)
+			return false;
+
+		resolver->keys = keys;
+		resolver->max_irks = max;
+	}
+
+	memcpy(resolver->irks[resolver->num_irks].val, irk, 16);
+	resolver->irks[resolver->num_irks].user_data = user_data;
+
+	/* The most significant octet of key corresponds to key[0] */
+	swap_buf(irk, key_msb, 16);
+	aes_expand_key(key_msb, &resolver->keys[resolver->num_irks]);
+
+	resolver->num_irks++;
+
+	/* A new IRK may resolve addresses cached as unresolvable */
+	resolver_invalidate(resolver);
+
+	return true;
+}
+
+bool bt_crypto_resolver_remove(struct bt_crypto_resolver *resolver,
+							void *user_data)
+{
+	size_t i, j;
+
+	if (!resolver)
+		return false;
+
+	for (i = 0, j = 0; i < resolver->num_irks; i++) {
+		if (resolver->irks[i].user_data == user_data)
+			continue;
+
+		if (i != j) {
+			resolver->irks[j] = resolver->irks[i];
+			resolver->keys[j] = resolver->keys[i];
+		}
+
+		j++;
+	}
+
+	if (j == resolver->num_irks)
+		return false;
+
+	resolver->num_irks = j;
+	resolver_invalidate(resolver);
+
+	return true;
+}
+
+size_t bt_crypto_resolver_get_count(struct bt_crypto_resolver *resolver)
+{
+	if (!resolver)
+		return 0;
+
+	return resolver->num_irks;
+}
+
+static void *resolver_lookup(struct bt_crypto_resolver *resolver,
+							const uint8_t rpa[6])
+{
+	struct bt_crypto *crypto = resolver->crypto;
+	uint8_t out[RESOLVE_BATCH][16];
+	uint8_t in[16];
+	size_t i, j, count;
+
+	/* AF_ALG has no access to the key schedules, use one op per IRK */
+	if (crypto->ops != &soft_ops) {
+		uint8_t hash[3];
+
+		for (i = 0; i < resolver->num_irks; i++) {
+			if (!bt_crypto_ah(crypto, resolver->irks[i].val,
+							rpa + 3, hash))
+				return NULL;
+
+			if (!memcmp(hash, rpa, 3))
+				return resolver->irks[i].user_data;
+		}
+
+		return NULL;
+	}
+
+	/*
+	 * r' = padding || prand, with the most significant octet first as
+	 * expected by the block cipher, see bt_crypto_ah.
+	 */
+	memset(in, 0, 13);
+	in[13] = rpa[5];
+	in[14] = rpa[4];
+	in[15] = rpa[3];
+
+	for (i = 0; i < resolver->num_irks; i += count) {
+		count = MIN(resolver->num_irks - i, RESOLVE_BATCH);
+
+		crypto->aes_encrypt_multi(&resolver->keys[i], count, in, out);
+
+		/* hash = e(k, r') mod 2^24, least significant octet first */
+		for (j = 0; j < count; j++) {
+			if (out[j][15] == rpa[0] && out[j][14] == rpa[1] &&
+							out[j][13] == rpa[2])
+				return resolver->irks[i + j].user_data;
+		}
+	}
+
+	return NULL;
+}
+
+void *bt_crypto_resolver_resolve(struct bt_crypto_resolver *resolver,
+							const uint8_t rpa[6])
+{
+	struct rpa_cache_entry *entry = NULL;
+	void *user_data;
+
+	if (!resolver || !resolver->num_irks)
+		return NULL;
+
+	if (resolver->cache) {
+		/* The hash and prand parts of an RPA are already random */
+		entry = &resolver->cache[get_le32(rpa) & resolver->cache_mask];
+
+		if (entry->valid && !memcmp(entry->rpa, rpa, 6))
+			return entry->user_data;
+	}
+
+	user_data = resolver_lookup(resolver, rpa);
+
+	if (entry) {
+		memcpy(entry->rpa, rpa, 6);
+		entry->valid = true;
+		entry->user_data = user_data;
+	}
+
+	return user_data;
+}
+
 typedef struct {
 	uint64_t a, b;
 } u128;
@@ -589,31 +1310,15 @@ bool bt_crypto_s1(struct bt_crypto *crypto, const uint8_t k[16],
 static bool aes_cmac_be(struct bt_crypto *crypto, const uint8_t key[16],
 			const uint8_t *msg, size_t msg_len, uint8_t res[16])
 {
-	ssize_t len;
-	int fd;
+	struct iovec iov;
 
 	if (msg_len > CMAC_MSG_MAX)
 		return false;
 
-	fd = alg_new(crypto->cmac_aes, key, 16);
-	if (fd < 0)
-		return false;
+	iov.iov_base = (void *) msg;
+	iov.iov_len = msg_len;
 
-	len = send(fd, msg, msg_len, 0);
-	if (len < 0) {
-		close(fd);
-		return false;
-	}
-
-	len = read(fd, res, 16);
-	if (len < 0) {
-		close(fd);
-		return false;
-	}
-
-	close(fd);
-
-	return true;
+	return crypto->ops->cmac(crypto, key, &iov, 1, res);
 }
 
 static bool aes_cmac(struct bt_crypto *crypto, const uint8_t key[16],
@@ -725,31 +1430,11 @@ bool bt_crypto_gatt_hash(struct bt_crypto *crypto, struct iovec *iov,
 				size_t iov_len, uint8_t res[16])
 {
 	const uint8_t key[16] = {};
-	ssize_t len;
-	int fd;
 
 	if (!crypto)
 		return false;
 
-	fd = alg_new(crypto->cmac_aes, key, 16);
-	if (fd < 0)
-		return false;
-
-	len = writev(fd, iov, iov_len);
-	if (len < 0) {
-		close(fd);
-		return false;
-	}
-
-	len = read(fd, res, 16);
-	if (len < 0) {
-		close(fd);
-		return false;
-	}
-
-	close(fd);
-
-	return true;
+	return crypto->ops->cmac(crypto, key, iov, iov_len, res);
 }
 
 /*
@@ -13,8 +13,17 @@
 #include <sys/uio.h>
 
 struct bt_crypto;
+struct bt_crypto_resolver;
+
+enum bt_crypto_backend {
+	BT_CRYPTO_BACKEND_DEFAULT,	/* CPU, else AF_ALG, else generic */
+	BT_CRYPTO_BACKEND_GENERIC,	/* Userspace, portable C */
+	BT_CRYPTO_BACKEND_AF_ALG,	/* Kernel crypto API sockets */
+};
 
 struct bt_crypto *bt_crypto_new(void);
+struct bt_crypto *bt_crypto_new_backend(enum bt_crypto_backend backend);
+const char *bt_crypto_get_backend(struct bt_crypto *crypto);
 
 struct bt_crypto *bt_crypto_ref(struct bt_crypto *crypto);
 void bt_crypto_unref(struct bt_crypto *crypto);
@@ -26,6 +35,18 @@ bool bt_crypto_e(struct bt_crypto *crypto, const uint8_t key[16],
 			const uint8_t plaintext[16], uint8_t encrypted[16]);
 bool bt_crypto_ah(struct bt_crypto *crypto, const uint8_t k[16],
 					const uint8_t r[3], uint8_t hash[3]);
+
+struct bt_crypto_resolver *bt_crypto_resolver_new(struct bt_crypto *crypto,
+							size_t cache_size);
+void bt_crypto_resolver_free(struct bt_crypto_resolver *resolver);
+bool bt_crypto_resolver_add(struct bt_crypto_resolver *resolver,
+				const uint8_t irk[16], void *user_data);
+bool bt_crypto_resolver_remove(struct bt_crypto_resolver *resolver,
+							void *user_data);
+size_t bt_crypto_resolver_get_count(struct bt_crypto_resolver *resolver);
+void *bt_crypto_resolver_resolve(struct bt_crypto_resolver *resolver,
+							const uint8_t rpa[6]);
+
 bool bt_crypto_c1(struct bt_crypto *crypto, const uint8_t k[16],
 			const uint8_t r[16], const uint8_t pres[7],
 			const uint8_t preq[7], uint8_t iat,
@@ -0,0 +1,742 @@
+// SPDX-License-Identifier: LGPL-2.1-or-later
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2026  agent <agent@local>
+ *
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "bluetooth/bluetooth.h"
+#include "bluetooth/uuid.h"
+#include "src/shared/util.h"
+#include "src/shared/queue.h"
+#include "src/shared/att.h"
+#include "src/shared/gatt-db.h"
+#include "src/shared/gatt-cache.h"
+
+/*
+ * File layout, all values little endian:
+ *
+ *   Header: magic "BZGC", version, flags, reserved (2 octets),
+ *           number of records (4 octets), length of the records
+ *           (4 octets) and Database Hash (16 octets).
+ *
+ *   Record: type, handle (2 octets) followed by:
+ *
+ *     Service:        end handle (2 octets), UUID
+ *     Include:        start handle (2 octets), end handle (2 octets)
+ *     Characteristic: value handle (2 octets), properties, value length,
+ *                     value, UUID
+ *     Descriptor:     value (2 octets), UUID
+ *
+ *   UUID: length (2 or 16) followed by the UUID.
+ *
+ * Records are stored in handle order, each service followed by its
+ * includes, characteristics and descriptors.
+ */
+#define CACHE_MAGIC		"BZGC"
+#define CACHE_HDR_LEN		32
+#define CACHE_FLAG_HASH		0x01
+
+#define CACHE_PRIMARY		0x01
+#define CACHE_SECONDARY		0x02
+#define CACHE_INCLUDE		0x03
+#define CACHE_CHRC		0x04
+#define CACHE_DESC		0x05
+
+struct cache_buf {
+	uint8_t *data;
+	size_t len;
+	size_t size;
+	bool err;
+};
+
+struct cache_saver {
+	struct gatt_db *db;
+	struct cache_buf buf;
+	uint32_t count;
+	uint16_t ext_props;
+	uint8_t hash[16];
+	bool has_hash;
+};
+
+static uint8_t *buf_reserve(struct cache_buf *buf, size_t len)
+{
+	uint8_t *ptr;
+
+	if (buf->err)
+		return NULL;
+
+	if (buf->len + len > buf->size) {
+		size_t size = buf->size ? buf->size * 2 : 512;
+
+		while (size < buf->len + len)
+			size *= 2;
+
+		ptr = realloc(buf->data, size);
+		if (!ptr) {
+			buf->err = true;
+			return NULL;
+		}
+
+		buf->data = ptr;
+		buf->size = size;
+	}
+
+	ptr = buf->data + buf->len;
+	buf->len += len;
+
+	return ptr;
+}
+
+static void buf_put_u8(struct cache_buf *buf, uint8_t val)
+{
+	uint8_t *ptr = buf_reserve(buf, 1);
+
+	if (ptr)
+		*ptr = val;
+}
+
+static void buf_put_le16(struct cache_buf *buf, uint16_t val)
+{
+	uint8_t *ptr = buf_reserve(buf, 2);
+
+	if (ptr)
+		put_le16(val, ptr);
+}
+
+static void buf_put_mem(struct cache_buf *buf, const void *data, size_t len)
+{
+	uint8_t *ptr = buf_reserve(buf, len);
+
+	if (ptr)
+		memcpy(ptr, data, len);
+}
+
+static void buf_put_uuid(struct cache_buf *buf, const bt_uuid_t *uuid)
+{
+	uint8_t *ptr;
+
+	if (uuid->type == BT_UUID16) {
+		buf_put_u8(buf, 2);
+		buf_put_le16(buf, uuid->value.u16);
+		return;
+	}
+
+	buf_put_u8(buf, 16);
+
+	ptr = buf_reserve(buf, 16);
+	if (ptr)
+		bt_uuid_to_le(uuid, ptr);
+}
+
+static void buf_put_record(struct cache_saver *saver, uint8_t type,
+							uint16_t handle)
+{
+	buf_put_u8(&saver->buf, type);
+	buf_put_le16(&saver->buf, handle);
+	saver->count++;
+}
+
+static void db_hash_read_value_cb(struct gatt_db_attribute *attrib,
+						int err, const uint8_t *value,
+						size_t length, void *user_data)
+{
+	const uint8_t **hash = user_data;
+
+	if (err || (length != 16))
+		return;
+
+	*hash = value;
+}
+
+static void store_desc(struct gatt_db_attribute *attr, void *user_data)
+{
+	struct cache_saver *saver = user_data;
+	const bt_uuid_t *uuid;
+	bt_uuid_t ext_uuid;
+	uint16_t value = 0;
+
+	uuid = gatt_db_attribute_get_type(attr);
+
+	bt_uuid16_create(&ext_uuid, GATT_CHARAC_EXT_PROPER_UUID);
+	if (!bt_uuid_cmp(uuid, &ext_uuid))
+		value = saver->ext_props;
+
+	buf_put_record(saver, CACHE_DESC, gatt_db_attribute_get_handle(attr));
+	buf_put_le16(&saver->buf, value);
+	buf_put_uuid(&saver->buf, uuid);
+}
+
+static void store_chrc(struct gatt_db_attribute *attr, void *user_data)
+{
+	struct cache_saver *saver = user_data;
+	uint16_t handle, value_handle;
+	uint8_t properties;
+	bt_uuid_t uuid, hash_uuid;
+	const uint8_t *hash = NULL;
+
+	if (!gatt_db_attribute_get_char_data(attr, &handle, &value_handle,
+						&properties, &saver->ext_props,
+						&uuid))
+		return;
+
+	/* Store Database Hash value if available */
+	bt_uuid16_create(&hash_uuid, GATT_CHARAC_DB_HASH);
+	if (!bt_uuid_cmp(&uuid, &hash_uuid)) {
+		gatt_db_attribute_read(gatt_db_get_attribute(saver->db,
+								value_handle),
+					0, BT_ATT_OP_READ_REQ, NULL,
+					db_hash_read_value_cb, &hash);
+		if (hash) {
+			memcpy(saver->hash, hash, sizeof(saver->hash));
+			saver->has_hash = true;
+		}
+	}
+
+	buf_put_record(saver, CACHE_CHRC, handle);
+	buf_put_le16(&saver->buf, value_handle);
+	buf_put_u8(&saver->buf, properties);
+	buf_put_u8(&saver->buf, hash ? 16 : 0);
+
+	if (hash)
+		buf_put_mem(&saver->buf, hash, 16);
+
+	buf_put_uuid(&saver->buf, &uuid);
+
+	gatt_db_service_foreach_desc(attr, store_desc, saver);
+}
+
+static void store_incl(struct gatt_db_attribute *attr, void *user_data)
+{
+	struct cache_saver *saver = user_data;
+	uint16_t handle, start, end;
+
+	if (!gatt_db_attribute_get_incl_data(attr, &handle, &start, &end))
+		return;
+
+	buf_put_record(saver, CACHE_INCLUDE, handle);
+	buf_put_le16(&saver->buf, start);
+	buf_put_le16(&saver->buf, end);
+}
+
+static void store_service(struct gatt_db_attribute *attr, void *user_data)
+{
+	struct cache_saver *saver = user_data;
+	uint16_t start, end;
+	bt_uuid_t uuid;
+	bool primary;
+
+	if (!gatt_db_attribute_get_service_data(attr, &start, &end, &primary,
+								&uuid))
+		return;
+
+	buf_put_record(saver, primary ? CACHE_PRIMARY : CACHE_SECONDARY,
+									start);
+	buf_put_le16(&saver->buf, end);
+	buf_put_uuid(&saver->buf, &uuid);
+
+	gatt_db_service_foreach_incl(attr, store_incl, saver);
+	gatt_db_service_foreach_char(attr, store_chrc, saver);
+}
+
+static int write_file(const char *filename, const uint8_t *data, size_t len)
+{
+	char *tmp;
+	ssize_t written;
+	int fd, err = 0;
+
+	if (asprintf(&tmp, "%s.tmp", filename) < 0)
+		return -ENOMEM;
+
+	fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+	if (fd < 0) {
+		err = -errno;
+		goto done;
+	}
+
+	while (len) {
+		written = write(fd, data, len);
+		if (written < 0) {
+			if (errno == EINTR)
+				continue;
+			err = -errno;
+			break;
+		}
+
+		data += written;
+		len -= written;
+	}
+
+	/* Make sure the data is on disk before it replaces the old cache */
+	if (!err && fsync(fd) < 0)
+		err = -errno;
+
+	close(fd);
+
+	/* Replace the old cache only once the new one is complete */
+	if (!err && rename(tmp, filename) < 0)
+		err = -errno;
+
+	if (err)
+		unlink(tmp);
+
+done:
+	free(tmp);
+	return err;
+}
+
+static bool file_matches(const char *filename, const uint8_t *data,
+								size_t len)
+{
+	struct stat st;
+	void *map;
+	bool match;
+	int fd;
+
+	fd = open(filename, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return false;
+
+	if (fstat(fd, &st) < 0 || (size_t) st.st_size != len) {
+		close(fd);
+		return false;
+	}
+
+	map = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if (map == MAP_FAILED)
+		return false;
+
+	match = !memcmp(map, data, len);
+
+	munmap(map, len);
+
+	return match;
+}
+
+int gatt_cache_store(struct gatt_db *db, const char *filename)
+{
+	struct cache_saver saver;
+	uint8_t *hdr;
+	int err;
+
+	if (!db || !filename)
+		return -EINVAL;
+
+	memset(&saver, 0, sizeof(saver));
+	saver.db = db;
+
+	hdr = buf_reserve(&saver.buf, CACHE_HDR_LEN);
+	if (!hdr)
+		return -ENOMEM;
+
+	gatt_db_foreach_service(db, NULL, store_service, &saver);
+
+	if (saver.buf.err) {
+		free(saver.buf.data);
+		return -ENOMEM;
+	}
+
+	hdr = saver.buf.data;
+	memcpy(hdr, CACHE_MAGIC, 4);
+	hdr[4] = GATT_CACHE_VERSION;
+	hdr[5] = saver.has_hash ? CACHE_FLAG_HASH : 0;
+	put_le16(0, hdr + 6);
+	put_le32(saver.count, hdr + 8);
+	put_le32(saver.buf.len - CACHE_HDR_LEN, hdr + 12);
+	memcpy(hdr + 16, saver.hash, sizeof(saver.hash));
+
+	/* Skip the rewrite only if the cache holds exactly the same data, the
+	 * stored Database Hash may be outdated after Service Changed.
+	 */
+	if (file_matches(filename, saver.buf.data, saver.buf.len))
+		err = 0;
+	else
+		err = write_file(filename, saver.buf.data, saver.buf.len);
+
+	free(saver.buf.data);
+
+	return err;
+}
+
+struct cache_reader {
+	const uint8_t *data;
+	size_t len;
+};
+
+static const uint8_t *pull_mem(struct cache_reader *reader, size_t len)
+{
+	const uint8_t *ptr;
+
+	if (reader->len < len)
+		return NULL;
+
+	ptr = reader->data;
+	reader->data += len;
+	reader->len -= len;
+
+	return ptr;
+}
+
+static bool pull_u8(struct cache_reader *reader, uint8_t *val)
+{
+	const uint8_t *ptr = pull_mem(reader, 1);
+
+	if (!ptr)
+		return false;
+
+	*val = *ptr;
+
+	return true;
+}
+
+static bool pull_le16(struct cache_reader *reader, uint16_t *val)
+{
+	const uint8_t *ptr = pull_mem(reader, 2);
+
+	if (!ptr)
+		return false;
+
+	*val = get_le16(ptr);
+
+	return true;
+}
+
+static bool pull_uuid(struct cache_reader *reader, bt_uuid_t *uuid)
+{
+	const uint8_t *ptr;
+	uint128_t u128;
+	uint8_t len;
+
+	if (!pull_u8(reader, &len))
+		return false;
+
+	switch (len) {
+	case 2:
+		ptr = pull_mem(reader, 2);
+		if (!ptr)
+			return false;
+
+		bt_uuid16_create(uuid, get_le16(ptr));
+		return true;
+	case 16:
+		ptr = pull_mem(reader, 16);
+		if (!ptr)
+			return false;
+
+		bswap_128(ptr, &u128);
+		bt_uuid128_create(uuid, u128);
+		return true;
+	}
+
+	return false;
+}
+
+struct cache_record {
+	uint8_t type;
+	uint16_t handle;
+	uint16_t end;			/* Service and include end handle */
+	uint16_t value_handle;		/* Characteristic or include start */
+	uint8_t properties;
+	uint8_t value_len;
+	const uint8_t *value;
+	uint16_t desc_value;
+	bt_uuid_t uuid;
+};
+
+static bool pull_record(struct cache_reader *reader,
+						struct cache_record *rec)
+{
+	if (!pull_u8(reader, &rec->type) || !pull_le16(reader, &rec->handle))
+		return false;
+
+	if (!rec->handle)
+		return false;
+
+	switch (rec->type) {
+	case CACHE_PRIMARY:
+	case CACHE_SECONDARY:
+		return pull_le16(reader, &rec->end) &&
+					rec->end >= rec->handle &&
+					pull_uuid(reader, &rec->uuid);
+	case CACHE_INCLUDE:
+		return pull_le16(reader, &rec->value_handle) &&
+					pull_le16(reader, &rec->end);
+	case CACHE_CHRC:
+		if (!pull_le16(reader, &rec->value_handle) ||
+				!pull_u8(reader, &rec->properties) ||
+				!pull_u8(reader, &rec->value_len))
+			return false;
+
+		rec->value = pull_mem(reader, rec->value_len);
+		if (!rec->value)
+			return false;
+
+		return pull_uuid(reader, &rec->uuid);
+	case CACHE_DESC:
+		return pull_le16(reader, &rec->desc_value) &&
+					pull_uuid(reader, &rec->uuid);
+	}
+
+	return false;
+}
+
+static void load_value_cb(struct gatt_db_attribute *attrib, int err,
+							void *user_data)
+{
+}
+
+static int load_service(struct gatt_db *db, struct cache_record *rec)
+{
+	if (!gatt_db_insert_service(db, rec->handle, &rec->uuid,
+					rec->type == CACHE_PRIMARY,
+					rec->end - rec->handle + 1))
+		return -EIO;
+
+	return 0;
+}
+
+static int load_incl(struct gatt_db *db, struct cache_record *rec,
+					struct gatt_db_attribute *service)
+{
+	struct gatt_db_attribute *att;
+
+	att = gatt_db_get_attribute(db, rec->value_handle);
+	if (!att)
+		return -EIO;
+
+	att = gatt_db_service_insert_included(service, rec->handle, att);
+	if (!att)
+		return -EIO;
+
+	return 0;
+}
+
+static int load_chrc(struct cache_record *rec,
+					struct gatt_db_attribute *service)
+{
+	struct gatt_db_attribute *att;
+
+	att = gatt_db_service_insert_characteristic(service, rec->handle,
+							rec->value_handle,
+							&rec->uuid, 0,
+							rec->properties,
+							NULL, NULL, NULL);
+	if (!att || gatt_db_attribute_get_handle(att) != rec->value_handle)
+		return -EIO;
+
+	if (rec->value_len && !gatt_db_attribute_write(att, 0, rec->value,
+							rec->value_len, 0,
+							NULL, load_value_cb,
+							NULL))
+		return -EIO;
+
+	return 0;
+}
+
+static int load_desc(struct cache_record *rec,
+					struct gatt_db_attribute *service)
+{
+	struct gatt_db_attribute *att;
+	uint8_t value[2];
+	bt_uuid_t ext_uuid;
+
+	/* If it is CEP then it must contain the value */
+	bt_uuid16_create(&ext_uuid, GATT_CHARAC_EXT_PROPER_UUID);
+	if (!bt_uuid_cmp(&rec->uuid, &ext_uuid) && !rec->desc_value)
+		return -EIO;
+
+	att = gatt_db_service_insert_descriptor(service, rec->handle,
+							&rec->uuid, 0,
+							NULL, NULL, NULL);
+	if (!att || gatt_db_attribute_get_handle(att) != rec->handle)
+		return -EIO;
+
+	if (!rec->desc_value)
+		return 0;
+
+	put_le16(rec->desc_value, value);
+
+	if (!gatt_db_attribute_write(att, 0, value, sizeof(value), 0, NULL,
+							load_value_cb, NULL))
+		return -EIO;
+
+	return 0;
+}
+
+static int load_records(struct gatt_db *db, const uint8_t *data, size_t len,
+								uint32_t count)
+{
+	struct gatt_db_attribute *service = NULL;
+	struct cache_reader reader;
+	struct cache_record rec;
+	uint32_t i;
+	int err;
+
+	/* First load service definitions, validating every record */
+	reader.data = data;
+	reader.len = len;
+
+	for (i = 0; i < count; i++) {
+		if (!pull_record(&reader, &rec))
+			return -EIO;
+
+		if (rec.type != CACHE_PRIMARY && rec.type != CACHE_SECONDARY)
+			continue;
+
+		err = load_service(db, &rec);
+		if (err)
+			return err;
+	}
+
+	if (reader.len)
+		return -EIO;
+
+	/* Then fill them with data */
+	reader.data = data;
+	reader.len = len;
+
+	for (i = 0; i < count; i++) {
+		pull_record(&reader, &rec);
+
+		switch (rec.type) {
+		case CACHE_PRIMARY:
+		case CACHE_SECONDARY:
+			if (service)
+				gatt_db_service_set_active(service, true);
+
+			service = gatt_db_get_attribute(db, rec.handle);
+			err = service ? 0 : -EIO;
+			break;
+		case CACHE_INCLUDE:
+			err = service ? load_incl(db, &rec, service) : -EIO;
+			break;
+		case CACHE_CHRC:
+			err = service ? load_chrc(&rec, service) : -EIO;
+			break;
+		default:
+			err = service ? load_desc(&rec, service) : -EIO;
+			break;
+		}
+
+		if (err)
+			return err;
+	}
+
+	if (service)
+		gatt_db_service_set_active(service, true);
+
+	return 0;
+}
+
+static void *map_file(const char *filename, size_t *len)
+{
+	struct stat st;
+	void *data;
+	int fd;
+
+	fd = open(filename, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return NULL;
+
+	if (fstat(fd, &st) < 0 || st.st_size < CACHE_HDR_LEN) {
+		close(fd);
+		errno = EIO;
+		return NULL;
+	}
+
+	data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if (data == MAP_FAILED)
+		return NULL;
+
+	*len = st.st_size;
+
+	return data;
+}
+
+static bool check_header(const uint8_t *data, size_t len)
+{
+	if (memcmp(data, CACHE_MAGIC, 4) || data[4] != GATT_CACHE_VERSION)
+		return false;
+
+	return get_le32(data + 12) == len - CACHE_HDR_LEN;
+}
+
+int gatt_cache_load(struct gatt_db *db, const char *filename)
+{
+	uint8_t *data;
+	size_t len;
+	int err;
+
+	if (!db || !filename)
+		return -EINVAL;
+
+	data = map_file(filename, &len);
+	if (!data)
+		return errno == ENOENT ? -ENOENT : -EIO;
+
+	if (!check_header(data, len)) {
+		err = -EIO;
+		goto done;
+	}
+
+	err = load_records(db, data + CACHE_HDR_LEN, len - CACHE_HDR_LEN,
+							get_le32(data + 8));
+	if (err)
+		gatt_db_clear(db);
+
+done:
+	munmap(data, len);
+
+	/* Drop a corrupted cache so the next store does not skip it */
+	if (err)
+		unlink(filename);
+
+	return err;
+}
+
+int gatt_cache_get_hash(const char *filename, uint8_t hash[16])
+{
+	uint8_t hdr[CACHE_HDR_LEN];
+	ssize_t len;
+	int fd;
+
+	if (!filename || !hash)
+		return -EINVAL;
+
+	fd = open(filename, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return -errno;
+
+	len = read(fd, hdr, sizeof(hdr));
+	close(fd);
+
+	if (len != sizeof(hdr) || memcmp(hdr, CACHE_MAGIC, 4) ||
+				hdr[4] != GATT_CACHE_VERSION ||
+				!(hdr[5] & CACHE_FLAG_HASH))
+		return -ENOENT;
+
+	memcpy(hash, hdr + 16, 16);
+
+	return 0;
+}
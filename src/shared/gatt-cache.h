@@ -0,0 +1,20 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2026  agent <agent@local>
+ *
+ *
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define GATT_CACHE_VERSION	0x01
+
+struct gatt_db;
+
+int gatt_cache_store(struct gatt_db *db, const char *filename);
+int gatt_cache_load(struct gatt_db *db, const char *filename);
+int gatt_cache_get_hash(const char *filename, uint8_t hash[16]);
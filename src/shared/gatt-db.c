@@ -13,6 +13,8 @@
 #endif
 
 #include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
 #include <errno.h>
 
 #include "bluetooth/bluetooth.h"
@@ -32,6 +34,8 @@
 #define MAX_INCLUDED_VALUE_LEN 6
 #define ATTRIBUTE_TIMEOUT 5000
 #define HASH_UPDATE_TIMEOUT 100
+#define HASH_UPDATE_MAX_DEFER 10
+#define TYPE_INDEX_MIN_LOOKUPS 2
 
 static const bt_uuid_t primary_service_uuid = { .type = BT_UUID16,
 					.value.u16 = GATT_PRIM_SVC_UUID };
@@ -58,9 +62,20 @@ struct gatt_db {
 	struct bt_crypto *crypto;
 	uint8_t hash[16];
 	unsigned int hash_id;
+	unsigned int hash_defer;
+	bool hash_stale;
 	uint16_t last_handle;
 	struct queue *services;
 
+	struct gatt_db_service **index;	/* Services sorted by handle */
+	unsigned int index_len;
+	unsigned int index_size;
+
+	struct type_entry *types;	/* Attributes sorted by type, handle */
+	unsigned int types_len;
+	unsigned int types_lookups;
+	unsigned int types_gen;
+
 	struct queue *notify_list;
 	unsigned int next_notify_id;
 
@@ -131,8 +146,130 @@ struct gatt_db_service {
 	bool claimed;
 	uint16_t num_handles;
 	struct gatt_db_attribute **attributes;
+
+	/* Database Hash input of the service, regenerated once changed */
+	uint8_t *hash_data;
+	size_t hash_len;
+	bool hash_valid;
+};
+
+struct type_entry {
+	uint128_t uuid;
+	struct gatt_db_attribute *attrib;
 };
 
+static void service_hash_invalidate(struct gatt_db_service *service)
+{
+	service->hash_valid = false;
+
+	if (service->db)
+		service->db->hash_stale = true;
+}
+
+static void types_invalidate(struct gatt_db *db)
+{
+	free(db->types);
+	db->types = NULL;
+	db->types_len = 0;
+	db->types_lookups = 0;
+	db->types_gen++;
+}
+
+static void gatt_db_service_get_handles(const struct gatt_db_service *service,
+							uint16_t *start_handle,
+							uint16_t *end_handle)
+{
+	if (start_handle)
+		*start_handle = service->attributes[0]->handle;
+
+	if (end_handle)
+		*end_handle = service->attributes[0]->handle +
+						service->num_handles - 1;
+}
+
+/* Returns the position of the first service ending at or after handle */
+static unsigned int index_search(struct gatt_db *db, uint16_t handle)
+{
+	unsigned int low = 0, high = db->index_len;
+
+	while (low < high) {
+		unsigned int mid = low + (high - low) / 2;
+		uint16_t end;
+
+		gatt_db_service_get_handles(db->index[mid], NULL, &end);
+
+		if (end < handle)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	return low;
+}
+
+static struct gatt_db_service *index_lookup(struct gatt_db *db,
+							uint16_t handle)
+{
+	unsigned int pos;
+	uint16_t start;
+
+	pos = index_search(db, handle);
+	if (pos == db->index_len)
+		return NULL;
+
+	gatt_db_service_get_handles(db->index[pos], &start, NULL);
+	if (start > handle)
+		return NULL;
+
+	return db->index[pos];
+}
+
+static bool index_insert(struct gatt_db *db, unsigned int pos,
+					struct gatt_db_service *service)
+{
+	if (db->index_len == db->index_size) {
+		struct gatt_db_service **index;
+		unsigned int size = db->index_size ? db->index_size * 2 : 16;
+
+		index = realloc(db->index, size * sizeof(*index));
+		if (!index)
+			return false;
+
+		db->index = index;
+		db->index_size = size;
+	}
+
+	memmove(&db->index[pos + 1], &db->index[pos],
+			(db->index_len - pos) * sizeof(*db->index));
+	db->index[pos] = service;
+	db->index_len++;
+
+	types_invalidate(db);
+	db->hash_stale = true;
+
+	return true;
+}
+
+static void index_remove(struct gatt_db *db, struct gatt_db_service *service)
+{
+	unsigned int pos;
+	uint16_t start;
+
+	gatt_db_service_get_handles(service, &start, NULL);
+
+	pos = index_search(db, start);
+	if (pos == db->index_len || db->index[pos] != service)
+		return;
+
+	db->index_len--;
+	memmove(&db->index[pos], &db->index[pos + 1],
+			(db->index_len - pos) * sizeof(*db->index));
+
+	types_invalidate(db);
+	db->hash_stale = true;
+}
+
+
 static void set_attribute_data(struct gatt_db_attribute *attribute,
 						gatt_db_read_t read_func,
 						gatt_db_write_t write_func,
@@ -214,6 +351,11 @@ static struct gatt_db_attribute *new_attribute(struct gatt_db_service *service,
 
 	attribute = new0(struct gatt_db_attribute, 1);
 
+	if (service->db)
+		types_invalidate(service->db);
+
+	service_hash_invalidate(service);
+
 	attribute->service = service;
 	attribute->handle = handle;
 	attribute->uuid = *type;
@@ -260,6 +402,8 @@ struct gatt_db *gatt_db_new(void)
 	return gatt_db_ref(db);
 }
 
+static void gatt_db_service_destroy(void *data);
+
 static void service_clone(void *data, void *user_data)
 {
 	struct gatt_db_service *service = data;
@@ -315,6 +459,12 @@ static void service_clone(void *data, void *user_data)
 		}
 	}
 
+	/* Services are cloned in order so they are appended to the index */
+	if (!index_insert(db, db->index_len, clone)) {
+		gatt_db_service_destroy(clone);
+		return;
+	}
+
 	queue_push_tail(db->services, clone);
 }
 
@@ -369,89 +519,133 @@ static void handle_notify(void *data, void *user_data)
 		notify->service_removed(notify_data->attr, notify->user_data);
 }
 
-struct hash_data {
-	struct iovec *iov;
-	uint16_t i;
-};
-
-static void gen_hash_m(struct gatt_db_attribute *attr, void *user_data)
+static size_t attribute_hash_len(const struct gatt_db_attribute *attr)
 {
-	struct hash_data *hash = user_data;
-	uint8_t *data;
-	size_t len;
-
 	if (!attr || !attr->value)
-		return;
+		return 0;
 
 	if (bt_uuid_len(&attr->uuid) != 2)
-		return;
+		return 0;
 
 	switch (attr->uuid.value.u16) {
 	case GATT_PRIM_SVC_UUID:
 	case GATT_SND_SVC_UUID:
 	case GATT_INCLUDE_UUID:
 	case GATT_CHARAC_UUID:
-		/* Allocate space for handle + type + value */
-		len = 2 + 2 + attr->value_len;
-		data = malloc(2 + 2 + attr->value_len);
-		put_le16(attr->handle, data);
-		bt_uuid_to_le(&attr->uuid, data + 2);
-		memcpy(data + 4, attr->value, attr->value_len);
-		break;
+		/* Handle + type + value */
+		return 2 + 2 + attr->value_len;
 	case GATT_CHARAC_USER_DESC_UUID:
 	case GATT_CLIENT_CHARAC_CFG_UUID:
 	case GATT_SERVER_CHARAC_CFG_UUID:
 	case GATT_CHARAC_FMT_UUID:
 	case GATT_CHARAC_AGREG_FMT_UUID:
-		/* Allocate space for handle + type  */
-		len = 2 + 2;
-		data = malloc(2 + 2 + attr->value_len);
-		put_le16(attr->handle, data);
-		bt_uuid_to_le(&attr->uuid, data + 2);
-		break;
+		/* Handle + type */
+		return 2 + 2;
 	default:
+		return 0;
+	}
+}
+
+static void service_hash_update(struct gatt_db_service *service)
+{
+	uint8_t *data;
+	size_t len = 0;
+	int i;
+
+	if (service->hash_valid)
 		return;
+
+	for (i = 0; i < service->num_handles; i++)
+		len += attribute_hash_len(service->attributes[i]);
+
+	free(service->hash_data);
+	service->hash_data = NULL;
+	service->hash_len = 0;
+
+	if (len) {
+		service->hash_data = malloc(len);
+		if (!service->hash_data)
+			return;
 	}
 
-	hash->iov[hash->i].iov_base = data;
-	hash->iov[hash->i].iov_len = len;
+	data = service->hash_data;
 
-	hash->i++;
+	for (i = 0; i < service->num_handles; i++) {
+		struct gatt_db_attribute *attr = service->attributes[i];
 
-	return;
-}
+		len = attribute_hash_len(attr);
+		if (!len)
+			continue;
 
-static void service_gen_hash_m(struct gatt_db_attribute *attr, void *user_data)
-{
-	gatt_db_service_foreach(attr, NULL, gen_hash_m, user_data);
+		put_le16(attr->handle, data);
+		bt_uuid_to_le(&attr->uuid, data + 2);
+		memcpy(data + 4, attr->value, len - 4);
+
+		data += len;
+		service->hash_len += len;
+	}
+
+	service->hash_valid = true;
 }
 
 static bool db_hash_update(void *user_data)
 {
 	struct gatt_db *db = user_data;
-	struct hash_data hash;
-	uint16_t i;
+	struct iovec *iov;
+	unsigned int i, count = 0;
 
 	db->hash_id = 0;
+	db->hash_defer = 0;
+	db->hash_stale = false;
 
 	if (gatt_db_isempty(db) || !db->last_handle)
 		return false;
 
-	hash.iov = new0(struct iovec, db->last_handle + 1);
-	hash.i = 0;
+	iov = new0(struct iovec, db->index_len);
 
-	gatt_db_foreach_service(db, NULL, service_gen_hash_m, &hash);
-	bt_crypto_gatt_hash(db->crypto, hash.iov, db->last_handle + 1,
-				db->hash);
+	/* Only services that have changed regenerate their input */
+	for (i = 0; i < db->index_len; i++) {
+		struct gatt_db_service *service = db->index[i];
 
-	for (i = 0; i < hash.i; i++)
-		free(hash.iov[i].iov_base);
+		if (!service->active)
+			continue;
 
-	free(hash.iov);
+		service_hash_update(service);
+		if (!service->hash_len)
+			continue;
+
+		iov[count].iov_base = service->hash_data;
+		iov[count].iov_len = service->hash_len;
+		count++;
+	}
+
+	bt_crypto_gatt_hash(db->crypto, iov, count, db->hash);
+
+	free(iov);
 
 	return false;
 }
 
+static void db_hash_schedule(struct gatt_db *db)
+{
+	if (!db->crypto)
+		return;
+
+	/* Restart the timer on every change so a burst of changes results in
+	 * a single update, up to HASH_UPDATE_MAX_DEFER times.
+	 */
+	if (db->hash_id) {
+		if (db->hash_defer >= HASH_UPDATE_MAX_DEFER)
+			return;
+
+		timeout_remove(db->hash_id);
+		db->hash_defer++;
+	}
+
+	db->hash_id = timeout_add(HASH_UPDATE_TIMEOUT, db_hash_update, db,
+									NULL);
+}
+
 static void handle_attribute_notify(void *data, void *user_data)
 {
 	struct attribute_notify *notify = data;
@@ -495,9 +689,7 @@ static void notify_service_changed(struct gatt_db *db,
 	queue_foreach(db->notify_list, handle_notify, &data);
 
 	/* Trigger hash update */
-	if (!db->hash_id && db->crypto)
-		db->hash_id = timeout_add(HASH_UPDATE_TIMEOUT, db_hash_update,
-								db, NULL);
+	db_hash_schedule(db);
 
 	gatt_db_unref(db);
 }
@@ -513,6 +705,7 @@ static void gatt_db_service_destroy(void *data)
 	for (i = 0; i < service->num_handles; i++)
 		attribute_destroy(service->attributes[i]);
 
+	free(service->hash_data);
 	free(service->attributes);
 	free(service);
 }
@@ -534,7 +727,11 @@ static void gatt_db_destroy(struct gatt_db *db)
 	if (db->hash_id)
 		timeout_remove(db->hash_id);
 
+	db->index_len = 0;
+	types_invalidate(db);
+
 	queue_destroy(db->services, gatt_db_service_destroy);
+	free(db->index);
 	free(db->ccc);
 	free(db);
 }
@@ -642,27 +839,26 @@ bool gatt_db_remove_service(struct gatt_db *db,
 	service = attrib->service;
 
 	queue_remove(db->services, service);
+	index_remove(db, service);
 
 	gatt_db_service_destroy(service);
 
 	return true;
 }
 
-bool gatt_db_clear(struct gatt_db *db)
+static void service_remove(void *data)
 {
-	return gatt_db_clear_range(db, 1, UINT16_MAX);
+	struct gatt_db_service *service = data;
+
+	/* Remove from the index before service_removed is notified */
+	index_remove(service->db, service);
+
+	gatt_db_service_destroy(service);
 }
 
-static void gatt_db_service_get_handles(const struct gatt_db_service *service,
-							uint16_t *start_handle,
-							uint16_t *end_handle)
+bool gatt_db_clear(struct gatt_db *db)
 {
-	if (start_handle)
-		*start_handle = service->attributes[0]->handle;
-
-	if (end_handle)
-		*end_handle = service->attributes[0]->handle +
-						service->num_handles - 1;
+	return gatt_db_clear_range(db, 1, UINT16_MAX);
 }
 
 struct clear_range {
@@ -690,6 +886,8 @@ bool gatt_db_clear_range(struct gatt_db *db, uint16_t start_handle,
 
 	/* Check if it is a full clear */
 	if (start_handle == 1 && end_handle == UINT16_MAX) {
+		db->index_len = 0;
+		types_invalidate(db);
 		queue_remove_all(db->services, NULL, NULL,
 						gatt_db_service_destroy);
 		goto done;
@@ -698,8 +896,7 @@ bool gatt_db_clear_range(struct gatt_db *db, uint16_t start_handle,
 	range.start = start_handle;
 	range.end = end_handle;
 
-	queue_remove_all(db->services, match_range, &range,
-						gatt_db_service_destroy);
+	queue_remove_all(db->services, match_range, &range, service_remove);
 
 done:
 	if (gatt_db_isempty(db))
@@ -715,8 +912,8 @@ uint8_t *gatt_db_get_hash(struct gatt_db *db)
 	if (!db || !db->crypto)
 		return NULL;
 
-	/* Generate hash if if has not been generated yet */
-	if (db->hash_id || !memcmp(db->hash, hash, 16)) {
+	/* Generate hash if it has not been generated or is out of date */
+	if (db->hash_id || db->hash_stale || !memcmp(db->hash, hash, 16)) {
 		timeout_remove(db->hash_id);
 		db_hash_update(db);
 	}
@@ -734,35 +931,29 @@ bool gatt_db_hash_support(struct gatt_db *db)
 
 static struct gatt_db_service *find_insert_loc(struct gatt_db *db,
 						uint16_t start, uint16_t end,
-						struct gatt_db_service **after)
+						struct gatt_db_service **after,
+						unsigned int *pos)
 {
-	const struct queue_entry *services_entry;
 	struct gatt_db_service *service;
-	uint16_t cur_start, cur_end;
-
-	*after = NULL;
-
-	services_entry = queue_get_entries(db->services);
+	uint16_t cur_start;
 
-	while (services_entry) {
-		service = services_entry->data;
+	*pos = index_search(db, start);
+	*after = *pos ? db->index[*pos - 1] : NULL;
 
-		gatt_db_service_get_handles(service, &cur_start, &cur_end);
-
-		if (start >= cur_start && start <= cur_end)
-			return service;
+	if (*pos == db->index_len)
+		return NULL;
 
-		if (end >= cur_start && end <= cur_end)
-			return service;
+	service = db->index[*pos];
 
-		if (end < cur_start)
-			return NULL;
+	gatt_db_service_get_handles(service, &cur_start, NULL);
 
-		*after = service;
-		services_entry = services_entry->next;
-	}
+	/* The first service ending at or after start overlaps the range
+	 * unless it starts after its end.
+	 */
+	if (end < cur_start)
+		return NULL;
 
-	return NULL;
+	return service;
 }
 
 struct gatt_db_attribute *gatt_db_insert_service(struct gatt_db *db,
@@ -772,6 +963,7 @@ struct gatt_db_attribute *gatt_db_insert_service(struct gatt_db *db,
 							uint16_t num_handles)
 {
 	struct gatt_db_service *service, *after;
+	unsigned int pos;
 
 	after = NULL;
 
@@ -784,7 +976,8 @@ struct gatt_db_attribute *gatt_db_insert_service(struct gatt_db *db,
 	if (num_handles < 1 || (handle + num_handles - 1) > UINT16_MAX)
 		return NULL;
 
-	service = find_insert_loc(db, handle, handle + num_handles - 1, &after);
+	service = find_insert_loc(db, handle, handle + num_handles - 1, &after,
+									&pos);
 	if (service) {
 		const bt_uuid_t *type;
 		bt_uuid_t value;
@@ -826,6 +1019,11 @@ struct gatt_db_attribute *gatt_db_insert_service(struct gatt_db *db,
 	service->attributes[0]->handle = handle;
 	service->num_handles = num_handles;
 
+	if (!index_insert(db, pos, service)) {
+		queue_remove(db->services, service);
+		goto fail;
+	}
+
 	/* Fast-forward last_handle if the new service was added to the end */
 	db->last_handle = MAX(handle + num_handles - 1, db->last_handle);
 
@@ -1440,6 +1638,7 @@ bool gatt_db_service_set_active(struct gatt_db_attribute *attrib, bool active)
 		return true;
 
 	service->active = active;
+	service->db->hash_stale = true;
 
 	notify_service_changed(service->db, service, active);
 
@@ -1634,7 +1833,7 @@ static void foreach_service_in_range(void *data, void *user_data)
 	foreach_data->func(service->attributes[0], foreach_data->user_data);
 }
 
-static void foreach_in_range(void *data, void *user_data)
+static void foreach_in_service(void *data, void *user_data)
 {
 	struct gatt_db_service *service = data;
 	struct foreach_data *foreach_data = user_data;
@@ -1657,7 +1856,12 @@ static void foreach_in_range(void *data, void *user_data)
 		return foreach_service_in_range(data, user_data);
 	}
 
-	for (i = 0; i < service->num_handles; i++) {
+	/* Attributes are stored at their offset from the service handle */
+	i = 0;
+	if (foreach_data->start > svc_start)
+		i = foreach_data->start - svc_start;
+
+	for (; i < service->num_handles; i++) {
 		struct gatt_db_attribute *attribute = service->attributes[i];
 
 		if (!attribute)
@@ -1677,6 +1881,165 @@ static void foreach_in_range(void *data, void *user_data)
 	}
 }
 
+static void foreach_in_range(struct gatt_db *db, struct foreach_data *data)
+{
+	unsigned int pos;
+	uint16_t svc_start, svc_end;
+
+	/* Look the next service up on each iteration as callbacks may add or
+	 * remove services.
+	 */
+	for (pos = index_search(db, data->start); pos < db->index_len;
+					pos = index_search(db, svc_end + 1)) {
+		struct gatt_db_service *service = db->index[pos];
+
+		gatt_db_service_get_handles(service, &svc_start, &svc_end);
+
+		if (svc_start > data->end)
+			return;
+
+		foreach_in_service(service, data);
+
+		if (svc_end >= data->end)
+			return;
+	}
+}
+
+static int type_entry_cmp(const void *a, const void *b)
+{
+	const struct type_entry *entry_a = a;
+	const struct type_entry *entry_b = b;
+	int ret;
+
+	ret = memcmp(&entry_a->uuid, &entry_b->uuid, sizeof(entry_a->uuid));
+	if (ret)
+		return ret;
+
+	return entry_a->attrib->handle - entry_b->attrib->handle;
+}
+
+static bool types_build(struct gatt_db *db)
+{
+	unsigned int i, len = 0;
+	int j;
+
+	for (i = 0; i < db->index_len; i++) {
+		struct gatt_db_service *service = db->index[i];
+
+		for (j = 0; j < service->num_handles; j++) {
+			if (service->attributes[j])
+				len++;
+		}
+	}
+
+	if (!len)
+		return false;
+
+	db->types = new0(struct type_entry, len);
+	db->types_len = len;
+
+	len = 0;
+
+	for (i = 0; i < db->index_len; i++) {
+		struct gatt_db_service *service = db->index[i];
+
+		for (j = 0; j < service->num_handles; j++) {
+			struct gatt_db_attribute *attrib;
+			bt_uuid_t uuid;
+
+			attrib = service->attributes[j];
+			if (!attrib)
+				continue;
+
+			bt_uuid_to_uuid128(&attrib->uuid, &uuid);
+			db->types[len].uuid = uuid.value.u128;
+			db->types[len].attrib = attrib;
+			len++;
+		}
+	}
+
+	qsort(db->types, db->types_len, sizeof(*db->types), type_entry_cmp);
+
+	return true;
+}
+
+/* Returns the position of the first attribute of type at or after handle */
+static unsigned int types_search(struct gatt_db *db, const uint128_t *uuid,
+							uint16_t handle)
+{
+	unsigned int low = 0, high = db->types_len;
+
+	while (low < high) {
+		unsigned int mid = low + (high - low) / 2;
+		struct type_entry *entry = &db->types[mid];
+		int ret;
+
+		ret = memcmp(&entry->uuid, uuid, sizeof(*uuid));
+		if (!ret)
+			ret = entry->attrib->handle < handle ? -1 : 1;
+
+		if (ret < 0)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	return low;
+}
+
+/* Walks the attributes of a given type using the type index, returns false
+ * with data->start updated if the range still needs to be walked.
+ */
+static bool foreach_type_in_range(struct gatt_db *db,
+						struct foreach_data *data)
+{
+	bt_uuid_t uuid;
+	unsigned int pos, gen;
+
+	/* Only build the index once lookups are not interleaved with changes
+	 * to the database, e.g. while a remote database is being discovered.
+	 */
+	if (!db->types) {
+		if (++db->types_lookups < TYPE_INDEX_MIN_LOOKUPS)
+			return false;
+
+		if (!types_build(db))
+			return true;
+	}
+
+	bt_uuid_to_uuid128(data->uuid, &uuid);
+	gen = db->types_gen;
+
+	for (pos = types_search(db, &uuid.value.u128, data->start);
+					pos < db->types_len; pos++) {
+		struct type_entry *entry = &db->types[pos];
+		struct gatt_db_attribute *attrib = entry->attrib;
+		uint16_t handle = attrib->handle;
+
+		if (memcmp(&entry->uuid, &uuid.value.u128, sizeof(entry->uuid)))
+			return true;
+
+		if (handle > data->end)
+			return true;
+
+		if (!attrib->service->active)
+			continue;
+
+		data->func(attrib, data->user_data);
+
+		/* Continue with a range walk if the database has changed */
+		if (db->types_gen != gen) {
+			if (handle >= data->end)
+				return true;
+
+			data->start = handle + 1;
+			return false;
+		}
+	}
+
+	return true;
+}
+
 void gatt_db_foreach_service_in_range(struct gatt_db *db,
 						const bt_uuid_t *uuid,
 						gatt_db_attribute_cb_t func,
@@ -1696,7 +2059,7 @@ void gatt_db_foreach_service_in_range(struct gatt_db *db,
 	data.end = end_handle;
 	data.attr = false;
 
-	queue_foreach(db->services, foreach_in_range, &data);
+	foreach_in_range(db, &data);
 }
 
 void gatt_db_foreach_in_range(struct gatt_db *db, const bt_uuid_t *uuid,
@@ -1717,7 +2080,10 @@ void gatt_db_foreach_in_range(struct gatt_db *db, const bt_uuid_t *uuid,
 	data.end = end_handle;
 	data.attr = true;
 
-	queue_foreach(db->services, foreach_in_range, &data);
+	if (uuid && foreach_type_in_range(db, &data))
+		return;
+
+	foreach_in_range(db, &data);
 }
 
 void gatt_db_service_foreach(struct gatt_db_attribute *attrib,
@@ -1841,17 +2207,6 @@ void gatt_db_service_foreach_incl(struct gatt_db_attribute *attrib,
 								user_data);
 }
 
-static bool find_service_for_handle(const void *data, const void *user_data)
-{
-	const struct gatt_db_service *service = data;
-	uint16_t handle = PTR_TO_UINT(user_data);
-	uint16_t start, end;
-
-	gatt_db_service_get_handles(service, &start, &end);
-
-	return (start <= handle) && (handle <= end);
-}
-
 struct gatt_db_attribute *gatt_db_get_service(struct gatt_db *db,
 							uint16_t handle)
 {
@@ -1860,8 +2215,7 @@ struct gatt_db_attribute *gatt_db_get_service(struct gatt_db *db,
 	if (!db || !handle)
 		return NULL;
 
-	service = queue_find(db->services, find_service_for_handle,
-						UINT_TO_PTR(handle));
+	service = index_lookup(db, handle);
 	if (!service)
 		return NULL;
 
@@ -1873,7 +2227,6 @@ struct gatt_db_attribute *gatt_db_get_attribute(struct gatt_db *db,
 {
 	struct gatt_db_attribute *attrib;
 	struct gatt_db_service *service;
-	int i;
 
 	attrib = gatt_db_get_service(db, handle);
 	if (!attrib)
@@ -1881,15 +2234,12 @@ struct gatt_db_attribute *gatt_db_get_attribute(struct gatt_db *db,
 
 	service = attrib->service;
 
-	for (i = 0; i < service->num_handles; i++) {
-		if (!service->attributes[i])
-			continue;
-
-		if (service->attributes[i]->handle == handle)
-			return service->attributes[i];
-	}
+	/* Attributes are stored at their offset from the service handle */
+	attrib = service->attributes[handle - attrib->handle];
+	if (!attrib || attrib->handle != handle)
+		return NULL;
 
-	return NULL;
+	return attrib;
 }
 
 static bool find_service_with_uuid(const void *data, const void *user_data)
@@ -2389,6 +2739,8 @@ bool gatt_db_attribute_write(struct gatt_db_attribute *attrib, uint16_t offset,
 
 	memcpy(&attrib->value[offset], value, len);
 
+	service_hash_invalidate(attrib->service);
+
 done:
 	if (func)
 		func(attrib, err, user_data);
@@ -2485,6 +2837,8 @@ bool gatt_db_attribute_reset(struct gatt_db_attribute *attrib)
 	attrib->value = NULL;
 	attrib->value_len = 0;
 
+	service_hash_invalidate(attrib->service);
+
 	return true;
 }
 
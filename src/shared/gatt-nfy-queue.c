@@ -0,0 +1,189 @@
+// SPDX-License-Identifier: LGPL-2.1-or-later
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2026  agent <agent@local>
+ *
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "src/shared/util.h"
+#include "src/shared/queue.h"
+#include "src/shared/gatt-nfy-queue.h"
+
+struct gatt_nfy_queue {
+	uint8_t mode;
+	unsigned int size;		/* Values kept per characteristic */
+	unsigned int dropped;		/* Values dropped or coalesced */
+	struct queue *values;		/* Oldest first */
+};
+
+struct nfy_value {
+	uint16_t handle;
+	uint16_t len;
+	uint8_t value[];
+};
+
+struct nfy_range {
+	uint16_t start;
+	uint16_t end;
+};
+
+struct gatt_nfy_queue *gatt_nfy_queue_new(uint8_t mode, unsigned int size)
+{
+	struct gatt_nfy_queue *queue;
+
+	if (mode > GATT_NFY_QUEUE_FIFO || !size)
+		return NULL;
+
+	queue = new0(struct gatt_nfy_queue, 1);
+	queue->mode = mode;
+	queue->size = mode == GATT_NFY_QUEUE_LATEST ? 1 : size;
+	queue->values = queue_new();
+
+	return queue;
+}
+
+void gatt_nfy_queue_free(struct gatt_nfy_queue *queue)
+{
+	if (!queue)
+		return;
+
+	queue_destroy(queue->values, free);
+	free(queue);
+}
+
+static bool match_handle(const void *data, const void *match_data)
+{
+	const struct nfy_value *nfy = data;
+	uint16_t handle = PTR_TO_UINT(match_data);
+
+	return nfy->handle == handle;
+}
+
+static unsigned int count_handle(struct gatt_nfy_queue *queue,
+							uint16_t handle)
+{
+	const struct queue_entry *entry;
+	unsigned int count = 0;
+
+	for (entry = queue_get_entries(queue->values); entry;
+						entry = entry->next) {
+		struct nfy_value *nfy = entry->data;
+
+		if (nfy->handle == handle)
+			count++;
+	}
+
+	return count;
+}
+
+bool gatt_nfy_queue_push(struct gatt_nfy_queue *queue, uint16_t handle,
+					const uint8_t *value, uint16_t len)
+{
+	struct nfy_value *nfy;
+
+	if (!queue || (len && !value))
+		return false;
+
+	/* Make room by dropping the oldest value of the characteristic, for
+	 * GATT_NFY_QUEUE_LATEST this is the value being replaced.
+	 */
+	if (count_handle(queue, handle) >= queue->size) {
+		free(queue_remove_if(queue->values, match_handle,
+						UINT_TO_PTR(handle)));
+		queue->dropped++;
+	}
+
+	nfy = malloc(sizeof(*nfy) + len);
+	if (!nfy)
+		return false;
+
+	nfy->handle = handle;
+	nfy->len = len;
+
+	if (len)
+		memcpy(nfy->value, value, len);
+
+	return queue_push_tail(queue->values, nfy);
+}
+
+static bool match_range(const void *data, const void *match_data)
+{
+	const struct nfy_value *nfy = data;
+	const struct nfy_range *range = match_data;
+
+	return nfy->handle >= range->start && nfy->handle <= range->end;
+}
+
+void gatt_nfy_queue_remove_range(struct gatt_nfy_queue *queue,
+					uint16_t start, uint16_t end)
+{
+	struct nfy_range range = { start, end };
+
+	if (!queue)
+		return;
+
+	queue_remove_all(queue->values, match_range, &range, free);
+}
+
+unsigned int gatt_nfy_queue_length(struct gatt_nfy_queue *queue)
+{
+	if (!queue)
+		return 0;
+
+	return queue_length(queue->values);
+}
+
+unsigned int gatt_nfy_queue_get_dropped(struct gatt_nfy_queue *queue)
+{
+	if (!queue)
+		return 0;
+
+	return queue->dropped;
+}
+
+void gatt_nfy_queue_foreach(struct gatt_nfy_queue *queue,
+				gatt_nfy_queue_func_t func, void *user_data)
+{
+	const struct queue_entry *entry;
+
+	if (!queue || !func)
+		return;
+
+	for (entry = queue_get_entries(queue->values); entry;
+						entry = entry->next) {
+		struct nfy_value *nfy = entry->data;
+
+		func(nfy->handle, nfy->value, nfy->len, user_data);
+	}
+}
+
+unsigned int gatt_nfy_queue_flush(struct gatt_nfy_queue *queue,
+				gatt_nfy_queue_func_t func, void *user_data)
+{
+	unsigned int count, i;
+
+	if (!queue || !func)
+		return 0;
+
+	/* Values pushed by func are kept for the next flush */
+	count = queue_length(queue->values);
+
+	for (i = 0; i < count; i++) {
+		struct nfy_value *nfy = queue_pop_head(queue->values);
+
+		func(nfy->handle, nfy->value, nfy->len, user_data);
+		free(nfy);
+	}
+
+	return count;
+}
@@ -0,0 +1,38 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2026  agent <agent@local>
+ *
+ *
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Only the latest value of each characteristic is kept */
+#define GATT_NFY_QUEUE_LATEST	0x00
+/* Up to size values of each characteristic are kept, oldest dropped */
+#define GATT_NFY_QUEUE_FIFO	0x01
+
+struct gatt_nfy_queue;
+
+typedef void (*gatt_nfy_queue_func_t)(uint16_t handle, const uint8_t *value,
+					uint16_t len, void *user_data);
+
+struct gatt_nfy_queue *gatt_nfy_queue_new(uint8_t mode, unsigned int size);
+void gatt_nfy_queue_free(struct gatt_nfy_queue *queue);
+
+bool gatt_nfy_queue_push(struct gatt_nfy_queue *queue, uint16_t handle,
+					const uint8_t *value, uint16_t len);
+void gatt_nfy_queue_remove_range(struct gatt_nfy_queue *queue,
+					uint16_t start, uint16_t end);
+
+unsigned int gatt_nfy_queue_length(struct gatt_nfy_queue *queue);
+unsigned int gatt_nfy_queue_get_dropped(struct gatt_nfy_queue *queue);
+
+void gatt_nfy_queue_foreach(struct gatt_nfy_queue *queue,
+				gatt_nfy_queue_func_t func, void *user_data);
+unsigned int gatt_nfy_queue_flush(struct gatt_nfy_queue *queue,
+				gatt_nfy_queue_func_t func, void *user_data);
@@ -1764,22 +1764,34 @@ bool bt_gatt_server_send_notification(struct bt_gatt_server *server,
 					uint16_t length, bool multiple)
 {
 	struct nfy_mult_data *data = NULL;
-	bool result;
+	uint8_t hdr[2];
+	struct iovec iov[2];
 
 	if (!server || (length && !value))
 		return false;
 
-	if (multiple) {
-		data = server->nfy_mult;
+	/* Single notifications are encoded straight into the ATT PDU */
+	if (!multiple) {
+		put_le16(handle, hdr);
 
-		/* flush buffered data if this request hits buffer size limit */
-		if (data && data->offset > 0 &&
-				data->len - data->offset < 4 + length) {
-			notify_multiple_timeout_remove(server);
-			notify_multiple(server);
-			/* data has been freed by notify_multiple */
-			data = NULL;
-		}
+		iov[0].iov_base = hdr;
+		iov[0].iov_len = sizeof(hdr);
+		iov[1].iov_base = (void *) value;
+		iov[1].iov_len = MIN(bt_att_get_mtu(server->att) - 3, length);
+
+		return !!bt_att_send_iov(server->att, BT_ATT_OP_HANDLE_NFY,
+						iov, 2, NULL, NULL, NULL);
+	}
+
+	data = server->nfy_mult;
+
+	/* flush buffered data if this request hits buffer size limit */
+	if (data && data->offset > 0 &&
+			data->len - data->offset < 4 + length) {
+		notify_multiple_timeout_remove(server);
+		notify_multiple(server);
+		/* data has been freed by notify_multiple */
+		data = NULL;
 	}
 
 	if (!data) {
@@ -1791,37 +1803,24 @@ bool bt_gatt_server_send_notification(struct bt_gatt_server *server,
 	if (!notify_append_le16(data, handle))
 		goto error;
 
-	if (multiple) {
-		length = MIN(data->len - data->offset - 2, length);
-		if (!notify_append_le16(data, length))
-			goto error;
-	} else {
-		length = MIN(data->len - data->offset, length);
-	}
+	length = MIN(data->len - data->offset - 2, length);
+	if (!notify_append_le16(data, length))
+		goto error;
 
 	if (value)
 		memcpy(data->pdu + data->offset, value, length);
 
 	data->offset += length;
 
-	if (multiple) {
-		if (!server->nfy_mult)
-			server->nfy_mult = data;
-
-		if (!server->nfy_mult->id)
-			server->nfy_mult->id = timeout_add(NFY_MULT_TIMEOUT,
-						   notify_multiple, server,
-						   NULL);
-
-		return true;
-	}
+	if (!server->nfy_mult)
+		server->nfy_mult = data;
 
-	result = !!bt_att_send(server->att, BT_ATT_OP_HANDLE_NFY,
-				data->pdu, data->offset, NULL, NULL, NULL);
-	free(data->pdu);
-	free(data);
+	if (!server->nfy_mult->id)
+		server->nfy_mult->id = timeout_add(NFY_MULT_TIMEOUT,
+					   notify_multiple, server,
+					   NULL);
 
-	return result;
+	return true;
 
 error:
 	if (data) {
@@ -1832,6 +1831,76 @@ error:
 	return false;
 }
 
+struct bt_gatt_notification {
+	int ref_count;
+	uint16_t len;
+	uint8_t pdu[];			/* Handle followed by the value */
+};
+
+struct bt_gatt_notification *bt_gatt_notification_new(uint16_t handle,
+							const uint8_t *value,
+							uint16_t length)
+{
+	struct bt_gatt_notification *nfy;
+
+	if ((length && !value) || length > UINT16_MAX - 2)
+		return NULL;
+
+	nfy = malloc(sizeof(*nfy) + length + 2);
+	if (!nfy)
+		return NULL;
+
+	nfy->ref_count = 1;
+	nfy->len = length + 2;
+	put_le16(handle, nfy->pdu);
+
+	if (length)
+		memcpy(nfy->pdu + 2, value, length);
+
+	return nfy;
+}
+
+struct bt_gatt_notification *bt_gatt_notification_ref(
+					struct bt_gatt_notification *nfy)
+{
+	if (!nfy)
+		return NULL;
+
+	__sync_fetch_and_add(&nfy->ref_count, 1);
+
+	return nfy;
+}
+
+void bt_gatt_notification_unref(struct bt_gatt_notification *nfy)
+{
+	if (!nfy)
+		return;
+
+	if (__sync_sub_and_fetch(&nfy->ref_count, 1))
+		return;
+
+	free(nfy);
+}
+
+bool bt_gatt_server_send_notification_pdu(struct bt_gatt_server *server,
+					struct bt_gatt_notification *nfy,
+					bool multiple)
+{
+	if (!server || !nfy)
+		return false;
+
+	if (multiple)
+		return bt_gatt_server_send_notification(server,
+						get_le16(nfy->pdu),
+						nfy->pdu + 2, nfy->len - 2,
+						true);
+
+	/* Only the length depends on the server, the PDU is shared */
+	return !!bt_att_send(server->att, BT_ATT_OP_HANDLE_NFY, nfy->pdu,
+				MIN(bt_att_get_mtu(server->att) - 1, nfy->len),
+				NULL, NULL, NULL);
+}
+
 struct ind_data {
 	bt_gatt_server_conf_func_t callback;
 	bt_gatt_server_destroy_func_t destroy;
@@ -1897,6 +1966,33 @@ bool bt_gatt_server_send_indication(struct bt_gatt_server *server,
 	return result;
 }
 
+bool bt_gatt_server_send_indication_pdu(struct bt_gatt_server *server,
+					struct bt_gatt_notification *nfy,
+					bt_gatt_server_conf_func_t callback,
+					void *user_data,
+					bt_gatt_server_destroy_func_t destroy)
+{
+	struct ind_data *data;
+	bool result;
+
+	if (!server || !nfy)
+		return false;
+
+	data = new0(struct ind_data, 1);
+
+	data->callback = callback;
+	data->destroy = destroy;
+	data->user_data = user_data;
+
+	result = !!bt_att_send(server->att, BT_ATT_OP_HANDLE_IND, nfy->pdu,
+				MIN(bt_att_get_mtu(server->att) - 1, nfy->len),
+				conf_cb, data, destroy_ind_data);
+	if (!result)
+		destroy_ind_data(data);
+
+	return result;
+}
+
 bool bt_gatt_server_set_authorize(struct bt_gatt_server *server,
 					bt_gatt_server_authorize_cb_t cb,
 					void *user_data)
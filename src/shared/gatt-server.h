@@ -49,3 +49,22 @@ bool bt_gatt_server_send_indication(struct bt_gatt_server *server,
 					bt_gatt_server_conf_func_t callback,
 					void *user_data,
 					bt_gatt_server_destroy_func_t destroy);
+
+/* Notification encoded once and shared by any number of servers */
+struct bt_gatt_notification;
+
+struct bt_gatt_notification *bt_gatt_notification_new(uint16_t handle,
+							const uint8_t *value,
+							uint16_t length);
+struct bt_gatt_notification *bt_gatt_notification_ref(
+					struct bt_gatt_notification *nfy);
+void bt_gatt_notification_unref(struct bt_gatt_notification *nfy);
+
+bool bt_gatt_server_send_notification_pdu(struct bt_gatt_server *server,
+					struct bt_gatt_notification *nfy,
+					bool multiple);
+bool bt_gatt_server_send_indication_pdu(struct bt_gatt_server *server,
+					struct bt_gatt_notification *nfy,
+					bt_gatt_server_conf_func_t callback,
+					void *user_data,
+					bt_gatt_server_destroy_func_t destroy);
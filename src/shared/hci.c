@@ -35,6 +35,9 @@
 #include "src/shared/hci.h"
 
 
+#define HCI_READ_BATCH		8
+#define HCI_READ_BUDGET		32
+
 struct bt_hci {
 	int ref_count;
 	struct io *io;
@@ -307,12 +310,27 @@ static void process_event(struct bt_hci *hci, const void *data, size_t size)
 	}
 }
 
+static void process_packet(struct bt_hci *hci, const uint8_t *buf,
+								size_t len)
+{
+	if (len < 1)
+		return;
+
+	switch (buf[0]) {
+	case BT_H4_EVT_PKT:
+		process_event(hci, buf + 1, len - 1);
+		break;
+	}
+}
+
 static bool io_read_callback(struct io *io, void *user_data)
 {
 	struct bt_hci *hci = user_data;
-	uint8_t buf[512];
+	uint8_t buf[HCI_READ_BATCH][512];
+	size_t sizes[HCI_READ_BATCH];
+	unsigned int budget = HCI_READ_BUDGET;
 	ssize_t len;
-	int fd;
+	int fd, i, count;
 
 	fd = io_get_fd(hci->io);
 	if (fd < 0)
@@ -321,19 +339,42 @@ static bool io_read_callback(struct io *io, void *user_data)
 	if (hci->is_stream)
 		return false;
 
-	len = read(fd, buf, sizeof(buf));
-	if (len < 0)
-		return false;
+	count = util_recv_batch(fd, buf, sizeof(buf[0]), HCI_READ_BATCH,
+									sizes);
+	if (count == -ENOTSOCK) {
+		len = read(fd, buf[0], sizeof(buf[0]));
+		if (len < 0)
+			return false;
 
-	if (len < 1)
+		sizes[0] = len;
+		count = 1;
+	} else if (count == -EAGAIN || count == -EINTR) {
 		return true;
+	} else if (count < 0) {
+		return false;
+	}
 
-	switch (buf[0]) {
-	case BT_H4_EVT_PKT:
-		process_event(hci, buf + 1, len - 1);
-		break;
+	bt_hci_ref(hci);
+
+	/* Drain pending packets, up to a budget to keep other fds served */
+	while (1) {
+		for (i = 0; i < count && hci->ref_count > 1; i++)
+			process_packet(hci, buf[i], sizes[i]);
+
+		budget -= count;
+
+		if (count < HCI_READ_BATCH || budget < HCI_READ_BATCH ||
+						hci->ref_count == 1)
+			break;
+
+		count = util_recv_batch(fd, buf, sizeof(buf[0]),
+						HCI_READ_BATCH, sizes);
+		if (count <= 0)
+			break;
 	}
 
+	bt_hci_unref(hci);
+
 	return true;
 }
 
@@ -16,11 +16,15 @@
 #define _GNU_SOURCE
 #include <stdio.h>
 #include <errno.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdbool.h>
 #include <unistd.h>
 #include <stdlib.h>
 #include <stddef.h>
 #include <string.h>
 #include <signal.h>
+#include <time.h>
 #include <sys/signalfd.h>
 #include <sys/timerfd.h>
 #include <sys/epoll.h>
@@ -30,11 +34,12 @@
 #include "mainloop.h"
 #include "mainloop-notify.h"
 
-#define MAX_EPOLL_EVENTS 10
+#define DEFAULT_EPOLL_EVENTS 64
 
 static int epoll_fd;
 static int epoll_terminate;
 static int exit_status = EXIT_SUCCESS;
+static unsigned int epoll_max_events = DEFAULT_EPOLL_EVENTS;
 
 struct mainloop_data {
 	int fd;
@@ -42,27 +47,58 @@ struct mainloop_data {
 	mainloop_event_func callback;
 	mainloop_destroy_func destroy;
 	void *user_data;
+	struct mainloop_data *next;
 };
 
-#define MAX_MAINLOOP_ENTRIES 128
+#define MIN_MAINLOOP_ENTRIES 128
 
-static struct mainloop_data *mainloop_list[MAX_MAINLOOP_ENTRIES];
+static struct mainloop_data **mainloop_list;
+static unsigned int mainloop_list_size;
 
+/*
+ * Entries removed while a batch of events is being dispatched may still be
+ * referenced by later events of the same batch, so freeing them is deferred
+ * until the batch is done.
+ */
+static bool epoll_dispatching;
+static struct mainloop_data *removed_list;
+
+#define TIMEOUT_UNARMED UINT_MAX
+
+/*
+ * All timeouts share a single timerfd. Armed timeouts are kept in a binary
+ * min-heap ordered by expiry and the timerfd is programmed for the earliest
+ * one, so arming or cancelling a timeout usually needs no system call at all.
+ */
 struct timeout_data {
-	int fd;
+	int id;
+	unsigned int index;
+	uint64_t expiry;
 	mainloop_timeout_func callback;
 	mainloop_destroy_func destroy;
 	void *user_data;
 };
 
+static int timer_fd = -1;
+static uint64_t timer_expiry;
+static bool timer_dispatching;
+
+static struct timeout_data **timeout_heap;
+static unsigned int timeout_heap_len;
+static unsigned int timeout_heap_size;
+
+static struct timeout_data **timeout_list;
+static unsigned int timeout_list_size;
+static unsigned int *timeout_free;
+static unsigned int timeout_free_len;
+
 void mainloop_init(void)
 {
-	unsigned int i;
-
 	epoll_fd = epoll_create1(EPOLL_CLOEXEC);
 
-	for (i = 0; i < MAX_MAINLOOP_ENTRIES; i++)
-		mainloop_list[i] = NULL;
+	free(mainloop_list);
+	mainloop_list = NULL;
+	mainloop_list_size = 0;
 
 	epoll_terminate = 0;
 }
@@ -86,27 +122,77 @@ void mainloop_exit_failure(void)
 	epoll_terminate = 1;
 }
 
+static void timeout_free_all(void);
+
+int mainloop_set_max_events(unsigned int max_events)
+{
+	if (!max_events)
+		return -EINVAL;
+
+	epoll_max_events = max_events;
+
+	return 0;
+}
+
+static void dispatch_events(struct epoll_event *events, int nfds)
+{
+	int n;
+
+	epoll_dispatching = true;
+
+	for (n = 0; n < nfds; n++) {
+		struct mainloop_data *data = events[n].data.ptr;
+
+		if (data->fd < 0)
+			continue;
+
+		data->callback(data->fd, events[n].events, data->user_data);
+	}
+
+	epoll_dispatching = false;
+
+	while (removed_list) {
+		struct mainloop_data *data = removed_list;
+
+		removed_list = data->next;
+		free(data);
+	}
+}
+
 int mainloop_run(void)
 {
+	struct epoll_event *events = NULL;
+	unsigned int max_events = 0;
 	unsigned int i;
 
 	while (!epoll_terminate) {
-		struct epoll_event events[MAX_EPOLL_EVENTS];
-		int n, nfds;
+		int nfds;
+
+		if (max_events != epoll_max_events) {
+			struct epoll_event *tmp;
+
+			tmp = realloc(events, epoll_max_events *
+							sizeof(*events));
+			if (tmp) {
+				events = tmp;
+				max_events = epoll_max_events;
+			} else if (!events) {
+				break;
+			}
+		}
 
-		nfds = epoll_wait(epoll_fd, events, MAX_EPOLL_EVENTS, -1);
+		nfds = epoll_wait(epoll_fd, events, max_events, -1);
 		if (nfds < 0)
 			continue;
 
-		for (n = 0; n < nfds; n++) {
-			struct mainloop_data *data = events[n].data.ptr;
-
-			data->callback(data->fd, events[n].events,
-							data->user_data);
-		}
+		dispatch_events(events, nfds);
 	}
 
-	for (i = 0; i < MAX_MAINLOOP_ENTRIES; i++) {
+	free(events);
+
+	timeout_free_all();
+
+	for (i = 0; i < mainloop_list_size; i++) {
 		struct mainloop_data *data = mainloop_list[i];
 
 		mainloop_list[i] = NULL;
@@ -121,6 +207,10 @@ int mainloop_run(void)
 		}
 	}
 
+	free(mainloop_list);
+	mainloop_list = NULL;
+	mainloop_list_size = 0;
+
 	close(epoll_fd);
 	epoll_fd = 0;
 
@@ -129,6 +219,30 @@ int mainloop_run(void)
 	return exit_status;
 }
 
+static bool mainloop_list_grow(int fd)
+{
+	struct mainloop_data **list;
+	unsigned int size = mainloop_list_size;
+
+	if (!size)
+		size = MIN_MAINLOOP_ENTRIES;
+
+	while (size <= (unsigned int) fd)
+		size *= 2;
+
+	list = realloc(mainloop_list, size * sizeof(*list));
+	if (!list)
+		return false;
+
+	memset(list + mainloop_list_size, 0,
+			(size - mainloop_list_size) * sizeof(*list));
+
+	mainloop_list = list;
+	mainloop_list_size = size;
+
+	return true;
+}
+
 int mainloop_add_fd(int fd, uint32_t events, mainloop_event_func callback,
 				void *user_data, mainloop_destroy_func destroy)
 {
@@ -136,9 +250,12 @@ int mainloop_add_fd(int fd, uint32_t events, mainloop_event_func callback,
 	struct epoll_event ev;
 	int err;
 
-	if (fd < 0 || fd > MAX_MAINLOOP_ENTRIES - 1 || !callback)
+	if (fd < 0 || !callback)
 		return -EINVAL;
 
+	if ((unsigned int) fd >= mainloop_list_size && !mainloop_list_grow(fd))
+		return -ENOMEM;
+
 	data = malloc(sizeof(*data));
 	if (!data)
 		return -ENOMEM;
@@ -171,7 +288,7 @@ int mainloop_modify_fd(int fd, uint32_t events)
 	struct epoll_event ev;
 	int err;
 
-	if (fd < 0 || fd > MAX_MAINLOOP_ENTRIES - 1)
+	if (fd < 0 || (unsigned int) fd >= mainloop_list_size)
 		return -EINVAL;
 
 	data = mainloop_list[fd];
@@ -196,7 +313,7 @@ int mainloop_remove_fd(int fd)
 	struct mainloop_data *data;
 	int err;
 
-	if (fd < 0 || fd > MAX_MAINLOOP_ENTRIES - 1)
+	if (fd < 0 || (unsigned int) fd >= mainloop_list_size)
 		return -EINVAL;
 
 	data = mainloop_list[fd];
@@ -210,53 +327,295 @@ int mainloop_remove_fd(int fd)
 	if (data->destroy)
 		data->destroy(data->user_data);
 
-	free(data);
+	if (epoll_dispatching) {
+		data->fd = -1;
+		data->next = removed_list;
+		removed_list = data;
+	} else
+		free(data);
 
 	return err;
 }
 
-static void timeout_destroy(void *user_data)
+static uint64_t timeout_now(void)
 {
-	struct timeout_data *data = user_data;
+	struct timespec ts;
 
-	close(data->fd);
-	data->fd = -1;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
 
-	if (data->destroy)
-		data->destroy(data->user_data);
+	return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
 
-	free(data);
+static void heap_set(unsigned int index, struct timeout_data *data)
+{
+	timeout_heap[index] = data;
+	data->index = index;
 }
 
-static void timeout_callback(int fd, uint32_t events, void *user_data)
+static void heap_sift_up(unsigned int index)
 {
-	struct timeout_data *data = user_data;
-	uint64_t expired;
-	ssize_t result;
+	struct timeout_data *data = timeout_heap[index];
 
-	if (events & (EPOLLERR | EPOLLHUP))
+	while (index > 0) {
+		unsigned int parent = (index - 1) / 2;
+
+		if (timeout_heap[parent]->expiry <= data->expiry)
+			break;
+
+		heap_set(index, timeout_heap[parent]);
+		index = parent;
+	}
+
+	heap_set(index, data);
+}
+
+static void heap_sift_down(unsigned int index)
+{
+	struct timeout_data *data = timeout_heap[index];
+
+	while (1) {
+		unsigned int child = index * 2 + 1;
+
+		if (child >= timeout_heap_len)
+			break;
+
+		if (child + 1 < timeout_heap_len &&
+				timeout_heap[child + 1]->expiry <
+				timeout_heap[child]->expiry)
+			child++;
+
+		if (data->expiry <= timeout_heap[child]->expiry)
+			break;
+
+		heap_set(index, timeout_heap[child]);
+		index = child;
+	}
+
+	heap_set(index, data);
+}
+
+static void heap_remove(struct timeout_data *data)
+{
+	unsigned int index = data->index;
+	struct timeout_data *last;
+
+	if (index == TIMEOUT_UNARMED)
 		return;
 
-	result = read(data->fd, &expired, sizeof(expired));
-	if (result != sizeof(expired))
+	data->index = TIMEOUT_UNARMED;
+
+	last = timeout_heap[--timeout_heap_len];
+	if (last == data)
 		return;
 
-	if (data->callback)
-		data->callback(data->fd, data->user_data);
+	heap_set(index, last);
+
+	if (index > 0 && timeout_heap[(index - 1) / 2]->expiry > last->expiry)
+		heap_sift_up(index);
+	else
+		heap_sift_down(index);
+}
+
+static bool heap_insert(struct timeout_data *data)
+{
+	if (timeout_heap_len == timeout_heap_size) {
+		struct timeout_data **heap;
+		unsigned int size = timeout_heap_size ? timeout_heap_size * 2 :
+							MIN_MAINLOOP_ENTRIES;
+
+		heap = realloc(timeout_heap, size * sizeof(*heap));
+		if (!heap)
+			return false;
+
+		timeout_heap = heap;
+		timeout_heap_size = size;
+	}
+
+	timeout_heap[timeout_heap_len] = data;
+	heap_sift_up(timeout_heap_len++);
+
+	return true;
 }
 
-static inline int timeout_set(int fd, unsigned int msec)
+static void timer_update(void)
 {
 	struct itimerspec itimer;
-	unsigned int sec = msec / 1000;
+	uint64_t expiry;
+
+	if (timer_dispatching || !timeout_heap_len)
+		return;
+
+	/*
+	 * Only ever move the timer forward. If the earliest timeout has been
+	 * cancelled, the timer expires early and is simply programmed again.
+	 */
+	expiry = timeout_heap[0]->expiry;
+	if (timer_expiry && timer_expiry <= expiry)
+		return;
 
 	memset(&itimer, 0, sizeof(itimer));
-	itimer.it_interval.tv_sec = 0;
-	itimer.it_interval.tv_nsec = 0;
-	itimer.it_value.tv_sec = sec;
-	itimer.it_value.tv_nsec = (msec - (sec * 1000)) * 1000 * 1000;
+	itimer.it_value.tv_sec = expiry / 1000000000ull;
+	itimer.it_value.tv_nsec = expiry % 1000000000ull;
+
+	if (timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &itimer, NULL) < 0)
+		return;
 
-	return timerfd_settime(fd, 0, &itimer, NULL);
+	timer_expiry = expiry;
+}
+
+static void timer_callback(int fd, uint32_t events, void *user_data)
+{
+	uint64_t expired, now;
+
+	if (events & (EPOLLERR | EPOLLHUP))
+		return;
+
+	if (read(fd, &expired, sizeof(expired)) < 0 && errno != EAGAIN)
+		return;
+
+	timer_expiry = 0;
+	timer_dispatching = true;
+
+	now = timeout_now();
+
+	while (timeout_heap_len && timeout_heap[0]->expiry <= now) {
+		struct timeout_data *data = timeout_heap[0];
+
+		heap_remove(data);
+		data->callback(data->id, data->user_data);
+	}
+
+	timer_dispatching = false;
+
+	timer_update();
+}
+
+static void timer_destroy(void *user_data)
+{
+	close(timer_fd);
+	timer_fd = -1;
+	timer_expiry = 0;
+}
+
+static int timer_setup(void)
+{
+	int fd;
+
+	if (timer_fd >= 0)
+		return 0;
+
+	fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (fd < 0)
+		return -EIO;
+
+	if (mainloop_add_fd(fd, EPOLLIN, timer_callback, NULL,
+							timer_destroy) < 0) {
+		close(fd);
+		return -EIO;
+	}
+
+	timer_fd = fd;
+
+	return 0;
+}
+
+static struct timeout_data *timeout_lookup(int id)
+{
+	if (id <= 0 || (unsigned int) id > timeout_list_size)
+		return NULL;
+
+	return timeout_list[id - 1];
+}
+
+static int timeout_alloc_id(struct timeout_data *data)
+{
+	unsigned int slot;
+
+	if (!timeout_free_len) {
+		struct timeout_data **list;
+		unsigned int *free_slots;
+		unsigned int i, size;
+
+		size = timeout_list_size ? timeout_list_size * 2 :
+							MIN_MAINLOOP_ENTRIES;
+		if (size > INT_MAX)
+			return -ENOMEM;
+
+		list = realloc(timeout_list, size * sizeof(*list));
+		if (!list)
+			return -ENOMEM;
+
+		timeout_list = list;
+
+		free_slots = realloc(timeout_free, size * sizeof(*free_slots));
+		if (!free_slots)
+			return -ENOMEM;
+
+		timeout_free = free_slots;
+
+		/* Hand out the lowest identifiers first */
+		for (i = size; i > timeout_list_size; i--) {
+			timeout_list[i - 1] = NULL;
+			timeout_free[timeout_free_len++] = i - 1;
+		}
+
+		timeout_list_size = size;
+	}
+
+	slot = timeout_free[--timeout_free_len];
+	timeout_list[slot] = data;
+
+	return slot + 1;
+}
+
+static void timeout_release(struct timeout_data *data)
+{
+	heap_remove(data);
+
+	timeout_list[data->id - 1] = NULL;
+	timeout_free[timeout_free_len++] = data->id - 1;
+
+	if (data->destroy)
+		data->destroy(data->user_data);
+
+	free(data);
+}
+
+static void timeout_free_all(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < timeout_list_size; i++) {
+		if (timeout_list[i])
+			timeout_release(timeout_list[i]);
+	}
+
+	free(timeout_heap);
+	timeout_heap = NULL;
+	timeout_heap_len = 0;
+	timeout_heap_size = 0;
+
+	free(timeout_list);
+	timeout_list = NULL;
+	timeout_list_size = 0;
+
+	free(timeout_free);
+	timeout_free = NULL;
+	timeout_free_len = 0;
+}
+
+static int timeout_set(struct timeout_data *data, unsigned int msec)
+{
+	heap_remove(data);
+
+	data->expiry = timeout_now() + msec * 1000000ull;
+
+	if (!heap_insert(data))
+		return -ENOMEM;
+
+	timer_update();
+
+	return 0;
 }
 
 int mainloop_add_timeout(unsigned int msec, mainloop_timeout_func callback,
@@ -267,53 +626,62 @@ int mainloop_add_timeout(unsigned int msec, mainloop_timeout_func callback,
 	if (!callback)
 		return -EINVAL;
 
+	if (timer_setup() < 0)
+		return -EIO;
+
 	data = malloc(sizeof(*data));
 	if (!data)
 		return -ENOMEM;
 
 	memset(data, 0, sizeof(*data));
+	data->index = TIMEOUT_UNARMED;
 	data->callback = callback;
 	data->destroy = destroy;
 	data->user_data = user_data;
 
-	data->fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
-	if (data->fd < 0) {
+	data->id = timeout_alloc_id(data);
+	if (data->id < 0) {
 		free(data);
-		return -EIO;
+		return -ENOMEM;
 	}
 
 	if (msec > 0) {
-		if (timeout_set(data->fd, msec) < 0) {
-			close(data->fd);
+		if (timeout_set(data, msec) < 0) {
+			timeout_list[data->id - 1] = NULL;
+			timeout_free[timeout_free_len++] = data->id - 1;
 			free(data);
 			return -EIO;
 		}
 	}
 
-	if (mainloop_add_fd(data->fd, EPOLLIN | EPOLLONESHOT,
-				timeout_callback, data, timeout_destroy) < 0) {
-		close(data->fd);
-		free(data);
-		return -EIO;
-	}
-
-	return data->fd;
+	return data->id;
 }
 
 int mainloop_modify_timeout(int id, unsigned int msec)
 {
+	struct timeout_data *data;
+
+	data = timeout_lookup(id);
+	if (!data)
+		return -EIO;
+
 	if (msec > 0) {
-		if (timeout_set(id, msec) < 0)
+		if (timeout_set(data, msec) < 0)
 			return -EIO;
 	}
 
-	if (mainloop_modify_fd(id, EPOLLIN | EPOLLONESHOT) < 0)
-		return -EIO;
-
 	return 0;
 }
 
 int mainloop_remove_timeout(int id)
 {
-	return mainloop_remove_fd(id);
+	struct timeout_data *data;
+
+	data = timeout_lookup(id);
+	if (!data)
+		return -ENXIO;
+
+	timeout_release(data);
+
+	return 0;
 }
@@ -30,6 +30,9 @@
 #define DBG(_mgmt, _format, arg...) \
 	mgmt_log(_mgmt, "%s:%s() " _format, __FILE__, __func__, ## arg)
 
+#define MGMT_READ_BATCH		16
+#define MGMT_READ_BUDGET	64
+
 struct mgmt {
 	int ref_count;
 	int fd;
@@ -371,45 +374,37 @@ static void process_notify(struct mgmt *mgmt, uint16_t event, uint16_t index,
 	}
 }
 
-static bool can_read_data(struct io *io, void *user_data)
+static void process_message(struct mgmt *mgmt, void *buf, size_t size)
 {
-	struct mgmt *mgmt = user_data;
 	struct mgmt_hdr *hdr;
 	struct mgmt_ev_cmd_complete *cc;
 	struct mgmt_ev_cmd_status *cs;
-	ssize_t bytes_read;
 	uint16_t opcode, event, index, length;
 
-	bytes_read = read(mgmt->fd, mgmt->buf, mgmt->len);
-	if (bytes_read < 0)
-		return false;
-
-	if (bytes_read < MGMT_HDR_SIZE)
-		return true;
+	if (size < MGMT_HDR_SIZE)
+		return;
 
-	hdr = mgmt->buf;
+	hdr = buf;
 	event = btohs(hdr->opcode);
 	index = btohs(hdr->index);
 	length = btohs(hdr->len);
 
-	if (bytes_read < length + MGMT_HDR_SIZE)
-		return true;
-
-	mgmt_ref(mgmt);
+	if (size < (size_t) length + MGMT_HDR_SIZE)
+		return;
 
 	switch (event) {
 	case MGMT_EV_CMD_COMPLETE:
-		cc = mgmt->buf + MGMT_HDR_SIZE;
+		cc = buf + MGMT_HDR_SIZE;
 		opcode = btohs(cc->opcode);
 
 		DBG(mgmt, "[0x%04x] command 0x%04x complete: 0x%02x",
 						index, opcode, cc->status);
 
 		request_complete(mgmt, cc->status, opcode, index, length - 3,
-						mgmt->buf + MGMT_HDR_SIZE + 3);
+						buf + MGMT_HDR_SIZE + 3);
 		break;
 	case MGMT_EV_CMD_STATUS:
-		cs = mgmt->buf + MGMT_HDR_SIZE;
+		cs = buf + MGMT_HDR_SIZE;
 		opcode = btohs(cs->opcode);
 
 		DBG(mgmt, "[0x%04x] command 0x%02x status: 0x%02x",
@@ -421,9 +416,58 @@ static bool can_read_data(struct io *io, void *user_data)
 		DBG(mgmt, "[0x%04x] event 0x%04x", index, event);
 
 		process_notify(mgmt, event, index, length,
-						mgmt->buf + MGMT_HDR_SIZE);
+						buf + MGMT_HDR_SIZE);
 		break;
 	}
+}
+
+static bool can_read_data(struct io *io, void *user_data)
+{
+	struct mgmt *mgmt = user_data;
+	size_t sizes[MGMT_READ_BATCH];
+	unsigned int budget = MGMT_READ_BUDGET;
+	ssize_t bytes_read;
+	int i, count;
+
+	count = util_recv_batch(mgmt->fd, mgmt->buf, mgmt->len,
+						MGMT_READ_BATCH, sizes);
+	if (count == -ENOTSOCK) {
+		/* Not a socket, so only a single read is safe per wakeup */
+		bytes_read = read(mgmt->fd, mgmt->buf, mgmt->len);
+		if (bytes_read < 0)
+			return false;
+
+		sizes[0] = bytes_read;
+		count = 1;
+	} else if (count == -EAGAIN || count == -EINTR) {
+		return true;
+	} else if (count < 0) {
+		return false;
+	}
+
+	mgmt_ref(mgmt);
+
+	/*
+	 * Drain the socket so that bursts of events, like device found
+	 * during discovery, do not need a main loop iteration each. The
+	 * budget keeps other file descriptors from being starved.
+	 */
+	while (1) {
+		for (i = 0; i < count && mgmt->ref_count > 1; i++)
+			process_message(mgmt, mgmt->buf + i * mgmt->len,
+								sizes[i]);
+
+		budget -= count;
+
+		if (count < MGMT_READ_BATCH || budget < MGMT_READ_BATCH ||
+						mgmt->ref_count == 1)
+			break;
+
+		count = util_recv_batch(mgmt->fd, mgmt->buf, mgmt->len,
+						MGMT_READ_BATCH, sizes);
+		if (count <= 0)
+			break;
+	}
 
 	mgmt_unref(mgmt);
 
@@ -468,7 +512,7 @@ struct mgmt *mgmt_new(int fd)
 	mgmt->close_on_unref = false;
 
 	mgmt->len = 512;
-	mgmt->buf = malloc(mgmt->len);
+	mgmt->buf = malloc(mgmt->len * MGMT_READ_BATCH);
 	if (!mgmt->buf) {
 		free(mgmt);
 		return NULL;
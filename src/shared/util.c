@@ -20,6 +20,7 @@
 #include <stdbool.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/socket.h>
 #include <unistd.h>
 #include <dirent.h>
 #include <limits.h>
@@ -313,6 +314,42 @@ ssize_t util_getrandom(void *buf, size_t buflen, unsigned int flags)
 #endif
 }
 
+/*
+ * Receive up to count datagrams of at most len bytes each, without blocking,
+ * into consecutive len sized slots of buf. The size of each datagram is
+ * stored in sizes. Returns the number of datagrams received or a negative
+ * errno, -ENOTSOCK if fd is not a socket.
+ */
+int util_recv_batch(int fd, void *buf, size_t len, unsigned int count,
+							size_t *sizes)
+{
+	struct mmsghdr msgs[UTIL_RECV_BATCH_MAX];
+	struct iovec iov[UTIL_RECV_BATCH_MAX];
+	unsigned int i;
+	int n;
+
+	if (!count || count > UTIL_RECV_BATCH_MAX)
+		return -EINVAL;
+
+	memset(msgs, 0, count * sizeof(*msgs));
+
+	for (i = 0; i < count; i++) {
+		iov[i].iov_base = buf + i * len;
+		iov[i].iov_len = len;
+		msgs[i].msg_hdr.msg_iov = &iov[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	n = recvmmsg(fd, msgs, count, MSG_DONTWAIT, NULL);
+	if (n < 0)
+		return -errno;
+
+	for (i = 0; i < (unsigned int) n; i++)
+		sizes[i] = msgs[i].msg_len;
+
+	return n;
+}
+
 /* Helpers for bitfield operations */
 
 /* Find unique id in range from 1 to max but no bigger than 64. */
@@ -201,6 +201,11 @@ unsigned char util_get_dt(const char *parent, const char *name);
 
 ssize_t util_getrandom(void *buf, size_t buflen, unsigned int flags);
 
+#define UTIL_RECV_BATCH_MAX 32
+
+int util_recv_batch(int fd, void *buf, size_t len, unsigned int count,
+							size_t *sizes);
+
 uint8_t util_get_uid(uint64_t *bitmap, uint8_t max);
 void util_clear_uid(uint64_t *bitmap, uint8_t id);
 
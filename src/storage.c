@@ -20,6 +20,7 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 #include <limits.h>
 #include <sys/file.h>
@@ -32,6 +33,11 @@
 #include "bluetooth/sdp_lib.h"
 #include "bluetooth/uuid.h"
 
+#include "src/shared/queue.h"
+#include "src/shared/timeout.h"
+
+#include "log.h"
+#include "btd.h"
 #include "textfile.h"
 #include "uuid-helper.h"
 #include "storage.h"
@@ -44,6 +50,28 @@ struct match {
 	char *pattern;
 };
 
+struct storage_entry {
+	char *filename;
+	GKeyFile *key_file;
+};
+
+/*
+ * Key files modified but not yet written, oldest first.
+ *
+ * Every key file of the device storage is read and written through
+ * btd_storage_load() and btd_storage_store() so that no pending change is
+ * missed or overwritten. There are two exceptions:
+ *
+ *  - the conversion of the legacy storage format in adapter.c, which runs
+ *    before the devices of the adapter are loaded, when nothing can be
+ *    pending yet;
+ *  - btmon, which reads attributes files with btd_settings_gatt_db_load()
+ *    from another process and sees changes only once they are written.
+ */
+static struct queue *storage_dirty;
+static unsigned int storage_flush_id;
+static unsigned int storage_updates;
+
 int read_discoverable_timeout(const char *src, int *timeout)
 {
 	char filename[PATH_MAX], *str;
@@ -178,3 +206,171 @@ sdp_record_t *find_record_in_list(sdp_list_t *recs, const char *uuid)
 	}
 	return NULL;
 }
+
+static void storage_entry_free(void *data)
+{
+	struct storage_entry *entry = data;
+
+	g_key_file_unref(entry->key_file);
+	g_free(entry->filename);
+	g_free(entry);
+}
+
+static bool match_filename(const void *data, const void *match_data)
+{
+	const struct storage_entry *entry = data;
+
+	return !strcmp(entry->filename, match_data);
+}
+
+static bool match_path(const void *data, const void *match_data)
+{
+	const struct storage_entry *entry = data;
+	const char *path = match_data;
+	size_t len = strlen(path);
+
+	return !strncmp(entry->filename, path, len) &&
+			(entry->filename[len] == '\0' ||
+			 entry->filename[len] == '/');
+}
+
+static void storage_write(void *data, void *user_data)
+{
+	struct storage_entry *entry = data;
+	GError *gerr = NULL;
+	gsize length = 0;
+	char *str;
+
+	create_file(entry->filename, 0600);
+
+	/* g_file_set_contents replaces the file atomically */
+	str = g_key_file_to_data(entry->key_file, &length, NULL);
+	if (!g_file_set_contents(entry->filename, str, length, &gerr)) {
+		error("Unable set contents for %s: (%s)", entry->filename,
+								gerr->message);
+		g_error_free(gerr);
+	}
+
+	g_free(str);
+}
+
+/*
+ * Returns the key file stored at filename, including changes not yet
+ * written. The reference must be released with g_key_file_unref since
+ * the key file may be shared with pending writes.
+ */
+GKeyFile *btd_storage_load(const char *filename, GError **gerr)
+{
+	struct storage_entry *entry;
+	GKeyFile *key_file;
+
+	entry = queue_find(storage_dirty, match_filename, filename);
+	if (entry)
+		return g_key_file_ref(entry->key_file);
+
+	key_file = g_key_file_new();
+	g_key_file_load_from_file(key_file, filename, 0, gerr);
+
+	return key_file;
+}
+
+static bool storage_flush_timeout(void *user_data)
+{
+	storage_flush_id = 0;
+
+	btd_storage_flush();
+
+	return false;
+}
+
+/*
+ * Schedules key_file to be written to filename. Writes to the same file
+ * are coalesced until StorageFlushDelay expires or StorageFlushLimit
+ * files are pending, whichever comes first.
+ */
+void btd_storage_store(const char *filename, GKeyFile *key_file)
+{
+	struct storage_entry *entry;
+
+	if (!storage_dirty)
+		storage_dirty = queue_new();
+
+	entry = queue_find(storage_dirty, match_filename, filename);
+	if (!entry) {
+		entry = g_new0(struct storage_entry, 1);
+		entry->filename = g_strdup(filename);
+		queue_push_tail(storage_dirty, entry);
+	}
+
+	if (entry->key_file != key_file) {
+		if (entry->key_file)
+			g_key_file_unref(entry->key_file);
+		entry->key_file = g_key_file_ref(key_file);
+	}
+
+	storage_updates++;
+
+	if (!btd_opts.storage_flush_delay ||
+			queue_length(storage_dirty) >=
+					btd_opts.storage_flush_limit) {
+		btd_storage_flush();
+		return;
+	}
+
+	if (!storage_flush_id)
+		storage_flush_id = timeout_add(btd_opts.storage_flush_delay,
+						storage_flush_timeout,
+						NULL, NULL);
+}
+
+/*
+ * Writes key_file to filename right away, bypassing the delay, for data
+ * that must survive a crash such as pairing keys. A pending write to the
+ * same file is superseded since key_file already includes it.
+ */
+void btd_storage_store_sync(const char *filename, GKeyFile *key_file)
+{
+	struct storage_entry entry;
+
+	queue_remove_all(storage_dirty, match_filename, (void *) filename,
+							storage_entry_free);
+
+	entry.filename = (char *) filename;
+	entry.key_file = key_file;
+
+	storage_write(&entry, NULL);
+}
+
+/* Drops pending writes to path or to any file below it */
+void btd_storage_remove(const char *path)
+{
+	queue_remove_all(storage_dirty, match_path, (void *) path,
+							storage_entry_free);
+}
+
+void btd_storage_flush(void)
+{
+	if (storage_flush_id) {
+		timeout_remove(storage_flush_id);
+		storage_flush_id = 0;
+	}
+
+	if (queue_isempty(storage_dirty))
+		return;
+
+	DBG("%u updates to %u files", storage_updates,
+					queue_length(storage_dirty));
+
+	queue_foreach(storage_dirty, storage_write, NULL);
+	queue_remove_all(storage_dirty, NULL, NULL, storage_entry_free);
+
+	storage_updates = 0;
+}
+
+void btd_storage_cleanup(void)
+{
+	btd_storage_flush();
+
+	queue_destroy(storage_dirty, NULL);
+	storage_dirty = NULL;
+}
@@ -14,3 +14,10 @@ int read_on_mode(const char *src, char *mode, int length);
 int read_local_name(const bdaddr_t *bdaddr, char *name);
 sdp_record_t *record_from_string(const char *str);
 sdp_record_t *find_record_in_list(sdp_list_t *recs, const char *uuid);
+
+GKeyFile *btd_storage_load(const char *filename, GError **gerr);
+void btd_storage_store(const char *filename, GKeyFile *key_file);
+void btd_storage_store_sync(const char *filename, GKeyFile *key_file);
+void btd_storage_remove(const char *path);
+void btd_storage_flush(void);
+void btd_storage_cleanup(void);
@@ -38,6 +38,8 @@
 
 #define MONITOR_INDEX_NONE 0xffff
 
+#define FLUSH_INTERVAL 1000
+
 struct monitor_hdr {
 	uint16_t opcode;
 	uint16_t index;
@@ -104,6 +106,14 @@ static void data_callback(int fd, uint32_t events, void *user_data)
 	}
 }
 
+static void flush_callback(int id, void *user_data)
+{
+	btsnoop_flush(btsnoop_file);
+
+	if (mainloop_modify_timeout(id, FLUSH_INTERVAL) < 0)
+		mainloop_exit_failure();
+}
+
 static bool open_monitor_channel(void)
 {
 	struct sockaddr_hci addr;
@@ -196,6 +206,7 @@ static void usage(void)
 		"\t-p, --parents          Create basename parent directories\n"
 		"\t-l, --limit <limit>    Limit traces file size (rotate)\n"
 		"\t-c, --count <count>    Limit number of rotated files\n"
+		"\t-B, --buffer <size>    Buffer writes (flushed every second)\n"
 		"\t-v, --version          Show version\n"
 		"\t-h, --help             Show help options\n");
 }
@@ -205,11 +216,33 @@ static const struct option main_options[] = {
 	{ "parents",	no_argument,		NULL, 'p' },
 	{ "limit",	required_argument,	NULL, 'l' },
 	{ "count",	required_argument,	NULL, 'c' },
+	{ "buffer",	required_argument,	NULL, 'B' },
 	{ "version",	no_argument,		NULL, 'v' },
 	{ "help",	no_argument,		NULL, 'h' },
 	{ }
 };
 
+static bool parse_size(const char *str, size_t *size)
+{
+	char *endptr;
+
+	*size = strtoul(str, &endptr, 10);
+
+	if (*size == ULONG_MAX)
+		return false;
+
+	if (*endptr != '\0') {
+		if (*endptr == 'K' || *endptr == 'k')
+			*size *= 1024;
+		else if (*endptr == 'M' || *endptr == 'm')
+			*size *= 1024 * 1024;
+		else
+			return false;
+	}
+
+	return true;
+}
+
 static int create_dir(const char *filename)
 {
 	char *dirc;
@@ -262,6 +295,7 @@ int main(int argc, char *argv[])
 	const char *path = "hci.log";
 	unsigned long max_count = 0;
 	size_t size_limit = 0;
+	size_t buffer_size = 0;
 	bool parents = false;
 	int exit_status;
 	char *endptr;
@@ -273,7 +307,7 @@ int main(int argc, char *argv[])
 	while (true) {
 		int opt;
 
-		opt = getopt_long(argc, argv, "b:l:c:vhp", main_options,
+		opt = getopt_long(argc, argv, "b:l:c:B:vhp", main_options,
 									NULL);
 		if (opt < 0)
 			break;
@@ -287,24 +321,11 @@ int main(int argc, char *argv[])
 			}
 			break;
 		case 'l':
-			size_limit = strtoul(optarg, &endptr, 10);
-
-			if (size_limit == ULONG_MAX) {
+			if (!parse_size(optarg, &size_limit)) {
 				fprintf(stderr, "Invalid limit\n");
 				return EXIT_FAILURE;
 			}
 
-			if (*endptr != '\0') {
-				if (*endptr == 'K' || *endptr == 'k') {
-					size_limit *= 1024;
-				} else if (*endptr == 'M' || *endptr == 'm') {
-					size_limit *= 1024 * 1024;
-				} else {
-					fprintf(stderr, "Invalid limit\n");
-					return EXIT_FAILURE;
-				}
-			}
-
 			/* limit this to reasonable size */
 			if (size_limit < 4096) {
 				fprintf(stderr, "Too small limit value\n");
@@ -314,6 +335,12 @@ int main(int argc, char *argv[])
 		case 'c':
 			max_count = strtoul(optarg, &endptr, 10);
 			break;
+		case 'B':
+			if (!parse_size(optarg, &buffer_size)) {
+				fprintf(stderr, "Invalid buffer size\n");
+				return EXIT_FAILURE;
+			}
+			break;
 		case 'p':
 			if (getppid() != 1) {
 				fprintf(stderr, "Parents option allowed only "
@@ -350,6 +377,17 @@ int main(int argc, char *argv[])
 	if (!btsnoop_file)
 		return EXIT_FAILURE;
 
+	if (buffer_size) {
+		if (!btsnoop_set_buffer(btsnoop_file, buffer_size,
+							FLUSH_INTERVAL)) {
+			fprintf(stderr, "Failed to setup write buffer\n");
+			return EXIT_FAILURE;
+		}
+
+		mainloop_add_timeout(FLUSH_INTERVAL, flush_callback,
+								NULL, NULL);
+	}
+
 	drop_capabilities();
 
 	printf("Bluetooth monitor logger ver %s\n", VERSION);
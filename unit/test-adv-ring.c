@@ -0,0 +1,335 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2026  agent <agent@local>
+ *
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <unistd.h>
+#include <string.h>
+#include <time.h>
+#include <poll.h>
+#include <sys/mman.h>
+
+#include <glib.h>
+
+#include "src/shared/util.h"
+#include "src/shared/adv-ring.h"
+#include "src/shared/tester.h"
+
+#define RING_SIZE		BT_ADV_RING_MIN_SIZE
+#define AD_LEN			31
+#define BENCH_SIZE		(1024 * 1024)
+#define BENCH_REPORTS		2000000
+#define BENCH_BATCH		64
+
+struct rings {
+	struct bt_adv_ring *producer;
+	struct bt_adv_ring *consumer;
+};
+
+struct received {
+	unsigned int count;
+	uint32_t next;
+};
+
+static void rings_new(struct rings *rings, size_t size)
+{
+	rings->producer = bt_adv_ring_new(size);
+	g_assert(rings->producer);
+
+	/* The consumer maps its own copy, as a client would */
+	rings->consumer = bt_adv_ring_attach(
+				dup(bt_adv_ring_get_fd(rings->producer)),
+				dup(bt_adv_ring_get_event_fd(rings->producer)));
+	g_assert(rings->consumer);
+}
+
+static void rings_free(struct rings *rings)
+{
+	bt_adv_ring_free(rings->consumer);
+	bt_adv_ring_free(rings->producer);
+}
+
+static void fill_report(struct bt_adv_report *report, uint8_t *ad,
+								uint32_t seq)
+{
+	memset(report, 0, sizeof(*report));
+	put_le32(seq, report->addr);
+	report->addr_type = seq % 3;
+	report->rssi = -(int8_t) (seq % 100);
+	report->flags = seq;
+	report->timestamp = (uint64_t) seq * 1000;
+
+	memset(ad, seq, AD_LEN);
+	report->data = ad;
+	report->len = AD_LEN - seq % 8;
+}
+
+static bool push(struct bt_adv_ring *ring, uint32_t seq)
+{
+	struct bt_adv_report report;
+	uint8_t ad[AD_LEN];
+
+	fill_report(&report, ad, seq);
+
+	return bt_adv_ring_push(ring, &report);
+}
+
+static void check_report(const struct bt_adv_report *report, void *user_data)
+{
+	struct received *received = user_data;
+	struct bt_adv_report expected;
+	uint8_t ad[AD_LEN];
+
+	fill_report(&expected, ad, received->next);
+
+	g_assert(!memcmp(report->addr, expected.addr, sizeof(report->addr)));
+	g_assert_cmpint(report->addr_type, ==, expected.addr_type);
+	g_assert_cmpint(report->rssi, ==, expected.rssi);
+	g_assert_cmpint(report->flags, ==, expected.flags);
+	g_assert_cmpint(report->timestamp, ==, expected.timestamp);
+	g_assert_cmpint(report->len, ==, expected.len);
+	g_assert(!memcmp(report->data, ad, report->len));
+
+	received->next++;
+	received->count++;
+}
+
+static bool event_pending(struct bt_adv_ring *ring)
+{
+	struct pollfd pfd;
+
+	pfd.fd = bt_adv_ring_get_event_fd(ring);
+	pfd.events = POLLIN;
+	pfd.revents = 0;
+
+	return poll(&pfd, 1, 0) == 1;
+}
+
+static void test_round_trip(const void *user_data)
+{
+	struct received received;
+	struct rings rings;
+	uint32_t seq;
+
+	rings_new(&rings, RING_SIZE);
+
+	g_assert_cmpint(bt_adv_ring_get_size(rings.consumer), ==, RING_SIZE);
+	g_assert(!event_pending(rings.consumer));
+
+	/* Only the first report into an empty ring wakes up the consumer */
+	memset(&received, 0, sizeof(received));
+
+	for (seq = 0; seq < 10; seq++)
+		g_assert(push(rings.producer, seq));
+
+	g_assert(event_pending(rings.consumer));
+	g_assert_cmpint(bt_adv_ring_read(rings.consumer, check_report,
+						&received), ==, 10);
+	g_assert(!event_pending(rings.consumer));
+
+	/* Records wrapping around the end of the ring are read in order */
+	for (; seq < 2000; seq++) {
+		g_assert(push(rings.producer, seq));
+
+		if (seq % 17 == 0)
+			bt_adv_ring_read(rings.consumer, check_report,
+								&received);
+	}
+
+	bt_adv_ring_read(rings.consumer, check_report, &received);
+	g_assert_cmpint(received.count, ==, 2000);
+	g_assert_cmpint(bt_adv_ring_get_dropped(rings.consumer), ==, 0);
+
+	rings_free(&rings);
+
+	tester_test_passed();
+}
+
+static void test_overflow(const void *user_data)
+{
+	struct received received;
+	struct rings rings;
+	unsigned int pushed = 0;
+	uint32_t seq;
+
+	rings_new(&rings, RING_SIZE);
+
+	/* Newest reports are dropped until the consumer catches up */
+	for (seq = 0; seq < 1000; seq++) {
+		if (!push(rings.producer, seq))
+			break;
+
+		pushed++;
+	}
+
+	g_assert_cmpint(pushed, <, 1000);
+	g_assert(!push(rings.producer, seq));
+	g_assert_cmpint(bt_adv_ring_get_dropped(rings.consumer), ==, 2);
+
+	memset(&received, 0, sizeof(received));
+	g_assert_cmpint(bt_adv_ring_read(rings.consumer, check_report,
+						&received), ==, pushed);
+
+	g_assert(push(rings.producer, seq));
+	g_assert_cmpint(bt_adv_ring_read(rings.consumer, check_report,
+						&received), ==, 1);
+
+	rings_free(&rings);
+
+	tester_test_passed();
+}
+
+/*
+ * The client can write to the whole header, the producer must not pick up
+ * head or dropped from it.
+ */
+static void test_header(const void *user_data)
+{
+	struct received received;
+	struct rings rings;
+	uint8_t *hdr;
+	uint32_t seq;
+
+	rings_new(&rings, RING_SIZE);
+
+	hdr = mmap(NULL, 256, PROT_READ | PROT_WRITE, MAP_SHARED,
+				bt_adv_ring_get_fd(rings.consumer), 0);
+	g_assert(hdr != MAP_FAILED);
+
+	memset(&received, 0, sizeof(received));
+
+	for (seq = 0; seq < 10; seq++)
+		g_assert(push(rings.producer, seq));
+
+	/* Dropped is at offset 12 and head at offset 64 */
+	*(uint32_t *) (hdr + 12) = 1000;
+	*(uint32_t *) (hdr + 64) = 0x12345;
+
+	g_assert(push(rings.producer, seq));
+	seq++;
+
+	g_assert_cmpint(bt_adv_ring_read(rings.consumer, check_report,
+						&received), ==, seq);
+	g_assert_cmpint(bt_adv_ring_get_dropped(rings.producer), ==, 0);
+
+	/* Fill the ring, the next drop publishes the producer count */
+	while (push(rings.producer, seq))
+		seq++;
+
+	g_assert_cmpint(bt_adv_ring_get_dropped(rings.producer), ==, 1);
+	g_assert_cmpint(bt_adv_ring_get_dropped(rings.consumer), ==, 1);
+	g_assert_cmpint(bt_adv_ring_read(rings.consumer, check_report,
+						&received), ==, seq - 11);
+	g_assert_cmpint(received.count, ==, seq);
+
+	munmap(hdr, 256);
+	rings_free(&rings);
+
+	tester_test_passed();
+}
+
+static void test_attach(const void *user_data)
+{
+	struct bt_adv_ring *ring;
+	int fds[2];
+
+	g_assert(!bt_adv_ring_new(BT_ADV_RING_MIN_SIZE - 1));
+	g_assert(!bt_adv_ring_new(BT_ADV_RING_MAX_SIZE + 1));
+
+	ring = bt_adv_ring_new(RING_SIZE + 1);
+	g_assert(ring);
+	g_assert_cmpint(bt_adv_ring_get_size(ring), ==, RING_SIZE * 2);
+
+	/* Only the consumer side reads */
+	g_assert_cmpint(bt_adv_ring_read(ring, check_report, NULL), ==, 0);
+
+	bt_adv_ring_free(ring);
+
+	/* Anything else than a ring is refused */
+	g_assert(pipe(fds) == 0);
+	g_assert(!bt_adv_ring_attach(fds[0], fds[1]));
+	close(fds[0]);
+	close(fds[1]);
+
+	tester_test_passed();
+}
+
+static uint64_t get_time_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1000000ull + ts.tv_nsec / 1000;
+}
+
+static void count_report(const struct bt_adv_report *report,
+							void *user_data)
+{
+	unsigned int *bytes = user_data;
+
+	*bytes += report->len;
+}
+
+static void test_throughput(const void *user_data)
+{
+	struct rings rings;
+	unsigned int reports = 0, bytes = 0, wakeups = 0;
+	uint64_t start, elapsed;
+	uint32_t seq = 0;
+
+	rings_new(&rings, BENCH_SIZE);
+
+	start = get_time_us();
+
+	while (seq < BENCH_REPORTS) {
+		unsigned int i;
+
+		for (i = 0; i < BENCH_BATCH; i++, seq++)
+			push(rings.producer, seq);
+
+		if (event_pending(rings.consumer))
+			wakeups++;
+
+		reports += bt_adv_ring_read(rings.consumer, count_report,
+								&bytes);
+	}
+
+	elapsed = get_time_us() - start;
+
+	tester_debug("%u reports, %u bytes of AD, %u wakeups in %llu us "
+			"(%llu reports/s)", reports, bytes, wakeups,
+			(unsigned long long) elapsed,
+			(unsigned long long) (elapsed ?
+				reports * 1000000ull / elapsed : 0));
+
+	g_assert_cmpint(reports, ==, BENCH_REPORTS);
+	g_assert_cmpint(bt_adv_ring_get_dropped(rings.consumer), ==, 0);
+	g_assert_cmpint(wakeups, ==, BENCH_REPORTS / BENCH_BATCH);
+
+	rings_free(&rings);
+
+	tester_test_passed();
+}
+
+int main(int argc, char *argv[])
+{
+	tester_init(&argc, &argv);
+
+	tester_add("/adv-ring/round-trip", NULL, NULL, test_round_trip, NULL);
+	tester_add("/adv-ring/overflow", NULL, NULL, test_overflow, NULL);
+	tester_add("/adv-ring/header", NULL, NULL, test_header, NULL);
+	tester_add("/adv-ring/attach", NULL, NULL, test_attach, NULL);
+	tester_add("/adv-ring/throughput", NULL, NULL, test_throughput, NULL);
+
+	return tester_run();
+}
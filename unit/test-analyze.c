@@ -0,0 +1,342 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2026  agent <agent@local>
+ *
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <glib.h>
+
+#include "src/shared/util.h"
+#include "src/shared/btsnoop.h"
+#include "src/shared/tester.h"
+#include "monitor/bt.h"
+#include "monitor/analyze.h"
+
+#define NUM_INDEX	3
+#define NUM_CONN	4
+#define NUM_ROUNDS	40
+#define TEST_TIME	1700000000
+
+/* Each round sends a packet, receives one and completes it per connection */
+#define SLOT_MSEC	3
+
+struct test_data {
+	unsigned int jobs;
+	bool window;
+};
+
+static char *trace_path;
+static struct timeval window_from;
+static struct timeval window_to;
+
+static void tick(struct timeval *tv, unsigned int msec)
+{
+	struct timeval delta = {
+		.tv_sec = msec / 1000,
+		.tv_usec = (msec % 1000) * 1000,
+	};
+
+	timeradd(tv, &delta, tv);
+}
+
+static void write_event(struct btsnoop *btsnoop, struct timeval *tv,
+				uint16_t index, uint8_t evt,
+				const void *data, uint8_t len)
+{
+	uint8_t buf[2 + 255];
+
+	buf[0] = evt;
+	buf[1] = len;
+	memcpy(buf + 2, data, len);
+
+	g_assert(btsnoop_write_hci(btsnoop, tv, index,
+					BTSNOOP_OPCODE_EVENT_PKT, 0,
+					buf, 2 + len));
+}
+
+static void write_setup(struct btsnoop *btsnoop, struct timeval *tv,
+							uint16_t index)
+{
+	struct btsnoop_opcode_new_index ni;
+	uint8_t cmd[3], rsp[10];
+
+	memset(&ni, 0, sizeof(ni));
+	ni.type = 0x00;
+	ni.bus = 0x01;
+	snprintf(ni.name, sizeof(ni.name), "hci%u", index);
+
+	g_assert(btsnoop_write_hci(btsnoop, tv, index,
+					BTSNOOP_OPCODE_NEW_INDEX, 0,
+					&ni, sizeof(ni)));
+	tick(tv, 1);
+
+	put_le16(BT_HCI_CMD_READ_BD_ADDR, cmd);
+	cmd[2] = 0;
+
+	g_assert(btsnoop_write_hci(btsnoop, tv, index,
+					BTSNOOP_OPCODE_COMMAND_PKT, 0,
+					cmd, sizeof(cmd)));
+	tick(tv, 1);
+
+	/* Num HCI Command Packets, opcode, status and address */
+	rsp[0] = 1;
+	put_le16(BT_HCI_CMD_READ_BD_ADDR, rsp + 1);
+	rsp[3] = 0;
+	memset(rsp + 4, 0x10 + index, 6);
+
+	write_event(btsnoop, tv, index, BT_HCI_EVT_CMD_COMPLETE,
+							rsp, sizeof(rsp));
+	tick(tv, 1);
+}
+
+static void write_connect(struct btsnoop *btsnoop, struct timeval *tv,
+					uint16_t index, uint16_t handle)
+{
+	struct {
+		uint8_t subevt;
+		struct bt_hci_evt_le_conn_complete evt;
+	} __attribute__((packed)) ev;
+
+	memset(&ev, 0, sizeof(ev));
+	ev.subevt = BT_HCI_EVT_LE_CONN_COMPLETE;
+	ev.evt.handle = cpu_to_le16(handle);
+	ev.evt.peer_addr_type = 0x01;
+	memset(ev.evt.peer_addr, handle, 6);
+
+	write_event(btsnoop, tv, index, BT_HCI_EVT_LE_META_EVENT,
+							&ev, sizeof(ev));
+	tick(tv, 1);
+}
+
+static void write_disconnect(struct btsnoop *btsnoop, struct timeval *tv,
+					uint16_t index, uint16_t handle)
+{
+	struct bt_hci_evt_disconnect_complete evt;
+
+	evt.status = 0;
+	evt.handle = cpu_to_le16(handle);
+	evt.reason = 0x13;
+
+	write_event(btsnoop, tv, index, BT_HCI_EVT_DISCONNECT_COMPLETE,
+							&evt, sizeof(evt));
+}
+
+static void write_acl(struct btsnoop *btsnoop, struct timeval *tv,
+				uint16_t index, uint16_t handle, bool out,
+				uint16_t len)
+{
+	uint8_t buf[4 + 4 + 64];
+
+	/* Start of an L2CAP frame on the ATT channel */
+	put_le16(handle | 0x2000, buf);
+	put_le16(4 + len, buf + 2);
+	put_le16(len, buf + 4);
+	put_le16(0x0004, buf + 6);
+	memset(buf + 8, len, len);
+
+	g_assert(btsnoop_write_hci(btsnoop, tv, index,
+					out ? BTSNOOP_OPCODE_ACL_TX_PKT :
+					BTSNOOP_OPCODE_ACL_RX_PKT, 0,
+					buf, 8 + len));
+}
+
+static void write_completed(struct btsnoop *btsnoop, struct timeval *tv,
+					uint16_t index, uint16_t handle)
+{
+	uint8_t evt[5];
+
+	evt[0] = 1;
+	put_le16(handle, evt + 1);
+	put_le16(1, evt + 3);
+
+	write_event(btsnoop, tv, index, BT_HCI_EVT_NUM_COMPLETED_PACKETS,
+							evt, sizeof(evt));
+}
+
+/*
+ * Controllers are interleaved in the trace, connections disconnect and a
+ * controller is removed halfway. Packets are sent at a constant rate so
+ * the latencies have a single value and no plot is drawn.
+ */
+static void write_trace(const char *path)
+{
+	struct btsnoop *btsnoop;
+	struct timeval tv;
+	unsigned int round, index, conn;
+
+	btsnoop = btsnoop_create(path, 0, 0, BTSNOOP_FORMAT_MONITOR);
+	g_assert(btsnoop);
+
+	tv.tv_sec = TEST_TIME;
+	tv.tv_usec = 0;
+
+	for (index = 0; index < NUM_INDEX; index++)
+		write_setup(btsnoop, &tv, index);
+
+	for (index = 0; index < NUM_INDEX; index++) {
+		for (conn = 0; conn < NUM_CONN; conn++)
+			write_connect(btsnoop, &tv, index, 0x40 + conn);
+	}
+
+	for (round = 0; round < NUM_ROUNDS; round++) {
+		if (round == NUM_ROUNDS / 4)
+			window_from = tv;
+
+		if (round == NUM_ROUNDS * 3 / 4)
+			window_to = tv;
+
+		for (index = 0; index < NUM_INDEX; index++) {
+			for (conn = 0; conn < NUM_CONN; conn++) {
+				struct timeval t = tv;
+				uint16_t handle = 0x40 + conn;
+
+				tick(&tv, SLOT_MSEC);
+
+				/* Last controller is gone after half */
+				if (index == NUM_INDEX - 1 &&
+						round >= NUM_ROUNDS / 2)
+					continue;
+
+				/* First connection is gone after a third */
+				if (conn == 0 && round >= NUM_ROUNDS / 3)
+					continue;
+
+				write_acl(btsnoop, &t, index, handle, true,
+							16 + round % 32);
+				tick(&t, 1);
+				write_acl(btsnoop, &t, index, handle, false,
+							16 + conn);
+				tick(&t, 1);
+				write_completed(btsnoop, &t, index, handle);
+			}
+		}
+
+		if (round + 1 == NUM_ROUNDS / 3) {
+			for (index = 0; index < NUM_INDEX; index++)
+				write_disconnect(btsnoop, &tv, index, 0x40);
+		}
+
+		if (round + 1 == NUM_ROUNDS / 2)
+			g_assert(btsnoop_write_hci(btsnoop, &tv, NUM_INDEX - 1,
+						BTSNOOP_OPCODE_DEL_INDEX, 0,
+						NULL, 0));
+	}
+
+	btsnoop_unref(btsnoop);
+}
+
+/* Run the analysis with its output redirected to a buffer */
+static char *analyze_output(unsigned int jobs, const struct timeval *from,
+				const struct timeval *to, size_t *len)
+{
+	char path[] = "/tmp/test-analyze-XXXXXX";
+	char *buf;
+	off_t size;
+	int fd, saved;
+
+	fd = mkstemp(path);
+	g_assert(fd >= 0);
+	unlink(path);
+
+	fflush(stdout);
+	saved = dup(STDOUT_FILENO);
+	g_assert(saved >= 0);
+	g_assert(dup2(fd, STDOUT_FILENO) >= 0);
+
+	analyze_trace(trace_path, from, to, jobs);
+
+	fflush(stdout);
+	g_assert(dup2(saved, STDOUT_FILENO) >= 0);
+	close(saved);
+
+	size = lseek(fd, 0, SEEK_END);
+	g_assert(size > 0);
+
+	buf = malloc(size + 1);
+	g_assert(buf);
+	g_assert(pread(fd, buf, size, 0) == size);
+	buf[size] = '\0';
+
+	close(fd);
+
+	*len = size;
+
+	return buf;
+}
+
+static void test_jobs(const void *user_data)
+{
+	const struct test_data *data = user_data;
+	const struct timeval *from = data->window ? &window_from : NULL;
+	const struct timeval *to = data->window ? &window_to : NULL;
+	char *serial, *parallel;
+	size_t serial_len, parallel_len;
+
+	serial = analyze_output(1, from, to, &serial_len);
+	parallel = analyze_output(data->jobs, from, to, &parallel_len);
+
+	tester_debug("%zu octets of output", serial_len);
+
+	g_assert(strstr(serial, "Found BR/EDR controller with index 2"));
+	g_assert(strstr(serial, "connection with handle 64"));
+
+	g_assert_cmpuint(parallel_len, ==, serial_len);
+	g_assert(!memcmp(parallel, serial, serial_len));
+
+	free(serial);
+	free(parallel);
+
+	tester_test_passed();
+}
+
+static const struct test_data jobs_2 = {
+	.jobs = 2,
+};
+
+static const struct test_data jobs_4 = {
+	.jobs = 4,
+};
+
+static const struct test_data jobs_window = {
+	.jobs = 4,
+	.window = true,
+};
+
+int main(int argc, char *argv[])
+{
+	int ret;
+
+	tester_init(&argc, &argv);
+
+	g_assert(asprintf(&trace_path, "/tmp/test-analyze-%d.btsnoop",
+							getpid()) > 0);
+	write_trace(trace_path);
+
+	tester_add("/analyze/jobs/2", &jobs_2, NULL, test_jobs, NULL);
+	tester_add("/analyze/jobs/4", &jobs_4, NULL, test_jobs, NULL);
+	tester_add("/analyze/jobs/window", &jobs_window, NULL, test_jobs,
+									NULL);
+
+	ret = tester_run();
+
+	unlink(trace_path);
+	free(trace_path);
+
+	return ret;
+}
@@ -0,0 +1,728 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2026  agent <agent@local>
+ *
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <time.h>
+#include <sys/socket.h>
+
+#include <glib.h>
+
+#include "bluetooth/bluetooth.h"
+#include "bluetooth/uuid.h"
+#include "src/shared/util.h"
+#include "src/shared/att.h"
+#include "src/shared/queue.h"
+#include "src/shared/timeout.h"
+#include "src/shared/gatt-db.h"
+#include "src/shared/gatt-server.h"
+#include "src/shared/tester.h"
+
+#define NUM_NOTIFICATIONS	50000
+#define NOTIFY_WINDOW		32
+#define NOTIFY_HANDLE		0x0003
+#define NUM_BURST		64
+#define ATT_WRITE_BURST		16	/* As in src/shared/att.c */
+#define NUM_REQUESTS		8
+#define NUM_EATT		3
+#define NUM_READS		64
+#define NUM_LARGE		4
+#define READ_DELAY		2
+#define LARGE_MTU		64
+#define LARGE_LEN		40
+#define NUM_CENTRALS		50
+#define NUM_UPDATES		200
+
+struct delayed_rsp;
+
+struct context {
+	struct bt_att *att;
+	struct bt_att *peer;
+	struct gatt_db *db;
+	struct bt_gatt_server *server;
+	unsigned int sent;
+	unsigned int received;
+	unsigned int responses;
+	unsigned int max_inflight;
+	struct delayed_rsp *held;
+	uint64_t start;
+};
+
+struct fanout {
+	struct context centrals[NUM_CENTRALS];
+	struct gatt_db *db;
+	unsigned int received;
+	uint64_t per_server;
+	uint64_t shared;
+};
+
+static uint64_t get_time_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1000000ull + ts.tv_nsec / 1000;
+}
+
+static void create_context(struct context *context)
+{
+	int sv[2];
+
+	g_assert(socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0,
+								sv) == 0);
+
+	context->att = bt_att_new(sv[0], false);
+	g_assert(context->att);
+	bt_att_set_close_on_unref(context->att, true);
+
+	context->peer = bt_att_new(sv[1], false);
+	g_assert(context->peer);
+	bt_att_set_close_on_unref(context->peer, true);
+}
+
+static void test_teardown(const void *user_data)
+{
+	struct context *context = (void *) user_data;
+
+	bt_gatt_server_unref(context->server);
+	gatt_db_unref(context->db);
+	bt_att_unref(context->att);
+	bt_att_unref(context->peer);
+
+	memset(context, 0, sizeof(*context));
+
+	tester_teardown_complete();
+}
+
+static const uint8_t iov_data[] = { 0x03, 0x00, 0x01, 0x02, 0x03, 0x04,
+								0x05, 0x06 };
+
+static void iov_cb(struct bt_att_chan *chan, uint16_t mtu, uint8_t opcode,
+					const void *pdu, uint16_t length,
+					void *user_data)
+{
+	g_assert_cmpint(opcode, ==, BT_ATT_OP_WRITE_CMD);
+	g_assert_cmpint(length, ==, sizeof(iov_data));
+	g_assert(!memcmp(pdu, iov_data, length));
+
+	tester_test_passed();
+}
+
+static void test_send_iov(const void *user_data)
+{
+	static uint8_t huge[UINT16_MAX];
+	struct context *context = (void *) user_data;
+	uint8_t large[BT_ATT_DEFAULT_LE_MTU];
+	struct iovec iov[3];
+
+	create_context(context);
+
+	bt_att_register(context->peer, BT_ATT_OP_WRITE_CMD, iov_cb, context,
+									NULL);
+
+	/* PDUs that do not fit the MTU are rejected */
+	memset(large, 0, sizeof(large));
+	iov[0].iov_base = large;
+	iov[0].iov_len = sizeof(large);
+	g_assert(!bt_att_send_iov(context->att, BT_ATT_OP_WRITE_CMD, iov, 1,
+							NULL, NULL, NULL));
+
+	/* Lengths that would wrap around a 16 bit PDU length are rejected */
+	iov[0].iov_base = huge;
+	iov[0].iov_len = UINT16_MAX;
+	g_assert(!bt_att_send_iov(context->att, BT_ATT_OP_WRITE_CMD, iov, 1,
+							NULL, NULL, NULL));
+
+	iov[0].iov_len = UINT16_MAX - 1;
+	iov[1].iov_base = huge;
+	iov[1].iov_len = 2;
+	g_assert(!bt_att_send_iov(context->att, BT_ATT_OP_WRITE_CMD, iov, 2,
+							NULL, NULL, NULL));
+
+	/* Missing data is rejected */
+	iov[0].iov_base = NULL;
+	iov[0].iov_len = 1;
+	g_assert(!bt_att_send_iov(context->att, BT_ATT_OP_WRITE_CMD, iov, 1,
+							NULL, NULL, NULL));
+
+	/* Empty vectors are skipped */
+	iov[0].iov_base = (void *) iov_data;
+	iov[0].iov_len = 2;
+	iov[1].iov_base = NULL;
+	iov[1].iov_len = 0;
+	iov[2].iov_base = (void *) (iov_data + 2);
+	iov[2].iov_len = sizeof(iov_data) - 2;
+	g_assert(bt_att_send_iov(context->att, BT_ATT_OP_WRITE_CMD, iov, 3,
+							NULL, NULL, NULL));
+}
+
+static void burst_cb(struct bt_att_chan *chan, uint16_t mtu, uint8_t opcode,
+					const void *pdu, uint16_t length,
+					void *user_data)
+{
+	struct context *context = user_data;
+	struct bt_att_write_stats stats;
+
+	g_assert_cmpint(length, ==, 4);
+	g_assert_cmpint(get_le32(pdu), ==, context->received);
+
+	if (++context->received < NUM_BURST)
+		return;
+
+	/* The socket has room for everything, so each wakeup writes a full
+	 * burst.
+	 */
+	g_assert(bt_att_get_write_stats(context->att, &stats));
+	g_assert_cmpint(stats.pdus, ==, NUM_BURST);
+	g_assert_cmpint(stats.wakeups, ==, NUM_BURST / ATT_WRITE_BURST);
+	g_assert_cmpint(stats.max_burst, ==, ATT_WRITE_BURST);
+
+	tester_debug("%u PDUs in %u wakeups, max %u per wakeup", stats.pdus,
+					stats.wakeups, stats.max_burst);
+
+	tester_test_passed();
+}
+
+static void test_write_burst(const void *user_data)
+{
+	struct context *context = (void *) user_data;
+	uint8_t value[4];
+	unsigned int i;
+
+	create_context(context);
+
+	bt_att_register(context->peer, BT_ATT_OP_WRITE_CMD, burst_cb, context,
+									NULL);
+
+	for (i = 0; i < NUM_BURST; i++) {
+		put_le32(i, value);
+		g_assert(bt_att_send(context->att, BT_ATT_OP_WRITE_CMD, value,
+					sizeof(value), NULL, NULL, NULL));
+	}
+}
+
+static void request_cb(struct bt_att_chan *chan, uint16_t mtu, uint8_t opcode,
+					const void *pdu, uint16_t length,
+					void *user_data)
+{
+	struct context *context = user_data;
+
+	/* A request may only be sent once the previous one was answered */
+	g_assert_cmpint(context->received, ==, context->responses);
+	context->received++;
+
+	bt_att_chan_send_rsp(chan, BT_ATT_OP_READ_RSP, pdu, length);
+}
+
+static void response_cb(uint8_t opcode, const void *pdu, uint16_t length,
+							void *user_data)
+{
+	struct context *context = user_data;
+
+	g_assert_cmpint(opcode, ==, BT_ATT_OP_READ_RSP);
+	g_assert_cmpint(get_le16(pdu), ==, context->responses);
+
+	if (++context->responses == NUM_REQUESTS)
+		tester_test_passed();
+}
+
+static void test_write_requests(const void *user_data)
+{
+	struct context *context = (void *) user_data;
+	uint8_t value[4];
+	unsigned int i;
+
+	create_context(context);
+
+	bt_att_register(context->peer, BT_ATT_OP_READ_REQ, request_cb,
+							context, NULL);
+
+	/* Interleave requests with commands so they share bursts */
+	for (i = 0; i < NUM_REQUESTS; i++) {
+		put_le16(i, value);
+		g_assert(bt_att_send(context->att, BT_ATT_OP_READ_REQ, value, 2,
+					response_cb, context, NULL));
+
+		put_le32(i, value);
+		g_assert(bt_att_send(context->att, BT_ATT_OP_WRITE_CMD, value,
+					sizeof(value), NULL, NULL, NULL));
+	}
+}
+
+static void send_notifications(struct context *context)
+{
+	uint8_t value[BT_ATT_DEFAULT_LE_MTU - 3];
+
+	while (context->sent < NUM_NOTIFICATIONS &&
+			context->sent - context->received < NOTIFY_WINDOW) {
+		memset(value, context->sent, sizeof(value));
+		put_le32(context->sent, value);
+
+		g_assert(bt_gatt_server_send_notification(context->server,
+					NOTIFY_HANDLE, value, sizeof(value),
+					false));
+		context->sent++;
+	}
+}
+
+static void notify_cb(struct bt_att_chan *chan, uint16_t mtu, uint8_t opcode,
+					const void *pdu, uint16_t length,
+					void *user_data)
+{
+	struct context *context = user_data;
+	uint64_t elapsed;
+
+	g_assert_cmpint(length, ==, BT_ATT_DEFAULT_LE_MTU - 1);
+	g_assert_cmpint(get_le16(pdu), ==, NOTIFY_HANDLE);
+	g_assert_cmpint(get_le32(pdu + 2), ==, context->received);
+
+	if (++context->received < NUM_NOTIFICATIONS) {
+		send_notifications(context);
+		return;
+	}
+
+	elapsed = get_time_us() - context->start;
+
+	tester_debug("%u notifications in %llu us", NUM_NOTIFICATIONS,
+					(unsigned long long) elapsed);
+
+	tester_test_passed();
+}
+
+static void test_notify_throughput(const void *user_data)
+{
+	struct context *context = (void *) user_data;
+
+	create_context(context);
+
+	context->db = gatt_db_new();
+	context->server = bt_gatt_server_new(context->db, context->att,
+						BT_ATT_DEFAULT_LE_MTU, 0);
+	g_assert(context->server);
+
+	bt_att_register(context->peer, BT_ATT_OP_HANDLE_NFY, notify_cb,
+							context, NULL);
+
+	context->start = get_time_us();
+
+	send_notifications(context);
+}
+
+static void attach_eatt(struct context *context, unsigned int count)
+{
+	unsigned int i;
+
+	for (i = 0; i < count; i++) {
+		int sv[2];
+
+		g_assert(socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0,
+								sv) == 0);
+
+		g_assert(!bt_att_attach_fd(context->att, sv[0]));
+		g_assert(!bt_att_attach_fd(context->peer, sv[1]));
+	}
+
+	g_assert_cmpint(bt_att_get_channels(context->att), ==, count + 1);
+}
+
+static void set_large_mtu(struct context *context)
+{
+	/* Only the fixed channel gets the large MTU */
+	g_assert(bt_att_set_mtu(context->att, LARGE_MTU));
+	g_assert(bt_att_set_mtu(context->peer, LARGE_MTU));
+}
+
+struct delayed_rsp {
+	struct bt_att_chan *chan;
+	uint16_t length;
+	uint8_t pdu[LARGE_MTU];
+};
+
+static bool delayed_rsp_cb(void *user_data)
+{
+	struct delayed_rsp *rsp = user_data;
+
+	bt_att_chan_send_rsp(rsp->chan, BT_ATT_OP_READ_RSP, rsp->pdu,
+								rsp->length);
+
+	return false;
+}
+
+static void delayed_request_cb(struct bt_att_chan *chan, uint16_t mtu,
+					uint8_t opcode, const void *pdu,
+					uint16_t length, void *user_data)
+{
+	struct context *context = user_data;
+	struct delayed_rsp *rsp;
+
+	context->received++;
+
+	if (context->received - context->responses > context->max_inflight)
+		context->max_inflight = context->received - context->responses;
+
+	rsp = new0(struct delayed_rsp, 1);
+	rsp->chan = chan;
+	rsp->length = length;
+	memcpy(rsp->pdu, pdu, length);
+
+	timeout_add(READ_DELAY, delayed_rsp_cb, rsp, free);
+}
+
+static void print_chan_stats(struct context *context)
+{
+	struct bt_att_chan_stats stats;
+	unsigned int i;
+
+	for (i = 0; bt_att_get_chan_stats(context->att, i, &stats); i++)
+		tester_debug("chan %u type %u mtu %u: %u requests, "
+				"latency %u us max %u us", i, stats.type,
+				stats.mtu, stats.requests, stats.latency,
+				stats.max_latency);
+}
+
+static void send_reads(struct context *context, unsigned int count,
+					bt_att_response_func_t callback)
+{
+	uint8_t value[2];
+	unsigned int i;
+
+	context->start = get_time_us();
+
+	for (i = 0; i < count; i++) {
+		put_le16(i, value);
+		g_assert(bt_att_send(context->att, BT_ATT_OP_READ_REQ, value,
+					sizeof(value), callback, context,
+					NULL));
+	}
+}
+
+static void parallel_rsp_cb(uint8_t opcode, const void *pdu, uint16_t length,
+								void *user_data)
+{
+	struct context *context = user_data;
+	struct bt_att_chan_stats stats;
+	uint64_t elapsed;
+	unsigned int i;
+	int chans;
+
+	g_assert_cmpint(opcode, ==, BT_ATT_OP_READ_RSP);
+
+	if (++context->responses < NUM_READS)
+		return;
+
+	elapsed = get_time_us() - context->start;
+	chans = bt_att_get_channels(context->att);
+
+	print_chan_stats(context);
+	tester_debug("%u reads over %d channels in %llu us", NUM_READS, chans,
+					(unsigned long long) elapsed);
+
+	/* A single bearer only ever has one request outstanding */
+	if (chans == 1) {
+		g_assert_cmpint(context->max_inflight, ==, 1);
+		tester_test_passed();
+		return;
+	}
+
+	/* Every bearer must have carried part of the load, concurrently */
+	for (i = 0; bt_att_get_chan_stats(context->att, i, &stats); i++)
+		g_assert_cmpint(stats.requests, >, 0);
+
+	g_assert_cmpint(context->max_inflight, >, 1);
+
+	tester_test_passed();
+}
+
+static void test_eatt_single(const void *user_data)
+{
+	struct context *context = (void *) user_data;
+
+	create_context(context);
+
+	bt_att_register(context->peer, BT_ATT_OP_READ_REQ, delayed_request_cb,
+								context, NULL);
+
+	send_reads(context, NUM_READS, parallel_rsp_cb);
+}
+
+static void test_eatt_parallel(const void *user_data)
+{
+	struct context *context = (void *) user_data;
+
+	create_context(context);
+	attach_eatt(context, NUM_EATT);
+
+	bt_att_register(context->peer, BT_ATT_OP_READ_REQ, delayed_request_cb,
+								context, NULL);
+
+	send_reads(context, NUM_READS, parallel_rsp_cb);
+}
+
+static void mtu_rsp_cb(uint8_t opcode, const void *pdu, uint16_t length,
+								void *user_data)
+{
+	struct context *context = user_data;
+
+	g_assert_cmpint(opcode, ==, BT_ATT_OP_READ_RSP);
+
+	/* Small requests must not wait for the large ones ahead of them
+	 * that only the fixed channel can carry.
+	 */
+	if (length == LARGE_LEN && !context->sent++)
+		g_assert_cmpint(context->received, >, 1);
+
+	if (++context->responses == NUM_LARGE + NUM_READS)
+		tester_test_passed();
+}
+
+static void test_eatt_mtu(const void *user_data)
+{
+	struct context *context = (void *) user_data;
+	uint8_t value[LARGE_LEN];
+	unsigned int i;
+
+	create_context(context);
+	attach_eatt(context, NUM_EATT);
+	set_large_mtu(context);
+
+	bt_att_register(context->peer, BT_ATT_OP_READ_REQ, delayed_request_cb,
+								context, NULL);
+
+	memset(value, 0, sizeof(value));
+
+	for (i = 0; i < NUM_LARGE; i++)
+		g_assert(bt_att_send(context->att, BT_ATT_OP_READ_REQ, value,
+					sizeof(value), mtu_rsp_cb, context,
+					NULL));
+
+	send_reads(context, NUM_READS, mtu_rsp_cb);
+}
+
+static void held_request_cb(struct bt_att_chan *chan, uint16_t mtu,
+					uint8_t opcode, const void *pdu,
+					uint16_t length, void *user_data)
+{
+	struct context *context = user_data;
+	struct delayed_rsp *rsp;
+
+	/* The large MTU channel stalls until everything else is done */
+	if (mtu != LARGE_MTU) {
+		delayed_request_cb(chan, mtu, opcode, pdu, length, user_data);
+		return;
+	}
+
+	g_assert(!context->held);
+
+	rsp = new0(struct delayed_rsp, 1);
+	rsp->chan = chan;
+	rsp->length = length;
+	memcpy(rsp->pdu, pdu, length);
+
+	context->held = rsp;
+}
+
+static void latency_rsp_cb(uint8_t opcode, const void *pdu, uint16_t length,
+								void *user_data)
+{
+	struct context *context = user_data;
+	struct bt_att_chan_stats stats, slow;
+	unsigned int i, requests = 0;
+
+	context->responses++;
+
+	if (context->responses == NUM_READS - 1 && context->held) {
+		delayed_rsp_cb(context->held);
+		free(context->held);
+		context->held = NULL;
+		return;
+	}
+
+	if (context->responses < NUM_READS)
+		return;
+
+	print_chan_stats(context);
+
+	/* The fixed channel is the last one and the stalled one, it must
+	 * not have been given more work while busy.
+	 */
+	g_assert(bt_att_get_chan_stats(context->att, NUM_EATT, &slow));
+	g_assert_cmpint(slow.mtu, ==, LARGE_MTU);
+	g_assert_cmpint(slow.requests, ==, 1);
+
+	for (i = 0; i < NUM_EATT; i++) {
+		g_assert(bt_att_get_chan_stats(context->att, i, &stats));
+		g_assert_cmpint(stats.requests, >, 0);
+		requests += stats.requests;
+	}
+
+	g_assert_cmpint(requests, ==, NUM_READS - 1);
+
+	tester_test_passed();
+}
+
+static void test_eatt_latency(const void *user_data)
+{
+	struct context *context = (void *) user_data;
+
+	create_context(context);
+	attach_eatt(context, NUM_EATT);
+	set_large_mtu(context);
+
+	bt_att_register(context->peer, BT_ATT_OP_READ_REQ, held_request_cb,
+								context, NULL);
+
+	send_reads(context, NUM_READS, latency_rsp_cb);
+}
+
+static void fanout_teardown(const void *user_data)
+{
+	struct fanout *fanout = (void *) user_data;
+	unsigned int i;
+
+	for (i = 0; i < NUM_CENTRALS; i++) {
+		struct context *context = &fanout->centrals[i];
+
+		bt_gatt_server_unref(context->server);
+		bt_att_unref(context->att);
+		bt_att_unref(context->peer);
+	}
+
+	gatt_db_unref(fanout->db);
+
+	memset(fanout, 0, sizeof(*fanout));
+
+	tester_teardown_complete();
+}
+
+static void fanout_notify_cb(struct bt_att_chan *chan, uint16_t mtu,
+					uint8_t opcode, const void *pdu,
+					uint16_t length, void *user_data)
+{
+	struct context *context = user_data;
+	struct fanout *fanout = (void *) context->db;
+
+	/* Both rounds deliver the same updates in order */
+	g_assert_cmpint(length, ==, BT_ATT_DEFAULT_LE_MTU - 1);
+	g_assert_cmpint(get_le16(pdu), ==, NOTIFY_HANDLE);
+	g_assert_cmpint(get_le32(pdu + 2), ==,
+					context->received++ % NUM_UPDATES);
+
+	if (++fanout->received < 2 * NUM_CENTRALS * NUM_UPDATES)
+		return;
+
+	tester_debug("%u updates to %u centrals: per server %llu us "
+				"shared %llu us", NUM_UPDATES, NUM_CENTRALS,
+				(unsigned long long) fanout->per_server,
+				(unsigned long long) fanout->shared);
+
+	tester_test_passed();
+}
+
+static void test_notify_fanout(const void *user_data)
+{
+	struct fanout *fanout = (void *) user_data;
+	uint8_t value[BT_ATT_DEFAULT_LE_MTU - 3];
+	uint64_t start;
+	unsigned int i, j;
+
+	fanout->db = gatt_db_new();
+
+	for (i = 0; i < NUM_CENTRALS; i++) {
+		struct context *context = &fanout->centrals[i];
+
+		create_context(context);
+
+		context->server = bt_gatt_server_new(fanout->db, context->att,
+						BT_ATT_DEFAULT_LE_MTU, 0);
+		g_assert(context->server);
+
+		/* Only used to find the fanout from the callback */
+		context->db = (void *) fanout;
+
+		bt_att_register(context->peer, BT_ATT_OP_HANDLE_NFY,
+					fanout_notify_cb, context, NULL);
+	}
+
+	/* Every server encodes its own PDU */
+	start = get_time_us();
+
+	for (i = 0; i < NUM_UPDATES; i++) {
+		memset(value, i, sizeof(value));
+		put_le32(i, value);
+
+		for (j = 0; j < NUM_CENTRALS; j++)
+			g_assert(bt_gatt_server_send_notification(
+					fanout->centrals[j].server,
+					NOTIFY_HANDLE, value, sizeof(value),
+					false));
+	}
+
+	fanout->per_server = get_time_us() - start;
+
+	/* The PDU is encoded once and shared by all servers */
+	start = get_time_us();
+
+	for (i = 0; i < NUM_UPDATES; i++) {
+		struct bt_gatt_notification *nfy;
+
+		memset(value, i, sizeof(value));
+		put_le32(i, value);
+
+		nfy = bt_gatt_notification_new(NOTIFY_HANDLE, value,
+								sizeof(value));
+		g_assert(nfy);
+
+		for (j = 0; j < NUM_CENTRALS; j++)
+			g_assert(bt_gatt_server_send_notification_pdu(
+					fanout->centrals[j].server, nfy,
+					false));
+
+		bt_gatt_notification_unref(nfy);
+	}
+
+	fanout->shared = get_time_us() - start;
+}
+
+int main(int argc, char *argv[])
+{
+	static struct context iov_context, burst_context, request_context;
+	static struct context notify_context, single_context;
+	static struct context parallel_context, mtu_context, latency_context;
+	static struct fanout fanout;
+
+	tester_init(&argc, &argv);
+
+	tester_add("/att/send/iov", &iov_context, NULL, test_send_iov,
+							test_teardown);
+	tester_add("/att/write/burst", &burst_context, NULL,
+					test_write_burst, test_teardown);
+	tester_add("/att/write/requests", &request_context, NULL,
+					test_write_requests, test_teardown);
+	tester_add("/att/notify/throughput", &notify_context, NULL,
+					test_notify_throughput, test_teardown);
+	tester_add("/att/notify/fanout", &fanout, NULL, test_notify_fanout,
+							fanout_teardown);
+	tester_add("/att/eatt/single", &single_context, NULL,
+					test_eatt_single, test_teardown);
+	tester_add("/att/eatt/parallel", &parallel_context, NULL,
+					test_eatt_parallel, test_teardown);
+	tester_add("/att/eatt/mtu", &mtu_context, NULL, test_eatt_mtu,
+							test_teardown);
+	tester_add("/att/eatt/latency", &latency_context, NULL,
+					test_eatt_latency, test_teardown);
+
+	return tester_run();
+}
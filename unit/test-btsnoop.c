@@ -0,0 +1,441 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2026  agent <agent@local>
+ *
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+#include <signal.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+
+#include <glib.h>
+
+#include "src/shared/btsnoop.h"
+#include "src/shared/tester.h"
+
+#define NUM_RECORDS	20000
+#define TEST_TIME	1700000000
+
+struct test_data {
+	size_t max_size;
+	unsigned int max_count;
+	size_t buffer_size;
+};
+
+static void write_records(struct btsnoop *btsnoop, uint16_t max_len)
+{
+	uint8_t data[BTSNOOP_MAX_PACKET_SIZE];
+	unsigned int i;
+
+	for (i = 0; i < NUM_RECORDS; i++) {
+		struct timeval tv;
+		uint16_t len = (i * 37) % max_len;
+
+		tv.tv_sec = TEST_TIME + i;
+		tv.tv_usec = i % 1000000;
+
+		memset(data, i, len);
+
+		g_assert(btsnoop_write_hci(btsnoop, &tv, 0,
+						BTSNOOP_OPCODE_EVENT_PKT, 0,
+						data, len));
+	}
+}
+
+static void compare_files(const char *path1, const char *path2)
+{
+	uint8_t buf1[4096], buf2[4096];
+	int fd1, fd2;
+	ssize_t len1, len2;
+
+	fd1 = open(path1, O_RDONLY);
+	g_assert(fd1 >= 0);
+
+	fd2 = open(path2, O_RDONLY);
+	g_assert(fd2 >= 0);
+
+	do {
+		len1 = read(fd1, buf1, sizeof(buf1));
+		len2 = read(fd2, buf2, sizeof(buf2));
+
+		g_assert(len1 == len2);
+		g_assert(!memcmp(buf1, buf2, len1));
+	} while (len1 > 0);
+
+	close(fd1);
+	close(fd2);
+}
+
+static uint64_t get_time_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1000000ull + ts.tv_nsec / 1000;
+}
+
+static void test_write(const void *user_data)
+{
+	const struct test_data *test = user_data;
+	char path1[] = "/tmp/btsnoop-direct-XXXXXX";
+	char path2[] = "/tmp/btsnoop-buffer-XXXXXX";
+	char name1[PATH_MAX], name2[PATH_MAX];
+	struct btsnoop *btsnoop;
+	uint64_t start, direct, buffered;
+	unsigned int i, count;
+	int fd;
+
+	fd = mkstemp(path1);
+	g_assert(fd >= 0);
+	close(fd);
+
+	fd = mkstemp(path2);
+	g_assert(fd >= 0);
+	close(fd);
+
+	btsnoop = btsnoop_create(path1, test->max_size, test->max_count,
+						BTSNOOP_FORMAT_MONITOR);
+	g_assert(btsnoop);
+
+	start = get_time_us();
+	write_records(btsnoop, test->max_size ? 300 : 1490);
+	btsnoop_unref(btsnoop);
+	direct = get_time_us() - start;
+
+	btsnoop = btsnoop_create(path2, test->max_size, test->max_count,
+						BTSNOOP_FORMAT_MONITOR);
+	g_assert(btsnoop);
+	g_assert(btsnoop_set_buffer(btsnoop, test->buffer_size, 0));
+
+	start = get_time_us();
+	write_records(btsnoop, test->max_size ? 300 : 1490);
+	btsnoop_unref(btsnoop);
+	buffered = get_time_us() - start;
+
+	tester_debug("%u records: direct %llu us buffered %llu us",
+				NUM_RECORDS, (unsigned long long) direct,
+				(unsigned long long) buffered);
+
+	if (!test->max_size) {
+		compare_files(path1, path2);
+		goto done;
+	}
+
+	/* Rotated files must be identical, including the rotation points */
+	count = 0;
+
+	for (i = 0; i < UINT_MAX; i++) {
+		struct stat st;
+
+		snprintf(name1, sizeof(name1), "%s.%u", path1, i);
+		snprintf(name2, sizeof(name2), "%s.%u", path2, i);
+
+		if (stat(name1, &st) < 0) {
+			g_assert(stat(name2, &st) < 0);
+
+			if (count)
+				break;
+
+			continue;
+		}
+
+		g_assert(st.st_size <= (off_t) test->max_size);
+
+		compare_files(name1, name2);
+
+		unlink(name1);
+		unlink(name2);
+		count++;
+	}
+
+	if (test->max_count)
+		g_assert(count == test->max_count);
+
+done:
+	unlink(path1);
+	unlink(path2);
+
+	tester_test_passed();
+}
+
+static void test_read(const void *user_data)
+{
+	char path[] = "/tmp/btsnoop-read-XXXXXX";
+	uint8_t data[BTSNOOP_MAX_PACKET_SIZE];
+	struct btsnoop *btsnoop;
+	struct timeval tv;
+	uint16_t index, opcode, size;
+	unsigned int count = 0;
+	int fd;
+
+	fd = mkstemp(path);
+	g_assert(fd >= 0);
+	close(fd);
+
+	btsnoop = btsnoop_create(path, 0, 0, BTSNOOP_FORMAT_MONITOR);
+	g_assert(btsnoop);
+	g_assert(btsnoop_set_buffer(btsnoop, 8192, 0));
+	write_records(btsnoop, 1490);
+	btsnoop_unref(btsnoop);
+
+	btsnoop = btsnoop_open(path, 0);
+	g_assert(btsnoop);
+
+	while (btsnoop_read_hci(btsnoop, &tv, &index, &opcode, data, &size)) {
+		g_assert(index == 0);
+		g_assert(opcode == BTSNOOP_OPCODE_EVENT_PKT);
+		g_assert(size == (count * 37) % 1490);
+		g_assert(tv.tv_sec == (time_t) (TEST_TIME + count));
+		count++;
+	}
+
+	g_assert(count == NUM_RECORDS);
+
+	btsnoop_unref(btsnoop);
+	unlink(path);
+
+	tester_test_passed();
+}
+
+/*
+ * Limits the file size so that writing the buffer fails part way through,
+ * nothing buffered may be lost and the file must stay readable once the
+ * limit is lifted again.
+ */
+static void test_write_failure(const void *user_data)
+{
+	char path[] = "/tmp/btsnoop-fail-XXXXXX";
+	uint8_t data[BTSNOOP_MAX_PACKET_SIZE];
+	struct btsnoop *btsnoop;
+	struct rlimit old, lim;
+	struct timeval tv;
+	struct stat st;
+	uint16_t index, opcode, size;
+	unsigned int i, count = 0;
+	off_t total = 16;
+	int fd;
+
+	fd = mkstemp(path);
+	g_assert(fd >= 0);
+	close(fd);
+
+	btsnoop = btsnoop_create(path, 0, 0, BTSNOOP_FORMAT_MONITOR);
+	g_assert(btsnoop);
+	g_assert(btsnoop_set_buffer(btsnoop, 8192, 0));
+
+	signal(SIGXFSZ, SIG_IGN);
+	g_assert(getrlimit(RLIMIT_FSIZE, &old) == 0);
+	lim = old;
+	lim.rlim_cur = 20011;
+	g_assert(setrlimit(RLIMIT_FSIZE, &lim) == 0);
+
+	for (i = 0; i < 100; i++) {
+		tv.tv_sec = TEST_TIME + i;
+		tv.tv_usec = 0;
+
+		memset(data, i, (i * 37) % 1490);
+
+		if (!btsnoop_write_hci(btsnoop, &tv, 0,
+					BTSNOOP_OPCODE_EVENT_PKT, 0, data,
+					(i * 37) % 1490))
+			break;
+	}
+
+	g_assert(i < 100);
+	g_assert(!btsnoop_flush(btsnoop));
+
+	g_assert(setrlimit(RLIMIT_FSIZE, &old) == 0);
+	signal(SIGXFSZ, SIG_DFL);
+
+	g_assert(btsnoop_flush(btsnoop));
+	btsnoop_unref(btsnoop);
+
+	btsnoop = btsnoop_open(path, 0);
+	g_assert(btsnoop);
+
+	while (btsnoop_read_hci(btsnoop, &tv, &index, &opcode, data, &size)) {
+		g_assert(tv.tv_sec == (time_t) (TEST_TIME + count));
+		g_assert(size == (count * 37) % 1490);
+		total += 24 + size;
+		count++;
+	}
+
+	btsnoop_unref(btsnoop);
+
+	/* Only the record that failed may be missing, nothing is torn */
+	g_assert(count == i || count == i + 1);
+	g_assert(stat(path, &st) == 0);
+	g_assert(st.st_size == total);
+
+	unlink(path);
+
+	tester_test_passed();
+}
+
+static void test_index(const void *user_data)
+{
+	char path[] = "/tmp/btsnoop-index-XXXXXX";
+	uint8_t data[BTSNOOP_MAX_PACKET_SIZE];
+	struct btsnoop *btsnoop;
+	struct timeval tv;
+	const void *ptr;
+	uint16_t index, opcode, size;
+	unsigned int count = 0;
+	size_t pos;
+	int fd;
+
+	fd = mkstemp(path);
+	g_assert(fd >= 0);
+	close(fd);
+
+	btsnoop = btsnoop_create(path, 0, 0, BTSNOOP_FORMAT_MONITOR);
+	g_assert(btsnoop);
+	write_records(btsnoop, 1490);
+	btsnoop_unref(btsnoop);
+
+	btsnoop = btsnoop_open(path, 0);
+	g_assert(btsnoop);
+	g_assert(btsnoop_index(btsnoop));
+	g_assert(btsnoop_get_count(btsnoop) == NUM_RECORDS);
+
+	/* Random access returns the payload in place */
+	for (pos = 0; pos < NUM_RECORDS; pos += 7) {
+		g_assert(btsnoop_peek_hci(btsnoop, pos, &tv, &index, &opcode,
+								&ptr, &size));
+		g_assert(tv.tv_sec == (time_t) (TEST_TIME + pos));
+		g_assert(size == (pos * 37) % 1490);
+
+		memset(data, pos, size);
+		g_assert(!memcmp(ptr, data, size));
+	}
+
+	g_assert(!btsnoop_peek_hci(btsnoop, NUM_RECORDS, &tv, &index,
+						&opcode, &ptr, &size));
+
+	/* Seek by time lands on the first packet not older than it */
+	tv.tv_sec = TEST_TIME + NUM_RECORDS / 2;
+	tv.tv_usec = 0;
+	g_assert(btsnoop_seek_time(btsnoop, &tv));
+	g_assert(btsnoop_tell(btsnoop) == NUM_RECORDS / 2);
+
+	tv.tv_usec = 999999;
+	g_assert(btsnoop_seek_time(btsnoop, &tv));
+	g_assert(btsnoop_tell(btsnoop) == NUM_RECORDS / 2 + 1);
+
+	tv.tv_sec = TEST_TIME + NUM_RECORDS;
+	g_assert(!btsnoop_seek_time(btsnoop, &tv));
+
+	/* Sequential reads continue from the seek position */
+	g_assert(btsnoop_seek(btsnoop, NUM_RECORDS - 10));
+
+	while (btsnoop_read_hci(btsnoop, &tv, &index, &opcode, data, &size)) {
+		g_assert(tv.tv_sec == (time_t) (TEST_TIME + NUM_RECORDS -
+								10 + count));
+		count++;
+	}
+
+	g_assert(count == 10);
+
+	btsnoop_unref(btsnoop);
+	unlink(path);
+
+	tester_test_passed();
+}
+
+static void test_index_truncated(const void *user_data)
+{
+	char path[] = "/tmp/btsnoop-trunc-XXXXXX";
+	uint8_t data[BTSNOOP_MAX_PACKET_SIZE];
+	struct btsnoop *btsnoop;
+	struct timeval tv;
+	struct stat st;
+	uint16_t index, opcode, size;
+	unsigned int count = 0;
+	int fd;
+
+	fd = mkstemp(path);
+	g_assert(fd >= 0);
+	close(fd);
+
+	btsnoop = btsnoop_create(path, 0, 0, BTSNOOP_FORMAT_MONITOR);
+	g_assert(btsnoop);
+	write_records(btsnoop, 1490);
+	btsnoop_unref(btsnoop);
+
+	/* Cut the last packet in half */
+	g_assert(stat(path, &st) == 0);
+	g_assert(truncate(path, st.st_size - 10) == 0);
+
+	btsnoop = btsnoop_open(path, 0);
+	g_assert(btsnoop);
+	g_assert(btsnoop_index(btsnoop));
+	g_assert(btsnoop_get_count(btsnoop) == NUM_RECORDS - 1);
+
+	while (btsnoop_read_hci(btsnoop, &tv, &index, &opcode, data, &size))
+		count++;
+
+	g_assert(count == NUM_RECORDS - 1);
+
+	btsnoop_unref(btsnoop);
+	unlink(path);
+
+	tester_test_passed();
+}
+
+static const struct test_data buffer_small = {
+	.buffer_size = 1,
+};
+
+static const struct test_data buffer_large = {
+	.buffer_size = 65536,
+};
+
+static const struct test_data rotate_buffer = {
+	.max_size = 100000,
+	.buffer_size = 8192,
+};
+
+static const struct test_data rotate_count_buffer = {
+	.max_size = 100000,
+	.max_count = 3,
+	.buffer_size = 16384,
+};
+
+int main(int argc, char *argv[])
+{
+	tester_init(&argc, &argv);
+
+	tester_add("/btsnoop/buffer/small", &buffer_small, NULL,
+							test_write, NULL);
+	tester_add("/btsnoop/buffer/large", &buffer_large, NULL,
+							test_write, NULL);
+	tester_add("/btsnoop/buffer/rotate", &rotate_buffer, NULL,
+							test_write, NULL);
+	tester_add("/btsnoop/buffer/rotate-count", &rotate_count_buffer, NULL,
+							test_write, NULL);
+	tester_add("/btsnoop/buffer/read", NULL, NULL, test_read, NULL);
+	tester_add("/btsnoop/buffer/write-failure", NULL, NULL,
+						test_write_failure, NULL);
+	tester_add("/btsnoop/index/seek", NULL, NULL, test_index, NULL);
+	tester_add("/btsnoop/index/truncated", NULL, NULL,
+						test_index_truncated, NULL);
+
+	return tester_run();
+}
@@ -17,6 +17,7 @@
 #include "src/shared/tester.h"
 
 #include <string.h>
+#include <time.h>
 #include <glib.h>
 
 static struct bt_crypto *crypto;
@@ -383,6 +384,272 @@ static void test_sih(const void *data)
 	tester_test_passed();
 }
 
+#define BENCH_COUNT	10000
+
+static const enum bt_crypto_backend backends[] = {
+	BT_CRYPTO_BACKEND_DEFAULT,
+	BT_CRYPTO_BACKEND_GENERIC,
+	BT_CRYPTO_BACKEND_AF_ALG,
+};
+
+static void test_aes(const void *data)
+{
+	/* FIPS-197 Appendix C.1, in least significant octet first order */
+	const uint8_t key[16] = {
+			0x0f, 0x0e, 0x0d, 0x0c, 0x0b, 0x0a, 0x09, 0x08,
+			0x07, 0x06, 0x05, 0x04, 0x03, 0x02, 0x01, 0x00 };
+	const uint8_t plaintext[16] = {
+			0xff, 0xee, 0xdd, 0xcc, 0xbb, 0xaa, 0x99, 0x88,
+			0x77, 0x66, 0x55, 0x44, 0x33, 0x22, 0x11, 0x00 };
+	const uint8_t exp[16] = {
+			0x5a, 0xc5, 0xb4, 0x70, 0x80, 0xb7, 0xcd, 0xd8,
+			0x30, 0x04, 0x7b, 0x6a, 0xd8, 0xe0, 0xc4, 0x69 };
+	uint8_t res[16];
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(backends); i++) {
+		struct bt_crypto *c = bt_crypto_new_backend(backends[i]);
+
+		if (!c)
+			continue;
+
+		tester_debug("Backend: %s", bt_crypto_get_backend(c));
+
+		g_assert(bt_crypto_e(c, key, plaintext, res));
+		g_assert(!memcmp(res, exp, 16));
+
+		bt_crypto_unref(c);
+	}
+
+	tester_test_passed();
+}
+
+static void test_backend(const void *data)
+{
+	struct bt_crypto *ref, *c;
+	uint8_t key[16], msg[80], res1[16], res2[16];
+	struct iovec iov[3];
+	unsigned int i, len;
+
+	ref = bt_crypto_new_backend(BT_CRYPTO_BACKEND_GENERIC);
+	g_assert(ref);
+
+	for (i = 0; i < ARRAY_SIZE(backends); i++) {
+		if (backends[i] == BT_CRYPTO_BACKEND_GENERIC)
+			continue;
+
+		c = bt_crypto_new_backend(backends[i]);
+		if (!c)
+			continue;
+
+		tester_debug("Comparing %s with %s", bt_crypto_get_backend(c),
+						bt_crypto_get_backend(ref));
+
+		for (len = 0; len <= sizeof(msg); len++) {
+			g_assert(bt_crypto_random_bytes(ref, key, sizeof(key)));
+			g_assert(bt_crypto_random_bytes(ref, msg, sizeof(msg)));
+
+			g_assert(bt_crypto_e(ref, key, msg, res1));
+			g_assert(bt_crypto_e(c, key, msg, res2));
+			g_assert(!memcmp(res1, res2, 16));
+
+			/* Split the message to cover partial blocks */
+			iov[0].iov_base = msg;
+			iov[0].iov_len = len / 3;
+			iov[1].iov_base = msg + len / 3;
+			iov[1].iov_len = len / 2 - len / 3;
+			iov[2].iov_base = msg + len / 2;
+			iov[2].iov_len = len - len / 2;
+
+			g_assert(bt_crypto_gatt_hash(ref, iov, 3, res1));
+			g_assert(bt_crypto_gatt_hash(c, iov, 3, res2));
+			g_assert(!memcmp(res1, res2, 16));
+
+			if (len > sizeof(msg) - 4)
+				continue;
+
+			g_assert(bt_crypto_sign_att(ref, key, msg, len, len,
+								res1));
+			g_assert(bt_crypto_sign_att(c, key, msg, len, len,
+								res2));
+			g_assert(!memcmp(res1, res2, 12));
+		}
+
+		bt_crypto_unref(c);
+	}
+
+	bt_crypto_unref(ref);
+
+	tester_test_passed();
+}
+
+static uint64_t get_time_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1000000ull + ts.tv_nsec / 1000;
+}
+
+static void test_benchmark(const void *data)
+{
+	const uint8_t key[16] = {};
+	uint8_t msg[32] = {}, res[16];
+	uint64_t start, ah, sign;
+	unsigned int i, j;
+
+	for (i = 0; i < ARRAY_SIZE(backends); i++) {
+		struct bt_crypto *c = bt_crypto_new_backend(backends[i]);
+
+		if (!c)
+			continue;
+
+		start = get_time_us();
+
+		for (j = 0; j < BENCH_COUNT; j++)
+			g_assert(bt_crypto_ah(c, key, msg, res));
+
+		ah = get_time_us() - start;
+		start = get_time_us();
+
+		for (j = 0; j < BENCH_COUNT; j++)
+			g_assert(bt_crypto_sign_att(c, key, msg, sizeof(msg),
+								j, res));
+
+		sign = get_time_us() - start;
+
+		tester_debug("%s: %u ah %llu us, %u sign_att %llu us",
+					bt_crypto_get_backend(c), BENCH_COUNT,
+					(unsigned long long) ah, BENCH_COUNT,
+					(unsigned long long) sign);
+
+		bt_crypto_unref(c);
+	}
+
+	tester_test_passed();
+}
+
+struct resolver_data {
+	unsigned int num_irks;
+};
+
+static const struct resolver_data resolver_1k = {
+	.num_irks = 1000,
+};
+
+static const struct resolver_data resolver_10k = {
+	.num_irks = 10000,
+};
+
+#define RESOLVE_COUNT	100
+
+static void generate_rpa(const uint8_t irk[16], uint8_t rpa[6])
+{
+	g_assert(bt_crypto_random_bytes(crypto, rpa + 3, 3));
+
+	rpa[5] &= 0x3f;
+	rpa[5] |= 0x40;
+
+	g_assert(bt_crypto_ah(crypto, irk, rpa + 3, rpa));
+}
+
+static void test_resolver(const void *data)
+{
+	const struct resolver_data *d = data;
+	struct bt_crypto_resolver *resolver;
+	uint8_t (*irks)[16];
+	uint8_t rpa[RESOLVE_COUNT][6], hash[3];
+	uintptr_t expect[RESOLVE_COUNT];
+	uint64_t start, naive, batch, cached;
+	unsigned int i, j;
+
+	irks = g_malloc0(d->num_irks * sizeof(*irks));
+
+	for (i = 0; i < d->num_irks; i++)
+		g_assert(bt_crypto_random_bytes(crypto, irks[i], 16));
+
+	resolver = bt_crypto_resolver_new(crypto, 256);
+	g_assert(resolver);
+
+	for (i = 0; i < d->num_irks; i++)
+		g_assert(bt_crypto_resolver_add(resolver, irks[i],
+						(void *) (uintptr_t) (i + 1)));
+
+	g_assert(bt_crypto_resolver_get_count(resolver) == d->num_irks);
+
+	/* Every other address belongs to an unknown device */
+	for (i = 0; i < RESOLVE_COUNT; i++) {
+		if (i % 2) {
+			uint8_t irk[16];
+
+			g_assert(bt_crypto_random_bytes(crypto, irk, 16));
+			generate_rpa(irk, rpa[i]);
+			expect[i] = 0;
+		} else {
+			expect[i] = (i * 7919) % d->num_irks + 1;
+			generate_rpa(irks[expect[i] - 1], rpa[i]);
+		}
+	}
+
+	start = get_time_us();
+
+	for (i = 0; i < RESOLVE_COUNT; i++) {
+		uintptr_t found = 0;
+
+		for (j = 0; j < d->num_irks; j++) {
+			g_assert(bt_crypto_ah(crypto, irks[j], rpa[i] + 3,
+								hash));
+			if (!memcmp(hash, rpa[i], 3)) {
+				found = j + 1;
+				break;
+			}
+		}
+
+		g_assert(found == expect[i]);
+	}
+
+	naive = get_time_us() - start;
+	start = get_time_us();
+
+	for (i = 0; i < RESOLVE_COUNT; i++)
+		g_assert((uintptr_t) bt_crypto_resolver_resolve(resolver,
+							rpa[i]) == expect[i]);
+
+	batch = get_time_us() - start;
+	start = get_time_us();
+
+	for (i = 0; i < RESOLVE_COUNT; i++)
+		g_assert((uintptr_t) bt_crypto_resolver_resolve(resolver,
+							rpa[i]) == expect[i]);
+
+	cached = get_time_us() - start;
+
+	tester_debug("%u IRKs, %u RPAs: ah %llu us, resolver %llu us, "
+				"cached %llu us", d->num_irks, RESOLVE_COUNT,
+				(unsigned long long) naive,
+				(unsigned long long) batch,
+				(unsigned long long) cached);
+
+	/* Removing an IRK must invalidate cached results */
+	g_assert(bt_crypto_resolver_remove(resolver,
+					(void *) (uintptr_t) expect[0]));
+	g_assert(!bt_crypto_resolver_resolve(resolver, rpa[0]));
+	g_assert(!bt_crypto_resolver_remove(resolver,
+					(void *) (uintptr_t) expect[0]));
+
+	/* As must adding one back for a previously unresolved address */
+	g_assert(bt_crypto_resolver_add(resolver, irks[expect[0] - 1],
+					(void *) (uintptr_t) expect[0]));
+	g_assert((uintptr_t) bt_crypto_resolver_resolve(resolver, rpa[0]) ==
+								expect[0]);
+
+	bt_crypto_resolver_free(resolver);
+	g_free(irks);
+
+	tester_test_passed();
+}
+
 int main(int argc, char *argv[])
 {
 	int exit_status;
@@ -412,6 +679,15 @@ int main(int argc, char *argv[])
 	tester_add("/crypto/sef", NULL, NULL, test_sef, NULL);
 	tester_add("/crypto/sih", NULL, NULL, test_sih, NULL);
 
+	tester_add("/crypto/aes", NULL, NULL, test_aes, NULL);
+	tester_add("/crypto/backend", NULL, NULL, test_backend, NULL);
+	tester_add("/crypto/benchmark", NULL, NULL, test_benchmark, NULL);
+
+	tester_add("/crypto/resolver/1k", &resolver_1k, NULL, test_resolver,
+									NULL);
+	tester_add("/crypto/resolver/10k", &resolver_10k, NULL, test_resolver,
+									NULL);
+
 	exit_status = tester_run();
 
 	bt_crypto_unref(crypto);
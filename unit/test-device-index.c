@@ -0,0 +1,204 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2026  agent <agent@local>
+ *
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include <glib.h>
+
+#include "bluetooth/bluetooth.h"
+
+#include "src/shared/tester.h"
+#include "src/device-index.h"
+
+#define NUM_DEVICES	10000
+#define NUM_LOOKUPS	200000
+
+/* Only compared by pointer, never dereferenced */
+#define DEVICE(n)	((struct btd_device *) GUINT_TO_POINTER(n))
+
+static const bdaddr_t identity = {{ 0x01, 0x02, 0x03, 0x04, 0x05, 0xc6 }};
+static const bdaddr_t rpa = {{ 0x11, 0x12, 0x13, 0x14, 0x15, 0x56 }};
+
+static uint64_t get_time_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1000000ull + ts.tv_nsec / 1000;
+}
+
+static void make_addr(bdaddr_t *bdaddr, unsigned int n)
+{
+	memset(bdaddr, 0, sizeof(*bdaddr));
+	bdaddr->b[0] = n;
+	bdaddr->b[1] = n >> 8;
+	bdaddr->b[2] = n >> 16;
+	bdaddr->b[5] = 0xc0;
+}
+
+static void test_shared_addr(const void *user_data)
+{
+	struct device_index *index = device_index_new();
+	GSList *list;
+
+	/* BR/EDR and LE devices using the same address share a bucket */
+	device_index_add(index, &identity, DEVICE(1));
+	device_index_add(index, &identity, DEVICE(2));
+
+	list = device_index_lookup(index, &identity);
+	g_assert(g_slist_length(list) == 2);
+	g_assert(list->data == DEVICE(2));
+
+	g_assert(device_index_remove(index, &identity, DEVICE(2)));
+	g_assert(!device_index_remove(index, &identity, DEVICE(2)));
+
+	list = device_index_lookup(index, &identity);
+	g_assert(g_slist_length(list) == 1);
+	g_assert(list->data == DEVICE(1));
+
+	g_assert(device_index_remove(index, &identity, DEVICE(1)));
+	g_assert(!device_index_lookup(index, &identity));
+
+	device_index_free(index);
+
+	tester_test_passed();
+}
+
+/*
+ * A device connects with its RPA and its identity address is resolved
+ * while connected: it must be found by both until it disconnects.
+ */
+static void test_conn_addr(const void *user_data)
+{
+	struct device_index *index = device_index_new();
+	GSList *list;
+
+	device_index_add(index, &rpa, DEVICE(1));
+
+	device_index_move(index, DEVICE(1), &rpa, &identity, true);
+
+	list = device_index_lookup(index, &rpa);
+	g_assert(list && list->data == DEVICE(1));
+
+	list = device_index_lookup(index, &identity);
+	g_assert(list && list->data == DEVICE(1));
+
+	/* Disconnecting drops the connection address only */
+	g_assert(device_index_remove(index, &rpa, DEVICE(1)));
+	g_assert(!device_index_lookup(index, &rpa));
+	g_assert(device_index_lookup(index, &identity));
+
+	/* Without a connection the old address goes right away */
+	device_index_move(index, DEVICE(1), &identity, &rpa, false);
+	g_assert(!device_index_lookup(index, &identity));
+	g_assert(device_index_lookup(index, &rpa));
+
+	/* Devices not indexed by the old address are not moved */
+	device_index_move(index, DEVICE(2), &identity, &rpa, false);
+	device_index_move(index, DEVICE(2), &identity, &rpa, true);
+	g_assert(g_slist_length(device_index_lookup(index, &rpa)) == 1);
+
+	device_index_free(index);
+
+	tester_test_passed();
+}
+
+static void test_clear(const void *user_data)
+{
+	struct device_index *index = device_index_new();
+
+	device_index_add(index, &rpa, DEVICE(1));
+	device_index_add(index, &identity, DEVICE(2));
+
+	device_index_clear(index);
+
+	g_assert(!device_index_lookup(index, &rpa));
+	g_assert(!device_index_lookup(index, &identity));
+
+	device_index_free(index);
+
+	tester_test_passed();
+}
+
+static gint match_addr(gconstpointer a, gconstpointer b)
+{
+	return bacmp(a, b);
+}
+
+/*
+ * Every device found event looks the device up by address, compare the
+ * index with walking the device list as done before it existed.
+ */
+static void test_benchmark(const void *user_data)
+{
+	struct device_index *index = device_index_new();
+	bdaddr_t *addrs = g_new0(bdaddr_t, NUM_DEVICES);
+	GSList *devices = NULL;
+	uint64_t start, indexed, walked;
+	unsigned int i;
+
+	for (i = 0; i < NUM_DEVICES; i++) {
+		make_addr(&addrs[i], i);
+		device_index_add(index, &addrs[i], DEVICE(i + 1));
+		devices = g_slist_prepend(devices, &addrs[i]);
+	}
+
+	start = get_time_us();
+
+	for (i = 0; i < NUM_LOOKUPS; i++) {
+		GSList *list;
+
+		list = device_index_lookup(index, &addrs[i % NUM_DEVICES]);
+		g_assert(list && list->data == DEVICE(i % NUM_DEVICES + 1));
+	}
+
+	indexed = get_time_us() - start;
+
+	start = get_time_us();
+
+	/* Fewer lookups, a full walk of the list is that much slower */
+	for (i = 0; i < NUM_LOOKUPS / 100; i++)
+		g_assert(g_slist_find_custom(devices, &addrs[i % NUM_DEVICES],
+								match_addr));
+
+	walked = (get_time_us() - start) * 100;
+
+	tester_debug("%u lookups in %u devices: index %llu us, "
+				"list %llu us (estimated)", NUM_LOOKUPS,
+				NUM_DEVICES, (unsigned long long) indexed,
+				(unsigned long long) walked);
+
+	g_slist_free(devices);
+	g_free(addrs);
+	device_index_free(index);
+
+	tester_test_passed();
+}
+
+int main(int argc, char *argv[])
+{
+	tester_init(&argc, &argv);
+
+	tester_add("/device-index/shared-addr", NULL, NULL, test_shared_addr,
+									NULL);
+	tester_add("/device-index/conn-addr", NULL, NULL, test_conn_addr, NULL);
+	tester_add("/device-index/clear", NULL, NULL, test_clear, NULL);
+	tester_add("/device-index/benchmark", NULL, NULL, test_benchmark, NULL);
+
+	return tester_run();
+}
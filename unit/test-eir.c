@@ -13,6 +13,8 @@
 #endif
 
 #include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include <glib.h>
 
@@ -632,6 +634,33 @@ static void test_ad(const struct test_data *test, struct eir_data *eir)
 	bt_ad_unref(ad);
 }
 
+static void test_scan(const struct test_data *test, struct eir_data *eir)
+{
+	struct eir_scan scan;
+	const struct queue_entry *q;
+
+	eir_scan(&scan, test->eir_data, test->eir_size);
+
+	g_assert_cmpint(scan.flags, ==, eir->flags);
+	g_assert(scan.name == (eir->name != NULL));
+	g_assert(scan.rsi == eir->rsi);
+
+	for (q = queue_get_entries(eir->sd_list); q; q = q->next) {
+		struct eir_sd *sd = q->data;
+		unsigned long uuid;
+
+		if (strcmp(sd->uuid + 8, "-0000-1000-8000-00805f9b34fb"))
+			continue;
+
+		uuid = strtoul(sd->uuid, NULL, 16);
+		if (uuid > UINT16_MAX)
+			continue;
+
+		g_assert(eir_has_service_data(test->eir_data, test->eir_size,
+									uuid));
+	}
+}
+
 static void test_parsing(gconstpointer data)
 {
 	const struct test_data *test = data;
@@ -692,6 +721,7 @@ static void test_parsing(gconstpointer data)
 	}
 
 	test_ad(data, &eir);
+	test_scan(data, &eir);
 
 	eir_data_free(&eir);
 
@@ -735,6 +765,208 @@ static const struct test_data uri_beacon_test = {
 	.uuid = uri_beacon_uuid,
 };
 
+static const struct test_data *replay_data[] = {
+	&macbookair_test,
+	&iphone5_test,
+	&ipadmini_test,
+	&gigaset_sl400h_test,
+	&gigaset_sl910_test,
+	&nokia_bh907_test,
+	&fuelband_test,
+	&bluesc_test,
+	&wahoo_scale_test,
+	&mio_alpha_test,
+	&cookoo_test,
+	&citizen_adv_test,
+	&citizen_scan_test,
+	&gigaset_gtag_test,
+	&uri_beacon_test,
+	NULL
+};
+
+#define REPLAY_ROUNDS	10000
+
+/* Replays the captured reports the way the adapter would see them while
+ * discovering, once with the full parser and once with the scan used to
+ * decide if a report is of interest.
+ */
+static void test_replay(gconstpointer data)
+{
+	unsigned int i, j, count = 0, parse_names = 0, scan_names = 0;
+	gint64 start, parse, scan;
+
+	start = g_get_monotonic_time();
+
+	for (i = 0; i < REPLAY_ROUNDS; i++) {
+		for (j = 0; replay_data[j]; j++) {
+			const struct test_data *test = replay_data[j];
+			struct eir_data eir;
+
+			memset(&eir, 0, sizeof(eir));
+			eir_parse(&eir, test->eir_data, test->eir_size);
+			if (eir.name)
+				parse_names++;
+			eir_data_free(&eir);
+			count++;
+		}
+	}
+
+	parse = g_get_monotonic_time() - start;
+	start = g_get_monotonic_time();
+
+	for (i = 0; i < REPLAY_ROUNDS; i++) {
+		for (j = 0; replay_data[j]; j++) {
+			const struct test_data *test = replay_data[j];
+			struct eir_scan eir;
+
+			eir_scan(&eir, test->eir_data, test->eir_size);
+			if (eir.name)
+				scan_names++;
+		}
+	}
+
+	scan = g_get_monotonic_time() - start;
+
+	tester_debug("%u reports: parse %" G_GINT64_FORMAT " us scan %"
+				G_GINT64_FORMAT " us", count, parse, scan);
+
+	g_assert_cmpint(parse_names, ==, scan_names);
+
+	tester_test_passed();
+}
+
+#define MATCHER_MONITORS	256
+#define MATCHER_ROUNDS		200
+
+struct matcher_data {
+	unsigned int matched[MATCHER_MONITORS];
+	unsigned int round;
+};
+
+static void matcher_match(void *data, void *user_data)
+{
+	struct matcher_data *md = user_data;
+	unsigned int i = PTR_TO_UINT(data);
+
+	/* Each monitor must only be reported once */
+	g_assert(md->matched[i] != md->round);
+	md->matched[i] = md->round;
+}
+
+static struct bt_ad *matcher_ad_new(unsigned int i)
+{
+	uint8_t data[] = { 0x02, 0x01, 0x06,
+				0x07, 0xff, 0x4c, 0x00, 0x02, i, i >> 8, 0x00,
+				0x05, 0x16, 0x0f, 0x18, 0x01, i };
+
+	return bt_ad_new_with_data(sizeof(data), data);
+}
+
+/* Registers monitors with a mix of manufacturer, service data and flags
+ * patterns and checks the compiled matcher against the linear match of each
+ * pattern list.
+ */
+static void test_matcher(const void *data)
+{
+	struct queue *patterns[MATCHER_MONITORS];
+	struct bt_ad *ads[MATCHER_MONITORS];
+	struct bt_ad_matcher *matcher;
+	struct matcher_data md;
+	gint64 start, linear, compiled;
+	unsigned int i, j, k, count = 0;
+
+	matcher = bt_ad_matcher_new();
+	g_assert(bt_ad_matcher_is_empty(matcher));
+	memset(&md, 0, sizeof(md));
+
+	for (i = 0; i < MATCHER_MONITORS; i++) {
+		uint8_t manuf[] = { 0x4c, 0x00, 0x02, i, i >> 8 };
+		uint8_t svc[] = { 0x01, i };
+		uint8_t flags = 0x06;
+
+		patterns[i] = queue_new();
+		queue_push_tail(patterns[i], bt_ad_pattern_new(
+					BT_AD_MANUFACTURER_DATA, 0,
+					sizeof(manuf), manuf));
+
+		if (i % 3 == 0)
+			queue_push_tail(patterns[i], bt_ad_pattern_new(
+					BT_AD_SERVICE_DATA16, 0,
+					sizeof(svc), svc));
+
+		if (i % 64 == 0)
+			queue_push_tail(patterns[i], bt_ad_pattern_new(
+					BT_AD_FLAGS, 0, 1, &flags));
+
+		g_assert(bt_ad_matcher_add(matcher, patterns[i],
+							UINT_TO_PTR(i)));
+
+		ads[i] = matcher_ad_new(i);
+		g_assert(ads[i]);
+	}
+
+	g_assert(!bt_ad_matcher_is_empty(matcher));
+
+	/* Drop a few monitors to exercise the removal path */
+	for (i = 1; i < MATCHER_MONITORS; i += 50)
+		g_assert(bt_ad_matcher_remove(matcher, UINT_TO_PTR(i)));
+
+	g_assert(!bt_ad_matcher_remove(matcher, UINT_TO_PTR(1)));
+
+	for (i = 0; i < MATCHER_MONITORS; i++) {
+		md.round++;
+		bt_ad_matcher_foreach_match(matcher, ads[i], matcher_match,
+									&md);
+
+		for (j = 0; j < MATCHER_MONITORS; j++) {
+			bool match = bt_ad_pattern_match(ads[i], patterns[j]);
+
+			if (j % 50 == 1)
+				match = false;
+
+			g_assert(match == (md.matched[j] == md.round));
+		}
+	}
+
+	start = g_get_monotonic_time();
+
+	for (k = 0; k < MATCHER_ROUNDS; k++) {
+		for (i = 0; i < MATCHER_MONITORS; i++) {
+			for (j = 0; j < MATCHER_MONITORS; j++) {
+				if (bt_ad_pattern_match(ads[i], patterns[j]))
+					count++;
+			}
+		}
+	}
+
+	linear = g_get_monotonic_time() - start;
+	start = g_get_monotonic_time();
+
+	for (k = 0; k < MATCHER_ROUNDS; k++) {
+		for (i = 0; i < MATCHER_MONITORS; i++) {
+			md.round++;
+			bt_ad_matcher_foreach_match(matcher, ads[i],
+							matcher_match, &md);
+		}
+	}
+
+	compiled = g_get_monotonic_time() - start;
+
+	tester_debug("%u monitors %u reports: linear %" G_GINT64_FORMAT
+			" us compiled %" G_GINT64_FORMAT " us (%u matches)",
+			MATCHER_MONITORS, MATCHER_MONITORS * MATCHER_ROUNDS,
+			linear, compiled, count);
+
+	bt_ad_matcher_free(matcher);
+
+	for (i = 0; i < MATCHER_MONITORS; i++) {
+		queue_destroy(patterns[i], free);
+		bt_ad_unref(ads[i]);
+	}
+
+	tester_test_passed();
+}
+
 int main(int argc, char *argv[])
 {
 	tester_init(&argc, &argv);
@@ -767,5 +999,8 @@ int main(int argc, char *argv[])
 	tester_add("ad/g-tag", &gigaset_gtag_test, NULL, test_parsing, NULL);
 	tester_add("ad/uri-beacon", &uri_beacon_test, NULL, test_parsing, NULL);
 
+	tester_add("/eir/replay", NULL, NULL, test_replay, NULL);
+	tester_add("/ad/matcher", NULL, NULL, test_matcher, NULL);
+
 	return tester_run();
 }
@@ -0,0 +1,429 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2026  agent <agent@local>
+ *
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <glib.h>
+
+#include "bluetooth/bluetooth.h"
+#include "bluetooth/uuid.h"
+#include "src/shared/util.h"
+#include "src/shared/queue.h"
+#include "src/shared/att.h"
+#include "src/shared/gatt-db.h"
+#include "src/shared/gatt-cache.h"
+#include "src/shared/tester.h"
+
+#define NUM_SERVICES		20
+#define NUM_CHARS		6
+#define NUM_DEVICES		200
+
+static const uint8_t db_hash[16] = {
+	0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08,
+	0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0x10,
+};
+
+static uint64_t get_time_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1000000ull + ts.tv_nsec / 1000;
+}
+
+static char *cache_filename(unsigned int index)
+{
+	char *filename;
+
+	g_assert(asprintf(&filename, "/tmp/test-gatt-cache-%d-%u", getpid(),
+							index) > 0);
+
+	return filename;
+}
+
+static void write_cb(struct gatt_db_attribute *attrib, int err,
+							void *user_data)
+{
+	g_assert_cmpint(err, ==, 0);
+}
+
+static void write_value(struct gatt_db_attribute *attrib,
+					const uint8_t *value, size_t len)
+{
+	g_assert(gatt_db_attribute_write(attrib, 0, value, len, 0, NULL,
+							write_cb, NULL));
+}
+
+static void service_uuid(bt_uuid_t *uuid, unsigned int index)
+{
+	uint128_t u128;
+
+	/* Mix 16 bit and 128 bit UUIDs */
+	if (index % 2) {
+		bt_uuid16_create(uuid, 0x1800 + index);
+		return;
+	}
+
+	memset(&u128, 0, sizeof(u128));
+	u128.data[0] = 0xfe;
+	u128.data[15] = index;
+	bt_uuid128_create(uuid, u128);
+}
+
+static void populate_db(struct gatt_db *db)
+{
+	struct gatt_db_attribute *service, *secondary, *attrib;
+	bt_uuid_t uuid, ccc_uuid, ext_uuid;
+	uint8_t ext_prop[2];
+	unsigned int i, j;
+
+	bt_uuid16_create(&ccc_uuid, GATT_CLIENT_CHARAC_CFG_UUID);
+	bt_uuid16_create(&ext_uuid, GATT_CHARAC_EXT_PROPER_UUID);
+
+	/* Generic Attribute with Database Hash */
+	bt_uuid16_create(&uuid, 0x1801);
+	service = gatt_db_add_service(db, &uuid, true, 3);
+	bt_uuid16_create(&uuid, GATT_CHARAC_DB_HASH);
+	attrib = gatt_db_service_add_characteristic(service, &uuid,
+						BT_ATT_PERM_READ,
+						BT_GATT_CHRC_PROP_READ,
+						NULL, NULL, NULL);
+	write_value(attrib, db_hash, sizeof(db_hash));
+	gatt_db_service_set_active(service, true);
+
+	bt_uuid16_create(&uuid, 0x1810);
+	secondary = gatt_db_add_service(db, &uuid, false, 3);
+	bt_uuid16_create(&uuid, 0x2a00);
+	gatt_db_service_add_characteristic(secondary, &uuid, BT_ATT_PERM_READ,
+						BT_GATT_CHRC_PROP_READ,
+						NULL, NULL, NULL);
+	gatt_db_service_set_active(secondary, true);
+
+	for (i = 0; i < NUM_SERVICES; i++) {
+		service_uuid(&uuid, i);
+		service = gatt_db_add_service(db, &uuid, true,
+							2 + NUM_CHARS * 4);
+		g_assert(service);
+
+		if (!i)
+			g_assert(gatt_db_service_add_included(service,
+								secondary));
+
+		for (j = 0; j < NUM_CHARS; j++) {
+			uint8_t props = BT_GATT_CHRC_PROP_READ |
+						BT_GATT_CHRC_PROP_NOTIFY;
+
+			if (j % 2)
+				props |= BT_GATT_CHRC_PROP_EXT_PROP;
+
+			bt_uuid16_create(&uuid, 0x2a00 + j);
+			g_assert(gatt_db_service_add_characteristic(service,
+							&uuid, BT_ATT_PERM_READ,
+							props, NULL, NULL,
+							NULL));
+			g_assert(gatt_db_service_add_descriptor(service,
+							&ccc_uuid,
+							BT_ATT_PERM_READ |
+							BT_ATT_PERM_WRITE,
+							NULL, NULL, NULL));
+
+			if (!(j % 2))
+				continue;
+
+			attrib = gatt_db_service_add_descriptor(service,
+							&ext_uuid,
+							BT_ATT_PERM_READ,
+							NULL, NULL, NULL);
+			g_assert(attrib);
+			put_le16(0x0001, ext_prop);
+			write_value(attrib, ext_prop, sizeof(ext_prop));
+		}
+
+		gatt_db_service_set_active(service, true);
+	}
+}
+
+static void compare_attr(struct gatt_db_attribute *a,
+					struct gatt_db_attribute *b)
+{
+	uint16_t a16[4], b16[4];
+	uint8_t a8, b8;
+	bool a_bool, b_bool;
+	bt_uuid_t a_uuid, b_uuid;
+
+	g_assert(!bt_uuid_cmp(gatt_db_attribute_get_type(a),
+					gatt_db_attribute_get_type(b)));
+
+	if (gatt_db_attribute_get_service_data(a, &a16[0], &a16[1], &a_bool,
+								&a_uuid)) {
+		g_assert(gatt_db_attribute_get_service_data(b, &b16[0],
+							&b16[1], &b_bool,
+							&b_uuid));
+		g_assert_cmpint(a16[0], ==, b16[0]);
+		g_assert_cmpint(a16[1], ==, b16[1]);
+		g_assert(a_bool == b_bool);
+		g_assert(!bt_uuid_cmp(&a_uuid, &b_uuid));
+		g_assert(gatt_db_service_get_active(b));
+	}
+
+	if (gatt_db_attribute_get_char_data(a, &a16[0], &a16[1], &a8, &a16[2],
+								&a_uuid)) {
+		g_assert(gatt_db_attribute_get_char_data(b, &b16[0], &b16[1],
+							&b8, &b16[2],
+							&b_uuid));
+		g_assert_cmpint(a16[1], ==, b16[1]);
+		g_assert_cmpint(a8, ==, b8);
+		g_assert_cmpint(a16[2], ==, b16[2]);
+		g_assert(!bt_uuid_cmp(&a_uuid, &b_uuid));
+	}
+
+	if (gatt_db_attribute_get_incl_data(a, &a16[0], &a16[1], &a16[2])) {
+		g_assert(gatt_db_attribute_get_incl_data(b, &b16[0], &b16[1],
+								&b16[2]));
+		g_assert_cmpint(a16[1], ==, b16[1]);
+		g_assert_cmpint(a16[2], ==, b16[2]);
+	}
+}
+
+static void compare_db(struct gatt_db *a, struct gatt_db *b)
+{
+	unsigned int handle;
+
+	for (handle = 1; handle <= UINT16_MAX; handle++) {
+		struct gatt_db_attribute *attr_a, *attr_b;
+
+		attr_a = gatt_db_get_attribute(a, handle);
+		attr_b = gatt_db_get_attribute(b, handle);
+
+		g_assert(!attr_a == !attr_b);
+
+		if (attr_a)
+			compare_attr(attr_a, attr_b);
+	}
+
+	/* Only the Database Hash value is stored */
+	g_assert(!memcmp(gatt_db_get_hash(a), gatt_db_get_hash(b), 16));
+}
+
+static void test_round_trip(const void *user_data)
+{
+	struct gatt_db *db, *loaded;
+	char *filename = cache_filename(0);
+	uint8_t hash[16];
+
+	db = gatt_db_new();
+	populate_db(db);
+
+	g_assert_cmpint(gatt_cache_store(db, filename), ==, 0);
+
+	g_assert_cmpint(gatt_cache_get_hash(filename, hash), ==, 0);
+	g_assert(!memcmp(hash, db_hash, sizeof(hash)));
+
+	loaded = gatt_db_new();
+	g_assert_cmpint(gatt_cache_load(loaded, filename), ==, 0);
+
+	compare_db(db, loaded);
+
+	gatt_db_unref(loaded);
+	gatt_db_unref(db);
+
+	unlink(filename);
+	free(filename);
+
+	tester_test_passed();
+}
+
+static void test_same_hash(const void *user_data)
+{
+	struct gatt_db *db, *loaded;
+	struct gatt_db_attribute *service;
+	char *filename = cache_filename(0);
+	bt_uuid_t uuid;
+	struct stat st;
+	ino_t ino;
+
+	db = gatt_db_new();
+	populate_db(db);
+
+	g_assert_cmpint(gatt_cache_store(db, filename), ==, 0);
+	g_assert_cmpint(stat(filename, &st), ==, 0);
+	ino = st.st_ino;
+
+	/* Same contents, the cache is kept as is */
+	g_assert_cmpint(gatt_cache_store(db, filename), ==, 0);
+	g_assert_cmpint(stat(filename, &st), ==, 0);
+	g_assert(st.st_ino == ino);
+
+	/* Services changed but the Database Hash was not read again, the
+	 * cache must still be rewritten.
+	 */
+	bt_uuid16_create(&uuid, 0x180f);
+	service = gatt_db_add_service(db, &uuid, true, 1);
+	gatt_db_service_set_active(service, true);
+
+	g_assert_cmpint(gatt_cache_store(db, filename), ==, 0);
+	g_assert_cmpint(stat(filename, &st), ==, 0);
+	g_assert(st.st_ino != ino);
+
+	loaded = gatt_db_new();
+	g_assert_cmpint(gatt_cache_load(loaded, filename), ==, 0);
+	g_assert(gatt_db_get_service_with_uuid(loaded, &uuid));
+
+	gatt_db_unref(loaded);
+	gatt_db_unref(db);
+
+	unlink(filename);
+	free(filename);
+
+	tester_test_passed();
+}
+
+static void corrupt_file(const char *filename, off_t offset, off_t length)
+{
+	uint8_t byte;
+	int fd;
+
+	fd = open(filename, O_RDWR);
+	g_assert(fd >= 0);
+
+	if (length) {
+		g_assert_cmpint(ftruncate(fd, length), ==, 0);
+	} else {
+		g_assert_cmpint(pread(fd, &byte, 1, offset), ==, 1);
+		byte ^= 0xff;
+		g_assert_cmpint(pwrite(fd, &byte, 1, offset), ==, 1);
+	}
+
+	close(fd);
+}
+
+static void test_corrupt(const void *user_data)
+{
+	struct gatt_db *db, *loaded;
+	char *filename = cache_filename(0);
+	struct stat st;
+
+	db = gatt_db_new();
+	populate_db(db);
+
+	loaded = gatt_db_new();
+	g_assert_cmpint(gatt_cache_load(loaded, filename), ==, -ENOENT);
+
+	/* Truncated */
+	g_assert_cmpint(gatt_cache_store(db, filename), ==, 0);
+	g_assert_cmpint(stat(filename, &st), ==, 0);
+	corrupt_file(filename, 0, st.st_size - 1);
+	g_assert_cmpint(gatt_cache_load(loaded, filename), ==, -EIO);
+	g_assert(gatt_db_isempty(loaded));
+
+	/* Dropped once found corrupted */
+	g_assert_cmpint(stat(filename, &st), <, 0);
+
+	/* Bad magic */
+	g_assert_cmpint(gatt_cache_store(db, filename), ==, 0);
+	corrupt_file(filename, 0, 0);
+	g_assert_cmpint(gatt_cache_load(loaded, filename), ==, -EIO);
+	g_assert(gatt_db_isempty(loaded));
+
+	/* Bad record type */
+	g_assert_cmpint(gatt_cache_store(db, filename), ==, 0);
+	corrupt_file(filename, 32, 0);
+	g_assert_cmpint(gatt_cache_load(loaded, filename), ==, -EIO);
+	g_assert(gatt_db_isempty(loaded));
+
+	/* Record count not matching the records */
+	g_assert_cmpint(gatt_cache_store(db, filename), ==, 0);
+	corrupt_file(filename, 8, 0);
+	g_assert_cmpint(gatt_cache_load(loaded, filename), ==, -EIO);
+	g_assert(gatt_db_isempty(loaded));
+
+	gatt_db_unref(loaded);
+	gatt_db_unref(db);
+
+	unlink(filename);
+	free(filename);
+
+	tester_test_passed();
+}
+
+static void test_benchmark(const void *user_data)
+{
+	struct gatt_db *db, *loaded;
+	char *filenames[NUM_DEVICES];
+	uint64_t start, store_us, load_us;
+	struct stat st;
+	unsigned int i;
+
+	db = gatt_db_new();
+	populate_db(db);
+
+	for (i = 0; i < NUM_DEVICES; i++)
+		filenames[i] = cache_filename(i);
+
+	start = get_time_us();
+
+	for (i = 0; i < NUM_DEVICES; i++)
+		g_assert_cmpint(gatt_cache_store(db, filenames[i]), ==, 0);
+
+	store_us = get_time_us() - start;
+
+	g_assert_cmpint(stat(filenames[0], &st), ==, 0);
+
+	loaded = gatt_db_new();
+	start = get_time_us();
+
+	for (i = 0; i < NUM_DEVICES; i++) {
+		g_assert_cmpint(gatt_cache_load(loaded, filenames[i]), ==, 0);
+		gatt_db_clear(loaded);
+	}
+
+	load_us = get_time_us() - start;
+
+	tester_debug("%u caches of %u bytes: store %llu us, load %llu us",
+				NUM_DEVICES, (unsigned int) st.st_size,
+				(unsigned long long) store_us,
+				(unsigned long long) load_us);
+
+	for (i = 0; i < NUM_DEVICES; i++) {
+		unlink(filenames[i]);
+		free(filenames[i]);
+	}
+
+	gatt_db_unref(loaded);
+	gatt_db_unref(db);
+
+	tester_test_passed();
+}
+
+int main(int argc, char *argv[])
+{
+	tester_init(&argc, &argv);
+
+	tester_add("/gatt-cache/round-trip", NULL, NULL, test_round_trip,
+									NULL);
+	tester_add("/gatt-cache/same-hash", NULL, NULL, test_same_hash, NULL);
+	tester_add("/gatt-cache/corrupt", NULL, NULL, test_corrupt, NULL);
+	tester_add("/gatt-cache/benchmark", NULL, NULL, test_benchmark, NULL);
+
+	return tester_run();
+}
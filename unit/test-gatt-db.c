@@ -0,0 +1,616 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2026  agent <agent@local>
+ *
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/uio.h>
+
+#include <glib.h>
+
+#include "bluetooth/bluetooth.h"
+#include "bluetooth/uuid.h"
+#include "src/shared/util.h"
+#include "src/shared/queue.h"
+#include "src/shared/att.h"
+#include "src/shared/gatt-db.h"
+#include "src/shared/crypto.h"
+#include "src/shared/timeout.h"
+#include "src/shared/tester.h"
+
+#define NUM_SERVICES		500
+#define NUM_CHARS		6
+#define NUM_TYPES		64
+#define NUM_RANGES		2000
+#define NUM_ROUNDS		5
+
+/* Service, characteristics with a value and CCC, user description */
+#define SERVICE_HANDLES		(1 + NUM_CHARS * 3 + 1)
+
+struct reference {
+	const bt_uuid_t *uuid;
+	uint16_t start;
+	uint16_t end;
+	struct queue *queue;
+};
+
+static uint64_t get_time_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1000000ull + ts.tv_nsec / 1000;
+}
+
+static void reference_attr(struct gatt_db_attribute *attr, void *user_data)
+{
+	struct reference *ref = user_data;
+	uint16_t handle = gatt_db_attribute_get_handle(attr);
+
+	if (handle < ref->start || handle > ref->end)
+		return;
+
+	if (ref->uuid && bt_uuid_cmp(ref->uuid,
+					gatt_db_attribute_get_type(attr)))
+		return;
+
+	queue_push_tail(ref->queue, attr);
+}
+
+static void reference_service(struct gatt_db_attribute *attr,
+							void *user_data)
+{
+	if (!gatt_db_service_get_active(attr))
+		return;
+
+	gatt_db_service_foreach(attr, NULL, reference_attr, user_data);
+}
+
+/* Walks every attribute of the database, the way lookups used to */
+static void reference_lookup(struct gatt_db *db, const bt_uuid_t *uuid,
+					uint16_t start, uint16_t end,
+					struct queue *queue)
+{
+	struct reference ref = { uuid, start, end, queue };
+
+	gatt_db_foreach_service(db, NULL, reference_service, &ref);
+}
+
+static void check_equal(struct queue *a, struct queue *b)
+{
+	const struct queue_entry *entry_a, *entry_b;
+
+	g_assert_cmpint(queue_length(a), ==, queue_length(b));
+
+	for (entry_a = queue_get_entries(a), entry_b = queue_get_entries(b);
+				entry_a && entry_b; entry_a = entry_a->next,
+				entry_b = entry_b->next)
+		g_assert(entry_a->data == entry_b->data);
+}
+
+static void check_lookup(struct gatt_db *db, const bt_uuid_t *uuid,
+						uint16_t start, uint16_t end)
+{
+	struct queue *found, *expected;
+
+	found = queue_new();
+	expected = queue_new();
+
+	if (uuid)
+		gatt_db_read_by_type(db, start, end, *uuid, found);
+	else
+		gatt_db_find_information(db, start, end, found);
+
+	reference_lookup(db, uuid, start, end, expected);
+	check_equal(found, expected);
+
+	queue_destroy(found, NULL);
+	queue_destroy(expected, NULL);
+}
+
+static void char_uuid(bt_uuid_t *uuid, unsigned int index)
+{
+	bt_uuid16_create(uuid, 0x2a00 + index % NUM_TYPES);
+}
+
+static struct gatt_db_attribute *add_service(struct gatt_db *db,
+							uint16_t handle,
+							unsigned int index)
+{
+	struct gatt_db_attribute *service, *attr;
+	bt_uuid_t uuid;
+	unsigned int i;
+
+	bt_uuid16_create(&uuid, 0x1800 + index % 32);
+
+	service = gatt_db_insert_service(db, handle, &uuid, true,
+							SERVICE_HANDLES);
+	if (!service)
+		return NULL;
+
+	for (i = 0; i < NUM_CHARS; i++) {
+		char_uuid(&uuid, index * NUM_CHARS + i);
+
+		attr = gatt_db_service_add_characteristic(service, &uuid,
+						BT_ATT_PERM_READ,
+						BT_GATT_CHRC_PROP_READ |
+						BT_GATT_CHRC_PROP_NOTIFY,
+						NULL, NULL, NULL);
+		g_assert(attr);
+
+		bt_uuid16_create(&uuid, GATT_CLIENT_CHARAC_CFG_UUID);
+		g_assert(gatt_db_service_add_descriptor(service, &uuid,
+						BT_ATT_PERM_READ |
+						BT_ATT_PERM_WRITE,
+						NULL, NULL, NULL));
+	}
+
+	bt_uuid16_create(&uuid, GATT_CHARAC_USER_DESC_UUID);
+	g_assert(gatt_db_service_add_descriptor(service, &uuid,
+						BT_ATT_PERM_READ, NULL, NULL,
+						NULL));
+
+	gatt_db_service_set_active(service, true);
+
+	return service;
+}
+
+static struct gatt_db *create_db(unsigned int num_services)
+{
+	struct gatt_db *db;
+	unsigned int i;
+
+	db = gatt_db_new();
+	g_assert(db);
+
+	for (i = 0; i < num_services; i++)
+		g_assert(add_service(db, 0, i));
+
+	return db;
+}
+
+static void test_lookup(const void *user_data)
+{
+	struct gatt_db *db;
+	struct gatt_db_attribute *service, *attr;
+	bt_uuid_t uuid;
+	uint16_t handle;
+
+	db = gatt_db_new();
+	g_assert(db);
+
+	/* Services inserted out of order, with gaps in between */
+	g_assert(add_service(db, 0x0100, 0));
+	g_assert(add_service(db, 0x0001, 1));
+	service = add_service(db, 0x0040, 2);
+	g_assert(service);
+
+	/* Overlapping ranges are rejected, the same service is returned */
+	bt_uuid16_create(&uuid, 0x1802);
+	g_assert(!gatt_db_insert_service(db, 0x0030, &uuid, true, 0x20));
+	g_assert(!gatt_db_insert_service(db, 0x0020, &uuid, true, 0x100));
+	g_assert(gatt_db_insert_service(db, 0x0040, &uuid, true,
+						SERVICE_HANDLES) == service);
+
+	for (handle = 0x0040; handle < 0x0040 + SERVICE_HANDLES; handle++) {
+		attr = gatt_db_get_attribute(db, handle);
+		g_assert(attr);
+		g_assert_cmpint(gatt_db_attribute_get_handle(attr), ==, handle);
+		g_assert(gatt_db_get_service(db, handle) == service);
+	}
+
+	g_assert(!gatt_db_get_attribute(db, 0x0000));
+	g_assert(!gatt_db_get_attribute(db, 0x0040 + SERVICE_HANDLES));
+	g_assert(!gatt_db_get_service(db, 0x00ff));
+	g_assert(gatt_db_get_service(db, 0x0100));
+
+	/* Removed services can no longer be looked up */
+	g_assert(gatt_db_remove_service(db, service));
+	g_assert(!gatt_db_get_service(db, 0x0040));
+	g_assert(gatt_db_get_service(db, 0x0001));
+
+	g_assert(gatt_db_clear_range(db, 0x00f0, 0x0100));
+	g_assert(!gatt_db_get_service(db, 0x0100));
+	g_assert(gatt_db_get_service(db, 0x0001));
+
+	gatt_db_unref(db);
+
+	tester_test_passed();
+}
+
+static void test_range(const void *user_data)
+{
+	struct gatt_db *db;
+	bt_uuid_t uuid;
+	unsigned int i;
+
+	db = create_db(50);
+
+	/* Inactive services are not returned */
+	gatt_db_service_set_active(gatt_db_get_service(db, 10 *
+						SERVICE_HANDLES + 1), false);
+
+	srand(0);
+
+	for (i = 0; i < NUM_RANGES; i++) {
+		uint16_t start = rand() % (60 * SERVICE_HANDLES) + 1;
+		uint16_t end = start + rand() % (3 * SERVICE_HANDLES);
+
+		char_uuid(&uuid, rand());
+
+		check_lookup(db, NULL, start, end);
+		check_lookup(db, &uuid, start, end);
+	}
+
+	bt_uuid16_create(&uuid, GATT_CHARAC_UUID);
+	check_lookup(db, &uuid, 0x0001, 0xffff);
+	check_lookup(db, NULL, 0x0001, 0xffff);
+
+	gatt_db_unref(db);
+
+	tester_test_passed();
+}
+
+static void remove_next(struct gatt_db_attribute *attr, void *user_data)
+{
+	struct gatt_db *db = user_data;
+	struct gatt_db_attribute *service;
+
+	/* Remove the service following the one being walked */
+	service = gatt_db_get_service(db, gatt_db_attribute_get_handle(attr) +
+							SERVICE_HANDLES);
+	if (service)
+		gatt_db_remove_service(db, service);
+}
+
+static void test_type(const void *user_data)
+{
+	struct gatt_db *db;
+	struct queue *queue;
+	bt_uuid_t uuid;
+	unsigned int i;
+
+	db = create_db(50);
+
+	bt_uuid16_create(&uuid, GATT_CHARAC_USER_DESC_UUID);
+
+	/* Repeated lookups are served by the type index */
+	for (i = 0; i < 3; i++)
+		check_lookup(db, &uuid, 0x0001, 0xffff);
+
+	/* Which follows changes to the database */
+	g_assert(add_service(db, 0, 50));
+	check_lookup(db, &uuid, 0x0001, 0xffff);
+	check_lookup(db, &uuid, 0x0001, 0xffff);
+
+	g_assert(gatt_db_remove_service(db, gatt_db_get_service(db,
+						SERVICE_HANDLES + 1)));
+	check_lookup(db, &uuid, 0x0001, 0xffff);
+	check_lookup(db, &uuid, 0x0001, 0xffff);
+
+	/* And from callbacks changing the database during the walk */
+	queue = queue_new();
+	gatt_db_read_by_type(db, 0x0001, 0xffff, uuid, queue);
+	g_assert_cmpint(queue_length(queue), ==, 50);
+	queue_destroy(queue, NULL);
+
+	gatt_db_foreach_in_range(db, &uuid, remove_next, db, 0x0001, 0xffff);
+	check_lookup(db, &uuid, 0x0001, 0xffff);
+
+	queue = queue_new();
+	gatt_db_read_by_type(db, 0x0001, 0xffff, uuid, queue);
+	g_assert_cmpint(queue_length(queue), ==, 26);
+	queue_destroy(queue, NULL);
+
+	gatt_db_unref(db);
+
+	tester_test_passed();
+}
+
+struct hash_input {
+	struct iovec iov[NUM_SERVICES * SERVICE_HANDLES];
+	unsigned int count;
+};
+
+static void read_value_cb(struct gatt_db_attribute *attrib, int err,
+					const uint8_t *value, size_t length,
+					void *user_data)
+{
+	struct iovec *iov = user_data;
+
+	iov->iov_base = (void *) value;
+	iov->iov_len = length;
+}
+
+static void hash_attr(struct gatt_db_attribute *attr, void *user_data)
+{
+	struct hash_input *input = user_data;
+	const bt_uuid_t *type = gatt_db_attribute_get_type(attr);
+	struct iovec value;
+	uint8_t *data;
+	size_t len;
+
+	g_assert(gatt_db_attribute_read(attr, 0, 0, NULL, read_value_cb,
+								&value));
+	if (!value.iov_base || type->type != BT_UUID16)
+		return;
+
+	switch (type->value.u16) {
+	case GATT_PRIM_SVC_UUID:
+	case GATT_SND_SVC_UUID:
+	case GATT_INCLUDE_UUID:
+	case GATT_CHARAC_UUID:
+		len = 4 + value.iov_len;
+		break;
+	case GATT_CHARAC_USER_DESC_UUID:
+	case GATT_CLIENT_CHARAC_CFG_UUID:
+	case GATT_SERVER_CHARAC_CFG_UUID:
+	case GATT_CHARAC_FMT_UUID:
+	case GATT_CHARAC_AGREG_FMT_UUID:
+		len = 4;
+		break;
+	default:
+		return;
+	}
+
+	data = malloc(len);
+	put_le16(gatt_db_attribute_get_handle(attr), data);
+	put_le16(type->value.u16, data + 2);
+	memcpy(data + 4, value.iov_base, len - 4);
+
+	input->iov[input->count].iov_base = data;
+	input->iov[input->count].iov_len = len;
+	input->count++;
+}
+
+static void hash_service(struct gatt_db_attribute *attr, void *user_data)
+{
+	gatt_db_service_foreach(attr, NULL, hash_attr, user_data);
+}
+
+/* Database Hash over one input per attribute, the way it used to be done */
+static void check_hash(struct gatt_db *db)
+{
+	static struct hash_input input;
+	struct bt_crypto *crypto;
+	uint8_t hash[16];
+	unsigned int i;
+
+	input.count = 0;
+	gatt_db_foreach_service(db, NULL, hash_service, &input);
+
+	crypto = bt_crypto_new();
+	g_assert(crypto);
+	g_assert(bt_crypto_gatt_hash(crypto, input.iov, input.count, hash));
+	bt_crypto_unref(crypto);
+
+	for (i = 0; i < input.count; i++)
+		free(input.iov[i].iov_base);
+
+	g_assert(!memcmp(gatt_db_get_hash(db), hash, sizeof(hash)));
+}
+
+static void service_added(struct gatt_db_attribute *attrib, void *user_data)
+{
+}
+
+static struct gatt_db *hash_db;
+
+static bool hash_timeout(void *user_data)
+{
+	/* The update scheduled by the last change has run by now */
+	check_hash(hash_db);
+
+	gatt_db_unref(hash_db);
+	hash_db = NULL;
+
+	tester_test_passed();
+
+	return false;
+}
+
+static void test_hash(const void *user_data)
+{
+	struct gatt_db *clone;
+	struct gatt_db_attribute *attr;
+	const uint8_t value[] = { 0x01, 0x02, 0x03 };
+	unsigned int i;
+
+	hash_db = create_db(50);
+	check_hash(hash_db);
+
+	/* Stored descriptor values are part of the input */
+	for (i = 0; i < 10; i++) {
+		attr = gatt_db_get_attribute(hash_db, (i * 5 + 1) *
+							SERVICE_HANDLES);
+		g_assert(attr);
+		g_assert(gatt_db_attribute_write(attr, 0, value, sizeof(value),
+							0, NULL, NULL, NULL));
+	}
+
+	check_hash(hash_db);
+
+	g_assert(gatt_db_attribute_reset(attr));
+	check_hash(hash_db);
+
+	attr = gatt_db_get_service(hash_db, 1);
+	gatt_db_service_set_active(attr, false);
+	check_hash(hash_db);
+
+	gatt_db_service_set_active(attr, true);
+	check_hash(hash_db);
+
+	g_assert(gatt_db_remove_service(hash_db, gatt_db_get_service(hash_db,
+						10 * SERVICE_HANDLES + 1)));
+	check_hash(hash_db);
+
+	g_assert(add_service(hash_db, 10 * SERVICE_HANDLES + 1, 10));
+	g_assert(add_service(hash_db, 0, 50));
+	check_hash(hash_db);
+
+	clone = gatt_db_clone(hash_db);
+	check_hash(clone);
+	gatt_db_unref(clone);
+
+	/* A burst of changes is hashed once it is over */
+	g_assert(gatt_db_register(hash_db, service_added, NULL, NULL, NULL));
+
+	for (i = 51; i < 60; i++)
+		g_assert(add_service(hash_db, 0, i));
+
+	timeout_add(500, hash_timeout, NULL, NULL);
+}
+
+static void test_hash_benchmark(const void *user_data)
+{
+	struct gatt_db *db;
+	uint64_t start;
+	unsigned int i;
+
+	db = gatt_db_new();
+	g_assert(db);
+	g_assert(gatt_db_register(db, service_added, NULL, NULL, NULL));
+
+	start = get_time_us();
+
+	/* Applications registering one service each, hash read in between */
+	for (i = 0; i < NUM_SERVICES; i++) {
+		g_assert(add_service(db, 0, i));
+		g_assert(gatt_db_get_hash(db));
+	}
+
+	tester_debug("%u services registered, hash updated each time: "
+				"%llu us", NUM_SERVICES,
+				(unsigned long long) (get_time_us() - start));
+
+	check_hash(db);
+
+	gatt_db_unref(db);
+
+	tester_test_passed();
+}
+
+struct request {
+	const bt_uuid_t *uuid;
+	uint16_t start;
+	uint16_t end;
+};
+
+static void run_requests(struct gatt_db *db, const struct request *reqs,
+					unsigned int count, bool indexed)
+{
+	struct queue *queue;
+	unsigned int i;
+
+	queue = queue_new();
+
+	for (i = 0; i < count; i++) {
+		const struct request *req = &reqs[i];
+
+		if (!indexed)
+			reference_lookup(db, req->uuid, req->start, req->end,
+									queue);
+		else if (req->uuid)
+			gatt_db_read_by_type(db, req->start, req->end,
+							*req->uuid, queue);
+		else
+			gatt_db_find_information(db, req->start, req->end,
+									queue);
+
+		queue_remove_all(queue, NULL, NULL, NULL);
+	}
+
+	queue_destroy(queue, NULL);
+}
+
+static void test_benchmark(const void *user_data)
+{
+	static struct request reqs[NUM_SERVICES * (NUM_CHARS + 1) + NUM_TYPES];
+	static bt_uuid_t types[NUM_TYPES];
+	bt_uuid_t chrc_uuid;
+	struct gatt_db *db;
+	uint64_t start, linear, indexed;
+	unsigned int i, j, count = 0;
+
+	db = create_db(NUM_SERVICES);
+
+	bt_uuid16_create(&chrc_uuid, GATT_CHARAC_UUID);
+
+	/* Requests of a client discovering the whole database */
+	for (i = 0; i < NUM_SERVICES; i++) {
+		uint16_t svc_start = i * SERVICE_HANDLES + 1;
+
+		reqs[count].uuid = &chrc_uuid;
+		reqs[count].start = svc_start;
+		reqs[count].end = svc_start + SERVICE_HANDLES - 1;
+		count++;
+
+		for (j = 0; j < NUM_CHARS; j++) {
+			reqs[count].uuid = NULL;
+			reqs[count].start = svc_start + 1 + j * 3 + 2;
+			reqs[count].end = svc_start + 1 + j * 3 + 3;
+			count++;
+		}
+	}
+
+	/* Followed by reads of each characteristic type by UUID */
+	for (i = 0; i < NUM_TYPES; i++) {
+		char_uuid(&types[i], i);
+
+		reqs[count].uuid = &types[i];
+		reqs[count].start = 0x0001;
+		reqs[count].end = 0xffff;
+		count++;
+	}
+
+	start = get_time_us();
+
+	for (i = 0; i < NUM_ROUNDS; i++)
+		run_requests(db, reqs, count, false);
+
+	linear = get_time_us() - start;
+
+	start = get_time_us();
+
+	for (i = 0; i < NUM_ROUNDS; i++)
+		run_requests(db, reqs, count, true);
+
+	indexed = get_time_us() - start;
+
+	tester_debug("%u attributes, %u requests: linear %llu us indexed "
+				"%llu us", NUM_SERVICES * SERVICE_HANDLES,
+				count * NUM_ROUNDS,
+				(unsigned long long) linear,
+				(unsigned long long) indexed);
+
+	gatt_db_unref(db);
+
+	tester_test_passed();
+}
+
+int main(int argc, char *argv[])
+{
+	tester_init(&argc, &argv);
+
+	tester_add("/gatt-db/lookup", NULL, NULL, test_lookup, NULL);
+	tester_add("/gatt-db/range", NULL, NULL, test_range, NULL);
+	tester_add("/gatt-db/type", NULL, NULL, test_type, NULL);
+	tester_add("/gatt-db/benchmark", NULL, NULL, test_benchmark, NULL);
+	tester_add("/gatt-db/hash", NULL, NULL, test_hash, NULL);
+	tester_add("/gatt-db/hash-benchmark", NULL, NULL, test_hash_benchmark,
+									NULL);
+
+	return tester_run();
+}
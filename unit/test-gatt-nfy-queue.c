@@ -0,0 +1,349 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2026  agent <agent@local>
+ *
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <unistd.h>
+#include <string.h>
+#include <time.h>
+#include <sys/socket.h>
+
+#include <glib.h>
+
+#include "bluetooth/bluetooth.h"
+#include "bluetooth/uuid.h"
+#include "src/shared/util.h"
+#include "src/shared/att.h"
+#include "src/shared/queue.h"
+#include "src/shared/gatt-db.h"
+#include "src/shared/gatt-server.h"
+#include "src/shared/gatt-nfy-queue.h"
+#include "src/shared/tester.h"
+
+#define NUM_HANDLES		3
+#define NUM_DEVICES		20
+#define NUM_UPDATES		50
+#define QUEUE_SIZE		8
+#define STORM_MTU		185
+
+static const uint16_t handles[NUM_HANDLES] = { 0x0003, 0x0006, 0x0009 };
+
+struct flushed {
+	uint16_t handle[NUM_HANDLES * NUM_UPDATES];
+	uint32_t value[NUM_HANDLES * NUM_UPDATES];
+	unsigned int count;
+};
+
+static void flush_cb(uint16_t handle, const uint8_t *value, uint16_t len,
+							void *user_data)
+{
+	struct flushed *flushed = user_data;
+
+	g_assert_cmpint(len, ==, 4);
+
+	flushed->handle[flushed->count] = handle;
+	flushed->value[flushed->count] = get_le32(value);
+	flushed->count++;
+}
+
+static void push_updates(struct gatt_nfy_queue *queue, uint32_t base)
+{
+	uint8_t value[4];
+	unsigned int i, j;
+
+	for (i = 0; i < NUM_UPDATES; i++) {
+		for (j = 0; j < NUM_HANDLES; j++) {
+			put_le32(base + i, value);
+			g_assert(gatt_nfy_queue_push(queue, handles[j], value,
+							sizeof(value)));
+		}
+	}
+}
+
+static void test_latest(const void *user_data)
+{
+	struct gatt_nfy_queue *queue;
+	struct flushed flushed;
+	uint8_t value[4];
+	unsigned int i;
+
+	queue = gatt_nfy_queue_new(GATT_NFY_QUEUE_LATEST, QUEUE_SIZE);
+	g_assert(queue);
+
+	push_updates(queue, 0);
+
+	/* Updating the first characteristic again moves it last */
+	put_le32(NUM_UPDATES, value);
+	g_assert(gatt_nfy_queue_push(queue, handles[0], value, sizeof(value)));
+
+	g_assert_cmpint(gatt_nfy_queue_length(queue), ==, NUM_HANDLES);
+	g_assert_cmpint(gatt_nfy_queue_get_dropped(queue), ==,
+					NUM_HANDLES * NUM_UPDATES + 1 -
+					NUM_HANDLES);
+
+	memset(&flushed, 0, sizeof(flushed));
+	g_assert_cmpint(gatt_nfy_queue_flush(queue, flush_cb, &flushed), ==,
+								NUM_HANDLES);
+	g_assert_cmpint(gatt_nfy_queue_length(queue), ==, 0);
+
+	for (i = 0; i < NUM_HANDLES; i++) {
+		unsigned int index = (i + 1) % NUM_HANDLES;
+
+		g_assert_cmpint(flushed.handle[i], ==, handles[index]);
+		g_assert_cmpint(flushed.value[i], ==, index ? NUM_UPDATES - 1 :
+								NUM_UPDATES);
+	}
+
+	gatt_nfy_queue_free(queue);
+
+	tester_test_passed();
+}
+
+static void test_fifo(const void *user_data)
+{
+	struct gatt_nfy_queue *queue;
+	struct flushed flushed;
+	unsigned int i;
+
+	queue = gatt_nfy_queue_new(GATT_NFY_QUEUE_FIFO, QUEUE_SIZE);
+	g_assert(queue);
+
+	push_updates(queue, 0);
+
+	g_assert_cmpint(gatt_nfy_queue_length(queue), ==,
+						NUM_HANDLES * QUEUE_SIZE);
+	g_assert_cmpint(gatt_nfy_queue_get_dropped(queue), ==,
+				NUM_HANDLES * (NUM_UPDATES - QUEUE_SIZE));
+
+	/* Only the newest values are kept, in the order they were queued */
+	memset(&flushed, 0, sizeof(flushed));
+	g_assert_cmpint(gatt_nfy_queue_flush(queue, flush_cb, &flushed), ==,
+						NUM_HANDLES * QUEUE_SIZE);
+
+	for (i = 0; i < flushed.count; i++) {
+		g_assert_cmpint(flushed.handle[i], ==, handles[i % NUM_HANDLES]);
+		g_assert_cmpint(flushed.value[i], ==, NUM_UPDATES - QUEUE_SIZE +
+							i / NUM_HANDLES);
+	}
+
+	gatt_nfy_queue_free(queue);
+
+	tester_test_passed();
+}
+
+static void test_range(const void *user_data)
+{
+	struct gatt_nfy_queue *queue;
+	struct flushed flushed;
+
+	g_assert(!gatt_nfy_queue_new(GATT_NFY_QUEUE_FIFO + 1, QUEUE_SIZE));
+	g_assert(!gatt_nfy_queue_new(GATT_NFY_QUEUE_FIFO, 0));
+
+	queue = gatt_nfy_queue_new(GATT_NFY_QUEUE_FIFO, QUEUE_SIZE);
+	g_assert(queue);
+
+	push_updates(queue, 0);
+
+	/* Values of a removed service are dropped */
+	gatt_nfy_queue_remove_range(queue, handles[1] - 1, handles[1] + 1);
+	g_assert_cmpint(gatt_nfy_queue_length(queue), ==,
+					(NUM_HANDLES - 1) * QUEUE_SIZE);
+
+	memset(&flushed, 0, sizeof(flushed));
+	gatt_nfy_queue_foreach(queue, flush_cb, &flushed);
+	g_assert_cmpint(flushed.count, ==, (NUM_HANDLES - 1) * QUEUE_SIZE);
+	g_assert_cmpint(gatt_nfy_queue_length(queue), ==, flushed.count);
+
+	gatt_nfy_queue_free(queue);
+
+	tester_test_passed();
+}
+
+struct device {
+	struct bt_att *att;
+	struct bt_att *peer;
+	struct bt_gatt_server *server;
+	struct gatt_nfy_queue *queue;
+	unsigned int index;
+	uint32_t next[NUM_HANDLES];
+};
+
+struct storm {
+	struct device devices[NUM_DEVICES];
+	struct gatt_db *db;
+	unsigned int values;
+	unsigned int pdus;
+	uint64_t start;
+};
+
+static uint64_t get_time_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1000000ull + ts.tv_nsec / 1000;
+}
+
+static void storm_teardown(const void *user_data)
+{
+	struct storm *storm = (void *) user_data;
+	unsigned int i;
+
+	for (i = 0; i < NUM_DEVICES; i++) {
+		struct device *device = &storm->devices[i];
+
+		gatt_nfy_queue_free(device->queue);
+		bt_gatt_server_unref(device->server);
+		bt_att_unref(device->att);
+		bt_att_unref(device->peer);
+	}
+
+	gatt_db_unref(storm->db);
+
+	memset(storm, 0, sizeof(*storm));
+
+	tester_teardown_complete();
+}
+
+static struct storm storm;
+
+static void storm_value(struct device *device, uint16_t handle,
+					const uint8_t *value, uint16_t len)
+{
+	unsigned int i;
+
+	g_assert_cmpint(len, ==, 4);
+
+	for (i = 0; i < NUM_HANDLES; i++) {
+		if (handles[i] == handle)
+			break;
+	}
+
+	g_assert(i < NUM_HANDLES);
+
+	/* Each device gets its own values, per characteristic in order */
+	g_assert_cmpint(get_le32(value), ==, (device->index << 16) +
+							device->next[i]);
+	device->next[i]++;
+
+	if (++storm.values < NUM_DEVICES * NUM_HANDLES * QUEUE_SIZE)
+		return;
+
+	tester_debug("%u values to %u devices in %u PDUs, %llu us",
+				storm.values, NUM_DEVICES, storm.pdus,
+				(unsigned long long) (get_time_us() -
+							storm.start));
+
+	g_assert_cmpint(storm.pdus, <, storm.values);
+
+	tester_test_passed();
+}
+
+static void nfy_mult_cb(struct bt_att_chan *chan, uint16_t mtu, uint8_t opcode,
+					const void *pdu, uint16_t length,
+					void *user_data)
+{
+	struct device *device = user_data;
+	const uint8_t *ptr = pdu;
+
+	storm.pdus++;
+
+	while (length >= 4) {
+		uint16_t len = get_le16(ptr + 2);
+
+		g_assert_cmpint(length, >=, 4 + len);
+
+		storm_value(device, get_le16(ptr), ptr + 4, len);
+
+		ptr += 4 + len;
+		length -= 4 + len;
+	}
+
+	g_assert_cmpint(length, ==, 0);
+}
+
+static void flush_server_cb(uint16_t handle, const uint8_t *value,
+					uint16_t len, void *user_data)
+{
+	struct device *device = user_data;
+
+	g_assert(bt_gatt_server_send_notification(device->server, handle,
+							value, len, true));
+}
+
+static void test_reconnect_storm(const void *user_data)
+{
+	unsigned int i, j;
+
+	storm.db = gatt_db_new();
+
+	/* Values queued while all devices were away */
+	for (i = 0; i < NUM_DEVICES; i++) {
+		struct device *device = &storm.devices[i];
+
+		device->index = i;
+		device->queue = gatt_nfy_queue_new(GATT_NFY_QUEUE_FIFO,
+								QUEUE_SIZE);
+		g_assert(device->queue);
+
+		push_updates(device->queue, i << 16);
+
+		for (j = 0; j < NUM_HANDLES; j++)
+			device->next[j] = NUM_UPDATES - QUEUE_SIZE;
+	}
+
+	storm.start = get_time_us();
+
+	/* All of them come back at once */
+	for (i = 0; i < NUM_DEVICES; i++) {
+		struct device *device = &storm.devices[i];
+		int sv[2];
+
+		g_assert(socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0,
+								sv) == 0);
+
+		device->att = bt_att_new(sv[0], false);
+		g_assert(device->att);
+		bt_att_set_close_on_unref(device->att, true);
+		g_assert(bt_att_set_mtu(device->att, STORM_MTU));
+
+		device->peer = bt_att_new(sv[1], false);
+		g_assert(device->peer);
+		bt_att_set_close_on_unref(device->peer, true);
+		g_assert(bt_att_set_mtu(device->peer, STORM_MTU));
+
+		bt_att_register(device->peer, BT_ATT_OP_HANDLE_NFY_MULT,
+						nfy_mult_cb, device, NULL);
+
+		device->server = bt_gatt_server_new(storm.db, device->att,
+							STORM_MTU, 0);
+		g_assert(device->server);
+
+		g_assert_cmpint(gatt_nfy_queue_flush(device->queue,
+						flush_server_cb, device), ==,
+						NUM_HANDLES * QUEUE_SIZE);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	tester_init(&argc, &argv);
+
+	tester_add("/gatt-nfy-queue/latest", NULL, NULL, test_latest, NULL);
+	tester_add("/gatt-nfy-queue/fifo", NULL, NULL, test_fifo, NULL);
+	tester_add("/gatt-nfy-queue/range", NULL, NULL, test_range, NULL);
+	tester_add("/gatt-nfy-queue/reconnect-storm", &storm, NULL,
+					test_reconnect_storm, storm_teardown);
+
+	return tester_run();
+}
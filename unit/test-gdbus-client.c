@@ -22,6 +22,9 @@
 #define SERVICE_NAME1 "org.bluez.unit.test_gdbus_client1"
 #define SERVICE_PATH "/org/bluez/unit/test_gdbus_client"
 
+#define FLOOD_UPDATES 1000
+#define FLOOD_INTERVAL 100
+
 struct context {
 	DBusConnection *dbus_conn;
 	GDBusClient *dbus_client;
@@ -904,6 +907,148 @@ static void client_ready(const void *data)
 						proxy_added, NULL, NULL, context);
 }
 
+static const unsigned int flood_interval = FLOOD_INTERVAL;
+
+struct flood {
+	dbus_uint32_t counter;
+	dbus_bool_t done;
+	dbus_uint32_t received;
+	unsigned int signals;
+	gint64 start;
+	unsigned int interval;
+};
+
+static gboolean get_counter(const GDBusPropertyTable *property,
+					DBusMessageIter *iter, void *data)
+{
+	struct context *context = data;
+	struct flood *flood = context->data;
+
+	dbus_message_iter_append_basic(iter, DBUS_TYPE_UINT32,
+							&flood->counter);
+
+	return TRUE;
+}
+
+static gboolean get_done(const GDBusPropertyTable *property,
+					DBusMessageIter *iter, void *data)
+{
+	struct context *context = data;
+	struct flood *flood = context->data;
+
+	dbus_message_iter_append_basic(iter, DBUS_TYPE_BOOLEAN, &flood->done);
+
+	return TRUE;
+}
+
+static gboolean emit_counter_change(gpointer user_data)
+{
+	struct context *context = user_data;
+	struct flood *flood = context->data;
+
+	flood->counter++;
+
+	g_dbus_emit_property_changed(context->dbus_conn, SERVICE_PATH,
+						SERVICE_NAME, "Counter");
+
+	if (flood->counter < FLOOD_UPDATES)
+		return TRUE;
+
+	/* Sends the pending change right away, without waiting */
+	flood->done = TRUE;
+
+	g_dbus_emit_property_changed(context->dbus_conn, SERVICE_PATH,
+						SERVICE_NAME, "Done");
+
+	context->timeout_source = 0;
+
+	return FALSE;
+}
+
+static void proxy_flood(GDBusProxy *proxy, void *user_data)
+{
+	struct context *context = user_data;
+	struct flood *flood = context->data;
+
+	tester_debug("proxy %s found", g_dbus_proxy_get_interface(proxy));
+
+	flood->start = g_get_monotonic_time();
+
+	context->timeout_source = g_timeout_add(1, emit_counter_change,
+								context);
+}
+
+static void property_flood_changed(GDBusProxy *proxy, const char *name,
+					DBusMessageIter *iter, void *user_data)
+{
+	struct context *context = user_data;
+	struct flood *flood = context->data;
+	unsigned int msec;
+
+	if (g_strcmp0(name, "Counter") == 0) {
+		g_assert(dbus_message_iter_get_arg_type(iter) ==
+							DBUS_TYPE_UINT32);
+		dbus_message_iter_get_basic(iter, &flood->received);
+		flood->signals++;
+		return;
+	}
+
+	g_assert(g_strcmp0(name, "Done") == 0);
+
+	/* The last update is merged into the signal carrying Done */
+	g_assert_cmpint(flood->received, ==, FLOOD_UPDATES);
+
+	msec = (g_get_monotonic_time() - flood->start) / 1000;
+
+	tester_debug("%u updates in %u signals, %u ms (%u signals/s)",
+				FLOOD_UPDATES, flood->signals, msec,
+				msec ? flood->signals * 1000 / msec : 0);
+
+	if (flood->interval)
+		g_assert_cmpint(flood->signals, <=,
+					msec / flood->interval + 2);
+
+	g_dbus_client_unref(context->dbus_client);
+}
+
+static void client_property_flood(const void *data)
+{
+	struct context *context = create_context();
+	const unsigned int *interval = data;
+	static const GDBusPropertyTable flood_properties[] = {
+		{ "Counter", "u", get_counter },
+		{ "Done", "b", get_done, NULL, NULL,
+					G_DBUS_PROPERTY_FLAG_URGENT },
+		{ },
+	};
+	struct flood *flood;
+
+	if (context == NULL)
+		return;
+
+	flood = g_new0(struct flood, 1);
+	flood->interval = interval ? *interval : 0;
+	context->data = flood;
+
+	g_dbus_register_interface(context->dbus_conn,
+				SERVICE_PATH, SERVICE_NAME,
+				methods, signals, flood_properties,
+				context, NULL);
+
+	g_dbus_set_property_changed_interval(context->dbus_conn,
+					SERVICE_PATH, SERVICE_NAME,
+					flood->interval);
+
+	context->dbus_client = g_dbus_client_new(context->dbus_conn,
+						SERVICE_NAME, SERVICE_PATH);
+
+	g_dbus_client_set_disconnect_watch(context->dbus_client,
+						disconnect_handler, context);
+	g_dbus_client_set_proxy_handlers(context->dbus_client, proxy_flood,
+						NULL, property_flood_changed,
+						context);
+}
+
 int main(int argc, char *argv[])
 {
 	tester_init(&argc, &argv);
@@ -948,5 +1093,11 @@ int main(int argc, char *argv[])
 
 	tester_add("/gdbus/client_ready", NULL, NULL, client_ready, NULL);
 
+	tester_add("/gdbus/client_property_flood", NULL, NULL,
+					client_property_flood, NULL);
+
+	tester_add("/gdbus/client_property_flood_limited", &flood_interval,
+					NULL, client_property_flood, NULL);
+
 	return tester_run();
 }
@@ -0,0 +1,382 @@
+// SPDX-License-Identifier: LGPL-2.1-or-later
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2026  agent <agent@local>
+ *
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/resource.h>
+
+#include <glib.h>
+
+#include "src/shared/util.h"
+#include "src/shared/tester.h"
+
+/*
+ * The tester runs on the GLib main loop, so the epoll based one under test
+ * is built in with its functions renamed.
+ */
+#define mainloop_init		epoll_mainloop_init
+#define mainloop_quit		epoll_mainloop_quit
+#define mainloop_exit_success	epoll_mainloop_exit_success
+#define mainloop_exit_failure	epoll_mainloop_exit_failure
+#define mainloop_run		epoll_mainloop_run
+#define mainloop_set_max_events	epoll_mainloop_set_max_events
+#define mainloop_add_fd		epoll_mainloop_add_fd
+#define mainloop_modify_fd	epoll_mainloop_modify_fd
+#define mainloop_remove_fd	epoll_mainloop_remove_fd
+#define mainloop_add_timeout	epoll_mainloop_add_timeout
+#define mainloop_modify_timeout	epoll_mainloop_modify_timeout
+#define mainloop_remove_timeout	epoll_mainloop_remove_timeout
+
+#include "src/shared/mainloop.c"
+
+#define NUM_TIMEOUTS		100000
+#define NUM_ORDERED		2000
+#define NUM_PIPES		300
+
+static uint64_t get_time_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1000000ull + ts.tv_nsec / 1000;
+}
+
+struct ordered {
+	unsigned int msec;
+	uint64_t fired;
+};
+
+static unsigned int ordered_count;
+static unsigned int ordered_last;
+
+static void ordered_callback(int id, void *user_data)
+{
+	struct ordered *entry = user_data;
+
+	/* Timeouts must never fire early or out of order */
+	g_assert(get_time_us() >= entry->fired + entry->msec * 1000);
+	g_assert(entry->msec >= ordered_last);
+
+	ordered_last = entry->msec;
+	entry->fired = 0;
+
+	mainloop_remove_timeout(id);
+
+	if (++ordered_count == NUM_ORDERED)
+		mainloop_quit();
+}
+
+static void test_ordered(const void *data)
+{
+	struct ordered *entries;
+	unsigned int i;
+
+	entries = new0(struct ordered, NUM_ORDERED);
+
+	mainloop_init();
+
+	for (i = 0; i < NUM_ORDERED; i++) {
+		entries[i].msec = ((i * 7919) % 97 + 1) * 5;
+		entries[i].fired = get_time_us();
+
+		g_assert(mainloop_add_timeout(entries[i].msec, ordered_callback,
+						&entries[i], NULL) > 0);
+	}
+
+	mainloop_run();
+
+	g_assert(ordered_count == NUM_ORDERED);
+
+	for (i = 0; i < NUM_ORDERED; i++)
+		g_assert(!entries[i].fired);
+
+	free(entries);
+
+	tester_test_passed();
+}
+
+static unsigned int destroyed;
+static unsigned int fired;
+static int cancelled_id;
+static int rearm_id;
+
+static void destroy_callback(void *user_data)
+{
+	destroyed++;
+}
+
+static void cancelled_callback(int id, void *user_data)
+{
+	g_assert_not_reached();
+}
+
+static void rearm_callback(int id, void *user_data)
+{
+	g_assert(id == rearm_id);
+
+	/* A fired timeout stays registered until it is armed again */
+	if (++fired < 3) {
+		g_assert(!mainloop_modify_timeout(id, 5));
+		return;
+	}
+
+	g_assert(!mainloop_remove_timeout(cancelled_id));
+	mainloop_quit();
+}
+
+static void test_semantics(const void *data)
+{
+	int idle_id;
+
+	mainloop_init();
+
+	g_assert(mainloop_add_timeout(10, NULL, NULL, NULL) < 0);
+
+	cancelled_id = mainloop_add_timeout(20, cancelled_callback, NULL,
+							destroy_callback);
+	g_assert(cancelled_id > 0);
+
+	/* Cancelling the earliest timeout must not stop the others */
+	idle_id = mainloop_add_timeout(1, cancelled_callback, NULL,
+							destroy_callback);
+	g_assert(idle_id > 0);
+	g_assert(!mainloop_remove_timeout(idle_id));
+	g_assert(destroyed == 1);
+	g_assert(mainloop_remove_timeout(idle_id) < 0);
+	g_assert(mainloop_modify_timeout(idle_id, 1) < 0);
+
+	/* A zero timeout is registered but never armed */
+	idle_id = mainloop_add_timeout(0, cancelled_callback, NULL,
+							destroy_callback);
+	g_assert(idle_id > 0);
+
+	rearm_id = mainloop_add_timeout(5, rearm_callback, NULL,
+							destroy_callback);
+	g_assert(rearm_id > 0);
+
+	mainloop_run();
+
+	g_assert(fired == 3);
+
+	/* Leftover timeouts are released when the loop exits */
+	g_assert(destroyed == 4);
+
+	tester_test_passed();
+}
+
+static unsigned int pipe_reads;
+
+static void pipe_callback(int fd, uint32_t events, void *user_data)
+{
+	char buf;
+
+	g_assert(read(fd, &buf, 1) == 1);
+	g_assert(buf == (char) (uintptr_t) user_data);
+
+	mainloop_remove_fd(fd);
+
+	if (++pipe_reads == 2)
+		mainloop_quit();
+}
+
+static void test_fds(const void *data)
+{
+	int fds[NUM_PIPES][2];
+	struct rlimit rlim;
+	unsigned int i, count;
+	char buf;
+
+	if (getrlimit(RLIMIT_NOFILE, &rlim) < 0) {
+		tester_test_abort();
+		return;
+	}
+
+	count = NUM_PIPES;
+	if (rlim.rlim_cur < NUM_PIPES * 2 + 32)
+		count = (rlim.rlim_cur - 32) / 2;
+
+	mainloop_init();
+
+	for (i = 0; i < count; i++) {
+		g_assert(pipe(fds[i]) == 0);
+		g_assert(!mainloop_add_fd(fds[i][0], EPOLLIN, pipe_callback,
+					(void *) (uintptr_t) i, NULL));
+	}
+
+	/* Both ends of the table must work, well past the initial size */
+	buf = 0;
+	g_assert(write(fds[0][1], &buf, 1) == 1);
+	buf = count - 1;
+	g_assert(write(fds[count - 1][1], &buf, 1) == 1);
+
+	g_assert(!mainloop_modify_fd(fds[count - 1][0], EPOLLIN));
+	g_assert(mainloop_modify_fd(fds[count - 1][1], EPOLLIN) < 0);
+
+	mainloop_run();
+
+	g_assert(pipe_reads == 2);
+
+	for (i = 0; i < count; i++) {
+		close(fds[i][0]);
+		close(fds[i][1]);
+	}
+
+	tester_debug("%u file descriptors in the main loop", count * 2);
+
+	tester_test_passed();
+}
+
+static int removal_fds[2][2];
+static unsigned int removal_calls;
+
+static void removal_callback(int fd, uint32_t events, void *user_data)
+{
+	/* Removing a descriptor with events pending in the same batch */
+	mainloop_remove_fd(removal_fds[0][0]);
+	mainloop_remove_fd(removal_fds[1][0]);
+
+	removal_calls++;
+
+	mainloop_quit();
+}
+
+static void test_removal(const void *data)
+{
+	unsigned int i;
+	char buf = 0;
+
+	mainloop_init();
+	g_assert(!mainloop_set_max_events(2));
+
+	for (i = 0; i < 2; i++) {
+		g_assert(pipe(removal_fds[i]) == 0);
+		g_assert(write(removal_fds[i][1], &buf, 1) == 1);
+		g_assert(!mainloop_add_fd(removal_fds[i][0], EPOLLIN,
+					removal_callback, NULL, NULL));
+	}
+
+	mainloop_run();
+
+	g_assert(removal_calls == 1);
+
+	for (i = 0; i < 2; i++) {
+		close(removal_fds[i][0]);
+		close(removal_fds[i][1]);
+	}
+
+	g_assert(mainloop_set_max_events(0) < 0);
+	g_assert(!mainloop_set_max_events(64));
+
+	tester_test_passed();
+}
+
+static void timeout_callback(int id, void *user_data)
+{
+}
+
+static int timerfd_arm(int epoll_fd, unsigned int msec)
+{
+	struct itimerspec itimer;
+	struct epoll_event ev;
+	int fd;
+
+	fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	g_assert(fd >= 0);
+
+	memset(&itimer, 0, sizeof(itimer));
+	itimer.it_value.tv_sec = msec / 1000;
+	itimer.it_value.tv_nsec = (msec % 1000) * 1000000;
+	g_assert(!timerfd_settime(fd, 0, &itimer, NULL));
+
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN | EPOLLONESHOT;
+	g_assert(!epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev));
+
+	return fd;
+}
+
+static void test_throughput(const void *data)
+{
+	static int ids[NUM_TIMEOUTS];
+	uint64_t start, per_fd, shared;
+	unsigned int i;
+	int epoll_fd;
+
+	/* Reference, one timerfd per timeout as the main loop used to do */
+	epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	g_assert(epoll_fd >= 0);
+
+	start = get_time_us();
+
+	for (i = 0; i < NUM_TIMEOUTS; i++) {
+		int fd = timerfd_arm(epoll_fd, 30000 + i % 1000);
+
+		epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+		close(fd);
+	}
+
+	per_fd = get_time_us() - start;
+
+	close(epoll_fd);
+
+	mainloop_init();
+
+	start = get_time_us();
+
+	for (i = 0; i < NUM_TIMEOUTS; i++) {
+		ids[i] = mainloop_add_timeout(30000 + i % 1000,
+						timeout_callback, NULL, NULL);
+		g_assert(ids[i] > 0);
+	}
+
+	for (i = 0; i < NUM_TIMEOUTS; i++)
+		g_assert(!mainloop_modify_timeout(ids[i], 30000 + i % 997));
+
+	for (i = 0; i < NUM_TIMEOUTS; i++)
+		g_assert(!mainloop_remove_timeout(ids[NUM_TIMEOUTS - 1 - i]));
+
+	shared = get_time_us() - start;
+
+	mainloop_quit();
+	mainloop_run();
+
+	tester_debug("%u timeouts armed and cancelled: "
+				"timerfd %llu us shared timer %llu us",
+				NUM_TIMEOUTS, (unsigned long long) per_fd,
+				(unsigned long long) shared);
+
+	tester_test_passed();
+}
+
+int main(int argc, char *argv[])
+{
+	tester_init(&argc, &argv);
+
+	tester_add("/mainloop/ordered", NULL, NULL, test_ordered, NULL);
+	tester_add("/mainloop/semantics", NULL, NULL, test_semantics, NULL);
+	tester_add("/mainloop/fds", NULL, NULL, test_fds, NULL);
+	tester_add("/mainloop/removal", NULL, NULL, test_removal, NULL);
+	tester_add("/mainloop/throughput", NULL, NULL, test_throughput, NULL);
+
+	return tester_run();
+}
@@ -0,0 +1,183 @@
+// SPDX-License-Identifier: LGPL-2.1-or-later
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2026  agent <agent@local>
+ *
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+
+#include <ell/ell.h>
+
+#include "mesh/net-cache.h"
+
+#define FAST_CACHE_SIZE		8
+#define MSG_CACHE_SIZE		70
+
+#define NUM_PDUS		200000
+#define NUM_REPEATS		3
+
+struct cache_msg {
+	uint64_t key;
+	uint32_t key_ext;
+};
+
+/* Reference implementation, the linked list the caches used to be */
+static bool match_msg(const void *a, const void *b)
+{
+	const struct cache_msg *msg = a;
+	const struct cache_msg *tst = b;
+
+	return msg->key == tst->key && msg->key_ext == tst->key_ext;
+}
+
+static bool queue_cache_add(struct l_queue *queue, unsigned int size,
+					uint64_t key, uint32_t key_ext)
+{
+	struct cache_msg tst = { .key = key, .key_ext = key_ext };
+	struct cache_msg *msg;
+
+	if (l_queue_find(queue, match_msg, &tst))
+		return false;
+
+	if (l_queue_length(queue) >= size)
+		msg = l_queue_pop_head(queue);
+	else
+		msg = l_new(struct cache_msg, 1);
+
+	*msg = tst;
+	l_queue_push_tail(queue, msg);
+
+	return true;
+}
+
+static uint32_t rand_state = 0x12345678;
+
+static uint32_t next_rand(void)
+{
+	rand_state = rand_state * 1103515245 + 12345;
+
+	return rand_state >> 8;
+}
+
+static void check_cache(unsigned int size, unsigned int range)
+{
+	struct net_cache *cache = net_cache_new(size);
+	struct l_queue *queue = l_queue_new();
+	unsigned int i;
+
+	l_info("Cache size %u key range %u", size, range);
+
+	if (!cache)
+		exit(1);
+
+	for (i = 0; i < NUM_PDUS; i++) {
+		uint64_t key = next_rand() % range;
+		uint32_t key_ext = key & 1 ? next_rand() % 2 : 0;
+
+		if (net_cache_add(cache, key, key_ext) !=
+				queue_cache_add(queue, size, key, key_ext))
+			exit(1);
+
+		if (net_cache_get_count(cache) != l_queue_length(queue))
+			exit(1);
+
+		/* Same as an IV Index update flushing the cache */
+		if (i % 50000 == 49999) {
+			net_cache_clear(cache);
+			l_queue_clear(queue, l_free);
+		}
+	}
+
+	net_cache_free(cache);
+	l_queue_destroy(queue, l_free);
+}
+
+/*
+ * Replays bursts of network PDUs the way net_msg_recv sees them: each PDU is
+ * received several times through relays and first goes through the fast
+ * cache, then through the network message cache when new.
+ */
+static void check_throughput(void)
+{
+	struct net_cache *fast = net_cache_new(FAST_CACHE_SIZE);
+	struct net_cache *msgs = net_cache_new(MSG_CACHE_SIZE);
+	struct l_queue *fast_queue = l_queue_new();
+	struct l_queue *msg_queue = l_queue_new();
+	uint64_t start, list_time, cache_time;
+	unsigned int i, j, list_new = 0, cache_new = 0;
+
+	start = l_time_now();
+
+	for (i = 0; i < NUM_PDUS; i++) {
+		for (j = 0; j < NUM_REPEATS; j++) {
+			/* Repeats of the PDU arrive shortly after the first */
+			unsigned int pdu = i - (j * 5 < i ? j * 5 : 0);
+			uint64_t hash = (uint64_t) pdu * 0x100000001ULL;
+
+			if (!queue_cache_add(fast_queue, FAST_CACHE_SIZE,
+								hash, 0))
+				continue;
+
+			if (queue_cache_add(msg_queue, MSG_CACHE_SIZE,
+						pdu & 0xffffff, pdu >> 8))
+				list_new++;
+		}
+	}
+
+	list_time = l_time_now() - start;
+	start = l_time_now();
+
+	for (i = 0; i < NUM_PDUS; i++) {
+		for (j = 0; j < NUM_REPEATS; j++) {
+			unsigned int pdu = i - (j * 5 < i ? j * 5 : 0);
+			uint64_t hash = (uint64_t) pdu * 0x100000001ULL;
+
+			if (!net_cache_add(fast, hash, 0))
+				continue;
+
+			if (net_cache_add(msgs, pdu & 0xffffff, pdu >> 8))
+				cache_new++;
+		}
+	}
+
+	cache_time = l_time_now() - start;
+
+	l_info("%u PDUs: list %" PRIu64 " us cache %" PRIu64 " us",
+				NUM_PDUS * NUM_REPEATS, list_time, cache_time);
+
+	if (list_new != cache_new || cache_new != NUM_PDUS)
+		exit(1);
+
+	net_cache_free(fast);
+	net_cache_free(msgs);
+	l_queue_destroy(fast_queue, l_free);
+	l_queue_destroy(msg_queue, l_free);
+}
+
+int main(int argc, char *argv[])
+{
+	l_log_set_stderr();
+
+	if (net_cache_new(0))
+		exit(1);
+
+	check_cache(FAST_CACHE_SIZE, 16);
+	check_cache(MSG_CACHE_SIZE, 100);
+	check_cache(MSG_CACHE_SIZE, 1000);
+	check_cache(1, 4);
+	check_cache(1000, 3000);
+
+	check_throughput();
+
+	return 0;
+}
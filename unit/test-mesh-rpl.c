@@ -0,0 +1,339 @@
+// SPDX-License-Identifier: LGPL-2.1-or-later
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2026  agent <agent@local>
+ *
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <inttypes.h>
+
+#include <sys/stat.h>
+
+#include <ell/ell.h>
+
+#include "mesh/mesh-defs.h"
+#include "mesh/node.h"
+#include "mesh/util.h"
+#include "mesh/rpl.h"
+
+#define NUM_SRC		200
+#define NUM_PUTS	20000
+
+struct mesh_node {
+	char *storage_dir;
+};
+
+const char *node_get_storage_dir(struct mesh_node *node)
+{
+	return node->storage_dir;
+}
+
+static struct mesh_node node;
+static char journal[PATH_MAX];
+
+static void setup(void)
+{
+	char dir[] = "/tmp/mesh-rpl-XXXXXX";
+
+	if (!mkdtemp(dir))
+		exit(1);
+
+	node.storage_dir = l_strdup(dir);
+	snprintf(journal, sizeof(journal), "%s/rpl/journal", dir);
+
+	if (!rpl_init(node.storage_dir))
+		exit(1);
+}
+
+static void teardown(void)
+{
+	rpl_release(&node);
+	del_path(node.storage_dir);
+	l_free(node.storage_dir);
+}
+
+/* Simulates a restart of the daemon and returns the reloaded entries */
+static struct l_hashmap *reload(void)
+{
+	struct l_hashmap *rpl_list = l_hashmap_new();
+
+	rpl_release(&node);
+
+	if (!rpl_get_list(&node, rpl_list))
+		exit(1);
+
+	return rpl_list;
+}
+
+static void check_entry(struct l_hashmap *rpl_list, uint16_t src,
+						uint32_t iv_index, uint32_t seq)
+{
+	struct mesh_rpl *rpl = l_hashmap_lookup(rpl_list, L_UINT_TO_PTR(src));
+
+	if (!rpl || rpl->src != src || rpl->iv_index != iv_index ||
+							rpl->seq != seq)
+		exit(1);
+}
+
+static off_t journal_size(void)
+{
+	struct stat st;
+
+	if (stat(journal, &st) < 0)
+		exit(1);
+
+	return st.st_size;
+}
+
+static void check_journal(void)
+{
+	struct l_hashmap *rpl_list;
+	uint64_t start;
+	unsigned int i;
+
+	l_info("Journal");
+	setup();
+
+	start = l_time_now();
+
+	for (i = 0; i < NUM_PUTS; i++) {
+		if (!rpl_put_entry(&node, 1 + i % NUM_SRC, 5, i))
+			exit(1);
+	}
+
+	l_info("%u entries stored in %" PRIu64 " us", NUM_PUTS,
+							l_time_now() - start);
+
+	/* Compaction keeps the journal bounded by the number of sources */
+	if (journal_size() > 8 + 12 * 4 * 1024)
+		exit(1);
+
+	rpl_del_entry(&node, 1);
+
+	rpl_list = reload();
+
+	if (l_hashmap_size(rpl_list) != NUM_SRC - 1)
+		exit(1);
+
+	for (i = NUM_PUTS - NUM_SRC + 1; i < NUM_PUTS; i++)
+		check_entry(rpl_list, 1 + i % NUM_SRC, 5, i);
+
+	l_hashmap_destroy(rpl_list, l_free);
+	teardown();
+}
+
+/*
+ * Makes compaction fail by leaving a dangling symlink where its temporary
+ * file goes, no record may be lost and compaction resumes once it is gone.
+ */
+static void check_compact_failure(void)
+{
+	struct l_hashmap *rpl_list;
+	char tmp_path[PATH_MAX + 4];
+	unsigned int i;
+
+	l_info("Compaction failure");
+	setup();
+
+	/* The journal is created on first use */
+	if (!rpl_put_entry(&node, 1, 5, 0))
+		exit(1);
+
+	snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", journal);
+	if (symlink("/nonexistent/journal", tmp_path) < 0)
+		exit(1);
+
+	for (i = 1; i < 2048; i++) {
+		if (!rpl_put_entry(&node, 1 + i % 10, 5, i))
+			exit(1);
+	}
+
+	/* Every record was appended, none was compacted away */
+	if (journal_size() != 8 + 12 * (1 + 2047))
+		exit(1);
+
+	rpl_list = reload();
+
+	if (l_hashmap_size(rpl_list) != 10)
+		exit(1);
+
+	for (i = 2048 - 10; i < 2048; i++)
+		check_entry(rpl_list, 1 + i % 10, 5, i);
+
+	l_hashmap_destroy(rpl_list, l_free);
+
+	unlink(tmp_path);
+
+	for (i = 2048; i < 4096; i++) {
+		if (!rpl_put_entry(&node, 1 + i % 10, 5, i))
+			exit(1);
+	}
+
+	if (journal_size() > 8 + 12 * 1024)
+		exit(1);
+
+	rpl_list = reload();
+
+	for (i = 4096 - 10; i < 4096; i++)
+		check_entry(rpl_list, 1 + i % 10, 5, i);
+
+	l_hashmap_destroy(rpl_list, l_free);
+	teardown();
+}
+
+/*
+ * Cuts the journal at every possible point of its last records, the way a
+ * power loss in the middle of a write would, and checks that all entries
+ * written before are still there and the journal can still be appended to.
+ */
+static void check_power_loss(void)
+{
+	struct l_hashmap *rpl_list;
+	off_t size;
+	int cut, fd;
+
+	l_info("Power loss");
+	setup();
+
+	for (cut = 1; cut <= 24; cut++) {
+		unsigned int expected;
+		uint16_t src;
+
+		for (src = 1; src <= 10; src++)
+			rpl_put_entry(&node, src, 7, 100 + src);
+
+		rpl_put_entry(&node, 11, 7, 200 + cut);
+		rpl_put_entry(&node, 12, 7, 300 + cut);
+		rpl_release(&node);
+
+		size = journal_size();
+		if (truncate(journal, size - cut) < 0)
+			exit(1);
+
+		/* Whole records lost with the cut, at most the last two */
+		expected = 12 - (cut + 11) / 12;
+
+		rpl_list = reload();
+
+		if (l_hashmap_size(rpl_list) != expected)
+			exit(1);
+
+		for (src = 1; src <= 10; src++)
+			check_entry(rpl_list, src, 7, 100 + src);
+
+		if (expected > 11)
+			check_entry(rpl_list, 11, 7, 200 + cut);
+
+		l_hashmap_destroy(rpl_list, l_free);
+
+		/* The torn record must have been dropped from the journal */
+		if ((journal_size() - 8) % 12)
+			exit(1);
+
+		rpl_del_entry(&node, 11);
+		rpl_del_entry(&node, 12);
+	}
+
+	/* Garbage at the end of the journal is discarded too */
+	fd = open(journal, O_WRONLY | O_APPEND);
+	if (fd < 0 || write(fd, "\x01\x02\x00\x05\x00\x00\x00\x99", 8) != 8)
+		exit(1);
+
+	close(fd);
+
+	rpl_list = reload();
+
+	if (l_hashmap_size(rpl_list) != 10)
+		exit(1);
+
+	l_hashmap_destroy(rpl_list, l_free);
+	teardown();
+}
+
+static void write_legacy(uint32_t iv_index, uint16_t src, uint32_t seq)
+{
+	char path[PATH_MAX];
+	char seq_txt[7];
+	int fd;
+
+	snprintf(path, PATH_MAX, "%s/rpl/%8.8x", node.storage_dir, iv_index);
+	mkdir(path, 0755);
+
+	snprintf(path, PATH_MAX, "%s/rpl/%8.8x/%4.4x", node.storage_dir,
+							iv_index, src);
+	fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+	snprintf(seq_txt, 7, "%6.6x", seq);
+
+	if (fd < 0 || write(fd, seq_txt, 6) != 6)
+		exit(1);
+
+	close(fd);
+}
+
+static void check_legacy(void)
+{
+	struct l_hashmap *rpl_list;
+	char path[PATH_MAX];
+	struct stat st;
+
+	l_info("Legacy import");
+	setup();
+
+	write_legacy(3, 0x0001, 0x10);
+	write_legacy(4, 0x0001, 0x05);
+	write_legacy(4, 0x0002, 0x20);
+	write_legacy(4, 0x8000, 0x30);
+
+	rpl_list = reload();
+
+	if (l_hashmap_size(rpl_list) != 2)
+		exit(1);
+
+	check_entry(rpl_list, 0x0001, 4, 0x05);
+	check_entry(rpl_list, 0x0002, 4, 0x20);
+	l_hashmap_destroy(rpl_list, l_free);
+
+	/* The old layout is gone once imported */
+	snprintf(path, PATH_MAX, "%s/rpl/%8.8x", node.storage_dir, 4);
+	if (stat(path, &st) == 0)
+		exit(1);
+
+	/* IV Index update drops entries older than the previous IV Index */
+	rpl_put_entry(&node, 0x0003, 5, 0x40);
+	rpl_update(&node, 6);
+
+	rpl_list = reload();
+
+	if (l_hashmap_size(rpl_list) != 1)
+		exit(1);
+
+	check_entry(rpl_list, 0x0003, 5, 0x40);
+	l_hashmap_destroy(rpl_list, l_free);
+
+	teardown();
+}
+
+int main(int argc, char *argv[])
+{
+	l_log_set_stderr();
+
+	check_journal();
+	check_compact_failure();
+	check_power_loss();
+	check_legacy();
+
+	return 0;
+}
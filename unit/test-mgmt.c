@@ -13,6 +13,7 @@
 #endif
 
 #include <stdbool.h>
+#include <string.h>
 #include <unistd.h>
 #include <sys/socket.h>
 
@@ -21,6 +22,7 @@
 #include "bluetooth/bluetooth.h"
 #include "bluetooth/mgmt.h"
 
+#include "src/shared/util.h"
 #include "src/shared/mgmt.h"
 
 struct context {
@@ -416,6 +418,49 @@ static void test_destroy(gconstpointer data)
 	execute_context(context);
 }
 
+#define BURST_EVENTS 200
+
+struct burst {
+	struct context *context;
+	uint16_t next_index;
+};
+
+static void burst_cb(uint16_t index, uint16_t length, const void *param,
+							void *user_data)
+{
+	struct burst *burst = user_data;
+
+	/* Draining the socket must not reorder or drop events */
+	g_assert_cmpint(index, ==, burst->next_index);
+
+	if (++burst->next_index == BURST_EVENTS)
+		context_quit(burst->context);
+}
+
+static void test_event_burst(gconstpointer data)
+{
+	const struct command_test_data *test = data;
+	struct context *context = create_context();
+	struct burst burst = { .context = context };
+	unsigned char buf[sizeof(event_index_added)];
+	uint16_t i;
+
+	mgmt_register(context->mgmt_client, test->opcode, MGMT_INDEX_NONE,
+						burst_cb, &burst, NULL);
+
+	memcpy(buf, test->cmd_data, sizeof(buf));
+
+	for (i = 0; i < BURST_EVENTS; i++) {
+		put_le16(i, buf + 2);
+		g_assert_cmpint(write(context->fd, buf, sizeof(buf)), ==,
+								sizeof(buf));
+	}
+
+	execute_context(context);
+
+	g_assert_cmpint(burst.next_index, ==, BURST_EVENTS);
+}
+
 int main(int argc, char *argv[])
 {
 	g_test_init(&argc, &argv, NULL);
@@ -430,6 +475,8 @@ int main(int argc, char *argv[])
 
 	g_test_add_data_func("/mgmt/event/1", &event_test_1, test_event);
 	g_test_add_data_func("/mgmt/event/2", &event_test_1, test_event2);
+	g_test_add_data_func("/mgmt/event/burst", &event_test_1,
+							test_event_burst);
 
 	g_test_add_data_func("/mgmt/unregister/1", &event_test_1,
 							test_unregister_all);
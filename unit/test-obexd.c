@@ -0,0 +1,469 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ *
+ *  OBEX Server
+ *
+ *  Copyright (C) 2026  agent <agent@local>
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <errno.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+
+#include "gobex/gobex.h"
+
+#include "obexd/src/obexd.h"
+#include "obexd/src/plugin.h"
+#include "obexd/src/obex.h"
+#include "obexd/src/obex-priv.h"
+#include "obexd/src/mimetype.h"
+#include "obexd/src/service.h"
+#include "obexd/src/server.h"
+
+#include "util.h"
+
+#define TEST_MTU	4096
+#define TEST_SIZE	(64 * 1024)
+#define TEST_TYPE	"x-bluez/test"
+
+#define LARGE_MTU	32767
+#define LARGE_SIZE	(1024 * 1024)
+#define LARGE_SIZE_PERF	(32 * 1024 * 1024)
+
+struct put_data {
+	GMainLoop *mainloop;
+	GError *err;
+	const int *script;
+	unsigned int step;
+	unsigned int writes;
+	unsigned int eagain;
+	GByteArray *data;
+	gchar *path;
+	gsize size;
+	gsize sent;
+	gint64 start;
+};
+
+static struct put_data *put;
+
+extern const struct obex_plugin_desc __obex_builtin_filesystem;
+
+const char *obex_option_root_folder(void)
+{
+	return "/";
+}
+
+gboolean obex_option_symlinks(void)
+{
+	return TRUE;
+}
+
+static gboolean resume_write(gpointer user_data)
+{
+	obex_object_set_io_flags(user_data, G_IO_OUT, 0);
+
+	return FALSE;
+}
+
+static void *test_open(const char *name, int oflag, mode_t mode,
+					void *context, size_t *size, int *err)
+{
+	*err = 0;
+
+	return context;
+}
+
+static int test_close(void *object)
+{
+	return 0;
+}
+
+/*
+ * Each write consumes an entry of the script: a positive value limits the
+ * number of bytes written, a negative one is returned as error. Once the
+ * script is over everything is written.
+ */
+static ssize_t test_write(void *object, const void *buf, size_t count)
+{
+	struct put_data *d = object;
+	int res = d->script ? d->script[d->step] : 0;
+
+	if (res)
+		d->step++;
+
+	d->writes++;
+
+	if (res == -EAGAIN) {
+		d->eagain++;
+		g_idle_add(resume_write, d);
+		return res;
+	}
+
+	if (res < 0)
+		return res;
+
+	if (res > 0 && (size_t) res < count)
+		count = res;
+
+	g_byte_array_append(d->data, buf, count);
+
+	return count;
+}
+
+static const struct obex_mime_type_driver test_mime = {
+	.mimetype = TEST_TYPE,
+	.open = test_open,
+	.close = test_close,
+	.write = test_write,
+};
+
+static void *test_connect(struct obex_session *os, int *err)
+{
+	*err = 0;
+
+	return put;
+}
+
+static int test_put(struct obex_session *os, void *user_data)
+{
+	struct put_data *d = user_data;
+
+	/*
+	 * Without a type the object is written to a file by the filesystem
+	 * plugin, as it is for OPP and FTP.
+	 */
+	if (d->path)
+		return obex_put_stream_start(os, d->path);
+
+	return obex_put_stream_start(os, obex_get_name(os));
+}
+
+static const struct obex_service_driver test_service = {
+	.name = "Test",
+	.connect = test_connect,
+	.put = test_put,
+};
+
+static gssize provide_data(void *buf, gsize len, gpointer user_data)
+{
+	struct put_data *d = user_data;
+	guint8 *p = buf;
+	gsize i;
+
+	len = MIN(len, d->size - d->sent);
+
+	for (i = 0; i < len; i++)
+		p[i] = d->sent + i;
+
+	d->sent += len;
+
+	return len;
+}
+
+static void put_complete(GObex *obex, GError *err, gpointer user_data)
+{
+	struct put_data *d = user_data;
+
+	if (err != NULL)
+		d->err = g_error_copy(err);
+
+	g_main_loop_quit(d->mainloop);
+}
+
+static void conn_complete(GObex *obex, GError *err, GObexPacket *rsp,
+							gpointer user_data)
+{
+	struct put_data *d = user_data;
+
+	if (err != NULL) {
+		d->err = g_error_copy(err);
+		g_main_loop_quit(d->mainloop);
+		return;
+	}
+
+	if (g_obex_put_req(obex, provide_data, put_complete, d, &d->err,
+				G_OBEX_HDR_NAME, "test.bin",
+				G_OBEX_HDR_TYPE, TEST_TYPE, sizeof(TEST_TYPE),
+				G_OBEX_HDR_LENGTH, (guint32) d->size,
+				G_OBEX_HDR_INVALID) == 0)
+		g_main_loop_quit(d->mainloop);
+}
+
+static gboolean put_timeout(gpointer user_data)
+{
+	struct put_data *d = user_data;
+
+	d->err = g_error_new(TEST_ERROR, TEST_ERROR_TIMEOUT, "Timed out");
+	g_main_loop_quit(d->mainloop);
+
+	return FALSE;
+}
+
+static void run_put(struct put_data *d, guint16 mtu,
+						GObexResponseFunc conn_func)
+{
+	struct obex_server server;
+	GIOChannel *io;
+	GObex *client;
+	guint timer_id;
+	int sv[2];
+
+	d->mainloop = g_main_loop_new(NULL, FALSE);
+	put = d;
+
+	memset(&server, 0, sizeof(server));
+	server.drivers = g_slist_append(NULL, (gpointer) &test_service);
+
+	g_assert(socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK, 0,
+								sv) == 0);
+
+	io = g_io_channel_unix_new(sv[0]);
+	g_io_channel_set_close_on_unref(io, TRUE);
+	client = g_obex_new(io, G_OBEX_TRANSPORT_PACKET, mtu, mtu);
+	g_io_channel_unref(io);
+	g_assert(client != NULL);
+
+	io = g_io_channel_unix_new(sv[1]);
+	g_io_channel_set_close_on_unref(io, TRUE);
+	g_assert(obex_session_start(io, mtu, mtu, FALSE, &server) == 0);
+	g_io_channel_unref(io);
+
+	timer_id = g_timeout_add_seconds(10, put_timeout, d);
+
+	g_obex_connect(client, conn_func, d, &d->err, G_OBEX_HDR_INVALID);
+	g_assert_no_error(d->err);
+
+	g_main_loop_run(d->mainloop);
+
+	g_source_remove(timer_id);
+
+	/* Let the server process the disconnection */
+	g_obex_unref(client);
+	while (g_main_context_iteration(NULL, FALSE))
+		;
+
+	g_main_loop_unref(d->mainloop);
+	g_slist_free(server.drivers);
+	put = NULL;
+}
+
+static void test_put_script(const void *user_data)
+{
+	struct put_data d;
+	gsize i;
+
+	memset(&d, 0, sizeof(d));
+	d.script = user_data;
+	d.size = TEST_SIZE;
+	d.data = g_byte_array_new();
+
+	g_assert(obex_mime_type_driver_register(&test_mime) == 0);
+
+	run_put(&d, TEST_MTU, conn_complete);
+
+	obex_mime_type_driver_unregister(&test_mime);
+
+	g_assert_no_error(d.err);
+
+	/* Every byte is written exactly once and in order */
+	g_assert_cmpuint(d.data->len, ==, TEST_SIZE);
+	for (i = 0; i < d.data->len; i++)
+		g_assert_cmpuint(d.data->data[i], ==, (guint8) i);
+
+	/* The whole script was used, each -EAGAIN was recovered from */
+	if (d.script) {
+		unsigned int eagain = 0;
+
+		for (i = 0; d.script[i]; i++) {
+			if (d.script[i] == -EAGAIN)
+				eagain++;
+		}
+
+		g_assert_cmpuint(d.step, ==, i);
+		g_assert_cmpuint(d.eagain, ==, eagain);
+	}
+
+	g_byte_array_unref(d.data);
+}
+
+static void conn_complete_large(GObex *obex, GError *err, GObexPacket *rsp,
+							gpointer user_data)
+{
+	struct put_data *d = user_data;
+
+	if (err != NULL) {
+		d->err = g_error_copy(err);
+		g_main_loop_quit(d->mainloop);
+		return;
+	}
+
+	d->start = g_get_monotonic_time();
+
+	if (g_obex_put_req(obex, provide_data, put_complete, d, &d->err,
+				G_OBEX_HDR_NAME, "large.bin",
+				G_OBEX_HDR_LENGTH, (guint32) d->size,
+				G_OBEX_HDR_INVALID) == 0)
+		g_main_loop_quit(d->mainloop);
+}
+
+/*
+ * Measure a PUT going through obexd itself: the session receives the body
+ * with SRM and the filesystem plugin preallocates and writes the file.
+ */
+static void test_put_large(void)
+{
+	struct put_data d;
+	gchar *contents;
+	gint64 elapsed;
+	gsize len, i;
+	int fd;
+
+	memset(&d, 0, sizeof(d));
+
+	/* Only transfer enough to measure the throughput with -m perf */
+	d.size = g_test_perf() ? LARGE_SIZE_PERF : LARGE_SIZE;
+
+	fd = g_file_open_tmp("test-obexd-XXXXXX", &d.path, &d.err);
+	g_assert_no_error(d.err);
+	close(fd);
+
+	run_put(&d, LARGE_MTU, conn_complete_large);
+
+	elapsed = g_get_monotonic_time() - d.start;
+
+	g_assert_no_error(d.err);
+
+	g_assert(g_file_get_contents(d.path, &contents, &len, NULL));
+	g_assert_cmpuint(len, ==, d.size);
+	for (i = 0; i < len; i++)
+		g_assert_cmpuint((guint8) contents[i], ==, (guint8) i);
+
+	g_free(contents);
+	unlink(d.path);
+	g_free(d.path);
+
+	g_test_message("%zu bytes in %" G_GINT64_FORMAT " us (%"
+			G_GINT64_FORMAT " KiB/s)", len, elapsed, elapsed ?
+			(gint64) len * 1000000 / 1024 / elapsed : 0);
+}
+
+/* Short write of the first packet, the remainder is buffered */
+static const int script_short_eagain[] = { 100, -EAGAIN, 0 };
+
+/* Nothing written at all, the whole packet is buffered */
+static const int script_eagain[] = { -EAGAIN, 0 };
+
+/* Short write of the buffered remainder when resuming */
+static const int script_resume_short[] = { 100, -EAGAIN, 200, -EAGAIN, 0 };
+
+/* Blocking again later on, once the transfer is streaming */
+static const int script_late_eagain[] = { 1000, 1000, 1000, 1000, 1000, 1000,
+						1000, 1000, 10, -EAGAIN, 0 };
+
+static int copy_file_range_err;
+static unsigned int copy_file_range_calls;
+
+ssize_t copy_file_range(int fd_in, loff_t *off_in, int fd_out,
+				loff_t *off_out, size_t len, unsigned int flags)
+{
+	copy_file_range_calls++;
+
+	if (copy_file_range_err) {
+		errno = copy_file_range_err;
+		return -1;
+	}
+
+	return syscall(__NR_copy_file_range, fd_in, off_in, fd_out, off_out,
+								len, flags);
+}
+
+static void test_copy(const void *user_data)
+{
+	const struct obex_mime_type_driver *driver;
+	char src[] = "/tmp/test-obexd-XXXXXX";
+	char *dst;
+	guint8 buf[3 * TEST_MTU + 7];
+	gchar *contents;
+	gsize len, i;
+	int fd;
+
+	copy_file_range_err = GPOINTER_TO_INT(user_data);
+	copy_file_range_calls = 0;
+
+	/* The filesystem plugin handles objects without a type */
+	driver = obex_mime_type_driver_find(NULL, 0, NULL, NULL, 0);
+	g_assert(driver != NULL && driver->copy != NULL);
+
+	for (i = 0; i < sizeof(buf); i++)
+		buf[i] = i;
+
+	fd = mkstemp(src);
+	g_assert(fd >= 0);
+	g_assert(write(fd, buf, sizeof(buf)) == (ssize_t) sizeof(buf));
+	close(fd);
+
+	dst = g_strconcat(src, ".copy", NULL);
+
+	g_assert_cmpint(driver->copy(src, dst), ==, 0);
+
+	/* On failure copy_file_range is not retried, sendfile is used */
+	if (copy_file_range_err)
+		g_assert_cmpuint(copy_file_range_calls, ==, 1);
+	else
+		g_assert_cmpuint(copy_file_range_calls, >=, 1);
+
+	g_assert(g_file_get_contents(dst, &contents, &len, NULL));
+	g_assert_cmpuint(len, ==, sizeof(buf));
+	g_assert(memcmp(contents, buf, len) == 0);
+
+	g_free(contents);
+	unlink(dst);
+	unlink(src);
+	g_free(dst);
+}
+
+int main(int argc, char *argv[])
+{
+	int ret;
+
+	g_test_init(&argc, &argv, NULL);
+
+	g_assert(__obex_builtin_filesystem.init() == 0);
+
+	g_test_add_data_func("/obexd/put", NULL, test_put_script);
+	g_test_add_data_func("/obexd/put_short_eagain", script_short_eagain,
+							test_put_script);
+	g_test_add_data_func("/obexd/put_eagain", script_eagain,
+							test_put_script);
+	g_test_add_data_func("/obexd/put_resume_short", script_resume_short,
+							test_put_script);
+	g_test_add_data_func("/obexd/put_late_eagain", script_late_eagain,
+							test_put_script);
+
+	g_test_add_func("/obexd/put_large", test_put_large);
+
+	g_test_add_data_func("/obexd/copy", GINT_TO_POINTER(0), test_copy);
+	g_test_add_data_func("/obexd/copy_exdev", GINT_TO_POINTER(EXDEV),
+								test_copy);
+	g_test_add_data_func("/obexd/copy_einval", GINT_TO_POINTER(EINVAL),
+								test_copy);
+
+	ret = g_test_run();
+
+	__obex_builtin_filesystem.exit();
+
+	return ret;
+}